@@ -99,7 +99,7 @@
       'type': 'static_library',
       'toolsets': ['host', 'target'],
       'sources': [
-        '<(gen_out_dir)/character_set.inc',
+        '<(gen_out_dir)/unicode_table.inc',
         '<(gen_out_dir)/version_def.h',
         'file_stream.cc',
         'file_util.cc',
@@ -108,9 +108,12 @@
         'logging.cc',
         'mmap.cc',
         'number_util.cc',
+        'parallel.cc',
+        'simd_util.cc',
         'system_util.cc',
         'text_normalizer.cc',
         'thread.cc',
+        'trace.cc',
         'util.cc',
         'version.cc',
         'win_util.cc',
@@ -118,7 +121,7 @@
       'dependencies': [
         'clock',
         'flags',
-        'gen_character_set#host',
+        'gen_unicode_table#host',
         'gen_version_def#host',
         'hash',
         'mutex',
@@ -240,12 +243,12 @@
       ],
     },
     {
-      'target_name': 'gen_character_set',
+      'target_name': 'gen_unicode_table',
       'type': 'none',
       'toolsets': ['host'],
       'actions': [
         {
-          'action_name': 'gen_character_set',
+          'action_name': 'gen_unicode_table',
           'variables': {
             'input_files': [
               '../data/unicode/CP932.TXT',
@@ -257,19 +260,20 @@
           },
           'inputs': [
             'gen_character_set.py',
+            'gen_unicode_table.py',
             '<@(input_files)',
           ],
           'outputs': [
-            '<(gen_out_dir)/character_set.inc',
+            '<(gen_out_dir)/unicode_table.inc',
           ],
           'action': [
-            'python', 'gen_character_set.py',
+            'python', 'gen_unicode_table.py',
             '--cp932file=../data/unicode/CP932.TXT',
             '--jisx0201file=../data/unicode/JIS0201.TXT',
             '--jisx0208file=../data/unicode/JIS0208.TXT',
             '--jisx0212file=../data/unicode/JIS0212.TXT',
             '--jisx0213file=../data/unicode/jisx0213-2004-std.txt',
-            '--output=<(gen_out_dir)/character_set.inc'
+            '--output=<(gen_out_dir)/unicode_table.inc'
           ],
         },
       ],
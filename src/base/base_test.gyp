@@ -135,14 +135,18 @@
       'sources': [
         'bitarray_test.cc',
         'flags_test.cc',
+        'freelist_test.cc',
         'iterator_adapter_test.cc',
         'logging_test.cc',
         'mmap_test.cc',
+        'parallel_test.cc',
+        'simd_util_test.cc',
         'singleton_test.cc',
         'stl_util_test.cc',
         'string_piece_test.cc',
         'text_normalizer_test.cc',
         'thread_test.cc',
+        'trace_test.cc',
         'version_test.cc',
       ],
       'conditions': [
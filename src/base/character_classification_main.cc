@@ -0,0 +1,161 @@
+// Copyright 2010-2018, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Benchmark for the character classification in Util.
+//
+// Reads the values of dictionary source files and reports the time per string
+// of Util::GetScriptType, GetFormType and GetCharacterSet, both for the
+// strings and for each of their characters.  The keys, which are hiragana,
+// are used for Util::IsScriptType(HIRAGANA).
+//
+// Usage:
+//   character_classification_main
+//     --input="data/dictionary_oss/dictionary00.txt ..." --iterations=20
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "base/file_stream.h"
+#include "base/flags.h"
+#include "base/init_mozc.h"
+#include "base/logging.h"
+#include "base/port.h"
+#include "base/stopwatch.h"
+#include "base/util.h"
+
+DEFINE_string(input, "", "space separated dictionary source files");
+DEFINE_int32(iterations, 20, "Number of passes over the values.");
+
+namespace mozc {
+namespace {
+
+// Reads the key and value columns of the dictionary source files.
+void LoadEntries(const string &files, std::vector<string> *keys,
+                 std::vector<string> *values) {
+  std::vector<string> filenames;
+  Util::SplitStringUsing(files, " ", &filenames);
+  for (size_t i = 0; i < filenames.size(); ++i) {
+    InputFileStream ifs(filenames[i].c_str());
+    CHECK(ifs.good()) << "Failed to open " << filenames[i];
+    string line;
+    std::vector<string> columns;
+    while (!getline(ifs, line).fail()) {
+      columns.clear();
+      Util::SplitStringAllowEmpty(line, "\t", &columns);
+      if (columns.size() < 5) {
+        continue;
+      }
+      keys->push_back(columns[0]);
+      values->push_back(columns[4]);
+    }
+  }
+}
+
+template <typename Func>
+void RunBenchmark(const char *name, const std::vector<string> &values,
+                  Func func) {
+  int64 checksum = 0;
+  Stopwatch stopwatch = Stopwatch::StartNew();
+  for (int i = 0; i < FLAGS_iterations; ++i) {
+    for (size_t j = 0; j < values.size(); ++j) {
+      checksum += func(values[j]);
+    }
+  }
+  stopwatch.Stop();
+  const double num_calls = static_cast<double>(values.size()) *
+                           FLAGS_iterations;
+  std::cout << name << ": "
+            << stopwatch.GetElapsedNanoseconds() / num_calls
+            << " ns/string checksum=" << checksum << std::endl;
+}
+
+int SumOfScriptTypes(const string &value) {
+  int sum = 0;
+  for (ConstChar32Iterator iter(value); !iter.Done(); iter.Next()) {
+    sum += Util::GetScriptType(iter.Get());
+  }
+  return sum;
+}
+
+int SumOfFormTypes(const string &value) {
+  int sum = 0;
+  for (ConstChar32Iterator iter(value); !iter.Done(); iter.Next()) {
+    sum += Util::GetFormType(iter.Get());
+  }
+  return sum;
+}
+
+int SumOfCharacterSets(const string &value) {
+  int sum = 0;
+  for (ConstChar32Iterator iter(value); !iter.Done(); iter.Next()) {
+    sum += Util::GetCharacterSet(iter.Get());
+  }
+  return sum;
+}
+
+}  // namespace
+}  // namespace mozc
+
+int main(int argc, char **argv) {
+  mozc::InitMozc(argv[0], &argc, &argv, false);
+
+  std::vector<string> keys, values;
+  mozc::LoadEntries(FLAGS_input, &keys, &values);
+  CHECK(!values.empty()) << "No values in --input";
+  std::cout << "values=" << values.size() << std::endl;
+
+  mozc::RunBenchmark("GetScriptType(char32)", values,
+                     mozc::SumOfScriptTypes);
+  mozc::RunBenchmark("GetFormType(char32)", values, mozc::SumOfFormTypes);
+  mozc::RunBenchmark("GetCharacterSet(char32)", values,
+                     mozc::SumOfCharacterSets);
+  mozc::RunBenchmark("GetScriptType(string)", values,
+                     [](const string &value) {
+                       return mozc::Util::GetScriptType(value);
+                     });
+  mozc::RunBenchmark("GetScriptTypeWithoutSymbols", values,
+                     [](const string &value) {
+                       return mozc::Util::GetScriptTypeWithoutSymbols(value);
+                     });
+  mozc::RunBenchmark("IsScriptType(HIRAGANA) for keys", keys,
+                     [](const string &value) {
+                       return static_cast<int>(mozc::Util::IsScriptType(
+                           value, mozc::Util::HIRAGANA));
+                     });
+  mozc::RunBenchmark("GetFormType(string)", values,
+                     [](const string &value) {
+                       return mozc::Util::GetFormType(value);
+                     });
+  mozc::RunBenchmark("GetCharacterSet(string)", values,
+                     [](const string &value) {
+                       return mozc::Util::GetCharacterSet(value);
+                     });
+  return 0;
+}
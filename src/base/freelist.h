@@ -30,7 +30,9 @@
 #ifndef MOZC_BASE_FREELIST_H_
 #define MOZC_BASE_FREELIST_H_
 
+#include <algorithm>
 #include <vector>
+
 #include "base/port.h"
 
 namespace mozc {
@@ -47,7 +49,8 @@ namespace mozc {
 template <class T> class FreeList {
  public:
   explicit FreeList(size_t size)
-      : current_index_(0), chunk_index_(0), size_(size) {
+      : current_index_(0), chunk_index_(0), size_(size),
+        max_retained_chunks_(1), allocated_chunks_(0), reused_chunks_(0) {
   }
 
   ~FreeList() {
@@ -60,12 +63,19 @@ template <class T> class FreeList {
     chunk_index_ = current_index_ = 0;
   }
 
+  // Invalidates all the objects allocated so far.  The chunks used since the
+  // last Free() are kept for reuse up to max_retained_chunks(), so that a
+  // steady workload doesn't allocate chunks at all.  The rest are deleted.
   void Free() {
-    for (size_t i = 1; i < pool_.size(); ++i) {
+    const size_t used_chunks =
+        (chunk_index_ == 0 && current_index_ == 0) ? 1 : chunk_index_ + 1;
+    const size_t retained_chunks = std::max<size_t>(
+        1, std::min(used_chunks, max_retained_chunks_));
+    for (size_t i = retained_chunks; i < pool_.size(); ++i) {
       delete [] pool_[i];
     }
-    if (pool_.size() > 1) {
-      pool_.resize(1);
+    if (pool_.size() > retained_chunks) {
+      pool_.resize(retained_chunks);
     }
     current_index_ = 0;
     chunk_index_ = 0;
@@ -79,10 +89,14 @@ template <class T> class FreeList {
     if ((current_index_ + len) >= size_) {
       chunk_index_++;
       current_index_ = 0;
+      if (chunk_index_ < pool_.size()) {
+        ++reused_chunks_;
+      }
     }
 
     if (chunk_index_ == pool_.size()) {
       pool_.push_back(new T[size_]);
+      ++allocated_chunks_;
     }
 
     T* r = pool_[chunk_index_] + current_index_;
@@ -94,11 +108,51 @@ template <class T> class FreeList {
     size_ = size;
   }
 
+  // The upper bound of the number of chunks kept by Free().  The default is 1,
+  // i.e., only the first chunk is reused.
+  size_t max_retained_chunks() const {
+    return max_retained_chunks_;
+  }
+
+  void set_max_retained_chunks(size_t max_retained_chunks) {
+    max_retained_chunks_ = max_retained_chunks;
+  }
+
+  // Bytes of the chunks currently held, including the ones in use.
+  size_t retained_bytes() const {
+    return pool_.size() * size_ * sizeof(T);
+  }
+
+  // Returns true if |ptr| points into one of the chunks held.  All the chunks
+  // are assumed to be of the current size.
+  bool Contains(const T *ptr) const {
+    for (size_t i = 0; i < pool_.size(); ++i) {
+      if (ptr >= pool_[i] && ptr < pool_[i] + size_) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // The number of chunks allocated with new[] so far.
+  uint64 allocated_chunks() const {
+    return allocated_chunks_;
+  }
+
+  // The number of chunk allocations avoided by reusing retained chunks.  The
+  // first chunk, which is always reused, is not counted.
+  uint64 reused_chunks() const {
+    return reused_chunks_;
+  }
+
  private:
   std::vector<T *> pool_;
   size_t current_index_;
   size_t chunk_index_;
   size_t size_;
+  size_t max_retained_chunks_;
+  uint64 allocated_chunks_;
+  uint64 reused_chunks_;
 
   DISALLOW_COPY_AND_ASSIGN(FreeList);
 };
@@ -133,6 +187,26 @@ template <class T> class ObjectPool {
     freelist_.set_size(size);
   }
 
+  void set_max_retained_chunks(size_t max_retained_chunks) {
+    freelist_.set_max_retained_chunks(max_retained_chunks);
+  }
+
+  size_t retained_bytes() const {
+    return freelist_.retained_bytes();
+  }
+
+  bool Contains(const T *ptr) const {
+    return freelist_.Contains(ptr);
+  }
+
+  uint64 allocated_chunks() const {
+    return freelist_.allocated_chunks();
+  }
+
+  uint64 reused_chunks() const {
+    return freelist_.reused_chunks();
+  }
+
  private:
   std::vector<T *> released_;
   FreeList<T> freelist_;
@@ -0,0 +1,126 @@
+// Copyright 2010-2018, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "base/freelist.h"
+
+#include <vector>
+
+#include "testing/base/public/gunit.h"
+
+namespace mozc {
+namespace {
+
+// Allocates |num| objects one by one.
+template <class T>
+void AllocObjects(FreeList<T> *freelist, size_t num) {
+  for (size_t i = 0; i < num; ++i) {
+    EXPECT_NE(nullptr, freelist->Alloc());
+  }
+}
+
+TEST(FreeListTest, KeepsOnlyFirstChunkByDefault) {
+  FreeList<int> freelist(10);
+  EXPECT_EQ(1, freelist.max_retained_chunks());
+
+  AllocObjects(&freelist, 35);
+  EXPECT_EQ(4, freelist.allocated_chunks());
+  EXPECT_EQ(4 * 10 * sizeof(int), freelist.retained_bytes());
+
+  freelist.Free();
+  EXPECT_EQ(10 * sizeof(int), freelist.retained_bytes());
+
+  AllocObjects(&freelist, 35);
+  EXPECT_EQ(7, freelist.allocated_chunks());
+  EXPECT_EQ(0, freelist.reused_chunks());
+}
+
+TEST(FreeListTest, RetainsChunksUpToHighWaterMark) {
+  FreeList<int> freelist(10);
+  freelist.set_max_retained_chunks(8);
+
+  AllocObjects(&freelist, 35);
+  EXPECT_EQ(4, freelist.allocated_chunks());
+  freelist.Free();
+  EXPECT_EQ(4 * 10 * sizeof(int), freelist.retained_bytes());
+
+  // The same workload doesn't allocate any chunk.
+  AllocObjects(&freelist, 35);
+  EXPECT_EQ(4, freelist.allocated_chunks());
+  EXPECT_EQ(3, freelist.reused_chunks());
+
+  // A smaller workload shrinks the retained chunks to what it used.
+  freelist.Free();
+  AllocObjects(&freelist, 5);
+  freelist.Free();
+  EXPECT_EQ(10 * sizeof(int), freelist.retained_bytes());
+}
+
+TEST(FreeListTest, RetainedChunksAreCapped) {
+  FreeList<int> freelist(10);
+  freelist.set_max_retained_chunks(2);
+
+  AllocObjects(&freelist, 100);
+  freelist.Free();
+  EXPECT_EQ(2 * 10 * sizeof(int), freelist.retained_bytes());
+}
+
+TEST(FreeListTest, ReusesSameMemory) {
+  FreeList<int> freelist(4);
+  freelist.set_max_retained_chunks(4);
+
+  std::vector<int *> first;
+  for (int i = 0; i < 10; ++i) {
+    first.push_back(freelist.Alloc());
+    *first.back() = i;
+  }
+  freelist.Free();
+  for (int i = 0; i < 10; ++i) {
+    int *ptr = freelist.Alloc();
+    EXPECT_EQ(first[i], ptr);
+    EXPECT_EQ(i, *ptr);
+  }
+}
+
+TEST(ObjectPoolTest, ForwardsRetention) {
+  ObjectPool<int> pool(10);
+  pool.set_max_retained_chunks(4);
+  for (int i = 0; i < 25; ++i) {
+    pool.Alloc();
+  }
+  pool.Free();
+  EXPECT_EQ(3 * 10 * sizeof(int), pool.retained_bytes());
+  for (int i = 0; i < 25; ++i) {
+    pool.Alloc();
+  }
+  EXPECT_EQ(3, pool.allocated_chunks());
+  EXPECT_EQ(2, pool.reused_chunks());
+}
+
+}  // namespace
+}  // namespace mozc
@@ -0,0 +1,286 @@
+# -*- coding: utf-8 -*-
+# Copyright 2010-2018, Google Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met:
+#
+#     * Redistributions of source code must retain the above copyright
+# notice, this list of conditions and the following disclaimer.
+#     * Redistributions in binary form must reproduce the above
+# copyright notice, this list of conditions and the following disclaimer
+# in the documentation and/or other materials provided with the
+# distribution.
+#     * Neither the name of Google Inc. nor the names of its
+# contributors may be used to endorse or promote products derived from
+# this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+# A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+# OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+# SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+# LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+# DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+# THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+"""Generates a two-level lookup table of Unicode character properties.
+
+Each code point is classified into the script type, the form type and the
+character set used by Util::GetScriptType, Util::GetFormType and
+Util::GetCharacterSet, and the three are packed into one byte.  The code
+points are split into blocks of 2^BLOCK_SHIFT; identical blocks are shared, so
+a lookup costs one load from the block index and one from the block data.
+"""
+
+import optparse
+import sys
+
+from gen_character_set import CodePointCategorizer
+
+
+MAX_CODEPOINT = 0x10FFFF
+BLOCK_SHIFT = 7
+
+# These lists must be in the order of the enums in base/util.h.
+SCRIPT_TYPES = ['UNKNOWN_SCRIPT', 'KATAKANA', 'HIRAGANA', 'KANJI', 'NUMBER',
+                'ALPHABET', 'EMOJI']
+FORM_TYPES = ['UNKNOWN_FORM', 'HALF_WIDTH', 'FULL_WIDTH']
+CHARACTER_SETS = ['ASCII', 'JISX0201', 'JISX0208', 'JISX0212', 'JISX0213',
+                  'CP932', 'UNICODE_ONLY']
+
+# Bit layout of a property byte.
+SCRIPT_TYPE_SHIFT = 0
+FORM_TYPE_SHIFT = 3
+CHARACTER_SET_SHIFT = 5
+
+# Ranges of the script types.  The first matching entry wins.
+# TODO(yukawa, team): Make a mechanism to keep this classifier up-to-date
+#   based on the original data from Unicode.org.
+SCRIPT_TYPE_RANGES = [
+    ('NUMBER', 0x0030, 0x0039),    # ascii number
+    ('NUMBER', 0xFF10, 0xFF19),    # full width number
+    ('ALPHABET', 0x0041, 0x005A),  # ascii upper
+    ('ALPHABET', 0x0061, 0x007A),  # ascii lower
+    ('ALPHABET', 0xFF21, 0xFF3A),  # fullwidth ascii upper
+    ('ALPHABET', 0xFF41, 0xFF5A),  # fullwidth ascii lower
+    # As of Unicode 6.0.2, each block has the following characters assigned.
+    # [U+3400, U+4DB5]:   CJK Unified Ideographs Extension A
+    # [U+4E00, U+9FCB]:   CJK Unified Ideographs
+    # [U+4E00, U+FAD9]:   CJK Compatibility Ideographs
+    # [U+20000, U+2A6D6]: CJK Unified Ideographs Extension B
+    # [U+2A700, U+2B734]: CJK Unified Ideographs Extension C
+    # [U+2B740, U+2B81D]: CJK Unified Ideographs Extension D
+    # [U+2F800, U+2FA1D]: CJK Compatibility Ideographs
+    ('KANJI', 0x3005, 0x3005),     # IDEOGRAPHIC ITERATION MARK
+    ('KANJI', 0x3400, 0x4DBF),     # CJK Unified Ideographs Extension A
+    ('KANJI', 0x4E00, 0x9FFF),     # CJK Unified Ideographs
+    ('KANJI', 0xF900, 0xFAFF),     # CJK Compatibility Ideographs
+    ('KANJI', 0x20000, 0x2A6DF),   # CJK Unified Ideographs Extension B
+    ('KANJI', 0x2A700, 0x2B73F),   # CJK Unified Ideographs Extension C
+    ('KANJI', 0x2B740, 0x2B81F),   # CJK Unified Ideographs Extension D
+    ('KANJI', 0x2F800, 0x2FA1F),   # CJK Compatibility Ideographs
+    ('HIRAGANA', 0x3041, 0x309F),  # hiragana
+    ('HIRAGANA', 0x1B001, 0x1B001),  # HIRAGANA LETTER ARCHAIC YE
+    ('KATAKANA', 0x30A1, 0x30FF),  # full width katakana
+    ('KATAKANA', 0x31F0, 0x31FF),  # Katakana Phonetic Extensions for Ainu
+    ('KATAKANA', 0xFF65, 0xFF9F),  # half width katakana
+    ('KATAKANA', 0x1B000, 0x1B000),  # KATAKANA LETTER ARCHAIC E
+    ('EMOJI', 0x02300, 0x023F3),   # Miscellaneous Technical
+    ('EMOJI', 0x02700, 0x027BF),   # Dingbats
+    ('EMOJI', 0x1F000, 0x1F02F),   # Mahjong tiles
+    ('EMOJI', 0x1F030, 0x1F09F),   # Domino tiles
+    ('EMOJI', 0x1F0A0, 0x1F0FF),   # Playing cards
+    ('EMOJI', 0x1F100, 0x1F2FF),   # Enclosed Alphanumeric Supplement
+    ('EMOJI', 0x1F200, 0x1F2FF),   # Enclosed Ideographic Supplement
+    ('EMOJI', 0x1F300, 0x1F5FF),   # Miscellaneous Symbols And Pictographs
+    ('EMOJI', 0x1F600, 0x1F64F),   # Emoticons
+    ('EMOJI', 0x1F680, 0x1F6FF),   # Transport And Map Symbols
+    ('EMOJI', 0x1F700, 0x1F77F),   # Alchemical Symbols
+    ('EMOJI', 0x26CE, 0x26CE),     # Ophiuchus
+    ('EMOJI', 0xFE000, 0xFEEA0),   # Google PUA emoji
+]
+
+# Ranges of the half width characters, i.e. the characters marked as 'Na' or
+# 'H' in 'Unicode Standard Annex #11: EAST ASIAN WIDTH'
+# http://www.unicode.org/reports/tr11/
+# http://www.unicode.org/Public/UNIDATA/EastAsianWidth.txt
+# The other characters are full width.
+HALF_WIDTH_RANGES = [
+    (0x0020, 0x007F),  # ascii
+    (0x27E6, 0x27ED),  # narrow mathematical symbols
+    (0x2985, 0x2986),  # narrow white parentheses
+    (0x00A2, 0x00A3),  # CENT SIGN, POUND SIGN
+    (0x00A5, 0x00A6),  # YEN SIGN, BROKEN BAR
+    (0x00AC, 0x00AC),  # NOT SIGN
+    (0x00AF, 0x00AF),  # MACRON
+    (0x20A9, 0x20A9),  # WON SIGN
+    (0xFF61, 0xFF9F),  # half-width katakana
+    (0xFFA0, 0xFFBE),  # half-width hangul
+    (0xFFC2, 0xFFCF),  # half-width hangul
+    (0xFFD2, 0xFFD7),  # half-width hangul
+    (0xFFDA, 0xFFDC),  # half-width hangul
+    (0xFFE8, 0xFFEE),  # half-width symbols
+]
+
+
+# Properties of the code points beyond MAX_CODEPOINT.
+OUT_OF_RANGE_PROPERTY = (
+    (SCRIPT_TYPES.index('UNKNOWN_SCRIPT') << SCRIPT_TYPE_SHIFT) |
+    (FORM_TYPES.index('FULL_WIDTH') << FORM_TYPE_SHIFT) |
+    (CHARACTER_SETS.index('UNICODE_ONLY') << CHARACTER_SET_SHIFT))
+
+
+def ParseOptions():
+  """Parses command line options."""
+  parser = optparse.OptionParser()
+  parser.add_option('--cp932file', dest='cp932file',
+                    help='File path for the unicode\'s CP932.TXT file')
+  parser.add_option('--jisx0201file', dest='jisx0201file',
+                    help='File path for the unicode\'s JIS0201.TXT file')
+  parser.add_option('--jisx0208file', dest='jisx0208file',
+                    help='File path for the unicode\'s JIS0208.TXT file')
+  parser.add_option('--jisx0212file', dest='jisx0212file',
+                    help='File path for the unicode\'s JIS0212.TXT file')
+  parser.add_option('--jisx0213file', dest='jisx0213file',
+                    help='File path for the unicode\'s jisx0213-2004-std.txt '
+                    'file')
+  parser.add_option('--output', dest='output',
+                    help='output file path. If not specified, '
+                    'output to stdout.')
+
+  return parser.parse_args()[0]
+
+
+def FillRanges(table, ranges, value, overwrite):
+  """Sets value to the table for the code points in the ranges."""
+  for first, last in ranges:
+    for codepoint in range(first, last + 1):
+      if overwrite or table[codepoint] is None:
+        table[codepoint] = value
+
+
+def BuildPropertyList(categorizer):
+  """Returns a list of the property bytes of all the code points."""
+  script_types = [None] * (MAX_CODEPOINT + 1)
+  for script_type, first, last in SCRIPT_TYPE_RANGES:
+    FillRanges(script_types, [(first, last)], script_type, False)
+
+  form_types = ['FULL_WIDTH'] * (MAX_CODEPOINT + 1)
+  FillRanges(form_types, HALF_WIDTH_RANGES, 'HALF_WIDTH', True)
+
+  properties = []
+  for codepoint in range(MAX_CODEPOINT + 1):
+    script_type = script_types[codepoint] or 'UNKNOWN_SCRIPT'
+    character_set = categorizer.GetCategory(codepoint)
+    properties.append(
+        (SCRIPT_TYPES.index(script_type) << SCRIPT_TYPE_SHIFT) |
+        (FORM_TYPES.index(form_types[codepoint]) << FORM_TYPE_SHIFT) |
+        (CHARACTER_SETS.index(character_set) << CHARACTER_SET_SHIFT))
+  return properties
+
+
+def BuildTwoLevelTable(properties):
+  """Splits the properties into blocks and shares the identical ones.
+
+  Args:
+    properties: a list of the property bytes of all the code points.
+  Returns:
+    A tuple of the block index of each block of the code points and the list
+    of the distinct blocks.  The first block always covers ASCII.
+  """
+  block_size = 1 << BLOCK_SHIFT
+  block_ids = {}
+  blocks = []
+  index = []
+  for begin in range(0, len(properties), block_size):
+    block = tuple(properties[begin:begin + block_size])
+    if block not in block_ids:
+      block_ids[block] = len(blocks)
+      blocks.append(block)
+    index.append(block_ids[block])
+  return index, blocks
+
+
+def GenerateArray(type_name, name, values, values_per_line):
+  """Generates lines of a C++ array definition."""
+  lines = ['const %s %s[] = {\n' % (type_name, name)]
+  for begin in range(0, len(values), values_per_line):
+    lines.append('    %s,\n' % ', '.join(
+        '0x%02X' % value for value in values[begin:begin + values_per_line]))
+  lines.append('};\n')
+  return lines
+
+
+def GenerateUnicodeTable(properties):
+  """Generates lines of unicode_table.inc file."""
+  index, blocks = BuildTwoLevelTable(properties)
+  assert len(blocks) <= 0xFFFF
+
+  lines = ['// This file is generated by base/gen_unicode_table.py\n',
+           '// Do not edit me!\n',
+           '\n']
+
+  # The property values are stored as the enum values of Util.
+  for names in (SCRIPT_TYPES, FORM_TYPES, CHARACTER_SETS):
+    for value, name in enumerate(names):
+      lines.append('static_assert(Util::%s == %d, "Enum changed.");\n' %
+                   (name, value))
+  lines.append('\n')
+
+  lines.extend([
+      'namespace {\n',
+      '\n',
+      'const char32 kUnicodeTableMaxCodePoint = 0x%X;\n' % MAX_CODEPOINT,
+      'const int kUnicodeTableBlockShift = %d;\n' % BLOCK_SHIFT,
+      'const int kScriptTypeShift = %d;\n' % SCRIPT_TYPE_SHIFT,
+      'const int kFormTypeShift = %d;\n' % FORM_TYPE_SHIFT,
+      'const int kCharacterSetShift = %d;\n' % CHARACTER_SET_SHIFT,
+      'const uint8 kScriptTypeMask = 0x%02X;\n' % (
+          ((1 << FORM_TYPE_SHIFT) - 1) >> SCRIPT_TYPE_SHIFT),
+      'const uint8 kFormTypeMask = 0x%02X;\n' % (
+          ((1 << CHARACTER_SET_SHIFT) - 1) >> FORM_TYPE_SHIFT),
+      'const uint8 kCharacterSetMask = 0x%02X;\n' % (
+          0xFF >> CHARACTER_SET_SHIFT),
+      '\n',
+      '// Properties of the code points beyond kUnicodeTableMaxCodePoint.\n',
+      'const uint8 kOutOfRangeProperty = 0x%02X;\n' % OUT_OF_RANGE_PROPERTY,
+      '\n'])
+
+  # Block index of each 2^BLOCK_SHIFT code points.
+  lines.extend(GenerateArray('uint16', 'kUnicodeTableIndex', index, 12))
+  lines.append('\n')
+
+  # Properties of the distinct blocks.
+  data = [value for block in blocks for value in block]
+  lines.extend(GenerateArray('uint8', 'kUnicodeTableData', data, 16))
+  lines.extend(['\n',
+                '}  // namespace\n'])
+  return lines
+
+
+def main():
+  options = ParseOptions()
+  categorizer = CodePointCategorizer(options.cp932file,
+                                     options.jisx0201file,
+                                     options.jisx0208file,
+                                     options.jisx0212file,
+                                     options.jisx0213file)
+  lines = GenerateUnicodeTable(BuildPropertyList(categorizer))
+
+  if options.output:
+    output = open(options.output, 'w')
+    try:
+      output.writelines(lines)
+    finally:
+      output.close()
+  else:
+    sys.stdout.writelines(lines)
+
+
+if __name__ == '__main__':
+  main()
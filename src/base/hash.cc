@@ -29,6 +29,9 @@
 
 #include "base/hash.h"
 
+#include <algorithm>
+#include <cstring>
+
 #include "base/port.h"
 
 namespace mozc {
@@ -56,65 +59,86 @@ uint32 Hash::Fingerprint32(StringPiece str) {
   return Fingerprint32WithSeed(str, kFingerPrint32Seed);
 }
 
-uint32 Hash::Fingerprint32WithSeed(StringPiece str, uint32 seed) {
 #define U32(x) static_cast<uint32>(x)
 #define ToUint32(a, b, c, d) \
   (U32(a) + (U32(b) << 8) + (U32(c) << 16) + (U32(d) << 24))
 
-  const uint32 str_len = U32(str.size());
-  uint32 a = 0x9e3779b9;
-  uint32 b = a;
-  uint32 c = seed;
+namespace {
 
-  while (str.size() >= 12) {
-    a += ToUint32(str[0], str[1], str[2], str[3]);
-    b += ToUint32(str[4], str[5], str[6], str[7]);
-    c += ToUint32(str[8], str[9], str[10], str[11]);
-    Mix(a, b, c);
-    str.remove_prefix(12);
-  }
+const size_t kBlockSize = 12;
+
+inline void AddBlock(const char *p, uint32 *a, uint32 *b, uint32 *c) {
+  *a += ToUint32(p[0], p[1], p[2], p[3]);
+  *b += ToUint32(p[4], p[5], p[6], p[7]);
+  *c += ToUint32(p[8], p[9], p[10], p[11]);
+  Mix(*a, *b, *c);
+}
 
-  c += U32(str_len);
-  switch (str.size()) {
+// Adds the last |size| (< kBlockSize) bytes and the total length |length|,
+// and returns the hash value.
+inline uint32 Finish(const char *p, size_t size, uint32 length,
+                     uint32 a, uint32 b, uint32 c) {
+  c += length;
+  switch (size) {
     case 11:
-      c += U32(str[10]) << 24;
+      c += U32(p[10]) << 24;
       FALLTHROUGH_INTENDED;
     case 10:
-      c += U32(str[9]) << 16;
+      c += U32(p[9]) << 16;
       FALLTHROUGH_INTENDED;
     case 9:
-      c += U32(str[8]) << 8;
+      c += U32(p[8]) << 8;
       FALLTHROUGH_INTENDED;
     case 8:
-      b += U32(str[7]) << 24;
+      b += U32(p[7]) << 24;
       FALLTHROUGH_INTENDED;
     case 7:
-      b += U32(str[6]) << 16;
+      b += U32(p[6]) << 16;
       FALLTHROUGH_INTENDED;
     case 6:
-      b += U32(str[5]) << 8;
+      b += U32(p[5]) << 8;
       FALLTHROUGH_INTENDED;
     case 5:
-      b += U32(str[4]);
+      b += U32(p[4]);
       FALLTHROUGH_INTENDED;
     case 4:
-      a += U32(str[3]) << 24;
+      a += U32(p[3]) << 24;
       FALLTHROUGH_INTENDED;
     case 3:
-      a += U32(str[2]) << 16;
+      a += U32(p[2]) << 16;
       FALLTHROUGH_INTENDED;
     case 2:
-      a += U32(str[1]) << 8;
+      a += U32(p[1]) << 8;
       FALLTHROUGH_INTENDED;
     case 1:
-      a += U32(str[0]);
+      a += U32(p[0]);
       break;
   }
   Mix(a, b, c);
-
   return c;
-#undef ToUint32
-#undef U32
+}
+
+uint64 Combine(uint32 hi, uint32 lo) {
+  uint64 result = static_cast<uint64>(hi) << 32 | static_cast<uint64>(lo);
+  if ((hi == 0) && (lo < 2)) {
+    result ^= GG_ULONGLONG(0x130f9bef94a0a928);
+  }
+  return result;
+}
+
+}  // namespace
+
+uint32 Hash::Fingerprint32WithSeed(StringPiece str, uint32 seed) {
+  const uint32 str_len = U32(str.size());
+  uint32 a = 0x9e3779b9;
+  uint32 b = a;
+  uint32 c = seed;
+
+  while (str.size() >= kBlockSize) {
+    AddBlock(str.data(), &a, &b, &c);
+    str.remove_prefix(kBlockSize);
+  }
+  return Finish(str.data(), str.size(), str_len, a, b, c);
 }
 
 uint64 Hash::Fingerprint(StringPiece str) {
@@ -122,13 +146,48 @@ uint64 Hash::Fingerprint(StringPiece str) {
 }
 
 uint64 Hash::FingerprintWithSeed(StringPiece str, uint32 seed) {
-  const uint32 hi = Fingerprint32WithSeed(str, seed);
-  const uint32 lo = Fingerprint32WithSeed(str, kFingerPrintSeed1);
-  uint64 result = static_cast<uint64>(hi) << 32 | static_cast<uint64>(lo);
-  if ((hi == 0) && (lo < 2)) {
-    result ^= GG_ULONGLONG(0x130f9bef94a0a928);
+  return Combine(Fingerprint32WithSeed(str, seed),
+                 Fingerprint32WithSeed(str, kFingerPrintSeed1));
+}
+
+FingerprintBuilder::FingerprintBuilder(uint32 seed)
+    : block_size_(0), length_(0) {
+  a_[0] = a_[1] = 0x9e3779b9;
+  b_[0] = b_[1] = 0x9e3779b9;
+  c_[0] = seed;
+  c_[1] = kFingerPrintSeed1;
+}
+
+void FingerprintBuilder::Append(StringPiece str) {
+  // The blocks are copied to |block_| only when they straddle the pieces.
+  length_ += U32(str.size());
+  if (block_size_ > 0) {
+    const size_t n = std::min(kBlockSize - block_size_, str.size());
+    memcpy(block_ + block_size_, str.data(), n);
+    block_size_ += n;
+    str.remove_prefix(n);
+    if (block_size_ < kBlockSize) {
+      return;
+    }
+    AddBlock(block_, &a_[0], &b_[0], &c_[0]);
+    AddBlock(block_, &a_[1], &b_[1], &c_[1]);
+    block_size_ = 0;
   }
-  return result;
+  while (str.size() >= kBlockSize) {
+    AddBlock(str.data(), &a_[0], &b_[0], &c_[0]);
+    AddBlock(str.data(), &a_[1], &b_[1], &c_[1]);
+    str.remove_prefix(kBlockSize);
+  }
+  memcpy(block_, str.data(), str.size());
+  block_size_ = str.size();
 }
 
+uint64 FingerprintBuilder::Fingerprint() const {
+  return Combine(Finish(block_, block_size_, length_, a_[0], b_[0], c_[0]),
+                 Finish(block_, block_size_, length_, a_[1], b_[1], c_[1]));
+}
+
+#undef ToUint32
+#undef U32
+
 }  // namespace mozc
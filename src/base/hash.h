@@ -83,6 +83,36 @@ class Hash {
   DISALLOW_IMPLICIT_CONSTRUCTORS(Hash);
 };
 
+// Calculates the same fingerprint as Hash::FingerprintWithSeed() of a string
+// from its pieces, without building the string.  The builder can be copied
+// to share the computation of a common prefix between strings:
+//
+//   FingerprintBuilder prefix(seed);
+//   prefix.Append(key);
+//   FingerprintBuilder builder = prefix;
+//   builder.Append(value);
+//   // Same as Hash::FingerprintWithSeed(key + value, seed).
+//   const uint64 fp = builder.Fingerprint();
+class FingerprintBuilder {
+ public:
+  explicit FingerprintBuilder(uint32 seed);
+
+  void Append(StringPiece str);
+
+  // Returns the fingerprint of the pieces appended so far.
+  uint64 Fingerprint() const;
+
+ private:
+  // The states of the two 32-bit hash values of the fingerprint.
+  uint32 a_[2];
+  uint32 b_[2];
+  uint32 c_[2];
+  // The bytes which don't fill a block yet.
+  char block_[12];
+  size_t block_size_;
+  uint32 length_;
+};
+
 }  // namespace mozc
 
 #endif  // MOZC_BASE_HASH_H_
@@ -57,6 +57,40 @@ TEST(HashTest, Basic) {
   EXPECT_EQ(0xe3fd29979d4f0b39, Hash::FingerprintWithSeed(s, 0xdeadbeef));
 }
 
+TEST(HashTest, FingerprintBuilder) {
+  const uint32 seed = 0xdeadbeef;
+  EXPECT_EQ(Hash::FingerprintWithSeed("", seed),
+            FingerprintBuilder(seed).Fingerprint());
+
+  const string s =
+      "Hello, world!  Hello, Tokyo!  Good afternoon!  Ladies and gentlemen.";
+  // Splits |s| into pieces of every combination of the lengths so that the
+  // blocks of the hash straddle the pieces in every way.
+  for (size_t len1 = 0; len1 <= 26; ++len1) {
+    for (size_t len2 = 0; len2 <= 26; ++len2) {
+      FingerprintBuilder builder(seed);
+      builder.Append(StringPiece(s).substr(0, len1));
+      builder.Append(StringPiece(s).substr(len1, len2));
+      builder.Append(StringPiece());
+      EXPECT_EQ(Hash::FingerprintWithSeed(s.substr(0, len1 + len2), seed),
+                builder.Fingerprint())
+          << len1 << " " << len2;
+      FingerprintBuilder copied = builder;
+      copied.Append(StringPiece(s).substr(len1 + len2));
+      EXPECT_EQ(Hash::FingerprintWithSeed(s, seed), copied.Fingerprint())
+          << len1 << " " << len2;
+    }
+  }
+
+  // Bytes over 0x7F are hashed in the same way.
+  FingerprintBuilder builder(seed);
+  builder.Append("LR\t");
+  builder.Append("かな");
+  builder.Append("\t漢字");
+  EXPECT_EQ(Hash::FingerprintWithSeed("LR\tかな\t漢字", seed),
+            builder.Fingerprint());
+}
+
 TEST(HashTest, Fingerprint32WithSeed_IntegralTypes) {
   const uint32 seed = 0xabcdef;
   {
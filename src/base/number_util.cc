@@ -139,6 +139,12 @@ int NumberUtil::SimpleAtoi(StringPiece str) {
   return i;
 }
 
+string NumberUtil::SimpleItoa(int32 number) {
+  std::stringstream ss;
+  ss << number;
+  return ss.str();
+}
+
 namespace {
 
 // TODO(hidehiko): Refactoring with GetScriptType in Util class.
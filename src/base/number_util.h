@@ -45,6 +45,9 @@ class NumberUtil {
   // Converts the string to a number and return it.
   static int SimpleAtoi(StringPiece str);
 
+  // Converts the number to a string and return it.
+  static string SimpleItoa(int32 number);
+
   // Returns true if the given input_string contains only number characters
   // (regardless of halfwidth or fullwidth).
   // False for empty string.
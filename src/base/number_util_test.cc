@@ -42,6 +42,12 @@ TEST(NumberUtilTest, SimpleAtoi) {
   EXPECT_EQ(-1, NumberUtil::SimpleAtoi("-1"));
 }
 
+TEST(NumberUtilTest, SimpleItoa) {
+  EXPECT_EQ("0", NumberUtil::SimpleItoa(0));
+  EXPECT_EQ("123", NumberUtil::SimpleItoa(123));
+  EXPECT_EQ("-1", NumberUtil::SimpleItoa(-1));
+}
+
 TEST(NumberUtilTest, SafeStrToInt16) {
   int16 value = 0x4321;
 
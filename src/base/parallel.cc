@@ -0,0 +1,108 @@
+// Copyright 2010-2018, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "base/parallel.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "base/logging.h"
+#include "base/thread.h"
+
+namespace mozc {
+namespace {
+
+class FunctionThread : public Thread {
+ public:
+  explicit FunctionThread(std::function<void()> func) : func_(func) {}
+
+  ~FunctionThread() override {
+    Join();
+  }
+
+  void Run() override {
+    func_();
+  }
+
+ private:
+  std::function<void()> func_;
+
+  DISALLOW_COPY_AND_ASSIGN(FunctionThread);
+};
+
+}  // namespace
+
+void ParallelFor(size_t size, int num_shards,
+                 const std::function<void(size_t, size_t)> &func) {
+  if (size == 0) {
+    return;
+  }
+  if (num_shards < 2 || size == 1) {
+    func(0, size);
+    return;
+  }
+  const size_t num_ranges =
+      std::min(static_cast<size_t>(num_shards), size);
+
+  // The first |size % num_ranges| ranges get one more index.
+  const size_t range_size = size / num_ranges;
+  const size_t num_larger_ranges = size % num_ranges;
+  std::vector<std::unique_ptr<FunctionThread>> threads;
+  size_t first_end = 0;
+  size_t begin = 0;
+  for (size_t i = 0; i < num_ranges; ++i) {
+    const size_t end = begin + range_size + (i < num_larger_ranges ? 1 : 0);
+    if (i == 0) {
+      first_end = end;
+    } else {
+      threads.emplace_back(
+          new FunctionThread([&func, begin, end]() { func(begin, end); }));
+      threads.back()->Start("ParallelFor");
+    }
+    begin = end;
+  }
+  DCHECK_EQ(size, begin);
+
+  func(0, first_end);
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i]->Join();
+  }
+}
+
+void RunInParallel(const std::vector<std::function<void()>> &tasks) {
+  ParallelFor(tasks.size(), static_cast<int>(tasks.size()),
+              [&tasks](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                  tasks[i]();
+                }
+              });
+}
+
+}  // namespace mozc
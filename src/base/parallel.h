@@ -0,0 +1,67 @@
+// Copyright 2010-2018, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Runs a function over the shards of an index range on multiple threads.
+//
+// usage:
+// std::vector<string> encoded(items.size());
+// ParallelFor(items.size(), num_threads, [&](size_t begin, size_t end) {
+//   for (size_t i = begin; i < end; ++i) {
+//     Encode(items[i], &encoded[i]);
+//   }
+// });
+//
+// Each shard is a contiguous range, and the shards are ordered by their
+// indices, so the callers can produce the same result as the single-threaded
+// loop by writing the results for index i into slot i.
+
+#ifndef MOZC_BASE_PARALLEL_H_
+#define MOZC_BASE_PARALLEL_H_
+
+#include <functional>
+#include <vector>
+
+#include "base/port.h"
+
+namespace mozc {
+
+// Splits [0, size) into at most |num_shards| contiguous ranges of almost the
+// same length and calls |func(begin, end)| for each of them on its own
+// thread.  The first range runs on the calling thread.  Returns after all the
+// calls have finished.  If |num_shards| is less than 2, |func(0, size)| is
+// called directly.  Nothing is called when |size| is 0.
+void ParallelFor(size_t size, int num_shards,
+                 const std::function<void(size_t, size_t)> &func);
+
+// Runs |tasks| on separate threads and waits for all of them.
+void RunInParallel(const std::vector<std::function<void()>> &tasks);
+
+}  // namespace mozc
+
+#endif  // MOZC_BASE_PARALLEL_H_
@@ -0,0 +1,102 @@
+// Copyright 2010-2018, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "base/parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "base/mutex.h"
+#include "testing/base/public/gunit.h"
+
+namespace mozc {
+namespace {
+
+TEST(ParallelTest, ParallelForCoversRangeOnce) {
+  const size_t kSizes[] = {0, 1, 2, 7, 100, 1001};
+  const int kNumShards[] = {0, 1, 2, 3, 8, 2000};
+  for (size_t size : kSizes) {
+    for (int num_shards : kNumShards) {
+      std::vector<int> counts(size, 0);
+      std::atomic<int> num_calls(0);
+      ParallelFor(size, num_shards, [&](size_t begin, size_t end) {
+        EXPECT_LT(begin, end);
+        EXPECT_LE(end, counts.size());
+        for (size_t i = begin; i < end; ++i) {
+          ++counts[i];
+        }
+        ++num_calls;
+      });
+      for (size_t i = 0; i < size; ++i) {
+        EXPECT_EQ(1, counts[i]) << "size=" << size << " index=" << i;
+      }
+      if (size == 0) {
+        EXPECT_EQ(0, num_calls.load());
+      } else {
+        EXPECT_GE(std::max(num_shards, 1), num_calls.load());
+      }
+    }
+  }
+}
+
+TEST(ParallelTest, ParallelForSplitsEvenly) {
+  Mutex mutex;
+  std::vector<std::pair<size_t, size_t>> ranges;
+  ParallelFor(11, 3, [&](size_t begin, size_t end) {
+    scoped_lock l(&mutex);
+    ranges.push_back(std::make_pair(begin, end));
+  });
+  std::sort(ranges.begin(), ranges.end());
+  ASSERT_EQ(3, ranges.size());
+  EXPECT_EQ(0, ranges[0].first);
+  EXPECT_EQ(4, ranges[0].second);
+  EXPECT_EQ(4, ranges[1].first);
+  EXPECT_EQ(8, ranges[1].second);
+  EXPECT_EQ(8, ranges[2].first);
+  EXPECT_EQ(11, ranges[2].second);
+}
+
+TEST(ParallelTest, RunInParallel) {
+  std::vector<int> results(4, 0);
+  std::vector<std::function<void()>> tasks;
+  for (size_t i = 0; i < results.size(); ++i) {
+    tasks.push_back([&results, i]() { results[i] = static_cast<int>(i) + 1; });
+  }
+  RunInParallel(tasks);
+  EXPECT_EQ(1, results[0]);
+  EXPECT_EQ(2, results[1]);
+  EXPECT_EQ(3, results[2]);
+  EXPECT_EQ(4, results[3]);
+}
+
+}  // namespace
+}  // namespace mozc
@@ -29,10 +29,15 @@
 
 #include "base/scheduler.h"
 
+#include <algorithm>
 #include <cstdlib>
+#include <deque>
 #include <functional>
+#include <limits>
 #include <map>
+#include <memory>
 #include <utility>
+#include <vector>
 
 #include "base/clock.h"
 #include "base/logging.h"
@@ -46,112 +51,61 @@
 namespace mozc {
 namespace {
 
-class TimerThread final : public Thread {
+// When the dispatcher wakes up for the earliest deadline, the other jobs due
+// within 1/kSlackRatio of their intervals, but not more than kMaxSlackMsec,
+// are run together in the same wakeup.
+const uint32 kSlackRatio = 16;
+const uint32 kMaxSlackMsec = 10 * 1000;
+
+// While due jobs are left in the run queue because all the workers are busy,
+// the dispatcher checks them again after this delay and adds a worker if they
+// still haven't been taken.
+const int kRunQueueCheckMsec = 100;
+
+// Returns the current time in milliseconds.  Only the difference between two
+// values is meaningful.
+uint64 GetCurrentMsec() {
+  const uint64 frequency = Clock::GetFrequency();
+  DCHECK_GE(frequency, 1000);
+  return Clock::GetTicks() / (frequency / 1000);
+}
+
+class CallbackThread final : public Thread {
  public:
-  TimerThread(std::function<void()> callback,
-              uint32 due_time,
-              uint32 interval)
-      : callback_(callback),
-        due_time_(due_time),
-        interval_(interval) {
-    CHECK(due_time_ != 0 || interval_ != 0)
-        << "Either of due_time or interval must be non 0.";
-  }
-
-  ~TimerThread() override {
-    SignalQuit();
+  explicit CallbackThread(std::function<void()> callback)
+      : callback_(callback) {}
+
+  ~CallbackThread() override {
     Join();
   }
 
   void Run() override {
-    if (event_.Wait(due_time_)) {
-      VLOG(1) << "Received notification event";
-      return;
-    }
-
-    VLOG(2) << "call TimerCallback()";
     callback_();
-
-    if (interval_ == 0) {
-      VLOG(2) << "Run() end";
-      return;
-    }
-
-    while (true) {
-      if (event_.Wait(interval_)) {
-        VLOG(1) << "Received notification event";
-        return;
-      }
-      VLOG(2) << "call TimerCallback()";
-      callback_();
-    }
   }
 
  private:
-  void SignalQuit() {
-    const bool result = event_.Notify();
-    DCHECK(result);
-  }
-
   std::function<void()> callback_;
 
-  // The amount of time to elapse before the timer is to be set to the
-  // signaled state for the first time, in milliseconds.
-  uint32 due_time_;
-
-  // The period of the timer, in milliseconds. If this is zero, the
-  // timer is one-shot timer. If this is greater than zero, the timer
-  // is periodic.
-  uint32 interval_;
-
-  UnnamedEvent event_;
-
-  DISALLOW_COPY_AND_ASSIGN(TimerThread);
-};
-
-class QueueTimer final {
- public:
-  QueueTimer(std::function<void()> callback,
-             uint32 due_time,
-             uint32 period)
-      : timer_thread_(callback, due_time, period) {
-  }
-
-  void Start() {
-    timer_thread_.Start("QueueTimer");
-  }
-
- private:
-  TimerThread timer_thread_;
-
-  DISALLOW_COPY_AND_ASSIGN(QueueTimer);
+  DISALLOW_COPY_AND_ASSIGN(CallbackThread);
 };
 
 class Job {
  public:
+  typedef std::multimap<uint64, Job *> Queue;
+
   explicit Job(const Scheduler::JobSetting &setting) :
       setting_(setting),
-      skip_count_(0),
       backoff_count_(0),
-      timer_(NULL),
-      running_(false) {}
-
-  ~Job() {
-    set_timer(NULL);
-  }
+      deadline_(0),
+      running_(false),
+      removed_(false),
+      queued_(false),
+      finished_event_(NULL) {}
 
-  const Scheduler::JobSetting setting() const {
+  const Scheduler::JobSetting &setting() const {
     return setting_;
   }
 
-  void set_skip_count(uint32 skip_count) {
-    skip_count_ = skip_count;
-  }
-
-  uint32 skip_count() const {
-    return skip_count_;
-  }
-
   void set_backoff_count(uint32 backoff_count) {
     backoff_count_ = backoff_count;
   }
@@ -160,21 +114,24 @@ class Job {
     return backoff_count_;
   }
 
-  void set_timer(QueueTimer *timer) {
-    if (timer_ != NULL) {
-      delete timer_;
-    }
-    timer_ = timer;
+  // The time in msec at which the callback is run next time.
+  void set_deadline(uint64 deadline) {
+    deadline_ = deadline;
   }
 
-  const QueueTimer *timer() const {
-    return timer_;
+  uint64 deadline() const {
+    return deadline_;
   }
 
-  QueueTimer *mutable_timer() {
-    return timer_;
+  // The amount of time in msec by which the callback may be run ahead of its
+  // deadline to share a wakeup with another job.
+  uint32 slack() const {
+    return std::min(setting_.default_interval() / kSlackRatio,
+                    kMaxSlackMsec);
   }
 
+  // True from when the job is put into the run queue until its callback
+  // returns.
   void set_running(bool running) {
     running_ = running;
   }
@@ -183,29 +140,94 @@ class Job {
     return running_;
   }
 
+  void set_removed(bool removed) {
+    removed_ = removed;
+  }
+
+  bool removed() const {
+    return removed_;
+  }
+
+  void set_queue_position(Queue::iterator position) {
+    queue_position_ = position;
+    queued_ = true;
+  }
+
+  Queue::iterator queue_position() const {
+    return queue_position_;
+  }
+
+  void clear_queue_position() {
+    queued_ = false;
+  }
+
+  bool queued() const {
+    return queued_;
+  }
+
+  // Notified when the running callback of the removed job returns.
+  void set_finished_event(UnnamedEvent *finished_event) {
+    finished_event_ = finished_event;
+  }
+
+  UnnamedEvent *finished_event() const {
+    return finished_event_;
+  }
+
  private:
-  Scheduler::JobSetting setting_;
-  uint32 skip_count_;
+  const Scheduler::JobSetting setting_;
   uint32 backoff_count_;
-  QueueTimer *timer_;
+  uint64 deadline_;
   bool running_;
+  bool removed_;
+  bool queued_;
+  Queue::iterator queue_position_;
+  UnnamedEvent *finished_event_;
 
-  // TODO(hsumita): Use DISALLOW_COPY_AND_ASSIGN(Job).
+  DISALLOW_COPY_AND_ASSIGN(Job);
 };
 
+// All the jobs share one dispatcher thread, which sleeps until the earliest
+// deadline in |queue_| and puts the due jobs into |run_queue_|.  The callbacks
+// are run by a pool of worker threads shared by all the jobs.  A worker is
+// added only when jobs are waiting in |run_queue_| while all the workers are
+// running callbacks, so usually one worker is enough, and a slow callback
+// doesn't hold up the other jobs for long.
 class SchedulerImpl : public Scheduler::SchedulerInterface {
  public:
-  SchedulerImpl() {
+  SchedulerImpl()
+      : dispatcher_(std::bind(&SchedulerImpl::Dispatch, this)),
+        num_idle_workers_(0),
+        quit_(false) {
     Util::SetRandomSeed(static_cast<uint32>(Clock::GetTime()));
   }
 
   virtual ~SchedulerImpl() {
     RemoveAllJobs();
+    {
+      scoped_lock l(&mutex_);
+      quit_ = true;
+    }
+    wake_event_.Notify();
+    run_event_.Notify();
+    dispatcher_.Join();
+    for (size_t i = 0; i < workers_.size(); ++i) {
+      workers_[i]->Join();
+    }
   }
 
   virtual void RemoveAllJobs() {
-    scoped_lock l(&mutex_);
-    jobs_.clear();
+    std::vector<std::unique_ptr<Job>> removed_jobs;
+    {
+      scoped_lock l(&mutex_);
+      for (auto &entry : jobs_) {
+        removed_jobs.push_back(std::move(entry.second));
+      }
+      jobs_.clear();
+    }
+    for (size_t i = 0; i < removed_jobs.size(); ++i) {
+      DeleteJob(std::move(removed_jobs[i]));
+    }
   }
 
   void ValidateSetting(const Scheduler::JobSetting &job_setting) const {
@@ -225,35 +247,32 @@ class SchedulerImpl : public Scheduler::SchedulerInterface {
       return false;
     }
 
-    std::pair<std::map<string, Job>::iterator, bool> insert_result =
-        jobs_.insert(std::make_pair(job_setting.name(), Job(job_setting)));
-    if (!insert_result.second) {
-      LOG(ERROR) << "insert failed";
-      return false;
-    }
-    Job *job = &insert_result.first->second;
-    DCHECK(job);
-
-    const uint32 delay = CalcDelay(job_setting);
-    // DON'T copy job instance after set_timer() not to delete timer twice.
-    // TODO(hsumita): Make Job class uncopiable.
-    job->set_timer(new QueueTimer(std::bind(TimerCallback, job), delay,
-                                  job_setting.default_interval()));
-    if (job->timer() == NULL) {
-      LOG(ERROR) << "failed to create QueueTimer";
-      return false;
+    std::unique_ptr<Job> job(new Job(job_setting));
+    job->set_deadline(GetCurrentMsec() + CalcDelay(job_setting));
+    Enqueue(job.get());
+    jobs_[job_setting.name()] = std::move(job);
+
+    if (!dispatcher_.IsRunning()) {
+      dispatcher_.Start("Scheduler");
     }
-    job->mutable_timer()->Start();
+    wake_event_.Notify();
     return true;
   }
 
   virtual bool RemoveJob(const string &name) {
-    scoped_lock l(&mutex_);
-    if (!HasJob(name)) {
-      LOG(WARNING) << "Job " << name << " is not registered";
-      return false;
+    std::unique_ptr<Job> job;
+    {
+      scoped_lock l(&mutex_);
+      std::map<string, std::unique_ptr<Job>>::iterator it = jobs_.find(name);
+      if (it == jobs_.end()) {
+        LOG(WARNING) << "Job " << name << " is not registered";
+        return false;
+      }
+      job = std::move(it->second);
+      jobs_.erase(it);
     }
-    return (jobs_.erase(name) != 0);
+    DeleteJob(std::move(job));
+    return true;
   }
 
   virtual bool HasJob(const string &name) const {
@@ -261,33 +280,185 @@ class SchedulerImpl : public Scheduler::SchedulerInterface {
   }
 
  private:
-  static void TimerCallback(void *param) {
-    Job *job = reinterpret_cast<Job *>(param);
-    DCHECK(job);
-    if (job->running()) {
+  // Puts |job| into |queue_|, which is ordered by the deadlines.
+  void Enqueue(Job *job) {
+    DCHECK(!job->queued());
+    job->set_queue_position(queue_.insert(
+        std::make_pair(job->deadline(), job)));
+  }
+
+  void Dequeue(Job *job) {
+    if (!job->queued()) {
       return;
     }
-    if (job->skip_count()) {
-      job->set_skip_count(job->skip_count() - 1);
-      VLOG(3) << "Backoff = " << job->backoff_count()
-              << " skip_count = " << job->skip_count();
+    queue_.erase(job->queue_position());
+    job->clear_queue_position();
+  }
+
+  // Deletes |job| taken out of |jobs_|.  If its callback is running, waits
+  // for it to return.
+  void DeleteJob(std::unique_ptr<Job> job) {
+    UnnamedEvent finished_event;
+    {
+      scoped_lock l(&mutex_);
+      job->set_removed(true);
+      Dequeue(job.get());
+      std::deque<Job *>::iterator it =
+          std::find(run_queue_.begin(), run_queue_.end(), job.get());
+      if (it != run_queue_.end()) {
+        // Not started yet.
+        run_queue_.erase(it);
+        job->set_running(false);
+      }
+      if (!job->running()) {
+        return;
+      }
+      job->set_finished_event(&finished_event);
+    }
+    finished_event.Wait(-1);
+    // RunJob() notifies |finished_event| with the lock held, so it doesn't
+    // touch the event nor the job once the lock is taken here.
+    scoped_lock l(&mutex_);
+  }
+
+  // Puts |due_jobs| into |run_queue_|, and adds a worker if all the workers
+  // are running callbacks.
+  void StartJobs(const std::vector<Job *> &due_jobs) {
+    for (size_t i = 0; i < due_jobs.size(); ++i) {
+      DCHECK(!due_jobs[i]->running());
+      due_jobs[i]->set_running(true);
+      run_queue_.push_back(due_jobs[i]);
+    }
+    if (run_queue_.empty()) {
       return;
     }
-    job->set_running(true);
+    if (num_idle_workers_ == 0) {
+      workers_.emplace_back(
+          new CallbackThread(std::bind(&SchedulerImpl::Work, this)));
+      workers_.back()->Start("SchedulerWorker");
+      ++num_idle_workers_;
+    }
+    run_event_.Notify();
+  }
+
+  // Takes the due jobs out of |queue_| if the earliest deadline has passed.
+  // The other jobs whose deadlines are within their slack from |now| are
+  // taken together so that they don't need another wakeup.
+  void PopDueJobs(uint64 now, std::vector<Job *> *due_jobs) {
+    if (queue_.empty() || queue_.begin()->first > now) {
+      return;
+    }
+    for (Job::Queue::iterator it = queue_.begin();
+         it != queue_.end() && it->first <= now + kMaxSlackMsec;) {
+      Job *job = it->second;
+      if (it->first > now + job->slack()) {
+        ++it;
+        continue;
+      }
+      it = queue_.erase(it);
+      job->clear_queue_position();
+      due_jobs->push_back(job);
+    }
+  }
+
+  void Dispatch() {
+    while (true) {
+      int wait_msec = -1;  // infinite
+      {
+        scoped_lock l(&mutex_);
+        if (quit_) {
+          return;
+        }
+        const uint64 now = GetCurrentMsec();
+        std::vector<Job *> due_jobs;
+        PopDueJobs(now, &due_jobs);
+        StartJobs(due_jobs);
+        if (!queue_.empty()) {
+          DCHECK_GT(queue_.begin()->first, now);
+          wait_msec = static_cast<int>(std::min<uint64>(
+              queue_.begin()->first - now,
+              std::numeric_limits<int>::max()));
+        }
+        if (!run_queue_.empty() &&
+            (wait_msec < 0 || wait_msec > kRunQueueCheckMsec)) {
+          wait_msec = kRunQueueCheckMsec;
+        }
+      }
+      wake_event_.Wait(wait_msec);
+    }
+  }
+
+  // The main loop of the worker threads.  Since |run_event_| wakes up one of
+  // the waiting workers, a worker which takes a job passes the event on to
+  // another worker while jobs remain.
+  void Work() {
+    while (true) {
+      Job *job = NULL;
+      {
+        scoped_lock l(&mutex_);
+        if (quit_) {
+          run_event_.Notify();
+          return;
+        }
+        if (!run_queue_.empty()) {
+          job = run_queue_.front();
+          run_queue_.pop_front();
+          --num_idle_workers_;
+          if (!run_queue_.empty()) {
+            run_event_.Notify();
+          }
+        }
+      }
+      if (job == NULL) {
+        run_event_.Wait(-1);
+        continue;
+      }
+      RunJob(job);
+      scoped_lock l(&mutex_);
+      ++num_idle_workers_;
+    }
+  }
+
+  void RunJob(Job *job) {
     Scheduler::JobSetting::CallbackFunc callback = job->setting().callback();
     DCHECK(callback != NULL);
     const bool success = callback(job->setting().data());
+
+    scoped_lock l(&mutex_);
     job->set_running(false);
+    if (job->removed()) {
+      if (job->finished_event() != NULL) {
+        job->finished_event()->Notify();
+      }
+      return;
+    }
+
+    // On failure, skips as many periods as |backoff_count|, which is doubled
+    // on each consecutive failure.
+    const uint64 interval = job->setting().default_interval();
+    uint32 skip_count = 0;
     if (success) {
       job->set_backoff_count(0);
     } else {
       const uint32 new_backoff_count = (job->backoff_count() == 0) ?
           1 : job->backoff_count() * 2;
-      if (new_backoff_count * job->setting().default_interval()
-          < job->setting().max_interval()) {
+      if (new_backoff_count * interval < job->setting().max_interval()) {
         job->set_backoff_count(new_backoff_count);
       }
-      job->set_skip_count(job->backoff_count());
+      skip_count = job->backoff_count();
+      VLOG(3) << "Backoff = " << job->backoff_count();
+    }
+
+    uint64 deadline = job->deadline() + (skip_count + 1) * interval;
+    const uint64 now = GetCurrentMsec();
+    if (deadline <= now) {
+      // The periods passed while the callback was running are skipped.
+      deadline += ((now - deadline) / interval + 1) * interval;
+    }
+    job->set_deadline(deadline);
+    Enqueue(job);
+    if (queue_.begin()->second == job) {
+      wake_event_.Notify();
     }
   }
 
@@ -299,7 +470,15 @@ class SchedulerImpl : public Scheduler::SchedulerInterface {
     return delay;
   }
 
-  std::map<string, Job> jobs_;
+  std::map<string, std::unique_ptr<Job>> jobs_;
+  Job::Queue queue_;
+  std::deque<Job *> run_queue_;
+  CallbackThread dispatcher_;
+  UnnamedEvent wake_event_;
+  std::vector<std::unique_ptr<CallbackThread>> workers_;
+  size_t num_idle_workers_;
+  UnnamedEvent run_event_;
+  bool quit_;
   Mutex mutex_;
 
   DISALLOW_COPY_AND_ASSIGN(SchedulerImpl);
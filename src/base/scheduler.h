@@ -34,6 +34,10 @@
 //    - Interval will be doubled as long as callback returns false, but
 //      will not exceed max_interval.
 //  2. Randomised delayed start to reduce server traffic peak.
+//  3. All the jobs share one timer thread and a pool of worker threads, which
+//     grows only while callbacks overlap.  A callback may be run ahead of its
+//     deadline by a small fraction of its interval so that jobs due at nearby
+//     times are run in one wakeup.
 //
 // usage:
 // // start scheduled job
@@ -101,6 +105,8 @@ class Scheduler {
   static bool AddJob(const JobSetting &job_setting);
 
   // stop scheduled job specified by neme.
+  // If the callback of the job is running, this waits for it to return, so
+  // this must not be called from the callback of the job itself.
   static bool RemoveJob(const string &name);
 
   // stop all jobs
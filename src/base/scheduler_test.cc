@@ -31,8 +31,10 @@
 
 #include <algorithm>
 #include <memory>
+#include <string>
 
 #include "base/logging.h"
+#include "base/number_util.h"
 #include "base/unnamed_event.h"
 #include "base/util.h"
 #include "testing/base/public/gunit.h"
@@ -256,6 +258,127 @@ TEST_F(SchedulerTest, DontBlockOtherJobs) {
   EXPECT_TRUE(info.quit_event.Notify());
 }
 
+TEST_F(SchedulerTest, DontBlockJobsDueTogether) {
+  struct SharedInfo {
+    UnnamedEvent notify_event;
+    UnnamedEvent quit_event;
+  };
+  class BlockingCallback {
+   public:
+    static bool Do(void *ptr) {
+      SharedInfo *info = static_cast<SharedInfo *>(ptr);
+      EXPECT_TRUE(info->notify_event.Notify());
+      EXPECT_TRUE(info->quit_event.Wait(kTimeout));
+      return false;   // stop
+    }
+  };
+
+  class SecondaryCallback {
+   public:
+    static bool Do(void *ptr) {
+      UnnamedEvent *event = static_cast<UnnamedEvent *>(ptr);
+      EXPECT_TRUE(event->Notify());
+      return false;   // stop
+    }
+  };
+
+  // Both the jobs become due in the same wakeup of the dispatcher, so the
+  // secondary job can be queued behind the blocking one.
+  SharedInfo info;
+  ASSERT_TRUE(info.notify_event.IsAvailable());
+  ASSERT_TRUE(info.quit_event.IsAvailable());
+  UnnamedEvent event;
+  ASSERT_TRUE(event.IsAvailable());
+  ScopedJob blocking_job(Scheduler::JobSetting(
+      "TestJob1", kTooLongTime, kTooLongTime, kMediumPeriod, kNoRandomDelay,
+      &BlockingCallback::Do, &info));
+  ScopedJob secondary_job(Scheduler::JobSetting(
+      "TestJob2", kTooLongTime, kTooLongTime, kMediumPeriod, kNoRandomDelay,
+      &SecondaryCallback::Do, &event));
+  ASSERT_TRUE(info.notify_event.Wait(kTimeout));
+  ASSERT_TRUE(event.Wait(kTimeout));
+
+  // Unblock |blocking_job|.
+  EXPECT_TRUE(info.quit_event.Notify());
+}
+
+TEST_F(SchedulerTest, RemoveJobWaitsForRunningCallback) {
+  struct SharedInfo {
+    SharedInfo()
+        : finished(false) {}
+    UnnamedEvent started_event;
+    volatile bool finished;
+  };
+
+  class TestCallback {
+   public:
+    static bool Do(void *ptr) {
+      SharedInfo *info = static_cast<SharedInfo *>(ptr);
+      EXPECT_TRUE(info->started_event.Notify());
+      Util::Sleep(kMediumPeriod);
+      info->finished = true;
+      return true;
+    }
+  };
+
+  SharedInfo info;
+  ASSERT_TRUE(info.started_event.IsAvailable());
+  ASSERT_TRUE(Scheduler::AddJob(Scheduler::JobSetting(
+      "Test", kTooLongTime, kTooLongTime, kImmediately, kNoRandomDelay,
+      &TestCallback::Do, &info)));
+  ASSERT_TRUE(info.started_event.Wait(kTimeout));
+  EXPECT_TRUE(Scheduler::RemoveJob("Test"));
+  EXPECT_TRUE(info.finished);
+}
+
+TEST_F(SchedulerTest, ManyJobs) {
+  const int kNumJobs = 32;
+
+  class TestCallback {
+   public:
+    static bool Do(void *ptr) {
+      UnnamedEvent *event = static_cast<UnnamedEvent *>(ptr);
+      EXPECT_TRUE(event->Notify());
+      return true;
+    }
+  };
+
+  std::unique_ptr<UnnamedEvent[]> events(new UnnamedEvent[kNumJobs]);
+  for (int i = 0; i < kNumJobs; ++i) {
+    ASSERT_TRUE(events[i].IsAvailable());
+    // The deadlines are spread over a short period to be coalesced.
+    ASSERT_TRUE(Scheduler::AddJob(Scheduler::JobSetting(
+        "Test" + NumberUtil::SimpleItoa(i), kMediumPeriod, kMediumPeriod, i,
+        kNoRandomDelay, &TestCallback::Do, &events[i])));
+  }
+  // Each job is run repeatedly.
+  for (int i = 0; i < kNumJobs; ++i) {
+    ASSERT_TRUE(events[i].Wait(kTimeout));
+    ASSERT_TRUE(events[i].Wait(kTimeout));
+  }
+}
+
+// A job is run at its deadline even if it may be batched with other jobs
+// within its slack, which is 10 sec for |kTooLongTime|.
+TEST_F(SchedulerTest, NotDelayedBySlack) {
+  class TestCallback {
+   public:
+    static bool Do(void *ptr) {
+      UnnamedEvent *event = static_cast<UnnamedEvent *>(ptr);
+      EXPECT_TRUE(event->Notify());
+      return false;
+    }
+  };
+
+  UnnamedEvent event;
+  ASSERT_TRUE(event.IsAvailable());
+  ScopedJob job(Scheduler::JobSetting(
+      "Test", kTooLongTime, kTooLongTime, kShortPeriod, kNoRandomDelay,
+      &TestCallback::Do, &event));
+  // The timeout period is arbitrary as long as it is shorter than the slack.
+  ASSERT_TRUE(event.Wait(5 * 1000));
+}
+
 class NameCheckScheduler : public Scheduler::SchedulerInterface {
  public:
   explicit NameCheckScheduler(const string &expected_name)
@@ -0,0 +1,559 @@
+// Copyright 2010-2018, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "base/simd_util.h"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MOZC_SIMD_UTIL_SSE2
+#include <emmintrin.h>
+#endif  // __SSE2__ || _M_X64 || _M_IX86_FP >= 2
+
+// The AVX2 kernels are compiled with the target attribute and used only when
+// the CPU supports AVX2, so that the binary still runs on older CPUs.
+#if defined(MOZC_SIMD_UTIL_SSE2) && defined(__GNUC__) && \
+    (defined(__x86_64__) || defined(__i386__)) && !defined(OS_NACL)
+#define MOZC_SIMD_UTIL_AVX2
+#define MOZC_AVX2_FUNCTION __attribute__((target("avx2")))
+#include <immintrin.h>
+#endif  // MOZC_SIMD_UTIL_SSE2 && __GNUC__ && x86 && !OS_NACL
+
+namespace mozc {
+namespace {
+
+// Same as Util::OneCharLen.
+inline size_t CharLen(char c) {
+  static const uint8 kLengthByHighNibble[16] = {
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 3, 4,
+  };
+  return kLengthByHighNibble[static_cast<uint8>(c) >> 4];
+}
+
+inline int PopCount(uint32 x) {
+#ifdef __GNUC__
+  return __builtin_popcount(x);
+#else  // __GNUC__
+  x = x - ((x >> 1) & 0x55555555);
+  x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
+  return (((x + (x >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
+#endif  // __GNUC__
+}
+
+// Returns the index of the lowest set bit of |x|, which must not be 0.
+inline int LowestBit(uint32 x) {
+#ifdef __GNUC__
+  return __builtin_ctz(x);
+#else  // __GNUC__
+  int index = 0;
+  while ((x & 1) == 0) {
+    x >>= 1;
+    ++index;
+  }
+  return index;
+#endif  // __GNUC__
+}
+
+// Returns the index of the highest set bit of |x|, which must not be 0.
+inline int HighestBit(uint32 x) {
+#ifdef __GNUC__
+  return 31 - __builtin_clz(x);
+#else  // __GNUC__
+  int index = 0;
+  while (x >>= 1) {
+    ++index;
+  }
+  return index;
+#endif  // __GNUC__
+}
+
+// Hiragana and katakana differ by 0x60 in the code points.  The conversion
+// rules of Util map U+3041..U+3094 and U+30A1..U+30F4 to each other.
+const char32 kKanaOffset = 0x60;
+const char32 kFirstHiragana = 0x3041;
+const char32 kLastHiragana = 0x3094;
+const char32 kFirstKatakana = kFirstHiragana + kKanaOffset;
+const char32 kLastKatakana = kLastHiragana + kKanaOffset;
+
+// Decodes the three-byte character at |p| into |c| if it is in
+// [first, last], which is in U+3000..U+3FFF.
+inline bool DecodeKana(const char *p, const char *end, char32 first,
+                       char32 last, char32 *c) {
+  if (end - p < 3 || static_cast<uint8>(p[0]) != 0xE3) {
+    return false;
+  }
+  const uint8 c1 = static_cast<uint8>(p[1]);
+  const uint8 c2 = static_cast<uint8>(p[2]);
+  if ((c1 & 0xC0) != 0x80 || (c2 & 0xC0) != 0x80) {
+    return false;
+  }
+  *c = 0x3000 | ((c1 & 0x3F) << 6) | (c2 & 0x3F);
+  return first <= *c && *c <= last;
+}
+
+// Converts the characters in [first, last] which are followed by another
+// such character.
+const char *ConvertKanaScalar(const char *begin, const char *end,
+                              char32 first, char32 last, char32 offset,
+                              string *output) {
+  char32 c = 0;
+  if (!DecodeKana(begin, end, first, last, &c)) {
+    return begin;
+  }
+  char32 next = 0;
+  while (DecodeKana(begin + 3, end, first, last, &next)) {
+    const char32 converted = c + offset;
+    const char utf8[3] = {
+      static_cast<char>(0xE3),
+      static_cast<char>(0x80 | ((converted >> 6) & 0x3F)),
+      static_cast<char>(0x80 | (converted & 0x3F)),
+    };
+    output->append(utf8, 3);
+    begin += 3;
+    c = next;
+  }
+  return begin;
+}
+
+size_t SkipCharsScalar(const char *begin, const char *end, size_t max_chars,
+                       const char **next) {
+  size_t num_chars = 0;
+  while (begin < end && num_chars < max_chars) {
+    begin += CharLen(*begin);
+    ++num_chars;
+  }
+  *next = begin;
+  return num_chars;
+}
+
+const char *SkipAsciiScalar(const char *begin, const char *end) {
+  while (end - begin >= 8) {
+    uint64 bytes = 0;
+    memcpy(&bytes, begin, sizeof(bytes));
+    if (bytes & 0x8080808080808080ULL) {
+      break;
+    }
+    begin += 8;
+  }
+  while (begin < end && static_cast<uint8>(*begin) < 0x80) {
+    ++begin;
+  }
+  return begin;
+}
+
+const char *HiraganaToKatakanaScalar(const char *begin, const char *end,
+                                     string *output) {
+  return ConvertKanaScalar(begin, end, kFirstHiragana, kLastHiragana,
+                           kKanaOffset, output);
+}
+
+const char *KatakanaToHiraganaScalar(const char *begin, const char *end,
+                                     string *output) {
+  return ConvertKanaScalar(begin, end, kFirstKatakana, kLastKatakana,
+                           -kKanaOffset, output);
+}
+
+#ifdef MOZC_SIMD_UTIL_SSE2
+
+// Returns 0xFF for the bytes of |v| greater than or equal to |x| as unsigned.
+inline __m128i GreaterEqualSse2(__m128i v, uint8 x) {
+  return _mm_cmpeq_epi8(_mm_max_epu8(v, _mm_set1_epi8(x)), v);
+}
+
+inline __m128i EqualSse2(__m128i v, uint8 x) {
+  return _mm_cmpeq_epi8(v, _mm_set1_epi8(x));
+}
+
+inline __m128i SelectSse2(__m128i mask, __m128i a, __m128i b) {
+  return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+// Skips the blocks of 16 bytes where every character is followed by the
+// expected number of trailing bytes.  In such blocks, the characters stepped
+// over by Util::OneCharLen are exactly the bytes other than trailing bytes.
+// The other blocks are stepped over one by one.
+size_t SkipCharsSse2(const char *begin, const char *end, size_t max_chars,
+                     const char **next) {
+  const char *p = begin;
+  size_t num_chars = 0;
+  while (end - p >= 16 && max_chars - num_chars >= 16) {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    if (_mm_movemask_epi8(v) == 0) {
+      p += 16;
+      num_chars += 16;
+      continue;
+    }
+    const __m128i trailing = EqualSse2(
+        _mm_and_si128(v, _mm_set1_epi8(static_cast<char>(0xC0))), 0x80);
+    const __m128i expected = _mm_or_si128(
+        _mm_or_si128(_mm_slli_si128(GreaterEqualSse2(v, 0xC0), 1),
+                     _mm_slli_si128(GreaterEqualSse2(v, 0xE0), 2)),
+        _mm_slli_si128(GreaterEqualSse2(v, 0xF0), 3));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(trailing, expected)) == 0xFFFF) {
+      const uint32 leading = ~_mm_movemask_epi8(trailing) & 0xFFFF;
+      num_chars += PopCount(leading);
+      const int last = HighestBit(leading);
+      p += last + CharLen(p[last]);
+    } else {
+      const char *block_end = p + 16;
+      while (p < block_end) {
+        p += CharLen(*p);
+        ++num_chars;
+      }
+    }
+  }
+  const char *rest = nullptr;
+  num_chars += SkipCharsScalar(p, end, max_chars - num_chars, &rest);
+  *next = rest;
+  return num_chars;
+}
+
+const char *SkipAsciiSse2(const char *begin, const char *end) {
+  while (end - begin >= 16) {
+    const int non_ascii = _mm_movemask_epi8(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin)));
+    if (non_ascii != 0) {
+      return begin + LowestBit(non_ascii);
+    }
+    begin += 16;
+  }
+  return SkipAsciiScalar(begin, end);
+}
+
+// Converts the 16 kana in the 48 bytes at |p| to |out| if they all are in
+// the source range.
+template <bool kToKatakana>
+bool ConvertKana16Sse2(const char *p, char *out) {
+  // The roles of the bytes; 0 for the leading bytes, 1 for the second bytes
+  // and 2 for the last bytes.
+  static const char kRoles[48] = {
+    0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0,
+    1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1,
+    2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2,
+  };
+  // The source characters are E3 xx yy where the pair (xx, yy) is in
+  // [(kLow, kLowMin), (kLow, 0xBF)] or
+  // [(kLow + 1, 0x80), (kLow + 1, kHighMax)].
+  const uint8 kLow = kToKatakana ? 0x81 : 0x82;
+  const uint8 kLowMin = kToKatakana ? 0x81 : 0xA1;
+  const uint8 kHighMax = kToKatakana ? 0x94 : 0xB4;
+
+  __m128i v[3];
+  for (int k = 0; k < 3; ++k) {
+    v[k] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 16 * k));
+  }
+  __m128i converted[3];
+  for (int k = 0; k < 3; ++k) {
+    const __m128i roles =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(kRoles + 16 * k));
+    const __m128i leading = EqualSse2(roles, 0);
+    const __m128i second = EqualSse2(roles, 1);
+    const __m128i last = EqualSse2(roles, 2);
+    // The previous and the next bytes of each byte.
+    __m128i prev = _mm_slli_si128(v[k], 1);
+    if (k > 0) {
+      prev = _mm_or_si128(prev, _mm_srli_si128(v[k - 1], 15));
+    }
+    __m128i next = _mm_srli_si128(v[k], 1);
+    if (k < 2) {
+      next = _mm_or_si128(next, _mm_slli_si128(v[k + 1], 15));
+    }
+
+    const __m128i low = EqualSse2(v[k], kLow);
+    const __m128i high = EqualSse2(v[k], kLow + 1);
+    const __m128i prev_low = EqualSse2(prev, kLow);
+    const __m128i prev_high = EqualSse2(prev, kLow + 1);
+    const __m128i in_low_range = _mm_and_si128(
+        prev_low, _mm_andnot_si128(GreaterEqualSse2(v[k], 0xC0),
+                                   GreaterEqualSse2(v[k], kLowMin)));
+    const __m128i in_high_range = _mm_and_si128(
+        prev_high, _mm_andnot_si128(GreaterEqualSse2(v[k], kHighMax + 1),
+                                    GreaterEqualSse2(v[k], 0x80)));
+    const __m128i valid = _mm_or_si128(
+        _mm_or_si128(_mm_and_si128(leading, EqualSse2(v[k], 0xE3)),
+                     _mm_and_si128(second, _mm_or_si128(low, high))),
+        _mm_and_si128(last, _mm_or_si128(in_low_range, in_high_range)));
+    if (_mm_movemask_epi8(valid) != 0xFFFF) {
+      return false;
+    }
+
+    // The last bytes below 0xA0 move to the upper half of the 64 code points
+    // of the second byte, and the others move to the lower half of the next
+    // or the previous second byte.
+    const __m128i next_upper = GreaterEqualSse2(next, 0xA0);
+    const __m128i upper = GreaterEqualSse2(v[k], 0xA0);
+    const __m128i plus = _mm_add_epi8(v[k], _mm_set1_epi8(0x20));
+    const __m128i minus = _mm_sub_epi8(v[k], _mm_set1_epi8(0x20));
+    __m128i second_byte, last_byte;
+    if (kToKatakana) {
+      // (81, 81..9F) -> (82, A1..BF), (81, A0..BF) -> (83, 80..9F),
+      // (82, 80..94) -> (83, A0..B4).
+      second_byte = SelectSse2(_mm_andnot_si128(next_upper, low),
+                               _mm_set1_epi8(kLow + 1),
+                               _mm_set1_epi8(kLow + 2));
+      last_byte = SelectSse2(_mm_and_si128(prev_low, upper), minus, plus);
+    } else {
+      // (82, A1..BF) -> (81, 81..9F), (83, 80..9F) -> (81, A0..BF),
+      // (83, A0..B4) -> (82, 80..94).
+      second_byte = SelectSse2(_mm_or_si128(low, _mm_andnot_si128(next_upper,
+                                                                  high)),
+                               _mm_set1_epi8(kLow - 1),
+                               _mm_set1_epi8(kLow));
+      last_byte = SelectSse2(_mm_andnot_si128(upper, prev_high), plus, minus);
+    }
+    converted[k] = SelectSse2(second, second_byte,
+                              SelectSse2(last, last_byte, v[k]));
+  }
+  for (int k = 0; k < 3; ++k) {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 16 * k), converted[k]);
+  }
+  return true;
+}
+
+// Converts 15 characters at a time while 16 characters are in the range, as
+// the last one is converted only if it is followed by another.
+template <bool kToKatakana>
+const char *ConvertKanaSse2(const char *begin, const char *end,
+                            string *output) {
+  char buffer[48];
+  while (end - begin >= 48 &&
+         ConvertKana16Sse2<kToKatakana>(begin, buffer)) {
+    output->append(buffer, 45);
+    begin += 45;
+  }
+  return kToKatakana ? HiraganaToKatakanaScalar(begin, end, output)
+                     : KatakanaToHiraganaScalar(begin, end, output);
+}
+
+const char *HiraganaToKatakanaSse2(const char *begin, const char *end,
+                                   string *output) {
+  return ConvertKanaSse2<true>(begin, end, output);
+}
+
+const char *KatakanaToHiraganaSse2(const char *begin, const char *end,
+                                   string *output) {
+  return ConvertKanaSse2<false>(begin, end, output);
+}
+
+#endif  // MOZC_SIMD_UTIL_SSE2
+
+#ifdef MOZC_SIMD_UTIL_AVX2
+
+MOZC_AVX2_FUNCTION
+inline __m256i GreaterEqualAvx2(__m256i v, uint8 x) {
+  return _mm256_cmpeq_epi8(_mm256_max_epu8(v, _mm256_set1_epi8(x)), v);
+}
+
+// Shifts |v| toward the higher address by |kBytes| across the 128-bit lanes.
+template <int kBytes>
+MOZC_AVX2_FUNCTION
+inline __m256i ShiftUpAvx2(__m256i v) {
+  return _mm256_alignr_epi8(v, _mm256_permute2x128_si256(v, v, 0x08),
+                            16 - kBytes);
+}
+
+// Same as SkipCharsSse2 with blocks of 32 bytes.
+MOZC_AVX2_FUNCTION
+size_t SkipCharsAvx2(const char *begin, const char *end, size_t max_chars,
+                     const char **next) {
+  const char *p = begin;
+  size_t num_chars = 0;
+  while (end - p >= 32 && max_chars - num_chars >= 32) {
+    const __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    if (_mm256_movemask_epi8(v) == 0) {
+      p += 32;
+      num_chars += 32;
+      continue;
+    }
+    const __m256i trailing = _mm256_cmpeq_epi8(
+        _mm256_and_si256(v, _mm256_set1_epi8(static_cast<char>(0xC0))),
+        _mm256_set1_epi8(static_cast<char>(0x80)));
+    const __m256i expected = _mm256_or_si256(
+        _mm256_or_si256(ShiftUpAvx2<1>(GreaterEqualAvx2(v, 0xC0)),
+                        ShiftUpAvx2<2>(GreaterEqualAvx2(v, 0xE0))),
+        ShiftUpAvx2<3>(GreaterEqualAvx2(v, 0xF0)));
+    if (static_cast<uint32>(_mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(trailing, expected))) == 0xFFFFFFFF) {
+      const uint32 leading = ~static_cast<uint32>(
+          _mm256_movemask_epi8(trailing));
+      num_chars += PopCount(leading);
+      const int last = HighestBit(leading);
+      p += last + CharLen(p[last]);
+    } else {
+      const char *block_end = p + 32;
+      while (p < block_end) {
+        p += CharLen(*p);
+        ++num_chars;
+      }
+    }
+  }
+  const char *rest = nullptr;
+  num_chars += SkipCharsScalar(p, end, max_chars - num_chars, &rest);
+  *next = rest;
+  return num_chars;
+}
+
+MOZC_AVX2_FUNCTION
+const char *SkipAsciiAvx2(const char *begin, const char *end) {
+  while (end - begin >= 32) {
+    const uint32 non_ascii = _mm256_movemask_epi8(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(begin)));
+    if (non_ascii != 0) {
+      return begin + LowestBit(non_ascii);
+    }
+    begin += 32;
+  }
+  return SkipAsciiSse2(begin, end);
+}
+
+bool IsAvx2Supported() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+}
+
+#endif  // MOZC_SIMD_UTIL_AVX2
+
+struct Kernels {
+  SimdUtil::InstructionSet instruction_set;
+  size_t (*skip_chars)(const char *begin, const char *end, size_t max_chars,
+                       const char **next);
+  const char *(*skip_ascii)(const char *begin, const char *end);
+  const char *(*hiragana_to_katakana)(const char *begin, const char *end,
+                                      string *output);
+  const char *(*katakana_to_hiragana)(const char *begin, const char *end,
+                                      string *output);
+};
+
+const Kernels kScalarKernels = {
+  SimdUtil::SCALAR,
+  &SkipCharsScalar,
+  &SkipAsciiScalar,
+  &HiraganaToKatakanaScalar,
+  &KatakanaToHiraganaScalar,
+};
+
+#ifdef MOZC_SIMD_UTIL_SSE2
+const Kernels kSse2Kernels = {
+  SimdUtil::SSE2,
+  &SkipCharsSse2,
+  &SkipAsciiSse2,
+  &HiraganaToKatakanaSse2,
+  &KatakanaToHiraganaSse2,
+};
+#endif  // MOZC_SIMD_UTIL_SSE2
+
+#ifdef MOZC_SIMD_UTIL_AVX2
+// The kana conversion handles 16 characters in 48 bytes, which does not fit
+// the 128-bit lanes of AVX2, so it shares the SSE2 kernels.
+const Kernels kAvx2Kernels = {
+  SimdUtil::AVX2,
+  &SkipCharsAvx2,
+  &SkipAsciiAvx2,
+  &HiraganaToKatakanaSse2,
+  &KatakanaToHiraganaSse2,
+};
+#endif  // MOZC_SIMD_UTIL_AVX2
+
+// Returns the kernels for |instruction_set|, or nullptr if not supported.
+const Kernels *GetKernels(SimdUtil::InstructionSet instruction_set) {
+  switch (instruction_set) {
+    case SimdUtil::SCALAR:
+      return &kScalarKernels;
+#ifdef MOZC_SIMD_UTIL_SSE2
+    case SimdUtil::SSE2:
+      return &kSse2Kernels;
+#endif  // MOZC_SIMD_UTIL_SSE2
+#ifdef MOZC_SIMD_UTIL_AVX2
+    case SimdUtil::AVX2:
+      return IsAvx2Supported() ? &kAvx2Kernels : nullptr;
+#endif  // MOZC_SIMD_UTIL_AVX2
+    default:
+      return nullptr;
+  }
+}
+
+const Kernels *DetectKernels() {
+  const SimdUtil::InstructionSet kPreferences[] = {
+    SimdUtil::AVX2, SimdUtil::SSE2, SimdUtil::SCALAR,
+  };
+  for (size_t i = 0; i < arraysize(kPreferences); ++i) {
+    const Kernels *kernels = GetKernels(kPreferences[i]);
+    if (kernels != nullptr) {
+      return kernels;
+    }
+  }
+  return &kScalarKernels;
+}
+
+const Kernels *&MutableKernels() {
+  static const Kernels *kernels = DetectKernels();
+  return kernels;
+}
+
+}  // namespace
+
+SimdUtil::InstructionSet SimdUtil::GetInstructionSet() {
+  return MutableKernels()->instruction_set;
+}
+
+bool SimdUtil::IsSupported(InstructionSet instruction_set) {
+  return GetKernels(instruction_set) != nullptr;
+}
+
+bool SimdUtil::SetInstructionSetForTesting(InstructionSet instruction_set) {
+  const Kernels *kernels = GetKernels(instruction_set);
+  if (kernels == nullptr) {
+    return false;
+  }
+  MutableKernels() = kernels;
+  return true;
+}
+
+size_t SimdUtil::SkipChars(const char *begin, const char *end,
+                           size_t max_chars, const char **next) {
+  return MutableKernels()->skip_chars(begin, end, max_chars, next);
+}
+
+const char *SimdUtil::SkipAscii(const char *begin, const char *end) {
+  return MutableKernels()->skip_ascii(begin, end);
+}
+
+const char *SimdUtil::HiraganaToKatakana(const char *begin, const char *end,
+                                         string *output) {
+  return MutableKernels()->hiragana_to_katakana(begin, end, output);
+}
+
+const char *SimdUtil::KatakanaToHiragana(const char *begin, const char *end,
+                                         string *output) {
+  return MutableKernels()->katakana_to_hiragana(begin, end, output);
+}
+
+}  // namespace mozc
@@ -0,0 +1,91 @@
+// Copyright 2010-2018, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Kernels scanning and converting UTF-8 strings for Util.  Each kernel has
+// SSE2 and AVX2 versions and a scalar fallback, and the fastest one supported
+// by the CPU is selected at runtime.  The kernels return the same results for
+// any input including invalid UTF-8 sequences, so that Util behaves the same
+// on every CPU.
+
+#ifndef MOZC_BASE_SIMD_UTIL_H_
+#define MOZC_BASE_SIMD_UTIL_H_
+
+#include <string>
+
+#include "base/port.h"
+
+namespace mozc {
+
+class SimdUtil {
+ public:
+  enum InstructionSet {
+    SCALAR,
+    SSE2,
+    AVX2,
+  };
+
+  // Returns the instruction set of the kernels in use.
+  static InstructionSet GetInstructionSet();
+
+  // Returns true if the CPU and the build support |instruction_set|.
+  static bool IsSupported(InstructionSet instruction_set);
+
+  // Switches the kernels to |instruction_set| if it is supported and returns
+  // true.  This is not thread-safe; only for tests and benchmarks.
+  static bool SetInstructionSetForTesting(InstructionSet instruction_set);
+
+  // Steps over at most |max_chars| characters from |begin| by
+  // Util::OneCharLen until reaching |end|, and returns the number of the
+  // characters.  |*next| is set to the position after them, which can be
+  // beyond |end| if the last character is truncated, like Util::CharsLen.
+  static size_t SkipChars(const char *begin, const char *end,
+                          size_t max_chars, const char **next);
+
+  // Returns the end of the run of ASCII characters from |begin|.
+  static const char *SkipAscii(const char *begin, const char *end);
+
+  // Appends the katakana of the run of hiragana U+3041..U+3094 from |begin|
+  // to |output| and returns the end of the converted characters.  The last
+  // hiragana of the run is not converted as it may be combined with the
+  // following character, e.g. "う゛", by the conversion rules.
+  static const char *HiraganaToKatakana(const char *begin, const char *end,
+                                        string *output);
+
+  // Appends the hiragana of the run of katakana U+30A1..U+30F4 from |begin|
+  // to |output| like HiraganaToKatakana.
+  static const char *KatakanaToHiragana(const char *begin, const char *end,
+                                        string *output);
+
+ private:
+  DISALLOW_IMPLICIT_CONSTRUCTORS(SimdUtil);
+};
+
+}  // namespace mozc
+
+#endif  // MOZC_BASE_SIMD_UTIL_H_
@@ -0,0 +1,220 @@
+// Copyright 2010-2018, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Benchmark for the SIMD kernels in SimdUtil.
+//
+// Reads the keys and values of dictionary source files and reports the time
+// per string of the Util functions backed by SimdUtil for every instruction
+// set supported by the CPU.  The "baseline" rows step over the characters by
+// Util::OneCharLen and convert the strings by Util::ConvertUsingDoubleArray,
+// which are the paths without the kernels.
+//
+// Usage:
+//   simd_util_main
+//     --input="data/dictionary_oss/dictionary00.txt ..." --iterations=20
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "base/file_stream.h"
+#include "base/flags.h"
+#include "base/init_mozc.h"
+#include "base/japanese_util_rule.h"
+#include "base/logging.h"
+#include "base/port.h"
+#include "base/simd_util.h"
+#include "base/stopwatch.h"
+#include "base/util.h"
+
+DEFINE_string(input, "", "space separated dictionary source files");
+DEFINE_int32(iterations, 20, "Number of passes over the strings.");
+
+namespace mozc {
+namespace {
+
+// Reads the key and value columns of the dictionary source files.
+void LoadEntries(const string &files, std::vector<string> *keys,
+                 std::vector<string> *values) {
+  std::vector<string> filenames;
+  Util::SplitStringUsing(files, " ", &filenames);
+  for (size_t i = 0; i < filenames.size(); ++i) {
+    InputFileStream ifs(filenames[i].c_str());
+    CHECK(ifs.good()) << "Failed to open " << filenames[i];
+    string line;
+    std::vector<string> columns;
+    while (!getline(ifs, line).fail()) {
+      columns.clear();
+      Util::SplitStringAllowEmpty(line, "\t", &columns);
+      if (columns.size() < 5) {
+        continue;
+      }
+      keys->push_back(columns[0]);
+      values->push_back(columns[4]);
+    }
+  }
+}
+
+template <typename Func>
+void RunBenchmark(const string &name, const std::vector<string> &strings,
+                  Func func) {
+  int64 checksum = 0;
+  Stopwatch stopwatch = Stopwatch::StartNew();
+  for (int i = 0; i < FLAGS_iterations; ++i) {
+    for (size_t j = 0; j < strings.size(); ++j) {
+      checksum += func(strings[j]);
+    }
+  }
+  stopwatch.Stop();
+  const double num_calls = static_cast<double>(strings.size()) *
+                           FLAGS_iterations;
+  std::cout << name << ": "
+            << stopwatch.GetElapsedNanoseconds() / num_calls
+            << " ns/string checksum=" << checksum << std::endl;
+}
+
+const char *GetInstructionSetName(SimdUtil::InstructionSet instruction_set) {
+  switch (instruction_set) {
+    case SimdUtil::SCALAR:
+      return "scalar";
+    case SimdUtil::SSE2:
+      return "sse2";
+    case SimdUtil::AVX2:
+      return "avx2";
+    default:
+      return "unknown";
+  }
+}
+
+size_t CharsLenByOneCharLen(const string &str) {
+  const char *begin = str.data();
+  const char *end = str.data() + str.size();
+  size_t num_chars = 0;
+  while (begin < end) {
+    begin += Util::OneCharLen(begin);
+    ++num_chars;
+  }
+  return num_chars;
+}
+
+void RunBaselineBenchmarks(const std::vector<string> &keys,
+                           const std::vector<string> &katakana_keys,
+                           const std::vector<string> &values) {
+  RunBenchmark("baseline CharsLen", values, CharsLenByOneCharLen);
+  RunBenchmark("baseline HiraganaToKatakana", keys,
+               [](const string &str) {
+                 string output;
+                 Util::ConvertUsingDoubleArray(
+                     japanese_util_rule::hiragana_to_katakana_da,
+                     japanese_util_rule::hiragana_to_katakana_table,
+                     str, &output);
+                 return output.size();
+               });
+  RunBenchmark("baseline KatakanaToHiragana", katakana_keys,
+               [](const string &str) {
+                 string output;
+                 Util::ConvertUsingDoubleArray(
+                     japanese_util_rule::katakana_to_hiragana_da,
+                     japanese_util_rule::katakana_to_hiragana_table,
+                     str, &output);
+                 return output.size();
+               });
+  RunBenchmark("baseline FullWidthAsciiToHalfWidthAscii", values,
+               [](const string &str) {
+                 string output;
+                 Util::ConvertUsingDoubleArray(
+                     japanese_util_rule::fullwidthascii_to_halfwidthascii_da,
+                     japanese_util_rule::fullwidthascii_to_halfwidthascii_table,
+                     str, &output);
+                 return output.size();
+               });
+}
+
+void RunBenchmarks(SimdUtil::InstructionSet instruction_set,
+                   const std::vector<string> &keys,
+                   const std::vector<string> &katakana_keys,
+                   const std::vector<string> &values) {
+  const string prefix = string(GetInstructionSetName(instruction_set)) + " ";
+  RunBenchmark(prefix + "CharsLen", values, [](const string &str) {
+    return Util::CharsLen(str);
+  });
+  RunBenchmark(prefix + "SubStringPiece", values, [](const string &str) {
+    return Util::SubStringPiece(str, 1, 3).size();
+  });
+  RunBenchmark(prefix + "SplitStringToUtf8Chars", values,
+               [](const string &str) {
+                 std::vector<string> chars;
+                 Util::SplitStringToUtf8Chars(str, &chars);
+                 return chars.size();
+               });
+  RunBenchmark(prefix + "HiraganaToKatakana", keys, [](const string &str) {
+    string output;
+    Util::HiraganaToKatakana(str, &output);
+    return output.size();
+  });
+  RunBenchmark(prefix + "KatakanaToHiragana", katakana_keys,
+               [](const string &str) {
+                 string output;
+                 Util::KatakanaToHiragana(str, &output);
+                 return output.size();
+               });
+  RunBenchmark(prefix + "FullWidthAsciiToHalfWidthAscii", values,
+               [](const string &str) {
+                 string output;
+                 Util::FullWidthAsciiToHalfWidthAscii(str, &output);
+                 return output.size();
+               });
+}
+
+}  // namespace
+}  // namespace mozc
+
+int main(int argc, char **argv) {
+  mozc::InitMozc(argv[0], &argc, &argv, false);
+
+  std::vector<string> keys, values;
+  mozc::LoadEntries(FLAGS_input, &keys, &values);
+  CHECK(!values.empty()) << "No values in --input";
+  std::vector<string> katakana_keys(keys.size());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    mozc::Util::HiraganaToKatakana(keys[i], &katakana_keys[i]);
+  }
+  std::cout << "values=" << values.size() << std::endl;
+
+  mozc::RunBaselineBenchmarks(keys, katakana_keys, values);
+  const mozc::SimdUtil::InstructionSet kInstructionSets[] = {
+    mozc::SimdUtil::SCALAR, mozc::SimdUtil::SSE2, mozc::SimdUtil::AVX2,
+  };
+  for (size_t i = 0; i < arraysize(kInstructionSets); ++i) {
+    if (mozc::SimdUtil::SetInstructionSetForTesting(kInstructionSets[i])) {
+      mozc::RunBenchmarks(kInstructionSets[i], keys, katakana_keys, values);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,234 @@
+// Copyright 2010-2018, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "base/simd_util.h"
+
+#include <string>
+
+#include "base/port.h"
+#include "base/util.h"
+#include "testing/base/public/gunit.h"
+
+namespace mozc {
+namespace {
+
+// Steps over the characters like the scalar kernel for comparison.
+size_t SkipCharsByOneCharLen(const char *begin, const char *end,
+                             size_t max_chars, const char **next) {
+  size_t num_chars = 0;
+  while (begin < end && num_chars < max_chars) {
+    begin += Util::OneCharLen(begin);
+    ++num_chars;
+  }
+  *next = begin;
+  return num_chars;
+}
+
+// Returns a random string which mixes ASCII, kana, kanji, surrogate pairs
+// in UTF-16 and invalid UTF-8 sequences.
+string RandomString(size_t num_pieces) {
+  static const char *kPieces[] = {
+    "a", "Z", " ", "\xC3\xA9",                  // é
+    "\xE3\x81\x81", "\xE3\x81\x82", "\xE3\x82\x94",  // ぁ, あ, ゔ
+    "\xE3\x82\x95", "\xE3\x82\x9B",             // ゕ, ゛
+    "\xE3\x82\xA1", "\xE3\x82\xA2", "\xE3\x83\xB4",  // ァ, ア, ヴ
+    "\xE3\x83\xB5", "\xE3\x83\xBC",             // ヵ, ー
+    "\xE6\xBC\xA2", "\xEF\xBD\xB1",             // 漢, ｱ
+    "\xF0\xA0\xAE\xB7",                         // 𠮷
+    "\x80", "\xE3\x81", "\xF0\x9F",
+  };
+  string result;
+  for (size_t i = 0; i < num_pieces; ++i) {
+    // Makes long runs of kana and ASCII more likely.
+    const int r = Util::Random(4);
+    if (r == 0) {
+      result.append(kPieces[Util::Random(arraysize(kPieces))]);
+    } else if (r == 1) {
+      result.append(kPieces[Util::Random(3)]);
+    } else {
+      const char32 c = (r == 2 ? 0x3041 : 0x30A1) + Util::Random(0x54);
+      Util::UCS4ToUTF8Append(c, &result);
+    }
+  }
+  return result;
+}
+
+class SimdUtilTest
+    : public ::testing::TestWithParam<SimdUtil::InstructionSet> {
+ protected:
+  void SetUp() override {
+    original_ = SimdUtil::GetInstructionSet();
+    supported_ = SimdUtil::SetInstructionSetForTesting(GetParam());
+  }
+
+  void TearDown() override {
+    SimdUtil::SetInstructionSetForTesting(original_);
+  }
+
+  SimdUtil::InstructionSet original_;
+  bool supported_;
+};
+
+TEST_P(SimdUtilTest, SkipChars) {
+  if (!supported_) {
+    return;
+  }
+  // "aあ𠮷é"
+  const string str = "a\xE3\x81\x82\xF0\xA0\xAE\xB7\xC3\xA9";
+  const char *begin = str.data();
+  const char *end = str.data() + str.size();
+  const char *next = nullptr;
+  EXPECT_EQ(4, SimdUtil::SkipChars(begin, end, string::npos, &next));
+  EXPECT_EQ(end, next);
+  EXPECT_EQ(2, SimdUtil::SkipChars(begin, end, 2, &next));
+  EXPECT_EQ(begin + 4, next);
+  EXPECT_EQ(0, SimdUtil::SkipChars(begin, end, 0, &next));
+  EXPECT_EQ(begin, next);
+  EXPECT_EQ(0, SimdUtil::SkipChars(end, end, string::npos, &next));
+  EXPECT_EQ(end, next);
+
+  // The truncated character is counted and stepped over beyond the end.
+  const string truncated = string(20, 'a') + "\xE3\x81";
+  begin = truncated.data();
+  end = truncated.data() + truncated.size();
+  EXPECT_EQ(21, SimdUtil::SkipChars(begin, end, string::npos, &next));
+  EXPECT_EQ(end + 1, next);
+}
+
+TEST_P(SimdUtilTest, SkipCharsForRandomStrings) {
+  if (!supported_) {
+    return;
+  }
+  for (int i = 0; i < 1000; ++i) {
+    const string str = RandomString(Util::Random(100));
+    const char *begin = str.data();
+    const char *end = str.data() + str.size();
+    const size_t max_chars =
+        Util::Random(2) == 0 ? string::npos : Util::Random(100);
+    const char *expected_next = nullptr;
+    const size_t expected =
+        SkipCharsByOneCharLen(begin, end, max_chars, &expected_next);
+    const char *next = nullptr;
+    EXPECT_EQ(expected, SimdUtil::SkipChars(begin, end, max_chars, &next))
+        << str;
+    EXPECT_EQ(expected_next, next) << str;
+  }
+}
+
+TEST_P(SimdUtilTest, SkipAscii) {
+  if (!supported_) {
+    return;
+  }
+  for (size_t length = 0; length < 70; ++length) {
+    const string str = string(length, 'a') + "\xE3\x81\x82" + "abc";
+    const char *begin = str.data();
+    EXPECT_EQ(begin + length,
+              SimdUtil::SkipAscii(begin, begin + str.size()));
+    EXPECT_EQ(begin + length, SimdUtil::SkipAscii(begin, begin + length));
+  }
+  const string del = "abc\x7F\x80";
+  EXPECT_EQ(del.data() + 4,
+            SimdUtil::SkipAscii(del.data(), del.data() + del.size()));
+}
+
+TEST_P(SimdUtilTest, HiraganaToKatakana) {
+  if (!supported_) {
+    return;
+  }
+  // The last hiragana of the run is left for the conversion rules.
+  string output = "x";
+  // "ぁあゔう゛"
+  const string str = "\xE3\x81\x81\xE3\x81\x82\xE3\x82\x94"
+                     "\xE3\x81\x86\xE3\x82\x9B";
+  const char *next =
+      SimdUtil::HiraganaToKatakana(str.data(), str.data() + str.size(),
+                                   &output);
+  EXPECT_EQ(str.data() + 9, next);
+  // "xァアヴ"
+  EXPECT_EQ("x\xE3\x82\xA1\xE3\x82\xA2\xE3\x83\xB4", output);
+
+  // Not hiragana.
+  output.clear();
+  const string katakana = "\xE3\x82\xA2\xE3\x82\xA2";  // "アア"
+  EXPECT_EQ(katakana.data(),
+            SimdUtil::HiraganaToKatakana(
+                katakana.data(), katakana.data() + katakana.size(), &output));
+  EXPECT_TRUE(output.empty());
+}
+
+TEST_P(SimdUtilTest, KatakanaToHiragana) {
+  if (!supported_) {
+    return;
+  }
+  string output;
+  // "ァアヴヵ"
+  const string str = "\xE3\x82\xA1\xE3\x82\xA2\xE3\x83\xB4\xE3\x83\xB5";
+  const char *next =
+      SimdUtil::KatakanaToHiragana(str.data(), str.data() + str.size(),
+                                   &output);
+  EXPECT_EQ(str.data() + 6, next);
+  // "ぁあ"
+  EXPECT_EQ("\xE3\x81\x81\xE3\x81\x82", output);
+}
+
+TEST_P(SimdUtilTest, KanaConversionForRandomStrings) {
+  if (!supported_) {
+    return;
+  }
+  const SimdUtil::InstructionSet instruction_set = GetParam();
+  for (int i = 0; i < 1000; ++i) {
+    const string str = RandomString(Util::Random(100));
+    for (size_t start = 0; start < str.size(); ++start) {
+      const char *begin = str.data() + start;
+      const char *end = str.data() + str.size();
+      string expected_hiragana, expected_katakana;
+      ASSERT_TRUE(SimdUtil::SetInstructionSetForTesting(SimdUtil::SCALAR));
+      const char *expected_hiragana_next =
+          SimdUtil::KatakanaToHiragana(begin, end, &expected_hiragana);
+      const char *expected_katakana_next =
+          SimdUtil::HiraganaToKatakana(begin, end, &expected_katakana);
+
+      string hiragana, katakana;
+      ASSERT_TRUE(SimdUtil::SetInstructionSetForTesting(instruction_set));
+      EXPECT_EQ(expected_hiragana_next,
+                SimdUtil::KatakanaToHiragana(begin, end, &hiragana));
+      EXPECT_EQ(expected_hiragana, hiragana);
+      EXPECT_EQ(expected_katakana_next,
+                SimdUtil::HiraganaToKatakana(begin, end, &katakana));
+      EXPECT_EQ(expected_katakana, katakana);
+    }
+  }
+}
+
+INSTANTIATE_TEST_CASE_P(InstructionSets, SimdUtilTest,
+                        ::testing::Values(SimdUtil::SCALAR, SimdUtil::SSE2,
+                                          SimdUtil::AVX2));
+
+}  // namespace
+}  // namespace mozc
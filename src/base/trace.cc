@@ -0,0 +1,268 @@
+// Copyright 2010-2018, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "base/trace.h"
+
+#ifdef OS_WIN
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif  // OS_WIN
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+#include "base/clock.h"
+#include "base/logging.h"
+#include "base/mutex.h"
+#include "base/util.h"
+
+namespace mozc {
+namespace {
+
+// The ring buffer of the spans recorded by one thread.  Only the owner
+// thread writes to it, while any thread may read it.
+class TraceBuffer {
+ public:
+  explicit TraceBuffer(uint32 thread_id)
+      : thread_id_(thread_id), started_(0), written_(0), first_(0) {}
+
+  void Record(const char *name, uint64 begin_ticks, uint64 end_ticks) {
+    const uint64 index = written_.load(std::memory_order_relaxed);
+    // Readers check |started_| after copying the slots to detect the slots
+    // overwritten while they were copied.
+    started_.store(index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    Slot &slot = slots_[index % Tracer::kBufferSize];
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.begin_ticks.store(begin_ticks, std::memory_order_relaxed);
+    slot.end_ticks.store(end_ticks, std::memory_order_relaxed);
+    written_.store(index + 1, std::memory_order_release);
+  }
+
+  void Copy(std::vector<Tracer::Span> *spans) const {
+    const uint64 end = written_.load(std::memory_order_acquire);
+    uint64 begin = first_.load(std::memory_order_relaxed);
+    if (end > Tracer::kBufferSize) {
+      begin = std::max(begin, end - Tracer::kBufferSize);
+    }
+    const size_t offset = spans->size();
+    for (uint64 i = begin; i < end; ++i) {
+      const Slot &slot = slots_[i % Tracer::kBufferSize];
+      Tracer::Span span;
+      span.name = slot.name.load(std::memory_order_relaxed);
+      span.thread_id = thread_id_;
+      span.begin_ticks = slot.begin_ticks.load(std::memory_order_relaxed);
+      span.end_ticks = slot.end_ticks.load(std::memory_order_relaxed);
+      spans->push_back(span);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const uint64 started = started_.load(std::memory_order_relaxed);
+    if (started > Tracer::kBufferSize &&
+        started - Tracer::kBufferSize > begin) {
+      const uint64 num_overwritten = std::min(
+          started - Tracer::kBufferSize - begin, end - begin);
+      spans->erase(spans->begin() + offset,
+                   spans->begin() + offset + num_overwritten);
+    }
+  }
+
+  void Clear() {
+    first_.store(written_.load(std::memory_order_relaxed),
+                 std::memory_order_relaxed);
+  }
+
+ private:
+  struct Slot {
+    std::atomic<const char *> name;
+    std::atomic<uint64> begin_ticks;
+    std::atomic<uint64> end_ticks;
+  };
+
+  const uint32 thread_id_;
+  // The number of the spans whose recording has been started.
+  std::atomic<uint64> started_;
+  // The number of the spans recorded.
+  std::atomic<uint64> written_;
+  // The index of the first span not cleared.
+  std::atomic<uint64> first_;
+  Slot slots_[Tracer::kBufferSize];
+
+  DISALLOW_COPY_AND_ASSIGN(TraceBuffer);
+};
+
+// The buffers are never deleted so that the spans of exited threads can
+// still be read.  When a thread exits, its buffer is put into
+// |g_free_buffers| and reused by the next new thread, so the number of the
+// buffers is bounded by the number of the threads alive at the same time.
+// A reused buffer keeps its thread id and the last spans of the exited thread.
+Mutex g_buffers_mutex;  // NOLINT
+std::vector<TraceBuffer *> *g_buffers = nullptr;
+std::vector<TraceBuffer *> *g_free_buffers = nullptr;
+
+// The thread local slot of the buffer of the current thread.
+once_t g_thread_buffer_key_once = MOZC_ONCE_INIT;
+#ifdef OS_WIN
+DWORD g_thread_buffer_key = FLS_OUT_OF_INDEXES;
+#else
+pthread_key_t g_thread_buffer_key;
+#endif  // OS_WIN
+
+// Called on the exit of a thread which has a buffer.
+void RecycleThreadBuffer(void *buffer) {
+  scoped_lock l(&g_buffers_mutex);
+  g_free_buffers->push_back(static_cast<TraceBuffer *>(buffer));
+}
+
+#ifdef OS_WIN
+void NTAPI RecycleThreadBufferCallback(void *buffer) {
+  RecycleThreadBuffer(buffer);
+}
+#endif  // OS_WIN
+
+void InitThreadBufferKey() {
+  {
+    scoped_lock l(&g_buffers_mutex);
+    g_buffers = new std::vector<TraceBuffer *>;
+    g_free_buffers = new std::vector<TraceBuffer *>;
+  }
+#ifdef OS_WIN
+  // Unlike TLS, FLS calls the callback on the thread exit.
+  g_thread_buffer_key = ::FlsAlloc(&RecycleThreadBufferCallback);
+  CHECK_NE(FLS_OUT_OF_INDEXES, g_thread_buffer_key);
+#else
+  CHECK_EQ(0, pthread_key_create(&g_thread_buffer_key, &RecycleThreadBuffer));
+#endif  // OS_WIN
+}
+
+TraceBuffer *GetThreadBuffer() {
+  CallOnce(&g_thread_buffer_key_once, &InitThreadBufferKey);
+#ifdef OS_WIN
+  TraceBuffer *buffer =
+      static_cast<TraceBuffer *>(::FlsGetValue(g_thread_buffer_key));
+#else
+  TraceBuffer *buffer =
+      static_cast<TraceBuffer *>(pthread_getspecific(g_thread_buffer_key));
+#endif  // OS_WIN
+  if (buffer != nullptr) {
+    return buffer;
+  }
+
+  {
+    scoped_lock l(&g_buffers_mutex);
+    if (g_free_buffers->empty()) {
+      buffer = new TraceBuffer(static_cast<uint32>(g_buffers->size()));
+      g_buffers->push_back(buffer);
+    } else {
+      buffer = g_free_buffers->back();
+      g_free_buffers->pop_back();
+    }
+  }
+#ifdef OS_WIN
+  ::FlsSetValue(g_thread_buffer_key, buffer);
+#else
+  pthread_setspecific(g_thread_buffer_key, buffer);
+#endif  // OS_WIN
+  return buffer;
+}
+
+// Orders the spans by the begin time, and puts the outer one first if two
+// spans begin at the same time.
+bool CompareSpans(const Tracer::Span &lhs, const Tracer::Span &rhs) {
+  if (lhs.begin_ticks != rhs.begin_ticks) {
+    return lhs.begin_ticks < rhs.begin_ticks;
+  }
+  return lhs.end_ticks > rhs.end_ticks;
+}
+
+}  // namespace
+
+const size_t Tracer::kBufferSize;
+
+void Tracer::Record(const char *name, uint64 begin_ticks, uint64 end_ticks) {
+  GetThreadBuffer()->Record(name, begin_ticks, end_ticks);
+}
+
+void Tracer::GetSpans(std::vector<Span> *spans) {
+  DCHECK(spans);
+  spans->clear();
+  {
+    scoped_lock l(&g_buffers_mutex);
+    if (g_buffers == nullptr) {
+      return;
+    }
+    for (size_t i = 0; i < g_buffers->size(); ++i) {
+      (*g_buffers)[i]->Copy(spans);
+    }
+  }
+  std::stable_sort(spans->begin(), spans->end(), CompareSpans);
+}
+
+void Tracer::GetChromeTraceEvents(string *output) {
+  DCHECK(output);
+  std::vector<Span> spans;
+  GetSpans(&spans);
+
+  // The timestamps are in microseconds.
+  const double usec_per_tick = 1000000.0 / Clock::GetFrequency();
+  output->assign("{\"traceEvents\":[");
+  for (size_t i = 0; i < spans.size(); ++i) {
+    const Span &span = spans[i];
+    if (i > 0) {
+      output->append(",");
+    }
+    output->append(Util::StringPrintf(
+        "\n{\"name\":\"%s\",\"cat\":\"mozc\",\"ph\":\"X\",\"pid\":0,"
+        "\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+        span.name, span.thread_id, span.begin_ticks * usec_per_tick,
+        (span.end_ticks - span.begin_ticks) * usec_per_tick));
+  }
+  output->append("]}\n");
+}
+
+void Tracer::Clear() {
+  scoped_lock l(&g_buffers_mutex);
+  if (g_buffers == nullptr) {
+    return;
+  }
+  for (size_t i = 0; i < g_buffers->size(); ++i) {
+    (*g_buffers)[i]->Clear();
+  }
+}
+
+ScopedTraceSpan::ScopedTraceSpan(const char *name)
+    : name_(name), begin_ticks_(Clock::GetTicks()) {}
+
+ScopedTraceSpan::~ScopedTraceSpan() {
+  Tracer::Record(name_, begin_ticks_, Clock::GetTicks());
+}
+
+}  // namespace mozc
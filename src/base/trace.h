@@ -0,0 +1,114 @@
+// Copyright 2010-2018, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+// Tracer records the latency of the stages of the conversion pipeline.
+//
+// usage:
+// void ImmutableConverterImpl::Viterbi(...) {
+//   MOZC_TRACE_SCOPE("ImmutableConverter::Viterbi");
+//   ...
+// }
+//
+// Each thread records the spans into its own ring buffer without a lock, so
+// only the most recent kBufferSize spans per thread are kept.  The buffer of
+// an exited thread is reused by a thread started later.  The spans
+// are dumped in the Chrome trace event format, which can be loaded by
+// chrome://tracing.
+//
+// Tracing is compiled out when MOZC_NO_TRACE is defined.
+
+#ifndef MOZC_BASE_TRACE_H_
+#define MOZC_BASE_TRACE_H_
+
+#include <string>
+#include <vector>
+
+#include "base/port.h"
+
+namespace mozc {
+
+class Tracer {
+ public:
+  // The number of the spans kept for each thread.
+  static const size_t kBufferSize = 4096;
+
+  struct Span {
+    const char *name;
+    uint32 thread_id;
+    // In the ticks of Clock::GetTicks().
+    uint64 begin_ticks;
+    uint64 end_ticks;
+  };
+
+  // Records a span on the buffer of the current thread.  |name| must be a
+  // string literal, since only the pointer is stored.
+  static void Record(const char *name, uint64 begin_ticks, uint64 end_ticks);
+
+  // Copies the spans kept for all the threads, in the order of the begin
+  // time.
+  static void GetSpans(std::vector<Span> *spans);
+
+  // Writes the spans kept for all the threads as a JSON object of the Chrome
+  // trace event format.
+  static void GetChromeTraceEvents(string *output);
+
+  // Discards the spans recorded so far.
+  static void Clear();
+
+ private:
+  DISALLOW_IMPLICIT_CONSTRUCTORS(Tracer);
+};
+
+// Records a span from the construction to the destruction.
+class ScopedTraceSpan {
+ public:
+  explicit ScopedTraceSpan(const char *name);
+  ~ScopedTraceSpan();
+
+ private:
+  const char *name_;
+  const uint64 begin_ticks_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedTraceSpan);
+};
+
+}  // namespace mozc
+
+#define MOZC_TRACE_CONCAT_INTERNAL(a, b) a##b
+#define MOZC_TRACE_CONCAT(a, b) MOZC_TRACE_CONCAT_INTERNAL(a, b)
+
+#ifdef MOZC_NO_TRACE
+#define MOZC_TRACE_SCOPE(name) do {} while (false)
+#else  // MOZC_NO_TRACE
+#define MOZC_TRACE_SCOPE(name) \
+  ::mozc::ScopedTraceSpan MOZC_TRACE_CONCAT(mozc_trace_span_, __LINE__)(name)
+#endif  // MOZC_NO_TRACE
+
+#endif  // MOZC_BASE_TRACE_H_
@@ -0,0 +1,188 @@
+// Copyright 2010-2018, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "base/trace.h"
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "base/port.h"
+#include "base/thread.h"
+#include "base/util.h"
+#include "testing/base/public/gunit.h"
+
+namespace mozc {
+namespace {
+
+const char kOuter[] = "Outer";
+const char kInner[] = "Inner";
+const char kOther[] = "Other";
+
+class RecordThread : public Thread {
+ public:
+  RecordThread(uint64 begin_ticks, size_t num_spans)
+      : begin_ticks_(begin_ticks), num_spans_(num_spans),
+        num_recorded_(nullptr), num_threads_(0) {}
+
+  // Makes the thread wait after recording until |num_threads| threads have
+  // recorded, so that they are alive at the same time.
+  void WaitForOtherThreads(std::atomic<int> *num_recorded, int num_threads) {
+    num_recorded_ = num_recorded;
+    num_threads_ = num_threads;
+  }
+
+  void Run() override {
+    for (size_t i = 0; i < num_spans_; ++i) {
+      Tracer::Record(kOther, begin_ticks_ + i, begin_ticks_ + i + 1);
+    }
+    if (num_recorded_ != nullptr) {
+      ++*num_recorded_;
+      while (*num_recorded_ < num_threads_) {
+        Util::Sleep(1);
+      }
+    }
+  }
+
+ private:
+  const uint64 begin_ticks_;
+  const size_t num_spans_;
+  std::atomic<int> *num_recorded_;
+  int num_threads_;
+};
+
+class TracerTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    Tracer::Clear();
+  }
+
+  void TearDown() override {
+    Tracer::Clear();
+  }
+};
+
+TEST_F(TracerTest, ScopedTraceSpan) {
+  {
+    ScopedTraceSpan outer(kOuter);
+    {
+      ScopedTraceSpan inner(kInner);
+    }
+  }
+
+  std::vector<Tracer::Span> spans;
+  Tracer::GetSpans(&spans);
+  ASSERT_EQ(2, spans.size());
+  EXPECT_EQ(kOuter, spans[0].name);
+  EXPECT_EQ(kInner, spans[1].name);
+  EXPECT_EQ(spans[0].thread_id, spans[1].thread_id);
+  EXPECT_LE(spans[0].begin_ticks, spans[1].begin_ticks);
+  EXPECT_LE(spans[1].begin_ticks, spans[1].end_ticks);
+  EXPECT_LE(spans[1].end_ticks, spans[0].end_ticks);
+}
+
+TEST_F(TracerTest, Clear) {
+  Tracer::Record(kOuter, 10, 20);
+  Tracer::Clear();
+  Tracer::Record(kInner, 30, 40);
+
+  std::vector<Tracer::Span> spans;
+  Tracer::GetSpans(&spans);
+  ASSERT_EQ(1, spans.size());
+  EXPECT_EQ(kInner, spans[0].name);
+  EXPECT_EQ(30, spans[0].begin_ticks);
+  EXPECT_EQ(40, spans[0].end_ticks);
+}
+
+TEST_F(TracerTest, KeepsRecentSpans) {
+  const size_t kNumSpans = Tracer::kBufferSize + 100;
+  for (size_t i = 0; i < kNumSpans; ++i) {
+    Tracer::Record(kOuter, i, i + 1);
+  }
+
+  std::vector<Tracer::Span> spans;
+  Tracer::GetSpans(&spans);
+  ASSERT_EQ(Tracer::kBufferSize, spans.size());
+  for (size_t i = 0; i < spans.size(); ++i) {
+    EXPECT_EQ(i + 100, spans[i].begin_ticks);
+  }
+}
+
+TEST_F(TracerTest, MultipleThreads) {
+  RecordThread thread1(1000, 10);
+  RecordThread thread2(1005, 10);
+  std::atomic<int> num_recorded(0);
+  thread1.WaitForOtherThreads(&num_recorded, 2);
+  thread2.WaitForOtherThreads(&num_recorded, 2);
+  thread1.Start("TracerTest");
+  thread2.Start("TracerTest");
+  thread1.Join();
+  thread2.Join();
+
+  std::vector<Tracer::Span> spans;
+  Tracer::GetSpans(&spans);
+  ASSERT_EQ(20, spans.size());
+  for (size_t i = 1; i < spans.size(); ++i) {
+    EXPECT_LE(spans[i - 1].begin_ticks, spans[i].begin_ticks);
+  }
+  EXPECT_NE(spans.front().thread_id, spans.back().thread_id);
+}
+
+TEST_F(TracerTest, ReusesBufferOfExitedThread) {
+  RecordThread thread1(1000, 10);
+  thread1.Start("TracerTest");
+  thread1.Join();
+  RecordThread thread2(2000, 10);
+  thread2.Start("TracerTest");
+  thread2.Join();
+
+  // The spans of |thread1| are kept in the buffer reused by |thread2|.
+  std::vector<Tracer::Span> spans;
+  Tracer::GetSpans(&spans);
+  ASSERT_EQ(20, spans.size());
+  EXPECT_EQ(1000, spans.front().begin_ticks);
+  EXPECT_EQ(2009, spans.back().begin_ticks);
+  EXPECT_EQ(spans.front().thread_id, spans.back().thread_id);
+}
+
+TEST_F(TracerTest, GetChromeTraceEvents) {
+  string output;
+  Tracer::GetChromeTraceEvents(&output);
+  EXPECT_EQ("{\"traceEvents\":[]}\n", output);
+
+  Tracer::Record(kOuter, 0, 0);
+  Tracer::GetChromeTraceEvents(&output);
+  EXPECT_NE(string::npos, output.find("\"name\":\"Outer\""));
+  EXPECT_NE(string::npos, output.find("\"ph\":\"X\""));
+  EXPECT_NE(string::npos, output.find("\"dur\":0.000"));
+}
+
+}  // namespace
+}  // namespace mozc
@@ -65,6 +65,7 @@
 #include "base/japanese_util_rule.h"
 #include "base/logging.h"
 #include "base/port.h"
+#include "base/simd_util.h"
 #include "base/string_piece.h"
 
 
@@ -233,6 +234,7 @@ void Util::SplitStringToUtf8Chars(StringPiece str,
                                   std::vector<string> *output) {
   const char *begin = str.data();
   const char *const end = str.data() + str.size();
+  output->reserve(output->size() + CharsLen(str));
   while (begin < end) {
     const size_t mblen = OneCharLen(begin);
     output->emplace_back(begin, mblen);
@@ -526,14 +528,8 @@ size_t Util::OneCharLen(const char *src) {
 }
 
 size_t Util::CharsLen(const char *src, size_t length) {
-  const char *begin = src;
-  const char *end = src + length;
-  int result = 0;
-  while (begin < end) {
-    ++result;
-    begin += OneCharLen(begin);
-  }
-  return result;
+  const char *next = nullptr;
+  return SimdUtil::SkipChars(src, src + length, string::npos, &next);
 }
 
 char32 Util::UTF8ToUCS4(const char *begin,
@@ -793,11 +789,8 @@ int Util::WideToUTF8(const std::wstring &input, string *output) {
 #endif  // OS_WIN
 
 StringPiece Util::SubStringPiece(StringPiece src, size_t start) {
-  const char *begin = src.data();
-  const char *end = begin + src.size();
-  for (size_t i = 0; i < start && begin < end; ++i) {
-    begin += OneCharLen(begin);
-  }
+  const char *begin = nullptr;
+  SimdUtil::SkipChars(src.data(), src.data() + src.size(), start, &begin);
   const size_t prefix_len = begin - src.data();
   return StringPiece(begin, src.size() - prefix_len);
 }
@@ -805,13 +798,9 @@ StringPiece Util::SubStringPiece(StringPiece src, size_t start) {
 StringPiece Util::SubStringPiece(
     StringPiece src, size_t start, size_t length) {
   src = SubStringPiece(src, start);
-  size_t l = length;
-  const char *substr_end = src.data();
-  const char *const end = src.data() + src.size();
-  while (l > 0 && substr_end < end) {
-    substr_end += OneCharLen(substr_end);
-    --l;
-  }
+  const char *substr_end = nullptr;
+  SimdUtil::SkipChars(src.data(), src.data() + src.size(), length,
+                      &substr_end);
   return StringPiece(src.data(), substr_end - src.data());
 }
 
@@ -1108,16 +1097,45 @@ int LookupDoubleArray(const japanese_util_rule::DoubleArray *array,
   return seekto;
 }
 
-}  // namespace
+// Returns true if any rule of |da| starts with an ASCII character.
+bool HasAsciiRule(const japanese_util_rule::DoubleArray *da) {
+  const int b = da[0].base;
+  for (int c = 0; c < 0x80; ++c) {
+    if (static_cast<uint32>(b) == da[b + c + 1].check) {
+      return true;
+    }
+  }
+  return false;
+}
 
-void Util::ConvertUsingDoubleArray(const japanese_util_rule::DoubleArray *da,
-                                   const char *ctable,
-                                   StringPiece input,
-                                   string *output) {
+// Conversion of hiragana and katakana by SimdUtil, which gives the same
+// result as the rules for the characters in the middle of kana.
+typedef const char *(*KanaConverter)(const char *begin, const char *end,
+                                     string *output);
+
+// Same as Util::ConvertUsingDoubleArray, but copies the runs of ASCII as is
+// if |copy_ascii| is true, and converts the runs of kana by |kana_converter|
+// if not null.
+void ConvertWithFastPaths(const japanese_util_rule::DoubleArray *da,
+                          const char *ctable, bool copy_ascii,
+                          KanaConverter kana_converter,
+                          StringPiece input, string *output) {
   output->clear();
   const char *begin = input.data();
   const char *const end = input.data() + input.size();
   while (begin < end) {
+    if (copy_ascii && static_cast<uint8>(*begin) < 0x80) {
+      const char *ascii_end = SimdUtil::SkipAscii(begin, end);
+      output->append(begin, ascii_end - begin);
+      begin = ascii_end;
+      continue;
+    }
+    if (kana_converter != nullptr) {
+      begin = kana_converter(begin, end, output);
+      if (begin >= end) {
+        break;
+      }
+    }
     int result = 0;
     int mblen = LookupDoubleArray(da, begin, static_cast<int>(end - begin),
                                   &result);
@@ -1128,32 +1146,38 @@ void Util::ConvertUsingDoubleArray(const japanese_util_rule::DoubleArray *da,
       mblen -= static_cast<int32>(p[len + 1]);
       begin += mblen;
     } else {
-      mblen = OneCharLen(begin);
+      // Clamps a truncated character at the end of |input|.
+      mblen = std::min<int>(Util::OneCharLen(begin), end - begin);
       output->append(begin, mblen);
       begin += mblen;
     }
   }
 }
 
+}  // namespace
+
+void Util::ConvertUsingDoubleArray(const japanese_util_rule::DoubleArray *da,
+                                   const char *ctable,
+                                   StringPiece input,
+                                   string *output) {
+  ConvertWithFastPaths(da, ctable, false, nullptr, input, output);
+}
+
 void Util::HiraganaToKatakana(StringPiece input, string *output) {
-  ConvertUsingDoubleArray(japanese_util_rule::hiragana_to_katakana_da,
-                          japanese_util_rule::hiragana_to_katakana_table,
-                          input,
-                          output);
+  static const bool kCopyAscii =
+      !HasAsciiRule(japanese_util_rule::hiragana_to_katakana_da);
+  ConvertWithFastPaths(japanese_util_rule::hiragana_to_katakana_da,
+                       japanese_util_rule::hiragana_to_katakana_table,
+                       kCopyAscii, &SimdUtil::HiraganaToKatakana,
+                       input, output);
 }
 
 void Util::HiraganaToHalfwidthKatakana(StringPiece input,
                                        string *output) {
   // combine two rules
   string tmp;
-  ConvertUsingDoubleArray(
-      japanese_util_rule::hiragana_to_katakana_da,
-      japanese_util_rule::hiragana_to_katakana_table,
-      input, &tmp);
-  ConvertUsingDoubleArray(
-      japanese_util_rule::fullwidthkatakana_to_halfwidthkatakana_da,
-      japanese_util_rule::fullwidthkatakana_to_halfwidthkatakana_table,
-      tmp, output);
+  HiraganaToKatakana(input, &tmp);
+  FullWidthKatakanaToHalfWidthKatakana(tmp, output);
 }
 
 void Util::HiraganaToRomanji(StringPiece input, string *output) {
@@ -1174,11 +1198,12 @@ void Util::HalfWidthAsciiToFullWidthAscii(StringPiece input,
 
 void Util::FullWidthAsciiToHalfWidthAscii(StringPiece input,
                                           string *output) {
-  ConvertUsingDoubleArray(
+  static const bool kCopyAscii =
+      !HasAsciiRule(japanese_util_rule::fullwidthascii_to_halfwidthascii_da);
+  ConvertWithFastPaths(
       japanese_util_rule::fullwidthascii_to_halfwidthascii_da,
       japanese_util_rule::fullwidthascii_to_halfwidthascii_table,
-      input,
-      output);
+      kCopyAscii, nullptr, input, output);
 }
 
 void Util::HiraganaToFullwidthRomanji(StringPiece input, string *output) {
@@ -1202,28 +1227,32 @@ void Util::RomanjiToHiragana(StringPiece input, string *output) {
 }
 
 void Util::KatakanaToHiragana(StringPiece input, string *output) {
-  ConvertUsingDoubleArray(japanese_util_rule::katakana_to_hiragana_da,
-                          japanese_util_rule::katakana_to_hiragana_table,
-                          input,
-                          output);
+  static const bool kCopyAscii =
+      !HasAsciiRule(japanese_util_rule::katakana_to_hiragana_da);
+  ConvertWithFastPaths(japanese_util_rule::katakana_to_hiragana_da,
+                       japanese_util_rule::katakana_to_hiragana_table,
+                       kCopyAscii, &SimdUtil::KatakanaToHiragana,
+                       input, output);
 }
 
 void Util::HalfWidthKatakanaToFullWidthKatakana(StringPiece input,
                                                 string *output) {
-  ConvertUsingDoubleArray(
+  static const bool kCopyAscii = !HasAsciiRule(
+      japanese_util_rule::halfwidthkatakana_to_fullwidthkatakana_da);
+  ConvertWithFastPaths(
       japanese_util_rule::halfwidthkatakana_to_fullwidthkatakana_da,
       japanese_util_rule::halfwidthkatakana_to_fullwidthkatakana_table,
-      input,
-      output);
+      kCopyAscii, nullptr, input, output);
 }
 
 void Util::FullWidthKatakanaToHalfWidthKatakana(StringPiece input,
                                                 string *output) {
-  ConvertUsingDoubleArray(
+  static const bool kCopyAscii = !HasAsciiRule(
+      japanese_util_rule::fullwidthkatakana_to_halfwidthkatakana_da);
+  ConvertWithFastPaths(
       japanese_util_rule::fullwidthkatakana_to_halfwidthkatakana_da,
       japanese_util_rule::fullwidthkatakana_to_halfwidthkatakana_table,
-      input,
-      output);
+      kCopyAscii, nullptr, input, output);
 }
 
 void Util::FullWidthToHalfWidth(StringPiece input, string *output) {
@@ -1244,10 +1273,11 @@ void Util::HalfWidthToFullWidth(StringPiece input, string *output) {
 // of some UNICODE only characters (required to display
 // and commit for old clients)
 void Util::NormalizeVoicedSoundMark(StringPiece input, string *output) {
-  ConvertUsingDoubleArray(japanese_util_rule::normalize_voiced_sound_da,
-                          japanese_util_rule::normalize_voiced_sound_table,
-                          input,
-                          output);
+  static const bool kCopyAscii =
+      !HasAsciiRule(japanese_util_rule::normalize_voiced_sound_da);
+  ConvertWithFastPaths(japanese_util_rule::normalize_voiced_sound_da,
+                       japanese_util_rule::normalize_voiced_sound_table,
+                       kCopyAscii, nullptr, input, output);
 }
 
 namespace {
@@ -1381,7 +1411,7 @@ bool Util::IsKanaSymbolContained(const string &input) {
   return false;
 }
 
-bool Util::IsEnglishTransliteration(const string &value) {
+bool Util::IsEnglishTransliteration(StringPiece value) {
   for (size_t i = 0; i < value.size(); ++i) {
     if (value[i] == 0x20 || value[i] == 0x21 ||
         value[i] == 0x27 || value[i] == 0x2D ||
@@ -1525,111 +1555,105 @@ void Util::EscapeCss(const string &plain, string *escaped) {
   StringReplace(plain, "<", "&lt;", true, escaped);
 }
 
-#define INRANGE(w, a, b) ((w) >= (a) && (w) <= (b))
+// Script type, form type and character set of every code point, packed into
+// one byte and looked up through a two-level table.
+#include "base/unicode_table.inc"
 
-// script type
-// TODO(yukawa, team): Make a mechanism to keep this classifier up-to-date
-//   based on the original data from Unicode.org.
-Util::ScriptType Util::GetScriptType(char32 w) {
-  if (INRANGE(w, 0x0030, 0x0039) ||    // ascii number
-      INRANGE(w, 0xFF10, 0xFF19)) {    // full width number
-    return NUMBER;
-  } else if (
-      INRANGE(w, 0x0041, 0x005A) ||    // ascii upper
-      INRANGE(w, 0x0061, 0x007A) ||    // ascii lower
-      INRANGE(w, 0xFF21, 0xFF3A) ||    // fullwidth ascii upper
-      INRANGE(w, 0xFF41, 0xFF5A)) {    // fullwidth ascii lower
-    return ALPHABET;
-  } else if (
-      w == 0x3005 ||                   // IDEOGRAPHIC ITERATION MARK "々"
-      INRANGE(w, 0x3400, 0x4DBF) ||    // CJK Unified Ideographs Extension A
-      INRANGE(w, 0x4E00, 0x9FFF) ||    // CJK Unified Ideographs
-      INRANGE(w, 0xF900, 0xFAFF) ||    // CJK Compatibility Ideographs
-      INRANGE(w, 0x20000, 0x2A6DF) ||  // CJK Unified Ideographs Extension B
-      INRANGE(w, 0x2A700, 0x2B73F) ||  // CJK Unified Ideographs Extension C
-      INRANGE(w, 0x2B740, 0x2B81F) ||  // CJK Unified Ideographs Extension D
-      INRANGE(w, 0x2F800, 0x2FA1F)) {  // CJK Compatibility Ideographs
-    // As of Unicode 6.0.2, each block has the following characters assigned.
-    // [U+3400, U+4DB5]:   CJK Unified Ideographs Extension A
-    // [U+4E00, U+9FCB]:   CJK Unified Ideographs
-    // [U+4E00, U+FAD9]:   CJK Compatibility Ideographs
-    // [U+20000, U+2A6D6]: CJK Unified Ideographs Extension B
-    // [U+2A700, U+2B734]: CJK Unified Ideographs Extension C
-    // [U+2B740, U+2B81D]: CJK Unified Ideographs Extension D
-    // [U+2F800, U+2FA1D]: CJK Compatibility Ideographs
-    return KANJI;
-  } else if (
-      INRANGE(w, 0x3041, 0x309F) ||    // hiragana
-      w == 0x1B001) {                  // HIRAGANA LETTER ARCHAIC YE
-    return HIRAGANA;
-  } else if (
-      INRANGE(w, 0x30A1, 0x30FF) ||    // full width katakana
-      INRANGE(w, 0x31F0, 0x31FF) ||    // Katakana Phonetic Extensions for Ainu
-      INRANGE(w, 0xFF65, 0xFF9F) ||    // half width katakana
-      w == 0x1B000) {                  // KATAKANA LETTER ARCHAIC E
-    return KATAKANA;
-  } else if (
-      INRANGE(w, 0x02300, 0x023F3) ||  // Miscellaneous Technical
-      INRANGE(w, 0x02700, 0x027BF) ||  // Dingbats
-      INRANGE(w, 0x1F000, 0x1F02F) ||  // Mahjong tiles
-      INRANGE(w, 0x1F030, 0x1F09F) ||  // Domino tiles
-      INRANGE(w, 0x1F0A0, 0x1F0FF) ||  // Playing cards
-      INRANGE(w, 0x1F100, 0x1F2FF) ||  // Enclosed Alphanumeric Supplement
-      INRANGE(w, 0x1F200, 0x1F2FF) ||  // Enclosed Ideographic Supplement
-      INRANGE(w, 0x1F300, 0x1F5FF) ||  // Miscellaneous Symbols And Pictographs
-      INRANGE(w, 0x1F600, 0x1F64F) ||  // Emoticons
-      INRANGE(w, 0x1F680, 0x1F6FF) ||  // Transport And Map Symbols
-      INRANGE(w, 0x1F700, 0x1F77F) ||  // Alchemical Symbols
-      w == 0x26CE ||                   // Ophiuchus
-      INRANGE(w, kUcs4MinGooglePuaEmoji, kUcs4MaxGooglePuaEmoji)) {
-    return EMOJI;
-  }
-
-  return UNKNOWN_SCRIPT;
+namespace {
+
+// Returns the packed properties of |w|.
+inline uint8 GetCharProperty(char32 w) {
+  if (w > kUnicodeTableMaxCodePoint) {
+    return kOutOfRangeProperty;
+  }
+  const char32 kOffsetMask = (1 << kUnicodeTableBlockShift) - 1;
+  return kUnicodeTableData[
+      (kUnicodeTableIndex[w >> kUnicodeTableBlockShift] <<
+       kUnicodeTableBlockShift) | (w & kOffsetMask)];
 }
 
-Util::FormType Util::GetFormType(char32 w) {
-  // 'Unicode Standard Annex #11: EAST ASIAN WIDTH'
-  // http://www.unicode.org/reports/tr11/
-
-  // Characters marked as 'Na' in
-  // http://www.unicode.org/Public/UNIDATA/EastAsianWidth.txt
-  if (INRANGE(w, 0x0020, 0x007F) ||  // ascii
-      INRANGE(w, 0x27E6, 0x27ED) ||  // narrow mathematical symbols
-      INRANGE(w, 0x2985, 0x2986)) {  // narrow white parentheses
-    return HALF_WIDTH;
-  }
-
-  // Other characters marked as 'Na' in
-  // http://www.unicode.org/Public/UNIDATA/EastAsianWidth.txt
-  if (INRANGE(w, 0x00A2, 0x00AF)) {
-    switch (w) {
-      case 0x00A2:  // CENT SIGN
-      case 0x00A3:  // POUND SIGN
-      case 0x00A5:  // YEN SIGN
-      case 0x00A6:  // BROKEN BAR
-      case 0x00AC:  // NOT SIGN
-      case 0x00AF:  // MACRON
-        return HALF_WIDTH;
+inline Util::ScriptType ToScriptType(uint8 property) {
+  return static_cast<Util::ScriptType>(
+      (property >> kScriptTypeShift) & kScriptTypeMask);
+}
+
+inline Util::FormType ToFormType(uint8 property) {
+  return static_cast<Util::FormType>(
+      (property >> kFormTypeShift) & kFormTypeMask);
+}
+
+inline Util::CharacterSet ToCharacterSet(uint8 property) {
+  return static_cast<Util::CharacterSet>(
+      (property >> kCharacterSetShift) & kCharacterSetMask);
+}
+
+// Decodes the first character of [*begin, end) into |w| and advances |*begin|.
+// Returns false at the end or at an invalid sequence like
+// ConstChar32Iterator.  ASCII and the three-byte sequences, which cover kana
+// and the kanji in BMP, are decoded inline.
+inline bool NextChar32(const char **begin, const char *end, char32 *w) {
+  const char *p = *begin;
+  if (p == end) {
+    return false;
+  }
+  const uint8 c0 = static_cast<uint8>(p[0]);
+  if (c0 < 0x80) {
+    *w = c0;
+    *begin = p + 1;
+    return true;
+  }
+  if ((c0 & 0xF0) == 0xE0 && end - p >= 3) {
+    const uint8 c1 = static_cast<uint8>(p[1]);
+    const uint8 c2 = static_cast<uint8>(p[2]);
+    if ((c1 & 0xC0) == 0x80 && (c2 & 0xC0) == 0x80) {
+      const char32 result =
+          ((c0 & 0x0F) << 12) | ((c1 & 0x3F) << 6) | (c2 & 0x3F);
+      if (result < 0x0800) {
+        // Redundant UTF-8 sequence.
+        return false;
+      }
+      *w = result;
+      *begin = p + 3;
+      return true;
     }
   }
+  const StringPiece s(p, end - p);
+  StringPiece rest;
+  if (!Util::SplitFirstChar32(s, w, &rest)) {
+    return false;
+  }
+  *begin = p + (s.size() - rest.size());
+  return true;
+}
 
-  // Characters marked as 'H' in
-  // http://www.unicode.org/Public/UNIDATA/EastAsianWidth.txt
-  if (w == 0x20A9 ||                 // WON SIGN
-      INRANGE(w, 0xFF61, 0xFF9F) ||  // half-width katakana
-      INRANGE(w, 0xFFA0, 0xFFBE) ||  // half-width hangul
-      INRANGE(w, 0xFFC2, 0xFFCF) ||  // half-width hangul
-      INRANGE(w, 0xFFD2, 0xFFD7) ||  // half-width hangul
-      INRANGE(w, 0xFFDA, 0xFFDC) ||  // half-width hangul
-      INRANGE(w, 0xFFE8, 0xFFEE)) {  // half-width symbols
-    return HALF_WIDTH;
+// Returns the end of the run of hiragana U+3041..U+309F from |begin|.  They
+// are encoded as E3 81 81..E3 81 BF and E3 82 80..E3 82 9F.
+inline const char *SkipHiragana(const char *begin, const char *end) {
+  while (end - begin >= 3 && static_cast<uint8>(begin[0]) == 0xE3) {
+    const uint8 c1 = static_cast<uint8>(begin[1]);
+    const uint8 c2 = static_cast<uint8>(begin[2]);
+    if (!((c1 == 0x81 && c2 >= 0x81 && c2 <= 0xBF) ||
+          (c1 == 0x82 && c2 >= 0x80 && c2 <= 0x9F))) {
+      break;
+    }
+    begin += 3;
   }
+  return begin;
+}
+
+}  // namespace
+
+Util::ScriptType Util::GetScriptType(char32 w) {
+  return ToScriptType(GetCharProperty(w));
+}
 
-  return FULL_WIDTH;
+Util::FormType Util::GetFormType(char32 w) {
+  return ToFormType(GetCharProperty(w));
 }
 
-#undef INRANGE
+Util::CharacterSet Util::GetCharacterSet(char32 ucs4) {
+  return ToCharacterSet(GetCharProperty(ucs4));
+}
 
 // return script type of first character in str
 Util::ScriptType Util::GetScriptType(const char *begin,
@@ -1643,9 +1667,18 @@ namespace {
 Util::ScriptType GetScriptTypeInternal(StringPiece str, bool ignore_symbols) {
   Util::ScriptType result = Util::SCRIPT_TYPE_SIZE;
 
-  for (ConstChar32Iterator iter(str); !iter.Done(); iter.Next()) {
-    const char32 w = iter.Get();
-    Util::ScriptType type = Util::GetScriptType(w);
+  const char *begin = str.data();
+  const char *const end = begin + str.size();
+  char32 w = 0;
+  while (true) {
+    if (result == Util::HIRAGANA) {
+      // The rest of the hiragana keeps the result.
+      begin = SkipHiragana(begin, end);
+    }
+    if (!NextChar32(&begin, end, &w)) {
+      break;
+    }
+    Util::ScriptType type = ToScriptType(GetCharProperty(w));
     if ((w == 0x30FC || w == 0x30FB || (w >= 0x3099 && w <= 0x309C)) &&
         // PROLONGEDSOUND MARK|MIDLE_DOT|VOICED_SOUND_MARKS
         // are HIRAGANA as well
@@ -1703,10 +1736,19 @@ Util::ScriptType Util::GetScriptTypeWithoutSymbols(const string &str) {
 
 // return true if all script_type in str is "type"
 bool Util::IsScriptType(StringPiece str, Util::ScriptType type) {
-  for (ConstChar32Iterator iter(str); !iter.Done(); iter.Next()) {
-    const char32 w = iter.Get();
+  const char *begin = str.data();
+  const char *const end = begin + str.size();
+  char32 w = 0;
+  while (true) {
+    if (type == HIRAGANA) {
+      begin = SkipHiragana(begin, end);
+    }
+    if (!NextChar32(&begin, end, &w)) {
+      break;
+    }
     // Exception: 30FC (PROLONGEDSOUND MARK is categorized as HIRAGANA as well)
-    if (type != GetScriptType(w) && (w != 0x30FC || type != HIRAGANA)) {
+    if (type != ToScriptType(GetCharProperty(w)) &&
+        (w != 0x30FC || type != HIRAGANA)) {
       return false;
     }
   }
@@ -1715,8 +1757,11 @@ bool Util::IsScriptType(StringPiece str, Util::ScriptType type) {
 
 // return true if the string contains script_type char
 bool Util::ContainsScriptType(StringPiece str, ScriptType type) {
-  for (ConstChar32Iterator iter(str); !iter.Done(); iter.Next()) {
-    if (type == GetScriptType(iter.Get())) {
+  const char *begin = str.data();
+  const char *const end = begin + str.size();
+  char32 w = 0;
+  while (NextChar32(&begin, end, &w)) {
+    if (type == ToScriptType(GetCharProperty(w))) {
       return true;
     }
   }
@@ -1728,8 +1773,11 @@ Util::FormType Util::GetFormType(const string &str) {
   // TODO(hidehiko): get rid of using FORM_TYPE_SIZE.
   FormType result = FORM_TYPE_SIZE;
 
-  for (ConstChar32Iterator iter(str); !iter.Done(); iter.Next()) {
-    const FormType type = GetFormType(iter.Get());
+  const char *begin = str.data();
+  const char *const end = begin + str.size();
+  char32 w = 0;
+  while (NextChar32(&begin, end, &w)) {
+    const FormType type = ToFormType(GetCharProperty(w));
     if (type == UNKNOWN_FORM ||
         (result != FORM_TYPE_SIZE && type != result)) {
       return UNKNOWN_FORM;
@@ -1740,13 +1788,14 @@ Util::FormType Util::GetFormType(const string &str) {
   return result;
 }
 
-// Util::CharcterSet Util::GetCharacterSet(char32 ucs4);
-#include "base/character_set.inc"
-
 Util::CharacterSet Util::GetCharacterSet(StringPiece str) {
+  const char *begin =
+      SimdUtil::SkipAscii(str.data(), str.data() + str.size());
+  const char *const end = str.data() + str.size();
   CharacterSet result = ASCII;
-  for (ConstChar32Iterator iter(str); !iter.Done(); iter.Next()) {
-    result = std::max(result, GetCharacterSet(iter.Get()));
+  char32 w = 0;
+  while (NextChar32(&begin, end, &w)) {
+    result = std::max(result, ToCharacterSet(GetCharProperty(w)));
   }
   return result;
 }
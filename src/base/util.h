@@ -333,7 +333,7 @@ class Util {
   static bool IsKanaSymbolContained(const string &input);
 
   // Returns true if |input| looks like a pure English word.
-  static bool IsEnglishTransliteration(const string &input);
+  static bool IsEnglishTransliteration(StringPiece input);
 
   static void NormalizeVoicedSoundMark(StringPiece input, string *output);
 
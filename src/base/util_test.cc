@@ -1483,6 +1483,25 @@ TEST(UtilTest, ScriptType) {
   EXPECT_EQ(Util::EMOJI, Util::GetScriptType("\xf3\xbe\x80\x83"));
 }
 
+TEST(UtilTest, ScriptTypeOfLongStrings) {
+  // Runs of hiragana and ASCII are skipped without decoding.
+  EXPECT_TRUE(Util::IsScriptType("あいうえおかきくけこゔゟー", Util::HIRAGANA));
+  EXPECT_FALSE(Util::IsScriptType("あいうえおかきくけこゔゟア", Util::HIRAGANA));
+  EXPECT_EQ(Util::HIRAGANA, Util::GetScriptType("あいうえおかきくけこ゛ー"));
+  EXPECT_EQ(Util::UNKNOWN_SCRIPT,
+            Util::GetScriptType("あいうえおかきくけこ漢"));
+  EXPECT_EQ(Util::ASCII, Util::GetCharacterSet("abcdefghijklmnopqrstuvwxyz"));
+  EXPECT_EQ(Util::JISX0208,
+            Util::GetCharacterSet("abcdefghijklmnopqrstuvwxyzあ"));
+  EXPECT_EQ(Util::JISX0213,
+            Util::GetCharacterSet("abcdefghijklmnop①qrstuvwxyz"));
+
+  // Invalid sequences end the strings.
+  EXPECT_TRUE(Util::IsScriptType("あいう\xE3\x81", Util::HIRAGANA));
+  EXPECT_EQ(Util::HIRAGANA, Util::GetScriptType("あいう\xE0\x80\x80漢"));
+  EXPECT_EQ(Util::ASCII, Util::GetCharacterSet("abcdefgh\xFF①"));
+}
+
 TEST(UtilTest, ScriptTypeWithoutSymbols) {
   EXPECT_EQ(Util::HIRAGANA, Util::GetScriptTypeWithoutSymbols("くど う"));
   EXPECT_EQ(Util::KANJI, Util::GetScriptTypeWithoutSymbols("京 都"));
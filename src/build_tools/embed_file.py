@@ -61,7 +61,7 @@ def main():
           '#error "%(name)s was already included or defined elsewhere"\n'
           '#else\n'
           '#define MOZC_EMBEDDED_FILE_%(name)s\n'
-          'const uint64 %(name)s_data[] = {\n'
+          'alignas(64) const uint64 %(name)s_data[] = {\n'
           % {'name': opts.name})
 
       while True:
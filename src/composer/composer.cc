@@ -231,7 +231,8 @@ void Composer::ResetInputMode() {
 }
 
 void Composer::ReloadConfig() {
-  // Do nothing at this moment.
+  // The preedit form of the characters may be changed.
+  composition_->ClearCache();
 }
 
 bool Composer::Empty() const {
@@ -251,6 +252,7 @@ void Composer::SetRequest(const commands::Request *request) {
 void Composer::SetConfig(const config::Config *config) {
   config_ = config;
   typing_corrector_.SetConfig(config);
+  composition_->ClearCache();
 }
 
 void Composer::SetInputMode(transliteration::TransliterationType mode) {
@@ -62,6 +62,20 @@
         '../transliteration/transliteration.gyp:transliteration',
       ],
     },
+    {
+      'target_name': 'composer_benchmark_main',
+      'type': 'executable',
+      'sources': [
+        'composer_benchmark_main.cc',
+      ],
+      'dependencies': [
+        '../base/base.gyp:base',
+        '../protocol/protocol.gyp:commands_proto',
+        '../protocol/protocol.gyp:config_proto',
+        '../transliteration/transliteration.gyp:transliteration',
+        'composer',
+      ],
+    },
     {
       'target_name': 'key_event_util',
       'type': 'static_library',
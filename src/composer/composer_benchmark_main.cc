@@ -0,0 +1,160 @@
+// Copyright 2010-2018, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+// Benchmark for the queries to Composer on each keystroke.
+//
+// Types each sentence in romaji through Composer and, after every key, asks
+// for the strings the session layer asks for: the preedit, the queries for
+// conversion and prediction, and the transliterations.  Reports the time and
+// the number of heap allocations per key.  The session layer may ask for the
+// same strings more than once for a key, which --queries_per_key simulates.
+//
+// Usage:
+//   composer_benchmark_main --iterations=1000 --queries_per_key=2
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <set>
+#include <string>
+
+#include "base/flags.h"
+#include "base/init_mozc.h"
+#include "base/logging.h"
+#include "base/port.h"
+#include "base/stopwatch.h"
+#include "composer/composer.h"
+#include "composer/table.h"
+#include "protocol/commands.pb.h"
+#include "protocol/config.pb.h"
+#include "transliteration/transliteration.h"
+
+DEFINE_string(table, "system://romanji-hiragana.tsv",
+              "preedit conversion table file.");
+DEFINE_int32(iterations, 1000, "number of passes over the sentences");
+DEFINE_int32(queries_per_key, 1,
+             "number of times the strings are asked for after each key");
+
+namespace {
+
+std::atomic<int64> g_num_allocations(0);
+
+}  // namespace
+
+// Counts all the heap allocations of the process.
+void *operator new(size_t size) {
+  g_num_allocations.fetch_add(1, std::memory_order_relaxed);
+  void *ptr = std::malloc(size == 0 ? 1 : size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void operator delete(void *ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t size) noexcept {
+  std::free(ptr);
+}
+
+namespace mozc {
+namespace composer {
+namespace {
+
+const char *kSentences[] = {
+  "watashinonamaehanakanodesukyouhaiitenkidesuneashitahaamegafurusoudesu",
+  "kaigihagogosanjikaradesukonoshiryouwoyondekudasaiyoroshikuonegaishimasu",
+  "shinkansennnikonnndenakattanodehikoukidekimashitakaerihadenshadesu",
+  "toukyoutokkyokyokakyokuchoutokyokatokkyokyokakyokuchouhayakuchikotoba",
+};
+
+// Asks |composer| for the strings the session layer asks for on a keystroke.
+void QueryComposer(const Composer &composer) {
+  string left, focused, right;
+  composer.GetPreedit(&left, &focused, &right);
+  string preedit;
+  composer.GetStringForPreedit(&preedit);
+  string conversion_query;
+  composer.GetQueryForConversion(&conversion_query);
+  string prediction_query;
+  composer.GetQueryForPrediction(&prediction_query);
+  string base;
+  std::set<string> expanded;
+  composer.GetQueriesForPrediction(&base, &expanded);
+  transliteration::Transliterations t13ns;
+  composer.GetTransliterations(&t13ns);
+}
+
+void Run() {
+  Table table;
+  CHECK(table.LoadFromFile(FLAGS_table.c_str())) << FLAGS_table;
+  Composer composer(&table, &commands::Request::default_instance(),
+                    &config::Config::default_instance());
+
+  int64 num_keys = 0;
+  const int64 num_allocations_begin = g_num_allocations.load();
+  Stopwatch stopwatch = Stopwatch::StartNew();
+  for (int i = 0; i < FLAGS_iterations; ++i) {
+    for (size_t j = 0; j < arraysize(kSentences); ++j) {
+      const string sentence = kSentences[j];
+      for (size_t k = 0; k < sentence.size(); ++k) {
+        composer.InsertCharacter(sentence.substr(k, 1));
+        for (int l = 0; l < FLAGS_queries_per_key; ++l) {
+          QueryComposer(composer);
+        }
+        ++num_keys;
+      }
+      composer.Reset();
+    }
+  }
+  stopwatch.Stop();
+  const int64 num_allocations =
+      g_num_allocations.load() - num_allocations_begin;
+
+  std::cout << "keys: " << num_keys << std::endl
+            << "time per key: "
+            << stopwatch.GetElapsedNanoseconds() / 1000.0 / num_keys << " us"
+            << std::endl
+            << "allocations per key: "
+            << static_cast<double>(num_allocations) / num_keys << std::endl;
+}
+
+}  // namespace
+}  // namespace composer
+}  // namespace mozc
+
+int main(int argc, char **argv) {
+  mozc::InitMozc(argv[0], &argc, &argv, false);
+  mozc::composer::Run();
+  return 0;
+}
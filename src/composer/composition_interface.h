@@ -128,6 +128,11 @@ class CompositionInterface {
   // Set composition table.
   // This class does NOT take the ownership of the table;
   virtual void SetTable(const Table *table) = 0;
+
+  // Drop the strings cached for the composition.  This should be called
+  // when the transliterated strings may change without any edit, for
+  // example by an update of the config.
+  virtual void ClearCache() = 0;
 };
 
 }  // namespace composer
@@ -46,6 +46,9 @@ namespace {
 // Max recursion count for looking up pending loop.
 const int kMaxRecursion = 4;
 
+// Initial capacity of the cached results of a chunk.
+const size_t kNumUsualCachedResults = 4;
+
 // Delete "end" from "target", if "target" ends with the "end".
 bool DeleteEnd(const string &end, string *target) {
   const string::size_type rindex = target->rfind(end);
@@ -112,11 +115,13 @@ CharChunk::CharChunk(Transliterators::Transliterator transliterator,
                      const Table *table)
     : transliterator_(transliterator),
       table_(table),
-      attributes_(NO_TABLE_ATTRIBUTE) {
+      attributes_(NO_TABLE_ATTRIBUTE),
+      has_expanded_results_(false) {
   DCHECK_NE(Transliterators::LOCAL, transliterator);
 }
 
 void CharChunk::Clear() {
+  ClearCache();
   raw_.clear();
   conversion_.clear();
   pending_.clear();
@@ -124,59 +129,92 @@ void CharChunk::Clear() {
 }
 
 size_t CharChunk::GetLength(Transliterators::Transliterator t12r) const {
-  const string t13n = Transliterate(
-      t12r,
-      Table::DeleteSpecialKey(raw_),
-      Table::DeleteSpecialKey(conversion_ + pending_));
-  return Util::CharsLen(t13n);
+  return GetCachedResult(RESULT, t12r).length;
 }
 
 void CharChunk::AppendResult(Transliterators::Transliterator t12r,
                              string *result) const {
-  const string t13n = Transliterate(
-      t12r,
-      Table::DeleteSpecialKey(raw_),
-      Table::DeleteSpecialKey(conversion_ + pending_));
-  result->append(t13n);
+  result->append(GetCachedResult(RESULT, t12r).result);
 }
 
 void CharChunk::AppendTrimedResult(Transliterators::Transliterator t12r,
                                    string *result) const {
-  // Only determined value (e.g. |conversion_| only) is added.
-  string converted = conversion_;
-  if (!pending_.empty()) {
-    size_t key_length = 0;
-    bool fixed = false;
-    const Entry *entry = table_->LookUpPrefix(pending_, &key_length, &fixed);
-    if (entry != NULL && entry->input() == entry->result()) {
-      converted.append(entry->result());
-    }
-  }
-  result->append(Transliterate(
-      t12r,
-      Table::DeleteSpecialKey(raw_),
-      Table::DeleteSpecialKey(converted)));
+  result->append(GetCachedResult(TRIMED_RESULT, t12r).result);
 }
 
 void CharChunk::AppendFixedResult(Transliterators::Transliterator t12r,
                                   string *result) const {
+  result->append(GetCachedResult(FIXED_RESULT, t12r).result);
+}
+
+const CharChunk::CachedResult &CharChunk::GetCachedResult(
+    ResultType type, Transliterators::Transliterator t12r) const {
+  for (size_t i = 0; i < cached_results_.size(); ++i) {
+    if (cached_results_[i].type == type &&
+        cached_results_[i].transliterator == t12r) {
+      return cached_results_[i];
+    }
+  }
+  if (cached_results_.capacity() == 0) {
+    // Most chunks are asked for a few kinds of results, mainly with the local
+    // transliterator.
+    cached_results_.reserve(kNumUsualCachedResults);
+  }
+  cached_results_.push_back(CachedResult());
+  CachedResult *cached = &cached_results_.back();
+  cached->type = type;
+  cached->transliterator = t12r;
+  cached->result = ComputeResult(type, t12r);
+  cached->length = Util::CharsLen(cached->result);
+  return *cached;
+}
+
+string CharChunk::ComputeResult(ResultType type,
+                                Transliterators::Transliterator t12r) const {
   string converted = conversion_;
-  if (!ambiguous_.empty()) {
-    // Add the |ambiguous_| value as a fixed value.  |ambiguous_|
-    // contains an undetermined result string like "ん" converted
-    // from a single 'n'.
-    converted.append(ambiguous_);
-  } else {
-    // If |pending_| exists but |ambiguous_| does not exist,
-    // |pending_| is appended.  If |ambiguous_| exists, the value of
-    // |pending_| is usually equal to |ambiguous_| so it is not
-    // appended.
-    converted.append(pending_);
+  switch (type) {
+    case RESULT:
+      converted.append(pending_);
+      break;
+    case TRIMED_RESULT:
+      // Only determined value (e.g. |conversion_| only) is added.
+      if (!pending_.empty()) {
+        size_t key_length = 0;
+        bool fixed = false;
+        const Entry *entry =
+            table_->LookUpPrefix(pending_, &key_length, &fixed);
+        if (entry != NULL && entry->input() == entry->result()) {
+          converted.append(entry->result());
+        }
+      }
+      break;
+    case FIXED_RESULT:
+      if (!ambiguous_.empty()) {
+        // Add the |ambiguous_| value as a fixed value.  |ambiguous_|
+        // contains an undetermined result string like "ん" converted
+        // from a single 'n'.
+        converted.append(ambiguous_);
+      } else {
+        // If |pending_| exists but |ambiguous_| does not exist,
+        // |pending_| is appended.  If |ambiguous_| exists, the value of
+        // |pending_| is usually equal to |ambiguous_| so it is not
+        // appended.
+        converted.append(pending_);
+      }
+      break;
+    default:
+      LOG(DFATAL) << "Unexpected result type: " << type;
+      break;
   }
-  result->append(Transliterate(
-      t12r,
-      Table::DeleteSpecialKey(raw_),
-      Table::DeleteSpecialKey(converted)));
+  return Transliterate(t12r,
+                       Table::DeleteSpecialKey(raw_),
+                       Table::DeleteSpecialKey(converted));
+}
+
+void CharChunk::ClearCache() {
+  cached_results_.clear();
+  has_expanded_results_ = false;
+  expanded_results_.clear();
 }
 
 // If we have the rule (roman),
@@ -224,6 +262,15 @@ void CharChunk::GetExpandedResults(std::set<string> *results) const {
   if (pending_.empty()) {
     return;
   }
+  if (!has_expanded_results_) {
+    DCHECK(expanded_results_.empty());
+    ComputeExpandedResults(&expanded_results_);
+    has_expanded_results_ = true;
+  }
+  results->insert(expanded_results_.begin(), expanded_results_.end());
+}
+
+void CharChunk::ComputeExpandedResults(std::set<string> *results) const {
   // Append current pending string
   if (conversion_.empty()) {
     results->insert(Table::DeleteSpecialKey(pending_));
@@ -277,6 +324,7 @@ bool CharChunk::IsConvertible(
 }
 
 void CharChunk::Combine(const CharChunk &left_chunk) {
+  ClearCache();
   conversion_ = left_chunk.conversion_ + conversion_;
   raw_ = left_chunk.raw_ + raw_;
   // TODO(komatsu): This is a hacky way.  We should look up the
@@ -294,6 +342,7 @@ void CharChunk::Combine(const CharChunk &left_chunk) {
 }
 
 bool CharChunk::AddInputInternal(string *input) {
+  ClearCache();
   const bool kNoLoop = false;
 
   size_t key_length = 0;
@@ -391,6 +440,7 @@ void CharChunk::AddInput(string *input) {
 }
 
 void CharChunk::AddConvertedChar(string *input) {
+  ClearCache();
   // TODO(komatsu) Nice to make "string Util::PopOneChar(string *str);".
   string first_char = Util::SubString(*input, 0, 1);
   conversion_.append(first_char);
@@ -400,6 +450,7 @@ void CharChunk::AddConvertedChar(string *input) {
 
 void CharChunk::AddInputAndConvertedChar(string *key,
                                          string *converted_char) {
+  ClearCache();
   // If this chunk is empty, the key and converted_char are simply
   // copied.
   if (raw_.empty() && pending_.empty() && conversion_.empty()) {
@@ -511,7 +562,10 @@ void CharChunk::SetTransliterator(
     // Just ignore.
     return;
   }
-  transliterator_ = transliterator;
+  if (transliterator != transliterator_) {
+    ClearCache();
+    transliterator_ = transliterator;
+  }
 }
 
 const string &CharChunk::raw() const {
@@ -519,6 +573,7 @@ const string &CharChunk::raw() const {
 }
 
 void CharChunk::set_raw(const string &raw) {
+  ClearCache();
   raw_ = raw;
 }
 
@@ -527,6 +582,7 @@ const string &CharChunk::conversion() const {
 }
 
 void CharChunk::set_conversion(const string &conversion) {
+  ClearCache();
   conversion_ = conversion;
 }
 
@@ -535,6 +591,7 @@ const string &CharChunk::pending() const {
 }
 
 void CharChunk::set_pending(const string &pending) {
+  ClearCache();
   pending_ = pending;
 }
 
@@ -543,6 +600,7 @@ const string &CharChunk::ambiguous() const {
 }
 
 void CharChunk::set_ambiguous(const string &ambiguous) {
+  ClearCache();
   ambiguous_ = ambiguous;
 }
 
@@ -553,6 +611,7 @@ bool CharChunk::SplitChunk(Transliterators::Transliterator t12r,
     LOG(WARNING) << "Invalid position: " << position;
     return false;
   }
+  ClearCache();
 
   string raw_lhs, raw_rhs, converted_lhs, converted_rhs;
   Transliterators::GetTransliterator(GetTransliterator(t12r))->Split(
@@ -619,6 +678,9 @@ CharChunk *CharChunk::Clone() const {
   new_char_chunk->pending_.assign(pending_);
   new_char_chunk->ambiguous_.assign(ambiguous_);
   new_char_chunk->attributes_ = attributes_;
+  new_char_chunk->cached_results_ = cached_results_;
+  new_char_chunk->has_expanded_results_ = has_expanded_results_;
+  new_char_chunk->expanded_results_ = expanded_results_;
   return new_char_chunk;
 }
 
@@ -32,6 +32,7 @@
 
 #include <set>
 #include <string>
+#include <vector>
 
 #include "base/port.h"
 #include "composer/internal/transliterators.h"
@@ -51,6 +52,10 @@ class Table;
 // size separated by the conversion table.  A sample units with normal
 // romaji-hiragana conversion table are {conversion: "か", pending: "", raw:
 // "ka"} and {conversion: "っ", pending: "t", raw: "tt"}.
+//
+// The transliterated results and the expanded results are computed on demand
+// and cached until the chunk is modified, so that querying the composition
+// repeatedly for the same state doesn't transliterate the chunks again.
 class CharChunk {
  public:
   // LOCAL transliterator is not accepted.
@@ -156,6 +161,10 @@ class CharChunk {
 
   CharChunk *Clone() const;
 
+  // Drops the cached results.  This is called before any field used by the
+  // results is modified.
+  void ClearCache();
+
   // Test only
   bool AddInputInternal(string *input);
 
@@ -163,6 +172,27 @@ class CharChunk {
   FRIEND_TEST(CharChunkTest, Clone);
   FRIEND_TEST(CharChunkTest, GetTransliterator);
 
+  enum ResultType {
+    RESULT,
+    TRIMED_RESULT,
+    FIXED_RESULT,
+  };
+
+  struct CachedResult {
+    ResultType type;
+    Transliterators::Transliterator transliterator;
+    string result;
+    size_t length;
+  };
+
+  // Returns the cached result of |type| with |t12r|, computing it if it is
+  // not cached yet.
+  const CachedResult &GetCachedResult(
+      ResultType type, Transliterators::Transliterator t12r) const;
+  string ComputeResult(ResultType type,
+                       Transliterators::Transliterator t12r) const;
+  void ComputeExpandedResults(std::set<string> *results) const;
+
   Transliterators::Transliterator transliterator_;
   const Table *table_;
 
@@ -171,6 +201,12 @@ class CharChunk {
   string pending_;
   string ambiguous_;
   TableAttributes attributes_;
+
+  // A chunk usually has only a few entries here: the local transliterator
+  // and the ones requested for the transliterations of the composition.
+  mutable std::vector<CachedResult> cached_results_;
+  mutable bool has_expanded_results_;
+  mutable std::set<string> expanded_results_;
 };
 
 }  // namespace composer
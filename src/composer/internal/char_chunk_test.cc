@@ -218,6 +218,70 @@ TEST(CharChunkTest, GetLength) {
   EXPECT_EQ(2, chunk3.GetLength(Transliterators::HALF_ASCII));
 }
 
+TEST(CharChunkTest, CachedResultsAreUpdated) {
+  Table table;
+  table.AddRule("ka", "か", "");
+  table.AddRule("ki", "き", "");
+  table.AddRule("kk", "っ", "k");
+  table.AddRule("n", "ん", "");
+  table.AddRule("na", "な", "");
+
+  CharChunk chunk(Transliterators::CONVERSION_STRING, &table);
+  string input = "k";
+  chunk.AddInput(&input);
+
+  string result;
+  chunk.AppendResult(Transliterators::LOCAL, &result);
+  EXPECT_EQ("k", result);
+  std::set<string> expanded;
+  chunk.GetExpandedResults(&expanded);
+  EXPECT_EQ(4, expanded.size());
+
+  // The results are recomputed after the chunk is modified.
+  input = "k";
+  chunk.AddInput(&input);
+  result.clear();
+  chunk.AppendResult(Transliterators::LOCAL, &result);
+  EXPECT_EQ("っk", result);
+  result.clear();
+  chunk.AppendFixedResult(Transliterators::LOCAL, &result);
+  EXPECT_EQ("っk", result);
+  result.clear();
+  chunk.AppendTrimedResult(Transliterators::LOCAL, &result);
+  EXPECT_EQ("っ", result);
+
+  input = "a";
+  chunk.AddInput(&input);
+  result.clear();
+  chunk.AppendResult(Transliterators::LOCAL, &result);
+  EXPECT_EQ("っか", result);
+  EXPECT_EQ(2, chunk.GetLength(Transliterators::LOCAL));
+  expanded.clear();
+  chunk.GetExpandedResults(&expanded);
+  EXPECT_TRUE(expanded.empty());
+
+  chunk.SetTransliterator(Transliterators::HALF_ASCII);
+  result.clear();
+  chunk.AppendResult(Transliterators::LOCAL, &result);
+  EXPECT_EQ("kka", result);
+  EXPECT_EQ(3, chunk.GetLength(Transliterators::LOCAL));
+
+  // A clone has the same results, and modifying it doesn't affect the
+  // original chunk.
+  std::unique_ptr<CharChunk> clone(chunk.Clone());
+  result.clear();
+  clone->AppendResult(Transliterators::LOCAL, &result);
+  EXPECT_EQ("kka", result);
+  clone->SetTransliterator(Transliterators::CONVERSION_STRING);
+  clone->set_conversion("き");
+  result.clear();
+  clone->AppendResult(Transliterators::LOCAL, &result);
+  EXPECT_EQ("き", result);
+  result.clear();
+  chunk.AppendResult(Transliterators::LOCAL, &result);
+  EXPECT_EQ("kka", result);
+}
+
 TEST(CharChunkTest, AddInputAndConvertedChar) {
   Table table;
   table.AddRule("す゛", "ず", "");
@@ -478,5 +478,12 @@ void Composition::SetTable(const Table *table) {
   table_ = table;
 }
 
+void Composition::ClearCache() {
+  for (CharChunkList::iterator it = chunks_.begin();
+       it != chunks_.end(); ++it) {
+    (*it)->ClearCache();
+  }
+}
+
 }  // namespace composer
 }  // namespace mozc
@@ -109,6 +109,8 @@ class Composition : public CompositionInterface {
 
   virtual void SetTable(const Table *table);
 
+  virtual void ClearCache();
+
   // Following methods are declared as public for unit test.
   void GetChunkAt(size_t position,
                   Transliterators::Transliterator transliterator,
@@ -37,6 +37,7 @@
 
 #include "base/config_file_stream.h"
 #include "base/logging.h"
+#include "base/mutex.h"
 #include "base/port.h"
 #include "base/singleton.h"
 #include "base/util.h"
@@ -560,11 +561,17 @@ class CharacterFormManager::Data {
   CharacterFormManagerImpl *GetConversionManager() {
     return conversion_.get();
   }
+  // The rules and the storage are shared by all the sessions, which may be
+  // evaluated in parallel.
+  Mutex *mutex() {
+    return &mutex_;
+  }
 
  private:
   std::unique_ptr<PreeditCharacterFormManagerImpl> preedit_;
   std::unique_ptr<ConversionCharacterFormManagerImpl> conversion_;
   std::unique_ptr<LRUStorage> storage_;
+  Mutex mutex_;
 };
 
 CharacterFormManager::Data::Data() {
@@ -596,6 +603,7 @@ CharacterFormManager::~CharacterFormManager() {
 }
 
 void CharacterFormManager::ReloadConfig(const Config &config) {
+  scoped_lock l(data_->mutex());
   Clear();
   if (config.character_form_rules_size() > 0) {
     for (size_t i = 0; i < config.character_form_rules_size(); ++i) {
@@ -627,16 +635,19 @@ void CharacterFormManager::ConvertWidth(
 
 void CharacterFormManager::ConvertPreeditString(const string &input,
                                                 string *output) const {
+  scoped_lock l(data_->mutex());
   data_->GetPreeditManager()->ConvertString(input, output);
 }
 
 void CharacterFormManager::ConvertConversionString(const string &input,
                                                    string *output) const {
+  scoped_lock l(data_->mutex());
   data_->GetConversionManager()->ConvertString(input, output);
 }
 
 bool CharacterFormManager::ConvertPreeditStringWithAlternative(
     const string &input, string *output, string *alternative_output) const {
+  scoped_lock l(data_->mutex());
   return data_->GetPreeditManager()->ConvertStringWithAlternative(
       input,
       output, alternative_output);
@@ -644,6 +655,7 @@ bool CharacterFormManager::ConvertPreeditStringWithAlternative(
 
 bool CharacterFormManager::ConvertConversionStringWithAlternative(
     const string &input, string *output, string *alternative_output) const {
+  scoped_lock l(data_->mutex());
   return data_->GetConversionManager()->ConvertStringWithAlternative(
       input,
       output, alternative_output);
@@ -651,15 +663,18 @@ bool CharacterFormManager::ConvertConversionStringWithAlternative(
 
 Config::CharacterForm CharacterFormManager::GetPreeditCharacterForm(
     const string &input) const {
+  scoped_lock l(data_->mutex());
   return data_->GetPreeditManager()->GetCharacterForm(input);
 }
 
 Config::CharacterForm CharacterFormManager::GetConversionCharacterForm(
     const string &input) const {
+  scoped_lock l(data_->mutex());
   return data_->GetConversionManager()->GetCharacterForm(input);
 }
 
 void CharacterFormManager::ClearHistory() {
+  scoped_lock l(data_->mutex());
   // no need to call, as storage is shared
   // GetPreeditManager()->ClearHistory();
   VLOG(1) << "CharacterFormManager::ClearHistory() is called";
@@ -667,6 +682,7 @@ void CharacterFormManager::ClearHistory() {
 }
 
 void CharacterFormManager::Clear() {
+  scoped_lock l(data_->mutex());
   VLOG(1) << "CharacterFormManager::Clear() is called";
   data_->GetConversionManager()->Clear();
   data_->GetPreeditManager()->Clear();
@@ -674,12 +690,14 @@ void CharacterFormManager::Clear() {
 
 void CharacterFormManager::SetCharacterForm(
     const string &input, Config::CharacterForm form) {
+  scoped_lock l(data_->mutex());
   // no need to call Preedit, as storage is shared
   // GetPreeditManager()->SetCharacterForm(input, form);
   data_->GetConversionManager()->SetCharacterForm(input, form);
 }
 
 void CharacterFormManager::GuessAndSetCharacterForm(const string &input) {
+  scoped_lock l(data_->mutex());
   // no need to call Preedit, as storage is shared
   // GetPreeditManager()->SetCharacterForm(input, form);
   data_->GetConversionManager()->GuessAndSetCharacterForm(input);
@@ -687,15 +705,18 @@ void CharacterFormManager::GuessAndSetCharacterForm(const string &input) {
 
 void CharacterFormManager::AddPreeditRule(
     const string &input, Config::CharacterForm form) {
+  scoped_lock l(data_->mutex());
   data_->GetPreeditManager()->AddRule(input, form);
 }
 
 void CharacterFormManager::AddConversionRule(
     const string &input, Config::CharacterForm form) {
+  scoped_lock l(data_->mutex());
   data_->GetConversionManager()->AddRule(input, form);
 }
 
 void CharacterFormManager::SetDefaultRule() {
+  scoped_lock l(data_->mutex());
   data_->GetPreeditManager()->SetDefaultRule();
   data_->GetConversionManager()->SetDefaultRule();
 }
@@ -37,6 +37,7 @@
 #include <string>
 #include <vector>
 
+#include "base/hash.h"
 #include "base/logging.h"
 #include "base/port.h"
 #include "base/util.h"
@@ -82,6 +83,9 @@ const int   kStructureCostOffset     = 3453;
 const int   kMinStructureCostOffset  = 1151;
 const int32 kStopEnmerationCacheSize = 15;
 
+// The seed of the fingerprints of the values in |seen_|.
+const uint32 kValueFingerprintSeed = 0x636e6466;  // "cndf"
+
 // Returns true if the given node sequence is noisy weak compound.
 // Please refer to the comment in FilterCandidateInternal for the idea.
 inline bool IsNoisyWeakCompound(const std::vector<const Node *> &nodes,
@@ -161,6 +165,79 @@ bool IsNormalOrConstrainedNode(const Node *node) {
       (node->node_type == Node::NOR_NODE || node->node_type == Node::CON_NODE);
 }
 
+// Returns true if "短縮よみ" or "記号,一般" is used with other words.
+bool HasMisplacedIsolatedWordOrGeneralSymbol(
+    const dictionary::POSMatcher &pos_matcher,
+    const std::vector<const Node *> &nodes) {
+  // "短縮よみ" or "記号,一般" must have only 1 node.  Note that "顔文字" POS
+  // from user dictionary is converted to "記号,一般" in Mozc engine.
+  if (nodes.size() > 1 &&
+      ContainsIsolatedWordOrGeneralSymbol(pos_matcher, nodes)) {
+    return true;
+  }
+  // This case tests the case where the isolated word or general symbol is in
+  // content word.
+  return IsIsolatedWordOrGeneralSymbol(pos_matcher, nodes[0]->lid) &&
+         (IsNormalOrConstrainedNode(nodes[0]->prev) ||
+          IsNormalOrConstrainedNode(nodes[0]->next));
+}
+
+// Suppress "書います", "書いすぎ", "買いて"
+// Basic idea:
+//  - WagyoRenyoConnectionVerb(= "動詞,*,*,*,五段・ワ行促音便,連用形",
+// "買い", "言い", "使い", etc) should not connect to TeSuffix(= "て",
+// "てる", "ちゃう", "とく", etc).
+//  - KagyoTaConnectionVerb(= 動詞,*,*,*,五段・カ行(促|イ)音便,連用タ接続",
+// "書い", "歩い", "言っ", etc) should not connect to verb suffix other
+// than TeSuffix
+bool HasBadVerbConnection(const dictionary::POSMatcher &pos_matcher,
+                          const std::vector<const Node *> &nodes) {
+  if (Util::GetScriptType(nodes[0]->value) == Util::HIRAGANA) {
+    return false;
+  }
+  if (nodes.size() >= 2) {
+    // For node sequence
+    if (pos_matcher.IsKagyoTaConnectionVerb(nodes[0]->rid) &&
+        pos_matcher.IsVerbSuffix(nodes[1]->lid) &&
+        !pos_matcher.IsTeSuffix(nodes[1]->lid)) {
+      // "書い" | "ます", "過ぎ", etc
+      return true;
+    }
+    if (pos_matcher.IsWagyoRenyoConnectionVerb(nodes[0]->rid) &&
+        pos_matcher.IsTeSuffix(nodes[1]->lid)) {
+      // "買い" | "て"
+      return true;
+    }
+  }
+  if (nodes[0]->lid != nodes[0]->rid) {
+    // For compound
+    if (pos_matcher.IsKagyoTaConnectionVerb(nodes[0]->lid) &&
+        pos_matcher.IsVerbSuffix(nodes[0]->rid) &&
+        !pos_matcher.IsTeSuffix(nodes[0]->rid)) {
+      // "書い" | "ます", "過ぎ", etc
+      return true;
+    }
+    if (pos_matcher.IsWagyoRenyoConnectionVerb(nodes[0]->lid) &&
+        pos_matcher.IsTeSuffix(nodes[0]->rid)) {
+      // "買い" | "て"
+      return true;
+    }
+  }
+  return false;
+}
+
+// Returns true if the candidate made from |nodes| gets CONTEXT_SENSITIVE
+// attribute in NBestGenerator.
+bool HasConstrainedNode(const std::vector<const Node *> &nodes) {
+  for (const Node *node : nodes) {
+    if (node->constrained_prev != nullptr ||
+        (node->next != nullptr && node->next->constrained_prev == node)) {
+      return true;
+    }
+  }
+  return false;
+}
+
 }  // namespace
 
 CandidateFilter::CandidateFilter(
@@ -255,17 +332,7 @@ CandidateFilter::ResultType CandidateFilter::FilterCandidateInternal(
 
   CHECK(top_candidate_);
 
-  // "短縮よみ" or "記号,一般" must have only 1 node.  Note that "顔文字" POS
-  // from user dictionary is converted to "記号,一般" in Mozc engine.
-  if (nodes.size() > 1 &&
-      ContainsIsolatedWordOrGeneralSymbol(*pos_matcher_, nodes)) {
-    return CandidateFilter::BAD_CANDIDATE;
-  }
-  // This case tests the case where the isolated word or general symbol is in
-  // content word.
-  if (IsIsolatedWordOrGeneralSymbol(*pos_matcher_, nodes[0]->lid) &&
-      (IsNormalOrConstrainedNode(nodes[0]->prev) ||
-       IsNormalOrConstrainedNode(nodes[0]->next))) {
+  if (HasMisplacedIsolatedWordOrGeneralSymbol(*pos_matcher_, nodes)) {
     return CandidateFilter::BAD_CANDIDATE;
   }
 
@@ -290,49 +357,14 @@ CandidateFilter::ResultType CandidateFilter::FilterCandidateInternal(
   }
 
   // The candidate is already seen.
-  if (seen_.find(candidate->value) != seen_.end()) {
+  if (seen_.find(GetValueFingerprint(candidate->value)) != seen_.end()) {
     return CandidateFilter::BAD_CANDIDATE;
   }
 
   CHECK(!nodes.empty());
 
-  // Suppress "書います", "書いすぎ", "買いて"
-  // Basic idea:
-  //  - WagyoRenyoConnectionVerb(= "動詞,*,*,*,五段・ワ行促音便,連用形",
-  // "買い", "言い", "使い", etc) should not connect to TeSuffix(= "て",
-  // "てる", "ちゃう", "とく", etc).
-  //  - KagyoTaConnectionVerb(= 動詞,*,*,*,五段・カ行(促|イ)音便,連用タ接続",
-  // "書い", "歩い", "言っ", etc) should not connect to verb suffix other
-  // than TeSuffix
-  if (Util::GetScriptType(nodes[0]->value) != Util::HIRAGANA) {
-    if (nodes.size() >= 2) {
-      // For node sequence
-      if (pos_matcher_->IsKagyoTaConnectionVerb(nodes[0]->rid) &&
-          pos_matcher_->IsVerbSuffix(nodes[1]->lid) &&
-          !pos_matcher_->IsTeSuffix(nodes[1]->lid)) {
-        // "書い" | "ます", "過ぎ", etc
-        return CandidateFilter::BAD_CANDIDATE;
-      }
-      if (pos_matcher_->IsWagyoRenyoConnectionVerb(nodes[0]->rid) &&
-          pos_matcher_->IsTeSuffix(nodes[1]->lid)) {
-        // "買い" | "て"
-        return CandidateFilter::BAD_CANDIDATE;
-      }
-    }
-    if (nodes[0]->lid != nodes[0]->rid) {
-      // For compound
-      if (pos_matcher_->IsKagyoTaConnectionVerb(nodes[0]->lid) &&
-          pos_matcher_->IsVerbSuffix(nodes[0]->rid) &&
-          !pos_matcher_->IsTeSuffix(nodes[0]->rid)) {
-        // "書い" | "ます", "過ぎ", etc
-        return CandidateFilter::BAD_CANDIDATE;
-      }
-      if (pos_matcher_->IsWagyoRenyoConnectionVerb(nodes[0]->lid) &&
-          pos_matcher_->IsTeSuffix(nodes[0]->rid)) {
-        // "買い" | "て"
-        return CandidateFilter::BAD_CANDIDATE;
-      }
-    }
+  if (HasBadVerbConnection(*pos_matcher_, nodes)) {
+    return CandidateFilter::BAD_CANDIDATE;
   }
 
   // The candidate consists of only one token
@@ -501,7 +533,8 @@ CandidateFilter::ResultType CandidateFilter::FilterCandidate(
     // In reverse conversion, only remove duplicates because the filtering
     // criteria of FilterCandidateInternal() are completely designed for
     // (forward) conversion.
-    const bool inserted = seen_.insert(candidate->value).second;
+    const bool inserted =
+        seen_.insert(GetValueFingerprint(candidate->value)).second;
     return inserted ? GOOD_CANDIDATE : BAD_CANDIDATE;
   } else {
     const ResultType result = FilterCandidateInternal(original_key, candidate,
@@ -509,10 +542,72 @@ CandidateFilter::ResultType CandidateFilter::FilterCandidate(
     if (result != GOOD_CANDIDATE) {
       return result;
     }
-    seen_.insert(candidate->value);
+    seen_.insert(GetValueFingerprint(candidate->value));
     return result;
   }
 }
 
+CandidateFilter::ResultType CandidateFilter::FilterNodes(
+    const std::vector<const Node *> &nodes,
+    Segments::RequestType request_type) const {
+  DCHECK(!nodes.empty());
+
+  FingerprintBuilder value_fingerprint(kValueFingerprintSeed);
+  bool is_user_dictionary = false;
+  for (const Node *node : nodes) {
+    value_fingerprint.Append(node->value);
+    if (node->attributes & Node::USER_DICTIONARY) {
+      is_user_dictionary = true;
+    }
+  }
+  const bool is_seen =
+      seen_.find(value_fingerprint.Fingerprint()) != seen_.end();
+  if (request_type == Segments::REVERSE_CONVERSION) {
+    return is_seen ? BAD_CANDIDATE : GOOD_CANDIDATE;
+  }
+
+  // The checks below follow FilterCandidateInternal() in the same order, but
+  // only the ones which don't need the strings of the candidate.  The checks
+  // accepting the candidate there end the pre-filtering here.
+  if (HasConstrainedNode(nodes)) {
+    return GOOD_CANDIDATE;
+  }
+  if (HasMisplacedIsolatedWordOrGeneralSymbol(*pos_matcher_, nodes)) {
+    return BAD_CANDIDATE;
+  }
+  if (is_user_dictionary) {
+    return GOOD_CANDIDATE;
+  }
+  if (seen_.size() + 1 >= kMaxCandidatesSize) {
+    // FilterCandidate() stops the enumeration.
+    return GOOD_CANDIDATE;
+  }
+  if (is_seen || HasBadVerbConnection(*pos_matcher_, nodes)) {
+    return BAD_CANDIDATE;
+  }
+  if (nodes.size() == 1) {
+    return GOOD_CANDIDATE;
+  }
+  size_t value_chars_len = 0;
+  for (const Node *node : nodes) {
+    value_chars_len += Util::CharsLen(node->value);
+  }
+  if (value_chars_len == 1) {
+    return GOOD_CANDIDATE;
+  }
+  if (IsNoisyWeakCompound(nodes, pos_matcher_) && !seen_.empty()) {
+    return BAD_CANDIDATE;
+  }
+  if (IsConnectedWeakCompound(nodes, pos_matcher_) &&
+      seen_.size() >= kSizeThresholdForWeakCompound) {
+    return BAD_CANDIDATE;
+  }
+  return GOOD_CANDIDATE;
+}
+
+uint64 CandidateFilter::GetValueFingerprint(StringPiece value) {
+  return Hash::FingerprintWithSeed(value, kValueFingerprintSeed);
+}
+
 }  // namespace converter
 }  // namespace mozc
@@ -30,11 +30,12 @@
 #ifndef MOZC_CONVERTER_CANDIDATE_FILTER_H_
 #define MOZC_CONVERTER_CANDIDATE_FILTER_H_
 
-#include <set>
 #include <string>
 #include <vector>
 
+#include "base/mozc_hash_set.h"
 #include "base/port.h"
+#include "base/string_piece.h"
 #include "converter/segments.h"
 #include "dictionary/pos_matcher.h"
 #include "dictionary/suppression_dictionary.h"
@@ -67,10 +68,19 @@ class CandidateFilter {
                              const std::vector<const Node *> &nodes,
                              Segments::RequestType request_type);
 
+  // Checks the nodes of a candidate before the candidate is built from them.
+  // Returns BAD_CANDIDATE only if FilterCandidate() would also return it for
+  // the candidate, so the caller can skip building it.  Otherwise returns
+  // GOOD_CANDIDATE, and FilterCandidate() is still needed for the candidate.
+  ResultType FilterNodes(const std::vector<const Node *> &nodes,
+                         Segments::RequestType request_type) const;
+
   // Resets the internal state.
   void Reset();
 
  private:
+  static uint64 GetValueFingerprint(StringPiece value);
+
   ResultType FilterCandidateInternal(const string &original_key,
                                      const Segment::Candidate *candidate,
                                      const std::vector<const Node *> &nodes,
@@ -80,7 +90,8 @@ class CandidateFilter {
   const dictionary::POSMatcher *pos_matcher_;
   const SuggestionFilter *suggestion_filter_;
 
-  std::set<string> seen_;
+  // Fingerprints of the values of the accepted candidates.
+  mozc_hash_set<uint64> seen_;
   const Segment::Candidate *top_candidate_;
   bool apply_suggestion_filter_for_exact_match_;
 
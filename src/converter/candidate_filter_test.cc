@@ -399,6 +399,66 @@ TEST_F(CandidateFilterTest, IsolatedWordInMultipleNodes) {
                                     Segments::CONVERSION));
 }
 
+TEST_F(CandidateFilterTest, FilterNodes) {
+  std::unique_ptr<CandidateFilter> filter(CreateCandidateFilter(true));
+
+  std::vector<Node *> nodes = {NewNode(), NewNode()};
+  nodes[0]->next = nodes[1];
+  nodes[0]->lid = pos_matcher().GetUnknownId();
+  nodes[0]->rid = pos_matcher().GetUnknownId();
+  nodes[0]->key = "abc";
+  nodes[0]->value = "abc";
+  nodes[1]->prev = nodes[0];
+  nodes[1]->lid = pos_matcher().GetIsolatedWordId();
+  nodes[1]->rid = pos_matcher().GetIsolatedWordId();
+  nodes[1]->key = "isolated";
+  nodes[1]->value = "isolated";
+  std::vector<const Node *> const_nodes(nodes.begin(), nodes.end());
+
+  // An isolated word with other words is rejected before the candidate is
+  // built, unless the nodes are constrained.
+  EXPECT_EQ(CandidateFilter::BAD_CANDIDATE,
+            filter->FilterNodes(const_nodes, Segments::CONVERSION));
+  EXPECT_EQ(CandidateFilter::GOOD_CANDIDATE,
+            filter->FilterNodes(const_nodes, Segments::REVERSE_CONVERSION));
+  nodes[1]->constrained_prev = nodes[0];
+  EXPECT_EQ(CandidateFilter::GOOD_CANDIDATE,
+            filter->FilterNodes(const_nodes, Segments::CONVERSION));
+  nodes[1]->constrained_prev = nullptr;
+
+  // A path whose value is already seen is rejected, unless it comes from the
+  // user dictionary.
+  nodes[1]->lid = pos_matcher().GetUnknownId();
+  nodes[1]->rid = pos_matcher().GetUnknownId();
+  Segment::Candidate *c = NewCandidate();
+  c->key = "abcisolated";
+  c->value = "abcisolated";
+  EXPECT_EQ(CandidateFilter::GOOD_CANDIDATE,
+            filter->FilterNodes(const_nodes, Segments::CONVERSION));
+  EXPECT_EQ(CandidateFilter::GOOD_CANDIDATE,
+            filter->FilterCandidate("abcisolated", c, const_nodes,
+                                    Segments::CONVERSION));
+  for (size_t i = 0; i < arraysize(kRequestTypes); ++i) {
+    EXPECT_EQ(CandidateFilter::BAD_CANDIDATE,
+              filter->FilterNodes(const_nodes, kRequestTypes[i]));
+  }
+  nodes[1]->attributes |= Node::USER_DICTIONARY;
+  EXPECT_EQ(CandidateFilter::GOOD_CANDIDATE,
+            filter->FilterNodes(const_nodes, Segments::CONVERSION));
+  nodes[1]->attributes &= ~Node::USER_DICTIONARY;
+
+  filter->Reset();
+  EXPECT_EQ(CandidateFilter::GOOD_CANDIDATE,
+            filter->FilterNodes(const_nodes, Segments::CONVERSION));
+
+  // In reverse conversion, only duplicates are rejected.
+  EXPECT_EQ(CandidateFilter::GOOD_CANDIDATE,
+            filter->FilterCandidate("abcisolated", c, const_nodes,
+                                    Segments::REVERSE_CONVERSION));
+  EXPECT_EQ(CandidateFilter::BAD_CANDIDATE,
+            filter->FilterNodes(const_nodes, Segments::REVERSE_CONVERSION));
+}
+
 TEST_F(CandidateFilterTest, MayHaveMoreCandidates) {
   std::unique_ptr<CandidateFilter> filter(CreateCandidateFilter(true));
   std::vector<const Node *> n;
@@ -648,10 +708,10 @@ TEST_F(CandidateFilterTest, CapabilityOfSuggestionFilter_Conversion) {
     nodes.push_back(n);
 
     Segment::Candidate *c = NewCandidate();
-    c->key = n->key;
-    c->value = n->value;
-    c->content_key = n->key;
-    c->content_value = n->value;
+    c->key = n->key.as_string();
+    c->value = n->value.as_string();
+    c->content_key = n->key.as_string();
+    c->content_value = n->value.as_string();
     c->cost = 1000;
     c->structure_cost = 2000;
 
@@ -674,10 +734,10 @@ TEST_F(CandidateFilterTest, CapabilityOfSuggestionFilter_Suggestion) {
     nodes.push_back(n);
 
     Segment::Candidate *c = NewCandidate();
-    c->key = n->key;
-    c->value = n->value;
-    c->content_key = n->key;
-    c->content_value = n->value;
+    c->key = n->key.as_string();
+    c->value = n->value.as_string();
+    c->content_key = n->key.as_string();
+    c->content_value = n->value.as_string();
     c->cost = 1000;
     c->structure_cost = 2000;
 
@@ -688,7 +748,8 @@ TEST_F(CandidateFilterTest, CapabilityOfSuggestionFilter_Suggestion) {
     filter->Reset();
     // Test case where "フィルター" is suggested from key "ふぃるたー".
     EXPECT_EQ(CandidateFilter::BAD_CANDIDATE,
-              filter->FilterCandidate(n->key, c, nodes, Segments::SUGGESTION));
+              filter->FilterCandidate(n->key.as_string(), c, nodes,
+                                      Segments::SUGGESTION));
   }
   // Next test bigram case.
   {
@@ -707,8 +768,8 @@ TEST_F(CandidateFilterTest, CapabilityOfSuggestionFilter_Suggestion) {
     nodes.push_back(n2);
 
     Segment::Candidate *c = NewCandidate();
-    c->key.assign(n1->key).append(n2->key);
-    c->value.assign(n1->value).append(n2->value);
+    c->key.assign(n1->key.as_string()).append(n2->key.as_string());
+    c->value.assign(n1->value.as_string()).append(n2->value.as_string());
     c->content_key = c->key;
     c->content_value = c->value;
     c->cost = 1000;
@@ -747,8 +808,10 @@ TEST_F(CandidateFilterTest, CapabilityOfSuggestionFilter_Suggestion) {
     nodes.push_back(n3);
 
     Segment::Candidate *c = NewCandidate();
-    c->key.assign(n1->key).append(n2->key).append(n3->key);;
-    c->value.assign(n1->value).append(n2->value).append(n3->value);
+    c->key.assign(n1->key.as_string()).append(n2->key.as_string())
+        .append(n3->key.as_string());
+    c->value.assign(n1->value.as_string()).append(n2->value.as_string())
+        .append(n3->value.as_string());
     c->content_key = c->key;
     c->content_value = c->value;
     c->cost = 1000;
@@ -780,10 +843,10 @@ TEST_F(CandidateFilterTest, CapabilityOfSuggestionFilter_Suggestion_Mobile) {
     nodes.push_back(n);
 
     Segment::Candidate *c = NewCandidate();
-    c->key = n->key;
-    c->value = n->value;
-    c->content_key = n->key;
-    c->content_value = n->value;
+    c->key = n->key.as_string();
+    c->value = n->value.as_string();
+    c->content_key = n->key.as_string();
+    c->content_value = n->value.as_string();
     c->cost = 1000;
     c->structure_cost = 2000;
 
@@ -794,7 +857,8 @@ TEST_F(CandidateFilterTest, CapabilityOfSuggestionFilter_Suggestion_Mobile) {
     filter->Reset();
     // Test case where "フィルター" is suggested from key "ふぃるたー".
     EXPECT_EQ(CandidateFilter::GOOD_CANDIDATE,
-              filter->FilterCandidate(n->key, c, nodes, Segments::SUGGESTION));
+              filter->FilterCandidate(n->key.as_string(), c, nodes,
+                                      Segments::SUGGESTION));
   }
 }
 
@@ -813,10 +877,10 @@ TEST_F(CandidateFilterTest, CapabilityOfSuggestionFilter_Prediction) {
     nodes.push_back(n);
 
     Segment::Candidate *c = NewCandidate();
-    c->key = n->key;
-    c->value = n->value;
-    c->content_key = n->key;
-    c->content_value = n->value;
+    c->key = n->key.as_string();
+    c->value = n->value.as_string();
+    c->content_key = n->key.as_string();
+    c->content_value = n->value.as_string();
     c->cost = 1000;
     c->structure_cost = 2000;
 
@@ -829,7 +893,8 @@ TEST_F(CandidateFilterTest, CapabilityOfSuggestionFilter_Prediction) {
     // are good if its key is equal to the original key.
     filter->Reset();
     EXPECT_EQ(CandidateFilter::GOOD_CANDIDATE,
-              filter->FilterCandidate(n->key, c, nodes, Segments::PREDICTION));
+              filter->FilterCandidate(n->key.as_string(), c, nodes,
+                                      Segments::PREDICTION));
   }
   // Next test bigram case.
   {
@@ -848,8 +913,8 @@ TEST_F(CandidateFilterTest, CapabilityOfSuggestionFilter_Prediction) {
     nodes.push_back(n2);
 
     Segment::Candidate *c = NewCandidate();
-    c->key.assign(n1->key).append(n2->key);
-    c->value.assign(n1->value).append(n2->value);
+    c->key.assign(n1->key.as_string()).append(n2->key.as_string());
+    c->value.assign(n1->value.as_string()).append(n2->value.as_string());
     c->content_key = c->key;
     c->content_value = c->value;
     c->cost = 1000;
@@ -889,8 +954,10 @@ TEST_F(CandidateFilterTest, CapabilityOfSuggestionFilter_Prediction) {
     nodes.push_back(n3);
 
     Segment::Candidate *c = NewCandidate();
-    c->key.assign(n1->key).append(n2->key).append(n3->key);;
-    c->value.assign(n1->value).append(n2->value).append(n3->value);
+    c->key.assign(n1->key.as_string()).append(n2->key.as_string())
+        .append(n3->key.as_string());
+    c->value.assign(n1->value.as_string()).append(n2->value.as_string())
+        .append(n3->value.as_string());
     c->content_key = c->key;
     c->content_value = c->value;
     c->cost = 1000;
@@ -927,8 +994,8 @@ TEST_F(CandidateFilterTest, ReverseConversion) {
 
   {
     Segment::Candidate *c = NewCandidate();
-    c->key.assign(n1->key);
-    c->value.assign(n1->value);
+    c->key.assign(n1->key.as_string());
+    c->value.assign(n1->value.as_string());
     c->content_key = c->key;
     c->content_value = c->value;
     c->cost = 1000;
@@ -944,8 +1011,8 @@ TEST_F(CandidateFilterTest, ReverseConversion) {
   {
     // White space should be valid candidate.
     Segment::Candidate *c = NewCandidate();
-    c->key.assign(n2->key);
-    c->value.assign(n2->value);
+    c->key.assign(n2->key.as_string());
+    c->value.assign(n2->value.as_string());
     c->content_key = c->key;
     c->content_value = c->value;
     c->cost = 1000;
@@ -31,19 +31,29 @@
 
 #include <algorithm>
 
+#include "base/flags.h"
 #include "base/logging.h"
 #include "base/port.h"
 #include "base/stl_util.h"
 #include "data_manager/data_manager_interface.h"
 #include "storage/louds/simple_succinct_bit_vector_index.h"
 
+DEFINE_bool(use_dense_connection_matrix, false,
+            "If true, the connection cost matrix is expanded in memory so "
+            "that every lookup is a single load.  It needs rsize * lsize * 2 "
+            "bytes of heap.");
+
 using mozc::storage::louds::SimpleSuccinctBitVectorIndex;
 
 namespace mozc {
 namespace {
 
-const uint32 kInvalidCacheKey = 0xFFFFFFFF;
+// POS ids are much smaller than 0xFFFF, so the key part never matches a valid
+// key.
+const uint64 kInvalidCacheSlot = 0xFFFFFFFFFFFFFFFFULL;
 const uint16 kConnectorMagicNumber = 0xCDAB;
+// The data has the index block of the rows; see gen_connection_data.py.
+const uint16 kConnectorMagicNumberWithIndex = 0xCDAC;
 const uint8 kInvalid1ByteCostValue = 255;
 
 inline uint32 GetHashValue(uint16 rid, uint16 lid, uint32 hash_mask) {
@@ -59,6 +69,18 @@ inline uint32 EncodeKey(uint16 rid, uint16 lid) {
   return (static_cast<uint32>(rid) << 16) | lid;
 }
 
+inline uint64 EncodeCacheSlot(uint32 key, int value) {
+  return (static_cast<uint64>(key) << 32) | static_cast<uint32>(value);
+}
+
+inline uint32 GetCacheSlotKey(uint64 slot) {
+  return static_cast<uint32>(slot >> 32);
+}
+
+inline int GetCacheSlotValue(uint64 slot) {
+  return static_cast<int>(static_cast<uint32>(slot));
+}
+
 }  // namespace
 
 class Connector::Row {
@@ -75,6 +97,30 @@ class Connector::Row {
     use_1byte_value_ = use_1byte_value;
   }
 
+  // Same as Init() but the indices of the bit vectors are taken from
+  // |index_image|, which consists of the index images of chunk bits and
+  // compact bits.
+  bool InitFromIndexImage(const uint8 *chunk_bits, size_t chunk_bits_size,
+                          const uint8 *compact_bits, size_t compact_bits_size,
+                          const uint8 *values, bool use_1byte_value,
+                          const uint8 *index_image, int index_image_size) {
+    if (!chunk_bits_index_.InitFromIndexImage(chunk_bits, chunk_bits_size,
+                                              index_image, index_image_size)) {
+      return false;
+    }
+    const int chunk_bits_index_size =
+        SimpleSuccinctBitVectorIndex::GetIndexImageSize(index_image);
+    if (!compact_bits_index_.InitFromIndexImage(
+            compact_bits, compact_bits_size,
+            index_image + chunk_bits_index_size,
+            index_image_size - chunk_bits_index_size)) {
+      return false;
+    }
+    values_ = values;
+    use_1byte_value_ = use_1byte_value;
+    return true;
+  }
+
   // Returns true if the value is found in the row and then store the found
   // value into |value|. Otherwise returns false.
   bool GetValue(uint16 index, uint16 *value) const {
@@ -111,6 +157,13 @@ class Connector::Row {
 
 Connector *Connector::CreateFromDataManager(
     const DataManagerInterface &data_manager) {
+  return CreateFromDataManager(
+      data_manager, FLAGS_use_dense_connection_matrix ? DENSE_MATRIX
+                                                      : COMPRESSED);
+}
+
+Connector *Connector::CreateFromDataManager(
+    const DataManagerInterface &data_manager, CostTableType type) {
 #ifdef OS_ANDROID
   const int kCacheSize = 256;
 #else
@@ -119,23 +172,47 @@ Connector *Connector::CreateFromDataManager(
   const char *connection_data = nullptr;
   size_t connection_data_size = 0;
   data_manager.GetConnectorData(&connection_data, &connection_data_size);
-  return new Connector(connection_data, connection_data_size, kCacheSize);
+  return new Connector(connection_data, connection_data_size, kCacheSize,
+                       type);
 }
 
 Connector::Connector(const char *connection_data,
                      size_t connection_size,
                      int cache_size)
     : default_cost_(nullptr),
+      matrix_size_(0),
       cache_size_(cache_size),
       cache_hash_mask_(cache_size - 1),
-      cache_key_(new uint32[cache_size]),
-      cache_value_(new int[cache_size]) {
+      cache_(new std::atomic<uint64>[cache_size]) {
+  Init(connection_data, connection_size, COMPRESSED);
+}
+
+Connector::Connector(const char *connection_data,
+                     size_t connection_size,
+                     int cache_size,
+                     CostTableType type)
+    : default_cost_(nullptr),
+      matrix_size_(0),
+      cache_size_(type == COMPRESSED ? cache_size : 0),
+      cache_hash_mask_(cache_size_ - 1),
+      cache_(type == COMPRESSED ? new std::atomic<uint64>[cache_size]
+                                : nullptr) {
+  Init(connection_data, connection_size, type);
+}
+
+void Connector::Init(const char *connection_data, size_t connection_size,
+                     CostTableType type) {
   const uint16 *ptr = reinterpret_cast<const uint16 *>(connection_data);
-  CHECK_EQ(kConnectorMagicNumber, ptr[0]);
+  const bool has_index = ptr[0] == kConnectorMagicNumberWithIndex;
+  if (!has_index) {
+    CHECK_EQ(kConnectorMagicNumber, ptr[0]);
+  }
   resolution_ = ptr[1];
+  invalid_cost_ = kInvalidCost * resolution_;
   const uint16 rsize = ptr[2];
   const uint16 lsize = ptr[3];
   CHECK_EQ(rsize, lsize) << "The connector matrix should be square.";
+  matrix_size_ = rsize;
   default_cost_ = ptr + 4;
 
   // Calculate the row's beginning position. Note that it should be aligned to
@@ -153,28 +230,70 @@ Connector::Connector(const char *connection_data,
   const bool use_1byte_value = resolution_ != 1;
 
   rows_.reserve(rsize);
-  for (size_t i = 0; i < rsize; ++i) {
-    const uint16 *size_data =
-        reinterpret_cast<const uint16 *>(connection_data + offset);
-    Row *row = new Row;
-    const uint16 compact_bits_size = size_data[0];
-    CHECK_EQ(compact_bits_size % 4, 0) << compact_bits_size;
-    const uint16 values_size = size_data[1];
-    CHECK_EQ(values_size % 4, 0) << values_size;
-
-    const uint8 *chunk_bits =
+  if (has_index) {
+    // Only the index block is read here.  The rows themselves are not touched
+    // until they are looked up.
+    const uint32 index_block_size =
+        *reinterpret_cast<const uint32 *>(connection_data + offset);
+    const uint8 *index_ptr =
         reinterpret_cast<const uint8 *>(connection_data + offset + 4);
-    const uint8 *compact_bits = chunk_bits + chunk_bits_size;
-    const uint8 *values = compact_bits + compact_bits_size;
-    row->Init(chunk_bits, chunk_bits_size, compact_bits, compact_bits_size,
-              values, use_1byte_value);
-    rows_.push_back(row);
+    const uint8 *index_end = index_ptr + index_block_size;
+    CHECK_LE(offset + 4 + index_block_size, connection_size);
+    for (size_t i = 0; i < rsize; ++i) {
+      CHECK_LE(index_ptr + 8, index_end);
+      const uint32 *entry = reinterpret_cast<const uint32 *>(index_ptr);
+      const uint32 row_offset = entry[0];
+      const uint32 compact_bits_size = entry[1];
+      CHECK_EQ(compact_bits_size % 4, 0) << compact_bits_size;
+      CHECK_LE(row_offset + 4 + chunk_bits_size + compact_bits_size,
+               connection_size);
+      index_ptr += 8;
+
+      const uint8 *chunk_bits =
+          reinterpret_cast<const uint8 *>(connection_data + row_offset + 4);
+      const uint8 *compact_bits = chunk_bits + chunk_bits_size;
+      const uint8 *values = compact_bits + compact_bits_size;
+      Row *row = new Row;
+      rows_.push_back(row);
+      CHECK(row->InitFromIndexImage(chunk_bits, chunk_bits_size,
+                                    compact_bits, compact_bits_size,
+                                    values, use_1byte_value,
+                                    index_ptr, index_end - index_ptr))
+          << "Broken index of row " << i;
+      const int chunk_bits_index_size =
+          SimpleSuccinctBitVectorIndex::GetIndexImageSize(index_ptr);
+      index_ptr += chunk_bits_index_size;
+      index_ptr += SimpleSuccinctBitVectorIndex::GetIndexImageSize(index_ptr);
+    }
+  } else {
+    for (size_t i = 0; i < rsize; ++i) {
+      const uint16 *size_data =
+          reinterpret_cast<const uint16 *>(connection_data + offset);
+      Row *row = new Row;
+      const uint16 compact_bits_size = size_data[0];
+      CHECK_EQ(compact_bits_size % 4, 0) << compact_bits_size;
+      const uint16 values_size = size_data[1];
+      CHECK_EQ(values_size % 4, 0) << values_size;
+
+      const uint8 *chunk_bits =
+          reinterpret_cast<const uint8 *>(connection_data + offset + 4);
+      const uint8 *compact_bits = chunk_bits + chunk_bits_size;
+      const uint8 *values = compact_bits + compact_bits_size;
+      row->Init(chunk_bits, chunk_bits_size, compact_bits, compact_bits_size,
+                values, use_1byte_value);
+      rows_.push_back(row);
+
+      offset += 4 + chunk_bits_size + compact_bits_size + values_size;
+    }
+  }
 
-    offset += 4 + chunk_bits_size + compact_bits_size + values_size;
+  if (type == DENSE_MATRIX) {
+    BuildDenseMatrix();
+    return;
   }
 
   // Check if the cache_size is the power of 2 and clear cache.
-  DCHECK_EQ(0, cache_size & (cache_size - 1));
+  DCHECK_EQ(0, cache_size_ & (cache_size_ - 1));
   ClearCache();
 }
 
@@ -183,15 +302,18 @@ Connector::~Connector() {
 }
 
 
-int Connector::GetTransitionCost(uint16 rid, uint16 lid) const {
+int Connector::GetCachedTransitionCost(uint16 rid, uint16 lid) const {
   const uint32 index = EncodeKey(rid, lid);
   const uint32 bucket = GetHashValue(rid, lid, cache_hash_mask_);
-  if (cache_key_[bucket] == index) {
-    return cache_value_[bucket];
+  // Relaxed ordering is enough as the slot is self-contained; on x86 and ARM64
+  // this is a plain load, as cheap as the unsynchronized cache used to be.
+  const uint64 slot = cache_[bucket].load(std::memory_order_relaxed);
+  if (GetCacheSlotKey(slot) == index) {
+    return GetCacheSlotValue(slot);
   }
   const int value = LookupCost(rid, lid);
-  cache_key_[bucket] = index;
-  cache_value_[bucket] = value;
+  cache_[bucket].store(EncodeCacheSlot(index, value),
+                       std::memory_order_relaxed);
   return value;
 }
 
@@ -199,8 +321,26 @@ int Connector::GetResolution() const {
   return resolution_;
 }
 
+int Connector::GetMatrixSize() const {
+  return static_cast<int>(matrix_size_);
+}
+
+Connector::CostTableType Connector::GetCostTableType() const {
+  return dense_matrix_ ? DENSE_MATRIX : COMPRESSED;
+}
+
+size_t Connector::GetTableMemoryUsage() const {
+  if (dense_matrix_) {
+    return matrix_size_ * matrix_size_ * sizeof(dense_matrix_[0]);
+  }
+  return cache_size_ * sizeof(cache_[0]);
+}
+
 void Connector::ClearCache() {
-  std::fill(cache_key_.get(), cache_key_.get() + cache_size_, kInvalidCacheKey);
+  // Note that cache_size_ is 0 for DENSE_MATRIX.
+  for (int i = 0; i < cache_size_; ++i) {
+    cache_[i].store(kInvalidCacheSlot, std::memory_order_relaxed);
+  }
 }
 
 int Connector::LookupCost(uint16 rid, uint16 lid) const {
@@ -211,4 +351,19 @@ int Connector::LookupCost(uint16 rid, uint16 lid) const {
   return value * resolution_;
 }
 
+void Connector::BuildDenseMatrix() {
+  dense_matrix_.reset(new int16[matrix_size_ * matrix_size_]);
+  int16 *cell = dense_matrix_.get();
+  for (size_t rid = 0; rid < matrix_size_; ++rid) {
+    for (size_t lid = 0; lid < matrix_size_; ++lid) {
+      // Costs of valid transitions are below kInvalidCost, which is mapped
+      // back to |invalid_cost_| by GetTransitionCost().
+      const int cost = LookupCost(rid, lid);
+      DCHECK(cost == invalid_cost_ || cost < kInvalidCost)
+          << "rid: " << rid << ", lid: " << lid << ", cost: " << cost;
+      *cell++ = static_cast<int16>(std::min<int>(cost, kInvalidCost));
+    }
+  }
+}
+
 }  // namespace mozc
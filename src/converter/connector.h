@@ -30,6 +30,7 @@
 #ifndef MOZC_CONVERTER_CONNECTOR_H_
 #define MOZC_CONVERTER_CONNECTOR_H_
 
+#include <atomic>
 #include <memory>
 #include <vector>
 
@@ -39,35 +40,87 @@ namespace mozc {
 
 class DataManagerInterface;
 
+// Returns the transition cost between two POS ids.
+//
+// GetTransitionCost() is thread-safe: a single instance can be shared by
+// conversions running concurrently.  The lookup cache is a direct-mapped table
+// whose slot packs the key (rid, lid) and the cost into one 64-bit word, so
+// that a slot is always read and written as a whole without locking.  Racing
+// writers may overwrite each other's slot, which only costs a cache miss.
+//
+// Alternatively, the compressed rows can be expanded into a dense rid x lid
+// matrix of int16 at construction time (see CostTableType).  Then every lookup
+// is a single indexed load at the expense of rsize * lsize * 2 bytes of heap
+// (about 14MB for the OSS data set).
 class Connector {
  public:
+  // Invalid transitions cost kInvalidCost scaled by the resolution in both
+  // CostTableTypes.
   static const int16 kInvalidCost = 30000;
 
+  enum CostTableType {
+    // Looks up the compressed rows through the direct-mapped cache.
+    COMPRESSED,
+    // Expands all the rows into a dense matrix.  Invalid transitions are
+    // stored as kInvalidCost and scaled by the resolution on lookup, so that
+    // the costs fit in int16 also with 1-byte cost values.
+    DENSE_MATRIX,
+  };
+
+  // Creates a connector of the type specified by
+  // --use_dense_connection_matrix.
   static Connector *CreateFromDataManager(
       const DataManagerInterface &data_manager);
+  static Connector *CreateFromDataManager(
+      const DataManagerInterface &data_manager, CostTableType type);
 
   Connector(const char *connection_data, size_t connection_size,
             int cache_size);
+  // |cache_size| is ignored for DENSE_MATRIX.
+  Connector(const char *connection_data, size_t connection_size,
+            int cache_size, CostTableType type);
   ~Connector();
 
-  int GetTransitionCost(uint16 rid, uint16 lid) const;
+  int GetTransitionCost(uint16 rid, uint16 lid) const {
+    if (dense_matrix_) {
+      const int cost =
+          dense_matrix_[static_cast<size_t>(rid) * matrix_size_ + lid];
+      return cost == kInvalidCost ? invalid_cost_ : cost;
+    }
+    return GetCachedTransitionCost(rid, lid);
+  }
   int GetResolution() const;
+  // Returns the number of POS ids, i.e., the number of rows and columns.
+  int GetMatrixSize() const;
+  CostTableType GetCostTableType() const;
+  // Returns the size of the heap memory used for the lookup, i.e., the cache
+  // or the dense matrix.
+  size_t GetTableMemoryUsage() const;
 
   void ClearCache();
 
  private:
   class Row;
 
+  void Init(const char *connection_data, size_t connection_size,
+            CostTableType type);
+  int GetCachedTransitionCost(uint16 rid, uint16 lid) const;
   int LookupCost(uint16 rid, uint16 lid) const;
+  void BuildDenseMatrix();
 
   std::vector<Row *> rows_;
   const uint16 *default_cost_;
   int resolution_;
+  // kInvalidCost scaled by the resolution.
+  int invalid_cost_;
+  size_t matrix_size_;
+  // Non-null only for DENSE_MATRIX.
+  std::unique_ptr<int16[]> dense_matrix_;
 
   const int cache_size_;
   const uint32 cache_hash_mask_;
-  mutable std::unique_ptr<uint32[]> cache_key_;
-  mutable std::unique_ptr<int[]> cache_value_;
+  // Each slot holds (EncodeKey(rid, lid) << 32 | cost).
+  mutable std::unique_ptr<std::atomic<uint64>[]> cache_;
 
   DISALLOW_COPY_AND_ASSIGN(Connector);
 };
@@ -0,0 +1,182 @@
+// Copyright 2010-2018, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Benchmark for Connector::GetTransitionCost.
+//
+// Runs random lookups from 1 to --max_threads threads sharing one Connector
+// and reports the throughput for each number of threads, both for the
+// compressed cost table with cache and for the dense matrix.  The (rid, lid)
+// pairs are drawn from a working set of --working_set_size pairs; a small set
+// is close to the cache hit ratio observed in the conversion lattice, and a
+// large one shows the cache thrashing on long inputs.
+//
+// Usage:
+//   connector_main [--engine_data=mozc.data --magic=...] --max_threads=8
+
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "base/flags.h"
+#include "base/init_mozc.h"
+#include "base/logging.h"
+#include "base/port.h"
+#include "base/stopwatch.h"
+#include "base/thread.h"
+#include "converter/connector.h"
+#include "data_manager/data_manager.h"
+#include "data_manager/oss/oss_data_manager.h"
+
+DEFINE_string(engine_data, "",
+              "Path to the data set file.  If empty, the embedded OSS data set "
+              "is used.");
+DEFINE_string(magic, "", "Expected magic number of --engine_data.");
+DEFINE_int32(max_threads, 8, "Maximum number of threads.");
+DEFINE_int32(lookups_per_thread, 10000000, "Number of lookups per thread.");
+DEFINE_int32(working_set_size, 4096,
+             "Number of distinct (rid, lid) pairs to look up.");
+
+namespace mozc {
+namespace {
+
+struct IdPair {
+  uint16 rid;
+  uint16 lid;
+};
+
+class LookupThread : public Thread {
+ public:
+  LookupThread(const Connector *connector, const std::vector<IdPair> *pairs,
+               int seed)
+      : connector_(connector), pairs_(pairs), seed_(seed), checksum_(0) {}
+
+  void Run() override {
+    std::mt19937 urbg(seed_);
+    std::uniform_int_distribution<size_t> dist(0, pairs_->size() - 1);
+    // Looks up the pairs in a random but fixed order so that the random
+    // number generator is out of the measured loop.
+    std::vector<IdPair> order(pairs_->size());
+    for (size_t i = 0; i < order.size(); ++i) {
+      order[i] = (*pairs_)[dist(urbg)];
+    }
+    int64 checksum = 0;
+    for (int i = 0; i < FLAGS_lookups_per_thread; ++i) {
+      const IdPair &pair = order[i % order.size()];
+      checksum += connector_->GetTransitionCost(pair.rid, pair.lid);
+    }
+    checksum_ = checksum;
+  }
+
+  int64 checksum() const { return checksum_; }
+
+ private:
+  const Connector *connector_;
+  const std::vector<IdPair> *pairs_;
+  const int seed_;
+  int64 checksum_;
+
+  DISALLOW_COPY_AND_ASSIGN(LookupThread);
+};
+
+void RunBenchmark(const Connector &connector, const std::vector<IdPair> &pairs,
+                  int num_threads) {
+  std::vector<std::unique_ptr<LookupThread>> threads;
+  for (int i = 0; i < num_threads; ++i) {
+    threads.emplace_back(new LookupThread(&connector, &pairs, i));
+    threads.back()->SetJoinable(true);
+  }
+  Stopwatch stopwatch = Stopwatch::StartNew();
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i]->Start("ConnectorBenchmark");
+  }
+  int64 checksum = 0;
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i]->Join();
+    checksum += threads[i]->checksum();
+  }
+  stopwatch.Stop();
+
+  const double total_lookups =
+      static_cast<double>(FLAGS_lookups_per_thread) * num_threads;
+  const double elapsed_sec = stopwatch.GetElapsedMicroseconds() / 1e6;
+  std::cout << "threads=" << num_threads
+            << " elapsed=" << elapsed_sec << "s"
+            << " lookups/sec=" << total_lookups / elapsed_sec
+            << " ns/lookup/thread="
+            << stopwatch.GetElapsedNanoseconds() / FLAGS_lookups_per_thread
+            << " checksum=" << checksum << std::endl;
+}
+
+}  // namespace
+}  // namespace mozc
+
+int main(int argc, char **argv) {
+  mozc::InitMozc(argv[0], &argc, &argv, false);
+
+  std::unique_ptr<mozc::DataManager> data_manager;
+  if (FLAGS_engine_data.empty()) {
+    data_manager.reset(new mozc::oss::OssDataManager());
+  } else {
+    data_manager.reset(new mozc::DataManager());
+    const mozc::DataManager::Status status =
+        data_manager->InitFromFile(FLAGS_engine_data, FLAGS_magic);
+    CHECK_EQ(status, mozc::DataManager::Status::OK)
+        << "Failed to load " << FLAGS_engine_data;
+  }
+
+  const mozc::Connector::CostTableType kTypes[] = {
+    mozc::Connector::COMPRESSED,
+    mozc::Connector::DENSE_MATRIX,
+  };
+  const char *kTypeNames[] = {"compressed", "dense matrix"};
+  for (size_t i = 0; i < arraysize(kTypes); ++i) {
+    mozc::Stopwatch stopwatch = mozc::Stopwatch::StartNew();
+    std::unique_ptr<mozc::Connector> connector(
+        mozc::Connector::CreateFromDataManager(*data_manager, kTypes[i]));
+    stopwatch.Stop();
+    std::cout << kTypeNames[i] << ": load="
+              << stopwatch.GetElapsedMilliseconds() << "ms"
+              << " heap=" << connector->GetTableMemoryUsage() << " bytes"
+              << std::endl;
+
+    std::mt19937 urbg(0);
+    std::uniform_int_distribution<int> dist(0,
+                                            connector->GetMatrixSize() - 1);
+    std::vector<mozc::IdPair> pairs(FLAGS_working_set_size);
+    for (size_t j = 0; j < pairs.size(); ++j) {
+      pairs[j].rid = dist(urbg);
+      pairs[j].lid = dist(urbg);
+    }
+    for (int n = 1; n <= FLAGS_max_threads; n *= 2) {
+      mozc::RunBenchmark(*connector, pairs, n);
+    }
+  }
+  return 0;
+}
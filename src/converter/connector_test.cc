@@ -36,6 +36,7 @@
 #include <vector>
 
 #include "base/mmap.h"
+#include "base/thread.h"
 #include "data_manager/connection_file_reader.h"
 #include "testing/base/public/gunit.h"
 #include "testing/base/public/mozctest.h"
@@ -87,6 +88,132 @@ TEST(ConnectorTest, CompareWithRawData) {
     }
   }
 }
+
+TEST(ConnectorTest, DenseMatrixCompareWithRawData) {
+  const string path = testing::GetSourceFileOrDie({
+      "data_manager", "testing", "connection.data"});
+  Mmap cmmap;
+  ASSERT_TRUE(cmmap.Open(path.c_str())) << "Failed to open image: " << path;
+  std::unique_ptr<Connector> connector(
+      new Connector(cmmap.begin(), cmmap.size(), 256,
+                    Connector::DENSE_MATRIX));
+  ASSERT_EQ(Connector::DENSE_MATRIX, connector->GetCostTableType());
+  const size_t matrix_size = connector->GetMatrixSize();
+  EXPECT_EQ(matrix_size * matrix_size * sizeof(int16),
+            connector->GetTableMemoryUsage());
+
+  const string connection_text_path = testing::GetSourceFileOrDie({
+      "data_manager", "testing", "connection_single_column.txt"});
+  for (ConnectionFileReader reader(connection_text_path);
+       !reader.done(); reader.Next()) {
+    EXPECT_EQ(reader.cost(),
+              connector->GetTransitionCost(reader.rid_of_left_node(),
+                                           reader.lid_of_right_node()));
+  }
+}
+
+// Both the table types should return the same costs for all the pairs of
+// (rid, lid), including invalid transitions of 1-byte cost values, which are
+// scaled by the resolution.
+TEST(ConnectorTest, DenseMatrixCompareWithCompressed) {
+  const char *kDataFiles[] = {"connection.data", "connection_1byte.data"};
+  for (size_t i = 0; i < arraysize(kDataFiles); ++i) {
+    SCOPED_TRACE(kDataFiles[i]);
+    const string path = testing::GetSourceFileOrDie({
+        "data_manager", "testing", kDataFiles[i]});
+    Mmap cmmap;
+    ASSERT_TRUE(cmmap.Open(path.c_str())) << "Failed to open image: " << path;
+    std::unique_ptr<Connector> compressed(
+        new Connector(cmmap.begin(), cmmap.size(), 256,
+                      Connector::COMPRESSED));
+    std::unique_ptr<Connector> dense(
+        new Connector(cmmap.begin(), cmmap.size(), 256,
+                      Connector::DENSE_MATRIX));
+    ASSERT_EQ(compressed->GetMatrixSize(), dense->GetMatrixSize());
+    if (i == 1) {
+      ASSERT_NE(1, compressed->GetResolution());
+    }
+
+    const int matrix_size = compressed->GetMatrixSize();
+    const int invalid_cost =
+        Connector::kInvalidCost * compressed->GetResolution();
+    int num_invalid_costs = 0;
+    for (int rid = 0; rid < matrix_size; ++rid) {
+      for (int lid = 0; lid < matrix_size; ++lid) {
+        const int cost = compressed->GetTransitionCost(rid, lid);
+        ASSERT_EQ(cost, dense->GetTransitionCost(rid, lid))
+            << "rid: " << rid << ", lid: " << lid;
+        ASSERT_LE(cost, invalid_cost);
+        if (cost == invalid_cost) {
+          ++num_invalid_costs;
+        }
+      }
+    }
+    EXPECT_LT(0, num_invalid_costs);
+  }
+}
+
+// Looks up all the entries in random order and counts wrong results.
+class LookupThread : public Thread {
+ public:
+  LookupThread(const Connector *connector,
+               const std::vector<ConnectionDataEntry> &data)
+      : connector_(connector), data_(data), num_errors_(0) {}
+
+  void Run() override {
+    std::mt19937 urbg(reinterpret_cast<uintptr_t>(this));
+    std::shuffle(data_.begin(), data_.end(), urbg);
+    for (size_t i = 0; i < data_.size(); ++i) {
+      if (connector_->GetTransitionCost(data_[i].rid, data_[i].lid) !=
+          data_[i].cost) {
+        ++num_errors_;
+      }
+    }
+  }
+
+  int num_errors() const { return num_errors_; }
+
+ private:
+  const Connector *connector_;
+  std::vector<ConnectionDataEntry> data_;
+  int num_errors_;
+};
+
+TEST(ConnectorTest, ConcurrentLookup) {
+  const string path = testing::GetSourceFileOrDie({
+      "data_manager", "testing", "connection.data"});
+  Mmap cmmap;
+  ASSERT_TRUE(cmmap.Open(path.c_str())) << "Failed to open image: " << path;
+  // Small cache so that threads keep overwriting the same slots.
+  std::unique_ptr<Connector> connector(
+      new Connector(cmmap.begin(), cmmap.size(), 64));
+
+  const string connection_text_path = testing::GetSourceFileOrDie({
+      "data_manager", "testing", "connection_single_column.txt"});
+  std::vector<ConnectionDataEntry> data;
+  for (ConnectionFileReader reader(connection_text_path);
+       !reader.done(); reader.Next()) {
+    ConnectionDataEntry entry;
+    entry.rid = reader.rid_of_left_node();
+    entry.lid = reader.lid_of_right_node();
+    entry.cost = reader.cost();
+    data.push_back(entry);
+  }
+
+  const int kNumThreads = 4;
+  std::vector<std::unique_ptr<LookupThread>> threads;
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back(new LookupThread(connector.get(), data));
+  }
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i]->SetJoinable(true);
+    threads[i]->Start("ConnectorTest");
+  }
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i]->Join();
+    EXPECT_EQ(0, threads[i]->num_errors());
+  }
+}
 #endif  // !OS_NACL
 
 }  // namespace
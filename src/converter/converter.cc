@@ -37,6 +37,7 @@
 #include "base/logging.h"
 #include "base/number_util.h"
 #include "base/port.h"
+#include "base/trace.h"
 #include "base/util.h"
 #include "composer/composer.h"
 #include "converter/immutable_converter_interface.h"
@@ -231,6 +232,7 @@ void ConverterImpl::Init(const POSMatcher *pos_matcher,
 
 bool ConverterImpl::StartConversionForRequest(const ConversionRequest &request,
                                               Segments *segments) const {
+  MOZC_TRACE_SCOPE("Converter::StartConversion");
   if (!request.has_composer()) {
     LOG(ERROR) << "Request doesn't have composer";
     return false;
@@ -346,6 +348,7 @@ bool ConverterImpl::Predict(const ConversionRequest &request,
                             const string &key,
                             const Segments::RequestType request_type,
                             Segments *segments) const {
+  MOZC_TRACE_SCOPE("Converter::Predict");
   const Segments::RequestType original_request_type = segments->request_type();
   if ((original_request_type != Segments::PREDICTION &&
        original_request_type != Segments::PARTIAL_PREDICTION) ||
@@ -900,6 +903,7 @@ void ConverterImpl::CompletePOSIds(Segment::Candidate *candidate) const {
 
 void ConverterImpl::RewriteAndSuppressCandidates(
     const ConversionRequest &request, Segments *segments) const {
+  MOZC_TRACE_SCOPE("Converter::Rewrite");
   if (!rewriter_->Rewrite(request, segments)) {
     return;
   }
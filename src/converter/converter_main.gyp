@@ -52,5 +52,17 @@
         'converter_base.gyp:segments',
       ],
     },
+    {
+      'target_name': 'connector_main',
+      'type': 'executable',
+      'sources': [
+        'connector_main.cc',
+      ],
+      'dependencies': [
+        '../base/base.gyp:base',
+        '../data_manager/oss/oss_data_manager.gyp:oss_data_manager',
+        'converter_base.gyp:connector',
+      ],
+    },
   ],
 }
@@ -102,6 +102,7 @@
       ],
       'dependencies': [
         '../data_manager/data_manager.gyp:connection_file_reader',
+        '../data_manager/testing/mock_data_manager.gyp:gen_separate_1byte_connection_data_for_mock#host',
         '../data_manager/testing/mock_data_manager.gyp:gen_separate_connection_data_for_mock#host',
         '../data_manager/testing/mock_data_manager.gyp:mock_data_manager',
         '../data_manager/testing/mock_data_manager_test.gyp:install_test_connection_txt',
@@ -37,10 +37,12 @@
 #include <utility>
 #include <vector>
 
+#include "base/hash.h"
 #include "base/logging.h"
 #include "base/port.h"
 #include "base/stl_util.h"
 #include "base/string_piece.h"
+#include "base/trace.h"
 #include "base/util.h"
 #include "config/config_handler.h"
 #include "converter/connector.h"
@@ -76,6 +78,7 @@ const size_t kMaxCharLengthForReverseConversion = 600;  // 200 chars in UTF8
 const int    kMaxCost                           = 32767;
 const int    kMinCost                           = -32767;
 const int    kDefaultNumberCost                 = 3000;
+const uint64 kHistoryFingerprintSeed            = 0x68697374;  // "hist"
 
 class KeyCorrectedNodeListBuilder : public BaseNodeListBuilder {
  public:
@@ -89,6 +92,14 @@ class KeyCorrectedNodeListBuilder : public BaseNodeListBuilder {
         key_corrector_(key_corrector),
         tail_(NULL) {}
 
+  // Skips the tokens rejected by OnToken() below without decoding their
+  // values, as the check needs only the length of the key.
+  virtual bool ShouldDecodeValue(const Token &token) {
+    const size_t offset =
+        key_corrector_->GetOriginalOffset(pos_, token.key.size());
+    return KeyCorrector::IsValidPosition(offset) && offset != 0;
+  }
+
   virtual ResultType OnToken(StringPiece key, StringPiece actual_key,
                              const Token &token) {
     const size_t offset =
@@ -97,7 +108,8 @@ class KeyCorrectedNodeListBuilder : public BaseNodeListBuilder {
       return TRAVERSE_NEXT_KEY;
     }
     Node *node = NewNodeFromToken(token);
-    node->key.assign(original_lookup_key_.data() + pos_, offset);
+    node->key = allocator_->NewString(
+        StringPiece(original_lookup_key_.data() + pos_, offset));
     node->wcost += KeyCorrector::GetCorrectedCostPenalty(node->key);
 
     // Push back |node| to the end.
@@ -162,8 +174,9 @@ bool ContainsWhiteSpacesOnly(const StringPiece s) {
   return true;
 }
 
-void DecomposeNumberAndSuffix(const string &input,
-                              string *number, string *suffix) {
+// |number| and |suffix| point to |input|.
+void DecomposeNumberAndSuffix(StringPiece input,
+                              StringPiece *number, StringPiece *suffix) {
   const char *begin = input.data();
   const char *end = input.data() + input.size();
   size_t pos = 0;
@@ -175,12 +188,13 @@ void DecomposeNumberAndSuffix(const string &input,
     }
     break;
   }
-  number->assign(input, 0, pos);
-  suffix->assign(input, pos, input.size() - pos);
+  *number = input.substr(0, pos);
+  *suffix = input.substr(pos);
 }
 
-void DecomposePrefixAndNumber(const string &input,
-                              string *prefix, string *number) {
+// |prefix| and |number| point to |input|.
+void DecomposePrefixAndNumber(StringPiece input,
+                              StringPiece *prefix, StringPiece *number) {
   const char *begin = input.data();
   const char *end = input.data() + input.size() - 1;
   size_t pos = input.size();
@@ -192,8 +206,8 @@ void DecomposePrefixAndNumber(const string &input,
     }
     break;
   }
-  prefix->assign(input, 0, pos);
-  number->assign(input, pos, input.size() - pos);
+  *prefix = input.substr(0, pos);
+  *number = input.substr(pos);
 }
 
 void NormalizeHistorySegments(Segments *segments) {
@@ -461,8 +475,10 @@ bool ImmutableConverterImpl::ResegmentArabicNumberAndSuffix(
         pos_matcher_->IsNumber(compound_node->lid) &&
         !pos_matcher_->IsNumber(compound_node->rid) &&
         IsNumber(compound_node->value[0]) && IsNumber(compound_node->key[0])) {
-      string number_value, number_key;
-      string suffix_value, suffix_key;
+      // They point to the strings of |compound_node|, which live as long as
+      // the lattice.
+      StringPiece number_value, number_key;
+      StringPiece suffix_value, suffix_key;
       DecomposeNumberAndSuffix(compound_node->value,
                                &number_value, &suffix_value);
       DecomposeNumberAndSuffix(compound_node->key,
@@ -538,8 +554,10 @@ bool ImmutableConverterImpl::ResegmentPrefixAndArabicNumber(
         !IsNumber(compound_node->key[0]) &&
         IsNumber(compound_node->value[compound_node->value.size() - 1]) &&
         IsNumber(compound_node->key[compound_node->key.size() - 1])) {
-      string number_value, number_key;
-      string prefix_value, prefix_key;
+      // They point to the strings of |compound_node|, which live as long as
+      // the lattice.
+      StringPiece number_value, number_key;
+      StringPiece prefix_value, prefix_key;
       DecomposePrefixAndNumber(compound_node->value,
                                &prefix_value, &number_value);
       DecomposePrefixAndNumber(compound_node->key,
@@ -650,7 +668,8 @@ bool ImmutableConverterImpl::ResegmentPersonalName(
              rnode != NULL; rnode = rnode->bnext) {
           if ((lnode->value.size() + rnode->value.size())
               == compound_node->value.size() &&
-              (lnode->value + rnode->value) == compound_node->value &&
+              compound_node->value.substr(lnode->value.size()) ==
+                  rnode->value &&
               segmenter_->IsBoundary(*lnode, *rnode, false)) {  // Constraint 3.
             const int32 cost = lnode->wcost + GetCost(lnode, rnode);
             if (cost < best_cost) {   // choose the smallest ones
@@ -817,8 +836,8 @@ Node *ImmutableConverterImpl::AddCharacterTypeBasedNodes(
     }
 
     new_node->wcost = kMaxCost;
-    new_node->value.assign(begin, mblen);
-    new_node->key.assign(begin, mblen);
+    new_node->key = lattice->NewString(StringPiece(begin, mblen));
+    new_node->value = new_node->key;
     new_node->node_type = Node::NOR_NODE;
     new_node->bnext = nodes;
     nodes = new_node;
@@ -859,8 +878,8 @@ Node *ImmutableConverterImpl::AddCharacterTypeBasedNodes(
       new_node->rid = unknown_id_;
     }
     new_node->wcost = kMaxCost / 2;
-    new_node->value.assign(begin, mblen);
-    new_node->key.assign(begin, mblen);
+    new_node->key = lattice->NewString(StringPiece(begin, mblen));
+    new_node->value = new_node->key;
     new_node->node_type = Node::NOR_NODE;
     new_node->bnext = nodes;
     nodes = new_node;
@@ -930,6 +949,7 @@ inline void ViterbiInternal(
 
 bool ImmutableConverterImpl::Viterbi(
     const Segments &segments, Lattice *lattice) const {
+  MOZC_TRACE_SCOPE("ImmutableConverter::Viterbi");
   const string &key = lattice->key();
 
   // Process BOS.
@@ -1038,6 +1058,17 @@ bool ImmutableConverterImpl::Viterbi(
   return true;
 }
 
+namespace {
+
+// Returns true if the forward cost of |node| computed by the previous
+// PredictionViterbi() is still valid.  Nodes inserted after that don't have
+// |prev| yet.
+inline bool HasCachedCost(const Node &node, int cost_cache_end_pos) {
+  return node.end_pos <= cost_cache_end_pos && node.prev != NULL;
+}
+
+}  // namespace
+
 // faster Viterbi algorithm for prediction
 //
 // Run simple Viterbi algorithm with contracting the same lid and rid.
@@ -1053,6 +1084,10 @@ bool ImmutableConverterImpl::Viterbi(
 // runs Viterbi for positions between calc_begin_pos and calc_end_pos,
 // inclusive.
 //
+// While the user types, the lattice is extended by Lattice::UpdateKey() and
+// the costs of the nodes ending at or before Lattice::cost_cache_end_pos()
+// are reused, so that only the nodes for the new characters are computed.
+//
 // We cannot apply this function in suggestion because in suggestion there are
 // WEAK_CONNECTED nodes and this function is not designed for them.
 //
@@ -1061,14 +1096,25 @@ bool ImmutableConverterImpl::Viterbi(
 
 bool ImmutableConverterImpl::PredictionViterbi(
     const Segments &segments, Lattice *lattice) const {
+  MOZC_TRACE_SCOPE("ImmutableConverter::PredictionViterbi");
   const size_t key_length = lattice->key().size();
   const size_t history_segments_size = segments.history_segments_size();
   size_t history_length = 0;
   for (size_t i = 0; i < history_segments_size; ++i) {
     history_length += segments.segment(i).key().size();
   }
-  PredictionViterbiInternal(0, history_length, lattice);
-  PredictionViterbiInternal(history_length, key_length, lattice);
+  // The history nodes are inserted every time, so compute them from scratch.
+  PredictionViterbiInternal(0, history_length, 0, lattice);
+
+  // The nodes ending at |key_length| get the suffix penalty, which is removed
+  // when the key is extended.  Thus their costs can't be reused next time.
+  const size_t cacheable_end_pos = key_length > 0 ? key_length - 1 : 0;
+  const size_t cost_cache_end_pos =
+      std::min(lattice->cost_cache_end_pos(), cacheable_end_pos);
+  PredictionViterbiInternal(history_length, key_length,
+                            std::max(cost_cache_end_pos, history_length),
+                            lattice);
+  lattice->set_cost_cache_end_pos(cacheable_end_pos);
 
   Node *node = lattice->eos_nodes();
   CHECK(node->bnext == NULL);
@@ -1088,7 +1134,8 @@ bool ImmutableConverterImpl::PredictionViterbi(
 }
 
 void ImmutableConverterImpl::PredictionViterbiInternal(
-    int calc_begin_pos, int calc_end_pos, Lattice *lattice) const {
+    int calc_begin_pos, int calc_end_pos, int cost_cache_end_pos,
+    Lattice *lattice) const {
   CHECK_LE(calc_begin_pos, calc_end_pos);
 
   // Mapping from lnode's rid to (cost, Node) of best way/cost, and vice versa.
@@ -1104,6 +1151,22 @@ void ImmutableConverterImpl::PredictionViterbiInternal(
   const std::pair<int, Node*> kInvalidValue(INT_MAX, static_cast<Node*>(NULL));
 
   for (size_t pos = calc_begin_pos; pos <= calc_end_pos; ++pos) {
+    // Skip the position if all the nodes starting here have cached costs.
+    if (pos < cost_cache_end_pos) {
+      bool has_uncached_node = false;
+      for (const Node *rnode = lattice->begin_nodes(pos); rnode != NULL;
+           rnode = rnode->bnext) {
+        if (rnode->end_pos <= calc_end_pos &&
+            !HasCachedCost(*rnode, cost_cache_end_pos)) {
+          has_uncached_node = true;
+          break;
+        }
+      }
+      if (!has_uncached_node) {
+        continue;
+      }
+    }
+
     lbest.clear();
     for (Node *lnode = lattice->end_nodes(pos);
          lnode != NULL; lnode = lnode->enext) {
@@ -1127,7 +1190,8 @@ void ImmutableConverterImpl::PredictionViterbiInternal(
     rbest.clear();
     Node *rnode_begin = lattice->begin_nodes(pos);
     for (Node *rnode = rnode_begin; rnode != NULL; rnode = rnode->bnext) {
-      if (rnode->end_pos > calc_end_pos) {
+      if (rnode->end_pos > calc_end_pos ||
+          HasCachedCost(*rnode, cost_cache_end_pos)) {
         continue;
       }
       BestMap::value_type key(rnode->lid, kInvalidValue);
@@ -1156,7 +1220,8 @@ void ImmutableConverterImpl::PredictionViterbiInternal(
     }
 
     for (Node *rnode = rnode_begin; rnode != NULL; rnode = rnode->bnext) {
-      if (rnode->end_pos > calc_end_pos) {
+      if (rnode->end_pos > calc_end_pos ||
+          HasCachedCost(*rnode, cost_cache_end_pos)) {
         continue;
       }
       BestMap::value_type key(rnode->lid, kInvalidValue);
@@ -1299,6 +1364,7 @@ void ImmutableConverterImpl::MakeLatticeNodesForPredictiveNodes(
 bool ImmutableConverterImpl::MakeLattice(
     const ConversionRequest &request,
     Segments *segments, Lattice *lattice) const {
+  MOZC_TRACE_SCOPE("ImmutableConverter::MakeLattice");
   if (segments == NULL) {
     LOG(ERROR) << "Segments is NULL";
     return false;
@@ -1423,6 +1489,28 @@ bool ImmutableConverterImpl::MakeLatticeNodesForHistorySegments(
   const size_t history_segments_size = segments.history_segments_size();
   const string &key = lattice->key();
 
+  // The forward costs cached in the lattice depend on the history nodes, so
+  // discard them when the history is changed.
+  FingerprintBuilder history_fingerprint(kHistoryFingerprintSeed);
+  for (size_t s = 0; s < history_segments_size; ++s) {
+    const Segment &segment = segments.segment(s);
+    if (segment.candidates_size() > 0) {
+      const Segment::Candidate &candidate = segment.candidate(0);
+      const uint32 sizes_and_ids[] = {
+        static_cast<uint32>(candidate.value.size()), candidate.lid,
+        candidate.rid,
+      };
+      history_fingerprint.Append(candidate.value);
+      history_fingerprint.Append(
+          StringPiece(reinterpret_cast<const char *>(sizes_and_ids),
+                      sizeof(sizes_and_ids)));
+    }
+  }
+  if (history_fingerprint.Fingerprint() != lattice->history_fingerprint()) {
+    lattice->set_cost_cache_end_pos(0);
+    lattice->set_history_fingerprint(history_fingerprint.Fingerprint());
+  }
+
   size_t segments_pos = 0;
   uint16 last_rid = 0;
 
@@ -1445,8 +1533,8 @@ bool ImmutableConverterImpl::MakeLatticeNodesForHistorySegments(
     rnode->lid = candidate.lid;
     rnode->rid = candidate.rid;
     rnode->wcost = 0;
-    rnode->value = candidate.value;
-    rnode->key = segment.key();
+    rnode->value = lattice->NewString(candidate.value);
+    rnode->key = lattice->NewString(segment.key());
     rnode->node_type = Node::HIS_NODE;
     rnode->bnext = NULL;
     lattice->Insert(segments_pos, rnode);
@@ -1469,8 +1557,8 @@ bool ImmutableConverterImpl::MakeLatticeNodesForHistorySegments(
       // TODO(team): Figure out a better way to set the cost using
       // boundary.def-like approach.
       rnode2->wcost = 0;
-      rnode2->value = candidate.value;
-      rnode2->key = segment.key();
+      rnode2->value = rnode->value;
+      rnode2->key = rnode->key;
       rnode2->node_type = Node::HIS_NODE;
       rnode2->bnext = NULL;
       lattice->Insert(segments_pos, rnode2);
@@ -1512,11 +1600,9 @@ bool ImmutableConverterImpl::MakeLatticeNodesForHistorySegments(
         CHECK(new_node);
 
         // get the suffix part ("たくや/卓也")
-        new_node->key.assign(compound_node->key, rnode->key.size(),
-                             compound_node->key.size() - rnode->key.size());
-        new_node->value.assign(
-            compound_node->value, rnode->value.size(),
-            compound_node->value.size() - rnode->value.size());
+        // The pieces share the strings of |compound_node|.
+        new_node->key = compound_node->key.substr(rnode->key.size());
+        new_node->value = compound_node->value.substr(rnode->value.size());
 
         // rid/lid are derived from the compound.
         // lid is just an approximation
@@ -1651,8 +1737,8 @@ void ImmutableConverterImpl::Resegment(
       rnode->lid       = candidate.lid;
       rnode->rid       = candidate.rid;
       rnode->wcost     = kMinCost;
-      rnode->value     = candidate.value;
-      rnode->key       = segment.key();
+      rnode->value     = lattice->NewString(candidate.value);
+      rnode->key       = lattice->NewString(segment.key());
       rnode->node_type = Node::CON_NODE;
       rnode->bnext     = NULL;
       lattice->Insert(segments_pos, rnode);
@@ -1798,6 +1884,7 @@ void ImmutableConverterImpl::InsertCandidates(
     size_t max_candidates_size,
     InsertCandidatesType type,
     FilterType filter_type) const {
+  MOZC_TRACE_SCOPE("ImmutableConverter::InsertCandidates");
   // skip HIS_NODE(s)
   Node *prev = lattice.bos_nodes();
   for (Node *node = lattice.bos_nodes()->next;
@@ -1957,6 +2044,7 @@ void ImmutableConverterImpl::MakeGroup(
 
 bool ImmutableConverterImpl::ConvertForRequest(
     const ConversionRequest &request, Segments *segments) const {
+  MOZC_TRACE_SCOPE("ImmutableConverter::Convert");
   const bool is_prediction =
       (segments->request_type() == Segments::PREDICTION ||
        segments->request_type() == Segments::SUGGESTION);
@@ -140,8 +140,11 @@ class ImmutableConverterImpl : public ImmutableConverterInterface {
   bool Viterbi(const Segments &segments, Lattice *lattice) const;
 
   bool PredictionViterbi(const Segments &segments, Lattice *lattice) const;
+  // Nodes ending at or before |cost_cache_end_pos| keep their costs if they
+  // already have them.
   void PredictionViterbiInternal(
-      int calc_begin_pos, int calc_end_pos, Lattice *lattice) const;
+      int calc_begin_pos, int calc_end_pos, int cost_cache_end_pos,
+      Lattice *lattice) const;
 
   // TODO(toshiyuki): Change parameter order for mutable |segments|.
 
@@ -548,4 +548,47 @@ TEST(ImmutableConverterTest, AutoPartialSuggestionForSingleSegment) {
   }
 }
 
+TEST(ImmutableConverterTest, IncrementalSuggestion) {
+  std::unique_ptr<MockDataAndImmutableConverter> data_and_converter(
+      new MockDataAndImmutableConverter);
+  ImmutableConverterImpl *converter = data_and_converter->GetConverter();
+
+  // Type the key character by character with the same Segments, which keeps
+  // the lattice, and compare the results with the ones from scratch.
+  std::vector<string> chars;
+  Util::SplitStringToUtf8Chars("わたしのなまえはなかのです", &chars);
+  Segments segments;
+  string key;
+  for (size_t i = 0; i < chars.size(); ++i) {
+    key.append(chars[i]);
+    segments.clear_conversion_segments();
+    segments.set_request_type(Segments::SUGGESTION);
+    segments.set_max_prediction_candidates_size(10);
+    segments.add_segment()->set_key(key);
+    ASSERT_TRUE(converter->Convert(&segments));
+
+    Segments expected;
+    expected.set_request_type(Segments::SUGGESTION);
+    expected.set_max_prediction_candidates_size(10);
+    expected.add_segment()->set_key(key);
+    ASSERT_TRUE(converter->Convert(&expected));
+
+    const Segment &actual_segment = segments.conversion_segment(0);
+    const Segment &expected_segment = expected.conversion_segment(0);
+    ASSERT_LT(0, expected_segment.candidates_size());
+    ASSERT_EQ(expected_segment.candidates_size(),
+              actual_segment.candidates_size());
+    for (size_t j = 0; j < expected_segment.candidates_size(); ++j) {
+      EXPECT_EQ(expected_segment.candidate(j).value,
+                actual_segment.candidate(j).value) << key;
+      EXPECT_EQ(expected_segment.candidate(j).cost,
+                actual_segment.candidate(j).cost) << key;
+    }
+
+    // The costs up to the previous key are kept for the next key.
+    EXPECT_EQ(key.size() - 1,
+              segments.mutable_cached_lattice()->cost_cache_end_pos());
+  }
+}
+
 }  // namespace mozc
@@ -574,9 +574,10 @@ size_t KeyCorrector::InvalidPosition() {
 }
 
 // static
-int KeyCorrector::GetCorrectedCostPenalty(const string &key) {
+int KeyCorrector::GetCorrectedCostPenalty(StringPiece key) {
   // "んん" and "っっ" must be mis-spelling.
-  if (key.find("んん") != string::npos || key.find("っっ") != string::npos) {
+  if (key.find("んん") != StringPiece::npos ||
+      key.find("っっ") != StringPiece::npos) {
     return 0;
   }
   // add 3000 to the original word cost
@@ -34,6 +34,7 @@
 #include <vector>
 
 #include "base/port.h"
+#include "base/string_piece.h"
 
 namespace mozc {
 
@@ -146,7 +147,7 @@ class KeyCorrector {
 
   // return the cost penalty for the corrected key.
   // The return value is added to the original cost as a penalty.
-  static int GetCorrectedCostPenalty(const string &key);
+  static int GetCorrectedCostPenalty(StringPiece key);
 
   // clear internal data
   void Clear();
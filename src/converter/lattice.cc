@@ -44,6 +44,13 @@
 namespace mozc {
 namespace {
 
+// Returns true if |node| is kept in the lattice by ResetNodeCost().
+bool IsKeptOnReset(const Node *node) {
+  return node->node_type == Node::BOS_NODE ||
+         node->node_type == Node::EOS_NODE ||
+         (node->attributes & Node::ENABLE_CACHE);
+}
+
 Node *InitBOSNode(Lattice *lattice, uint16 length) {
   Node *bos_node = lattice->NewNode();
   DCHECK(bos_node);
@@ -142,7 +149,9 @@ struct LatticeDisplayNodeInfo {
   string display_node_str_;
 };
 
-Lattice::Lattice() : history_end_pos_(0), node_allocator_(new NodeAllocator) {}
+Lattice::Lattice()
+    : history_end_pos_(0), history_fingerprint_(0), cost_cache_end_pos_(0),
+      node_allocator_(new NodeAllocator) {}
 
 Lattice::~Lattice() {}
 
@@ -154,6 +163,10 @@ Node *Lattice::NewNode() {
   return node_allocator_->NewNode();
 }
 
+StringPiece Lattice::NewString(StringPiece str) {
+  return node_allocator_->NewString(str);
+}
+
 Node *Lattice::begin_nodes(size_t pos) const {
   return begin_nodes_[pos];
 }
@@ -229,6 +242,8 @@ void Lattice::Clear() {
   node_allocator_->Free();
   cache_info_.clear();
   history_end_pos_ = 0;
+  history_fingerprint_ = 0;
+  cost_cache_end_pos_ = 0;
 }
 
 void Lattice::SetDebugDisplayNode(size_t begin_pos, size_t end_pos,
@@ -252,6 +267,22 @@ size_t Lattice::history_end_pos() const {
   return history_end_pos_;
 }
 
+void Lattice::set_history_fingerprint(uint64 fingerprint) {
+  history_fingerprint_ = fingerprint;
+}
+
+uint64 Lattice::history_fingerprint() const {
+  return history_fingerprint_;
+}
+
+size_t Lattice::cost_cache_end_pos() const {
+  return cost_cache_end_pos_;
+}
+
+void Lattice::set_cost_cache_end_pos(size_t pos) {
+  cost_cache_end_pos_ = pos;
+}
+
 void Lattice::UpdateKey(const string &new_key) {
   const string old_key = key_;
   const string common_prefix = GetCommonPrefix(new_key, old_key);
@@ -291,8 +322,10 @@ void Lattice::AddSuffix(const string &suffix_key) {
   std::fill(end_nodes_.begin() + old_size + 1, end_nodes_.end(),
             static_cast<Node *>(NULL));
 
-  end_nodes_[0] = InitBOSNode(this,
-                              static_cast<uint16>(0));
+  // Keep the BOS node, to which the cached paths are connected.
+  if (end_nodes_[0] == NULL) {
+    end_nodes_[0] = InitBOSNode(this, static_cast<uint16>(0));
+  }
   begin_nodes_[new_size] =
       InitEOSNode(this, static_cast<uint16>(new_size));
 
@@ -347,6 +380,7 @@ void Lattice::ShrinkKey(const size_t new_len) {
     cache_info_[i] = std::min(cache_info_[i], new_len - i);
   }
   std::fill(cache_info_.begin() + new_len, cache_info_.end(), 0);
+  cost_cache_end_pos_ = std::min(cost_cache_end_pos_, new_len);
 
   // update key
   key_.erase(new_len);
@@ -363,60 +397,39 @@ void Lattice::SetCacheInfo(const size_t pos, const size_t len) {
 }
 
 void Lattice::ResetNodeCost() {
+  // Erase the nodes without ENABLE_CACHE attribute, e.g., the history nodes,
+  // from the lattice.
   for (size_t i = 0; i <= key_.size(); ++i) {
-    if (begin_nodes_[i] != NULL) {
-      Node *prev = NULL;
-      for (Node *node = begin_nodes_[i]; node != NULL; node = node->bnext) {
-        // do not process BOS / EOS nodes
-        if (node->node_type == Node::BOS_NODE ||
-            node->node_type == Node::EOS_NODE) {
-          continue;
-        }
-        // if the node has ENABLE_CACHE attribute, then revert its wcost.
-        // Otherwise, erase the node from the lattice.
-        if (node->attributes & Node::ENABLE_CACHE) {
-          node->wcost = node->raw_wcost;
-        } else {
-          if (node == begin_nodes_[i]) {
-            if (node->bnext == NULL) {
-              begin_nodes_[i] = NULL;
-            } else {
-              begin_nodes_[i] = node->bnext;
-            }
-          } else {
-            CHECK(prev);
-            CHECK_EQ(prev->bnext, node);
-            prev->next = node->bnext;
-          }
-        }
-        // traverse a next node
-        prev = node;
+    for (Node **link = &begin_nodes_[i]; *link != NULL;) {
+      if (IsKeptOnReset(*link)) {
+        link = &(*link)->bnext;
+      } else {
+        *link = (*link)->bnext;
       }
     }
+    for (Node **link = &end_nodes_[i]; *link != NULL;) {
+      if (IsKeptOnReset(*link)) {
+        link = &(*link)->enext;
+      } else {
+        *link = (*link)->enext;
+      }
+    }
+  }
 
-    if (end_nodes_[i] != NULL) {
-      Node *prev = NULL;
-      for (Node *node = end_nodes_[i]; node != NULL; node = node->enext) {
-        if (node->node_type == Node::BOS_NODE ||
-            node->node_type == Node::EOS_NODE) {
-          continue;
-        }
-        if (node->attributes & Node::ENABLE_CACHE) {
-          node->wcost = node->raw_wcost;
-        } else {
-          if (node == end_nodes_[i]) {
-            if (node->enext == NULL) {
-              end_nodes_[i] = NULL;
-            } else {
-              end_nodes_[i] = node->enext;
-            }
-          } else {
-            CHECK(prev);
-            CHECK_EQ(prev->enext, node);
-            prev->next = node->enext;
-          }
-        }
-        prev = node;
+  for (size_t i = 0; i <= key_.size(); ++i) {
+    for (Node *node = begin_nodes_[i]; node != NULL; node = node->bnext) {
+      // do not process BOS / EOS nodes
+      if (node->node_type == Node::BOS_NODE ||
+          node->node_type == Node::EOS_NODE) {
+        continue;
+      }
+      // Revert the wcost of the cached node.
+      node->wcost = node->raw_wcost;
+      // The best path to the node may go through an erased node.  Drop it
+      // so that the erased node is never reached, and the forward cost of
+      // the node is computed again.
+      if (node->prev != NULL && !IsKeptOnReset(node->prev)) {
+        node->prev = NULL;
       }
     }
   }
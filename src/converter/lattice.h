@@ -60,9 +60,27 @@ class Lattice {
 
   size_t history_end_pos() const;
 
+  // Set the fingerprint of the history segments the lattice was built for.
+  void set_history_fingerprint(uint64 fingerprint);
+
+  uint64 history_fingerprint() const;
+
+  // The forward Viterbi costs (|cost| and |prev|) of the nodes ending at or
+  // before this position are kept from the previous conversion and are still
+  // valid, so that PredictionViterbi() only needs to compute the nodes added
+  // after the position.  0 means no cost is reusable.  SetKey() and Clear()
+  // reset it and ShrinkKey() shortens it.
+  size_t cost_cache_end_pos() const;
+
+  void set_cost_cache_end_pos(size_t pos);
+
   // allocate new node.
   Node *NewNode();
 
+  // Copies |str| into the string arena of the node allocator.  The copy is
+  // valid until the nodes are freed.  Use this for the strings of nodes.
+  StringPiece NewString(StringPiece str);
+
   // return nodes (linked list) starting with |pos|.
   // To traverse all nodes, use Node::bnext member.
   Node *begin_nodes(size_t pos) const;
@@ -122,6 +140,8 @@ class Lattice {
   // TODO(team): Splitting the cache module may make this module simpler.
   string key_;
   size_t history_end_pos_;
+  uint64 history_fingerprint_;
+  size_t cost_cache_end_pos_;
   std::vector<Node *> begin_nodes_;
   std::vector<Node *> end_nodes_;
   std::unique_ptr<NodeAllocator> node_allocator_;
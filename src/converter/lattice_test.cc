@@ -118,7 +118,7 @@ void InsertNodes(Lattice *lattice) {
   const size_t key_size = lattice->key().size();
   for (size_t i = 0; i < key_size; ++i) {
     Node *node = lattice->NewNode();
-    node->key.assign(lattice->key(), i, key_size - i);
+    node->key = lattice->NewString(StringPiece(lattice->key()).substr(i));
     lattice->Insert(i, node);
   }
 }
@@ -174,6 +174,75 @@ TEST(LatticeTest, AddSuffixTest) {
   }
 }
 
+TEST(LatticeTest, CostCacheEndPosTest) {
+  Lattice lattice;
+  lattice.SetKey("test");
+  EXPECT_EQ(0, lattice.cost_cache_end_pos());
+
+  // AddSuffix() keeps the costs and the BOS node the cached paths reach.
+  const Node *bos_node = lattice.bos_nodes();
+  lattice.set_cost_cache_end_pos(3);
+  lattice.AddSuffix("ing");
+  EXPECT_EQ(3, lattice.cost_cache_end_pos());
+  EXPECT_EQ(bos_node, lattice.bos_nodes());
+
+  // ShrinkKey() drops the costs beyond the new key.
+  lattice.set_cost_cache_end_pos(6);
+  lattice.ShrinkKey(5);
+  EXPECT_EQ(5, lattice.cost_cache_end_pos());
+  lattice.ShrinkKey(2);
+  EXPECT_EQ(2, lattice.cost_cache_end_pos());
+
+  // UpdateKey() with a short common prefix rebuilds the lattice.
+  lattice.UpdateKey("xyz");
+  EXPECT_EQ(0, lattice.cost_cache_end_pos());
+
+  lattice.set_cost_cache_end_pos(2);
+  lattice.Clear();
+  EXPECT_EQ(0, lattice.cost_cache_end_pos());
+}
+
+TEST(LatticeTest, ResetNodeCostTest) {
+  Lattice lattice;
+  lattice.SetKey("test");
+
+  // A history node "te" followed by a cached node "st".
+  Node *history_node = lattice.NewNode();
+  history_node->key = "te";
+  history_node->node_type = Node::HIS_NODE;
+  lattice.Insert(0, history_node);
+
+  Node *cached_node = lattice.NewNode();
+  cached_node->key = "st";
+  cached_node->attributes |= Node::ENABLE_CACHE;
+  cached_node->raw_wcost = 100;
+  cached_node->wcost = 200;
+  lattice.Insert(2, cached_node);
+
+  Node *cached_bos_node = lattice.NewNode();
+  cached_bos_node->key = "t";
+  cached_bos_node->attributes |= Node::ENABLE_CACHE;
+  lattice.Insert(0, cached_bos_node);
+
+  history_node->prev = lattice.bos_nodes();
+  cached_node->prev = history_node;
+  cached_bos_node->prev = lattice.bos_nodes();
+
+  lattice.ResetNodeCost();
+
+  // The history node is erased from both the lists.
+  EXPECT_EQ(cached_bos_node, lattice.begin_nodes(0));
+  EXPECT_EQ(nullptr, cached_bos_node->bnext);
+  EXPECT_EQ(nullptr, lattice.end_nodes(2));
+  EXPECT_EQ(cached_node, lattice.begin_nodes(2));
+  EXPECT_EQ(cached_node, lattice.end_nodes(4));
+  EXPECT_EQ(100, cached_node->wcost);
+
+  // The retained nodes never point to the erased node.
+  EXPECT_EQ(nullptr, cached_node->prev);
+  EXPECT_EQ(lattice.bos_nodes(), cached_bos_node->prev);
+}
+
 TEST(LatticeTest, ShrinkKeyTest) {
   Lattice lattice;
 
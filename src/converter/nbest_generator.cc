@@ -193,13 +193,13 @@ void NBestGenerator::MakeCandidate(
     const Node *node = nodes[i];
     DCHECK(node != NULL);
     if (!is_functional && !pos_matcher_->IsFunctional(node->lid)) {
-      candidate->content_value += node->value;
-      candidate->content_key += node->key;
+      node->value.AppendToString(&candidate->content_value);
+      node->key.AppendToString(&candidate->content_key);
     } else {
       is_functional = true;
     }
-    candidate->key += node->key;
-    candidate->value += node->value;
+    node->key.AppendToString(&candidate->key);
+    node->value.AppendToString(&candidate->value);
 
     if (node->constrained_prev != NULL ||
         (node->next != NULL && node->next->constrained_prev == node)) {
@@ -352,6 +352,13 @@ bool NBestGenerator::Next(const string &original_key,
       }
       CHECK(!nodes_.empty());
 
+      // Skip building the candidate strings if the path is rejected anyway.
+      if (filter_->FilterNodes(nodes_, request_type) ==
+          CandidateFilter::BAD_CANDIDATE) {
+        nodes_.clear();
+        continue;
+      }
+
       MakeCandidate(candidate, top->gx, top->structure_gx, top->w_gx, nodes_);
       const int filter_result = filter_->FilterCandidate(original_key,
                                                          candidate,
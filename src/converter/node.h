@@ -30,13 +30,20 @@
 #ifndef MOZC_CONVERTER_NODE_H_
 #define MOZC_CONVERTER_NODE_H_
 
-#include <string>
-
 #include "base/port.h"
+#include "base/string_piece.h"
 #include "dictionary/dictionary_token.h"
 
 namespace mozc {
 
+// A node of the conversion lattice.
+//
+// Node doesn't own its strings: |key|, |actual_key| and |value| point to the
+// string arena of the NodeAllocator that allocated the node (see
+// NodeAllocator::NewString()) or to string literals.  Thus Node is trivially
+// copyable and destructible, and creating one never allocates.  The members
+// read by Viterbi (links, ids, positions and costs) precede the strings so
+// that they stay close together.
 struct Node {
   enum NodeType {
     NOR_NODE,  // normal node
@@ -175,9 +182,10 @@ struct Node {
   // actual_key: The actual search key that corresponds to the value.
   //           Can differ from key when no modifier conversion is enabled.
   // value: The surface form of the word.
-  string key;
-  string actual_key;
-  string value;
+  // They must outlive the node; never assign a temporary string here.
+  StringPiece key;
+  StringPiece actual_key;
+  StringPiece value;
 
   Node() {
     Init();
@@ -203,6 +211,9 @@ struct Node {
     value.clear();
   }
 
+  // Initializes the members except for the strings from |token|.  Since the
+  // strings of |token| are usually transient, the caller needs to copy them
+  // with NodeAllocator::NewString().
   inline void InitFromToken(const dictionary::Token &token) {
     prev = nullptr;
     next = nullptr;
@@ -225,9 +236,9 @@ struct Node {
       attributes |= USER_DICTIONARY;
       attributes |= NO_VARIANTS_EXPANSION;
     }
-    key = token.key;
+    key.clear();
     actual_key.clear();
-    value = token.value;
+    value.clear();
   }
 };
 
@@ -30,17 +30,30 @@
 #ifndef MOZC_CONVERTER_NODE_ALLOCATOR_H_
 #define MOZC_CONVERTER_NODE_ALLOCATOR_H_
 
+#include <cstring>
+#include <memory>
+#include <vector>
+
 #include "base/freelist.h"
 #include "base/logging.h"
 #include "base/port.h"
+#include "base/string_piece.h"
 #include "converter/node.h"
 
 namespace mozc {
 
+// Allocates nodes and their strings.  Both are released at once by Free().
+// The memory used by a conversion is kept for the next one, up to
+// max_nodes_size() nodes and kMaxRetainedStringChunks string chunks so that
+// steady-state typing doesn't call malloc for the lattice.
 class NodeAllocator {
  public:
-  NodeAllocator() : node_freelist_(1024), max_nodes_size_(8192),
-                    node_count_(0) {}
+  NodeAllocator() : node_freelist_(kNodeChunkSize),
+                    string_freelist_(kStringChunkSize),
+                    max_nodes_size_(8192), node_count_(0) {
+    node_freelist_.set_max_retained_chunks(GetNodeChunks(max_nodes_size_));
+    string_freelist_.set_max_retained_chunks(kMaxRetainedStringChunks);
+  }
   ~NodeAllocator() {}
 
   Node *NewNode() {
@@ -51,9 +64,28 @@ class NodeAllocator {
     return node;
   }
 
-  // Frees all nodes allocateed by NewNode().
+  // Copies |str| into the string arena and returns the copy, which is valid
+  // until Free() is called.
+  StringPiece NewString(StringPiece str) {
+    if (str.empty()) {
+      return StringPiece();
+    }
+    char *buffer = nullptr;
+    if (str.size() < kStringChunkSize) {
+      buffer = string_freelist_.Alloc(str.size());
+    } else {
+      large_strings_.emplace_back(new char[str.size()]);
+      buffer = large_strings_.back().get();
+    }
+    memcpy(buffer, str.data(), str.size());
+    return StringPiece(buffer, str.size());
+  }
+
+  // Frees all nodes allocateed by NewNode() and strings by NewString().
   void Free() {
     node_freelist_.Free();
+    string_freelist_.Free();
+    large_strings_.clear();
     node_count_ = 0;
   }
 
@@ -63,14 +95,37 @@ class NodeAllocator {
 
   void set_max_nodes_size(size_t max_nodes_size) {
     max_nodes_size_ = max_nodes_size;
+    node_freelist_.set_max_retained_chunks(GetNodeChunks(max_nodes_size_));
   }
 
   size_t node_count() const {
     return node_count_;
   }
 
+  // Bytes held for nodes and strings, including the ones in use.
+  size_t retained_bytes() const {
+    return node_freelist_.retained_bytes() + string_freelist_.retained_bytes();
+  }
+
+  // The number of chunk allocations avoided by reusing retained memory.
+  uint64 allocations_avoided() const {
+    return node_freelist_.reused_chunks() + string_freelist_.reused_chunks();
+  }
+
  private:
+  static const size_t kNodeChunkSize = 1024;
+  static const size_t kStringChunkSize = 16 * 1024;
+  static const size_t kMaxRetainedStringChunks = 16;
+
+  // Alloc() may skip the tail of a chunk, hence one more chunk.
+  static size_t GetNodeChunks(size_t nodes_size) {
+    return nodes_size / kNodeChunkSize + 1;
+  }
+
   FreeList<Node> node_freelist_;
+  FreeList<char> string_freelist_;
+  // Strings longer than a chunk of |string_freelist_|.
+  std::vector<std::unique_ptr<char[]>> large_strings_;
   size_t max_nodes_size_;
   size_t node_count_;
 
@@ -40,6 +40,14 @@ namespace mozc {
 namespace {
 const size_t kMaxHistorySize = 32;
 const size_t kMaxConversionCandidatesSize = 200;
+
+// Chunk sizes of the object pools and the number of chunks kept across
+// Clear() so that steady-state conversions reuse the same objects.
+const size_t kCandidatePoolChunkSize = 16;
+const size_t kMaxRetainedCandidateChunks =
+    kMaxConversionCandidatesSize / kCandidatePoolChunkSize + 1;
+const size_t kSegmentPoolChunkSize = 32;
+const size_t kMaxRetainedSegmentChunks = 2;
 }
 
 StringPiece Segment::Candidate::functional_key() const {
@@ -204,9 +212,7 @@ StringPiece Segment::Candidate::InnerSegmentIterator::GetContentValue() const {
   return StringPiece(value_offset_, encoded_lengths & 0xff);
 }
 
-Segment::Segment()
-    : segment_type_(FREE),
-      pool_(new ObjectPool<Candidate>(16)) {}
+Segment::Segment() : segment_type_(FREE) {}
 
 Segment::~Segment() {}
 
@@ -238,10 +244,15 @@ const Segment::Candidate &Segment::candidate(int i) const {
 Segment::Candidate *Segment::mutable_candidate(int i) {
   if (i < 0) {
     const size_t meta_index = -i-1;
-    DCHECK_LT(meta_index, meta_candidates_.size());
-    return &meta_candidates_[meta_index];
+    DCHECK_LT(meta_index, meta_candidates_size());
+    return &(*mutable_meta_candidates())[meta_index];
   }
   DCHECK_LT(i, candidates_.size());
+  if (IsShared(candidates_[i])) {
+    Candidate *candidate = AllocCandidate();
+    candidate->CopyFrom(*candidates_[i]);
+    candidates_[i] = candidate;
+  }
   return candidates_[i];
 }
 
@@ -256,8 +267,8 @@ int Segment::indexOf(const Segment::Candidate *candidate) {
     }
   }
 
-  for (int i = 0; i < static_cast<int>(meta_candidates_.size()); ++i) {
-    if (&(meta_candidates_[i]) == candidate) {
+  for (int i = 0; i < static_cast<int>(meta_candidates_size()); ++i) {
+    if (&meta_candidate(i) == candidate) {
       return -i-1;
     }
   }
@@ -270,20 +281,21 @@ size_t Segment::candidates_size() const {
 }
 
 void Segment::clear_candidates() {
-  pool_->Free();
+  if (pool_) {
+    pool_->Free();
+  }
+  shared_pools_.clear();
   candidates_.clear();
 }
 
 Segment::Candidate *Segment::push_back_candidate() {
-  Candidate *candidate = pool_->Alloc();
-  candidate->Init();
+  Candidate *candidate = AllocCandidate();
   candidates_.push_back(candidate);
   return candidate;
 }
 
 Segment::Candidate *Segment::push_front_candidate() {
-  Candidate *candidate = pool_->Alloc();
-  candidate->Init();
+  Candidate *candidate = AllocCandidate();
   candidates_.push_front(candidate);
   return candidate;
 }
@@ -303,24 +315,21 @@ Segment::Candidate *Segment::insert_candidate(int i) {
                 << i << " / " << candidates_.size();
     i = static_cast<int>(candidates_.size());
   }
-  Candidate *candidate = pool_->Alloc();
-  candidate->Init();
+  Candidate *candidate = AllocCandidate();
   candidates_.insert(candidates_.begin() + i, candidate);
   return candidate;
 }
 
 void Segment::pop_front_candidate() {
   if (!candidates_.empty()) {
-    Candidate *c = candidates_.front();
-    pool_->Release(c);
+    ReleaseCandidate(candidates_.front());
     candidates_.pop_front();
   }
 }
 
 void Segment::pop_back_candidate() {
   if (!candidates_.empty()) {
-    Candidate *c = candidates_.back();
-    pool_->Release(c);
+    ReleaseCandidate(candidates_.back());
     candidates_.pop_back();
   }
 }
@@ -330,7 +339,7 @@ void Segment::erase_candidate(int i) {
     LOG(WARNING) << "invalid index";
     return;
   }
-  pool_->Release(mutable_candidate(i));
+  ReleaseCandidate(candidates_[i]);
   candidates_.erase(candidates_.begin() + i);
 }
 
@@ -343,49 +352,64 @@ void Segment::erase_candidates(int i, size_t size) {
     return;
   }
   for (int j = i; j < static_cast<int>(end); ++j) {
-    pool_->Release(mutable_candidate(j));
+    ReleaseCandidate(candidates_[j]);
   }
   candidates_.erase(candidates_.begin() + i,
                     candidates_.begin() + end);
 }
 
 size_t Segment::meta_candidates_size() const {
-  return meta_candidates_.size();
+  return meta_candidates_ ? meta_candidates_->size() : 0;
 }
 
 void Segment::clear_meta_candidates() {
-  meta_candidates_.clear();
+  if (meta_candidates_.use_count() == 1) {
+    meta_candidates_->clear();
+  } else {
+    meta_candidates_.reset();
+  }
 }
 
 const std::vector<Segment::Candidate> &Segment::meta_candidates() const {
-  return meta_candidates_;
+  if (!meta_candidates_) {
+    static const std::vector<Candidate> *kEmptyCandidates =
+        new std::vector<Candidate>;
+    return *kEmptyCandidates;
+  }
+  return *meta_candidates_;
 }
 
 std::vector<Segment::Candidate> *Segment::mutable_meta_candidates() {
-  return &meta_candidates_;
+  if (!meta_candidates_) {
+    meta_candidates_ = std::make_shared<std::vector<Candidate>>();
+  } else if (meta_candidates_.use_count() > 1) {
+    meta_candidates_ =
+        std::make_shared<std::vector<Candidate>>(*meta_candidates_);
+  }
+  return meta_candidates_.get();
 }
 
 const Segment::Candidate &Segment::meta_candidate(size_t i) const {
-  if (i >= meta_candidates_.size()) {
+  if (i >= meta_candidates_size()) {
     LOG(ERROR) << "Invalid index number of meta_candidate: " << i;
     i = 0;
   }
-  return meta_candidates_[i];
+  return meta_candidates()[i];
 }
 
 Segment::Candidate *Segment::mutable_meta_candidate(size_t i) {
-  if (i >= meta_candidates_.size()) {
+  if (i >= meta_candidates_size()) {
     LOG(ERROR) << "Invalid index number of meta_candidate: " << i;
     i = 0;
   }
-  return &meta_candidates_[i];
+  return &(*mutable_meta_candidates())[i];
 }
 
 Segment::Candidate *Segment::add_meta_candidate() {
-  Candidate candidate;
-  candidate.Init();
-  meta_candidates_.push_back(candidate);
-  return &meta_candidates_[meta_candidates_size()-1];
+  std::vector<Candidate> *meta_candidates = mutable_meta_candidates();
+  meta_candidates->push_back(Candidate());
+  meta_candidates->back().Init();
+  return &meta_candidates->back();
 }
 
 void Segment::move_candidate(int old_idx, int new_idx) {
@@ -394,7 +418,7 @@ void Segment::move_candidate(int old_idx, int new_idx) {
     const int meta_idx = -old_idx-1;
     DCHECK_LT(meta_idx, meta_candidates_size());
     Candidate *c = insert_candidate(new_idx);
-    *c = meta_candidates_[meta_idx];
+    *c = meta_candidate(meta_idx);
     return;
   }
 
@@ -422,7 +446,7 @@ void Segment::move_candidate(int old_idx, int new_idx) {
 void Segment::Clear() {
   clear_candidates();
   key_.clear();
-  meta_candidates_.clear();
+  clear_meta_candidates();
   segment_type_ = FREE;
 }
 
@@ -443,6 +467,49 @@ void Segment::CopyFrom(const Segment &src) {
   }
 }
 
+void Segment::ShareFrom(const Segment &src) {
+  if (&src == this) {
+    return;
+  }
+  Clear();
+
+  key_ = src.key();
+  segment_type_ = src.segment_type();
+
+  src.FreezePool();
+  shared_pools_ = src.shared_pools_;
+  candidates_ = src.candidates_;
+  meta_candidates_ = src.meta_candidates_;
+}
+
+bool Segment::IsShared(const Candidate *candidate) const {
+  return !shared_pools_.empty() && (!pool_ || !pool_->Contains(candidate));
+}
+
+void Segment::ReleaseCandidate(Candidate *candidate) {
+  if (!IsShared(candidate)) {
+    pool_->Release(candidate);
+  }
+}
+
+void Segment::FreezePool() const {
+  if (candidates_.empty() || !pool_) {
+    return;
+  }
+  shared_pools_.push_back(std::shared_ptr<ObjectPool<Candidate>>(
+      pool_.release()));
+}
+
+Segment::Candidate *Segment::AllocCandidate() {
+  if (!pool_) {
+    pool_.reset(new ObjectPool<Candidate>(kCandidatePoolChunkSize));
+    pool_->set_max_retained_chunks(kMaxRetainedCandidateChunks);
+  }
+  Candidate *candidate = pool_->Alloc();
+  candidate->Init();
+  return candidate;
+}
+
 string Segment::DebugString() const {
   std::stringstream os;
   os << "[segtype=" << segment_type() << " key=" << key() << std::endl;
@@ -475,8 +542,10 @@ Segments::Segments()
     resized_(false),
     user_history_enabled_(true),
     request_type_(Segments::CONVERSION),
-    pool_(new ObjectPool<Segment>(32)),
-    cached_lattice_(new Lattice()) {}
+    pool_(new ObjectPool<Segment>(kSegmentPoolChunkSize)),
+    cached_lattice_(new Lattice()) {
+  pool_->set_max_retained_chunks(kMaxRetainedSegmentChunks);
+}
 
 Segments::~Segments() {}
 
@@ -627,6 +696,26 @@ void Segments::CopyFrom(const Segments &src) {
   }
 }
 
+void Segments::ShareFrom(const Segments &src) {
+  if (&src == this) {
+    return;
+  }
+  Clear();
+  max_history_segments_size_ = src.max_history_segments_size();
+  max_prediction_candidates_size_ = src.max_prediction_candidates_size();
+  max_conversion_candidates_size_ = src.max_conversion_candidates_size();
+  resized_ = src.resized();
+  user_history_enabled_ = src.user_history_enabled();
+
+  request_type_ = src.request_type();
+
+  for (size_t i = 0; i < src.segments_size(); ++i) {
+    add_segment()->ShareFrom(src.segment(i));
+  }
+
+  revert_entries_ = src.revert_entries_;
+}
+
 void Segments::clear_segments() {
   pool_->Free();
   resized_ = false;
@@ -340,6 +340,15 @@ class Segment {
   void Clear();
   void CopyFrom(const Segment &src);
 
+  // Same as CopyFrom() but the candidates are shared with |src| instead of
+  // being copied.  A shared candidate is copied when mutable_candidate() is
+  // called for it on either segment, so the copy costs O(candidates_size())
+  // pointer copies and each segment pays only for the candidates it modifies.
+  // The meta candidates are shared in the same way, but copied all together.
+  // Note that pointers to the candidates obtained before the call must not be
+  // used to modify them afterwards.
+  void ShareFrom(const Segment &src);
+
   // Keep clear() method as other modules are still using the old method
   void clear() { Clear(); }
 
@@ -356,8 +365,20 @@ class Segment {
   // You should detect that by using both Composer and Segments.
   string key_;
   std::deque<Candidate *> candidates_;
-  std::vector<Candidate>  meta_candidates_;
-  std::unique_ptr<ObjectPool<Candidate>> pool_;
+  // Shared by ShareFrom() and copied on write as a whole.  NULL if empty.
+  std::shared_ptr<std::vector<Candidate>> meta_candidates_;
+  // Allocated on demand.  The pool is frozen into |shared_pools_| by
+  // ShareFrom(), which is why these are mutable.  The candidates which are
+  // not allocated from |pool_| belong to |shared_pools_| and are never
+  // modified in place.
+  mutable std::unique_ptr<ObjectPool<Candidate>> pool_;
+  mutable std::vector<std::shared_ptr<ObjectPool<Candidate>>> shared_pools_;
+
+  Candidate *AllocCandidate();
+  bool IsShared(const Candidate *candidate) const;
+  void ReleaseCandidate(Candidate *candidate);
+  void FreezePool() const;
+
   DISALLOW_COPY_AND_ASSIGN(Segment);
 };
 
@@ -474,6 +495,10 @@ class Segments {
   // Copy segments from src
   void CopyFrom(const Segments &src);
 
+  // Copy segments from src sharing their candidates.  See
+  // Segment::ShareFrom().
+  void ShareFrom(const Segments &src);
+
   // Dump Segments structure
   string DebugString() const;
 
@@ -541,6 +541,85 @@ TEST(SegmentTest, CopyFrom) {
   EXPECT_EQ(src.meta_candidate(0).key, dest.meta_candidate(0).key);
 }
 
+TEST(SegmentTest, ShareFrom) {
+  Segment src, dest;
+
+  src.set_key("key");
+  src.set_segment_type(Segment::FIXED_VALUE);
+  const int kCandidatesSize = 40;
+  for (int i = 0; i < kCandidatesSize; ++i) {
+    src.add_candidate()->value = "value" + std::to_string(i);
+  }
+  src.add_meta_candidate()->value = "meta";
+
+  dest.ShareFrom(src);
+  EXPECT_EQ(src.key(), dest.key());
+  EXPECT_EQ(src.segment_type(), dest.segment_type());
+  ASSERT_EQ(kCandidatesSize, dest.candidates_size());
+  for (int i = 0; i < kCandidatesSize; ++i) {
+    EXPECT_EQ(&src.candidate(i), &dest.candidate(i));
+  }
+  EXPECT_EQ("meta", dest.meta_candidate(0).value);
+
+  // A candidate is copied when it is modified on either side.
+  dest.mutable_candidate(0)->value = "dest0";
+  src.mutable_candidate(1)->value = "src1";
+  EXPECT_EQ("value0", src.candidate(0).value);
+  EXPECT_EQ("dest0", dest.candidate(0).value);
+  EXPECT_EQ("src1", src.candidate(1).value);
+  EXPECT_EQ("value1", dest.candidate(1).value);
+  EXPECT_NE(&src.candidate(0), &dest.candidate(0));
+  EXPECT_NE(&src.candidate(1), &dest.candidate(1));
+  EXPECT_EQ(&src.candidate(2), &dest.candidate(2));
+
+  // The copied candidate is modified in place from then on.
+  Segment::Candidate *candidate = dest.mutable_candidate(0);
+  EXPECT_EQ(candidate, dest.mutable_candidate(0));
+
+  // Erasing and adding candidates don't affect the other segment.
+  dest.erase_candidates(0, 10);
+  dest.pop_back_candidate();
+  dest.add_candidate()->value = "new";
+  dest.move_candidate(dest.candidates_size() - 1, 0);
+  EXPECT_EQ("new", dest.candidate(0).value);
+  ASSERT_EQ(kCandidatesSize, src.candidates_size());
+  for (int i = 2; i < kCandidatesSize; ++i) {
+    EXPECT_EQ("value" + std::to_string(i), src.candidate(i).value);
+  }
+
+  // A segment shared twice keeps its contents.
+  Segment dest2;
+  dest2.ShareFrom(dest);
+  dest.Clear();
+  EXPECT_EQ("new", dest2.candidate(0).value);
+  EXPECT_EQ("value10", dest2.candidate(1).value);
+}
+
+TEST(SegmentsTest, ShareFrom) {
+  Segments src, dest;
+  src.set_max_history_segments_size(5);
+  Segment *segment = src.add_segment();
+  segment->set_key("key0");
+  segment->add_candidate()->value = "value0";
+  segment = src.add_segment();
+  segment->set_key("key1");
+  segment->add_candidate()->value = "value1";
+  src.push_back_revert_entry()->key = "revert";
+
+  dest.ShareFrom(src);
+  EXPECT_EQ(5, dest.max_history_segments_size());
+  ASSERT_EQ(2, dest.segments_size());
+  EXPECT_EQ("key1", dest.segment(1).key());
+  EXPECT_EQ("value1", dest.segment(1).candidate(0).value);
+  ASSERT_EQ(1, dest.revert_entries_size());
+  EXPECT_EQ("revert", dest.revert_entry(0).key);
+
+  dest.mutable_segment(0)->mutable_candidate(0)->value = "dest0";
+  src.clear_segments();
+  EXPECT_EQ("dest0", dest.segment(0).candidate(0).value);
+  EXPECT_EQ("value1", dest.segment(1).candidate(0).value);
+}
+
 TEST(SegmentTest, MetaCandidateTest) {
   Segment segment;
 
@@ -41,7 +41,7 @@ namespace mozc {
 namespace {
 
 bool IsValidAlignment(int a) {
-  return a == 8 || a == 16 || a == 32 || a == 64;
+  return a == 8 || a == 16 || a == 32 || a == 64 || a == 512;
 }
 
 }  // namespace
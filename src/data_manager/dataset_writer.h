@@ -48,7 +48,7 @@ class DataSetWriter {
   ~DataSetWriter();
 
   // Adds a binary image to the packed file so that data is aligned at the
-  // specified bit boundary (8, 16, 32, or 64).
+  // specified bit boundary (8, 16, 32, 64, or 512 for a cache line).
   void Add(const string &name, int alignment, StringPiece data);
 
   // Similar to Add() for StringPiece but data is read from file.
@@ -45,7 +45,7 @@ from build_tools import code_generator_util
 INVALID_COST = 30000
 INVALID_1BYTE_COST = 255
 RESOLUTION_FOR_1BYTE = 64
-FILE_MAGIC = '\xAB\xCD'
+FILE_MAGIC = '\xAC\xCD'
 
 FALSE_VALUES = ['f', 'false', '0']
 TRUE_VALUES = ['t', 'true', '1']
@@ -144,6 +144,32 @@ def OutputBitList(bit_list, stream):
     stream.write(struct.pack('B', byte))
 
 
+def BitListToBytes(bit_list):
+  stream = StringIO.StringIO()
+  OutputBitList(bit_list, stream)
+  return stream.getvalue()
+
+
+def BuildIndexImage(bit_bytes):
+  """Builds the index image of SimpleSuccinctBitVectorIndex.
+
+  The image is the same as the one SimpleSuccinctBitVectorIndex creates for
+  |bit_bytes| with 4-byte chunks and no lower bound cache.  See
+  storage/louds/simple_succinct_bit_vector_index.h for the format.
+  """
+  assert len(bit_bytes) % 4 == 0
+  # Header: chunk size, bit vector length, lb0 and lb1 cache sizes.
+  result = [4, len(bit_bytes), 0, 0]
+  # The cumulative number of 1-bits from the beginning of each chunk.
+  num_bits = 0
+  for i in xrange(0, len(bit_bytes), 4):
+    result.append(num_bits)
+    num_bits += sum(bin(ord(c)).count('1') for c in bit_bytes[i:i + 4])
+  result.append(num_bits)
+  # Lower bound caches of size 0 are omitted from the image.
+  return struct.pack('<%di' % len(result), *result)
+
+
 def BuildBinaryData(matrix, mode_value_list, use_1byte_cost):
   # To compress the connection data, we use two-level succinct bit vector.
   #
@@ -163,17 +189,29 @@ def BuildBinaryData(matrix, mode_value_list, use_1byte_cost):
   # the compact bit vector by using Rank1 operation on chunk-bits.
   #
   # The file format is as follows:
-  # FILE_MAGIC (\xAB\xCD): 2bytes
+  # FILE_MAGIC (\xAC\xCD): 2bytes
   # Resolution: 2bytes
   # Num rids: 2bytes
   # Num lids: 2bytes
   # A list of mode values: 2bytes * rids (aligned to 32bits)
+  # The size of the index block in bytes: 4bytes
+  # The index block.
   # A list of row data.
   #
+  # The index block holds the following entry for each row, so that the
+  # rank index of the bit vectors is used as is without scanning the rows:
+  # The offset of the row data from the beginning of the file: 4bytes
+  # The size of compact bits in bytes: 4bytes
+  # The index image of chunk_bits
+  # The index image of compact_bits
+  #
   # The row data format is as follows:
   # The size of compact bits in bytes: 2bytes
   # The size of values in bytes: 2bytes
   # chunk_bits, compact_bits, followed by values.
+  #
+  # The file with FILE_MAGIC \xAB\xCD has no index block.  It is still
+  # supported by the reader, which builds the index at startup.
 
   if use_1byte_cost:
     resolution = RESOLUTION_FOR_1BYTE
@@ -196,6 +234,9 @@ def BuildBinaryData(matrix, mode_value_list, use_1byte_cost):
   if len(mode_value_list) % 2:
     stream.write('\x00\x00')
 
+  row_stream = StringIO.StringIO()
+  index_entries = []
+
   # Process each row:
   for row in matrix:
     chunk_bits = []
@@ -237,17 +278,32 @@ def BuildBinaryData(matrix, mode_value_list, use_1byte_cost):
       values_size = len(values) * 2
 
     # Output the bits for a row.
-    stream.write(struct.pack('<HH', len(compact_bits) / 8, values_size))
-    OutputBitList(chunk_bits, stream)
-    OutputBitList(compact_bits, stream)
+    chunk_bytes = BitListToBytes(chunk_bits)
+    compact_bytes = BitListToBytes(compact_bits)
+    index_entries.append((row_stream.tell(), len(compact_bytes),
+                          BuildIndexImage(chunk_bytes) +
+                          BuildIndexImage(compact_bytes)))
+    row_stream.write(struct.pack('<HH', len(compact_bytes), values_size))
+    row_stream.write(chunk_bytes)
+    row_stream.write(compact_bytes)
     if use_1byte_cost:
       for value in values:
         assert 0 <= value <= 255
-        stream.write(struct.pack('<B', value))
+        row_stream.write(struct.pack('<B', value))
     else:
       for value in values:
         assert 0 <= value <= 65535
-        stream.write(struct.pack('<H', value))
+        row_stream.write(struct.pack('<H', value))
+
+  # Output the index block followed by the rows.
+  index_block_size = sum(8 + len(images) for _, _, images in index_entries)
+  rows_offset = stream.tell() + 4 + index_block_size
+  stream.write(struct.pack('<I', index_block_size))
+  for row_offset, compact_bits_size, images in index_entries:
+    stream.write(struct.pack('<II', rows_offset + row_offset,
+                             compact_bits_size))
+    stream.write(images)
+  stream.write(row_stream.getvalue())
 
   return stream.getvalue()
 
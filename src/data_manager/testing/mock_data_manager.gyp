@@ -53,4 +53,51 @@
   #   - mock_data_manager  (type: static_library)
   #   - gen_mock_embedded_data  (type: none)
   'includes': [ '../data_manager.gypi' ],
+  'targets': [
+    {
+      # Connection data with 1-byte cost values for connector_test.
+      'target_name': 'gen_separate_1byte_connection_data_for_mock',
+      'type': 'none',
+      'toolsets': ['host'],
+      'dependencies': [
+        'gen_connection_single_column_txt_for_mock#host',
+      ],
+      'actions': [
+        {
+          'action_name': 'gen_separate_1byte_connection_data_for_mock',
+          'variables': {
+            'text_connection_file': '<(gen_out_dir)/connection_single_column.txt',
+            'id_file': '<(platform_data_dir)/id.def',
+            'special_pos_file': '<(common_data_dir)/rules/special_pos.def',
+          },
+          'inputs': [
+            '<(mozc_dir)/data_manager/gen_connection_data.py',
+            '<(text_connection_file)',
+            '<(id_file)',
+            '<(special_pos_file)',
+          ],
+          'outputs': [
+            '<(gen_out_dir)/connection_1byte.data',
+          ],
+          'action': [
+            'python', '<(mozc_dir)/data_manager/gen_connection_data.py',
+            '--text_connection_file',
+            '<(text_connection_file)',
+            '--id_file',
+            '<(id_file)',
+            '--special_pos_file',
+            '<(special_pos_file)',
+            '--binary_output_file',
+            '<@(_outputs)',
+            '--target_compiler',
+            '<(compiler_target)',
+            '--use_1byte_cost',
+            'true',
+          ],
+          'message': ('[mock] Generating ' +
+                      '<(gen_out_dir)/connection_1byte.data'),
+        },
+      ],
+    },
+  ],
 }
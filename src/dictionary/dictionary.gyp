@@ -92,6 +92,25 @@
         },
       },
     },
+    {
+      'target_name': 'user_dictionary_benchmark_main',
+      'type': 'executable',
+      'sources': [
+        'user_dictionary_benchmark_main.cc',
+      ],
+      'dependencies': [
+        '../base/base.gyp:base',
+        '../config/config.gyp:config_handler',
+        '../data_manager/oss/oss_data_manager.gyp:oss_data_manager',
+        '../protocol/protocol.gyp:config_proto',
+        '../protocol/protocol.gyp:user_dictionary_storage_proto',
+        '../request/request.gyp:conversion_request',
+        'dictionary_base.gyp:pos_matcher',
+        'dictionary_base.gyp:suppression_dictionary',
+        'dictionary_base.gyp:user_dictionary',
+        'dictionary_base.gyp:user_pos',
+      ],
+    },
     {
       'target_name': 'dictionary_mock',
       'type': 'static_library',
@@ -112,16 +112,17 @@ class CallbackWithFilter : public DictionaryInterface::Callback {
     return callback_->OnActualKey(key, actual_key, is_expanded);
   }
 
+  virtual bool ShouldDecodeValue(const Token &token) {
+    return !IsFilteredOutWithoutValue(token) &&
+           callback_->ShouldDecodeValue(token);
+  }
+
   virtual ResultType OnToken(StringPiece key, StringPiece actual_key,
                              const Token &token) {
+    if (IsFilteredOutWithoutValue(token)) {
+      return TRAVERSE_CONTINUE;
+    }
     if (!(token.attributes & Token::USER_DICTIONARY)) {
-      if (!use_spelling_correction_ &&
-          (token.attributes & Token::SPELLING_CORRECTION)) {
-        return TRAVERSE_CONTINUE;
-      }
-      if (!use_zip_code_conversion_ && pos_matcher_->IsZipcode(token.lid)) {
-        return TRAVERSE_CONTINUE;
-      }
       if (!use_t13n_conversion_ &&
           Util::IsEnglishTransliteration(token.value)) {
         return TRAVERSE_CONTINUE;
@@ -134,6 +135,21 @@ class CallbackWithFilter : public DictionaryInterface::Callback {
   }
 
  private:
+  // Returns true if |token| is filtered out regardless of its value.
+  bool IsFilteredOutWithoutValue(const Token &token) const {
+    if (token.attributes & Token::USER_DICTIONARY) {
+      return false;
+    }
+    if (!use_spelling_correction_ &&
+        (token.attributes & Token::SPELLING_CORRECTION)) {
+      return true;
+    }
+    if (!use_zip_code_conversion_ && pos_matcher_->IsZipcode(token.lid)) {
+      return true;
+    }
+    return false;
+  }
+
   const bool use_spelling_correction_;
   const bool use_zip_code_conversion_;
   const bool use_t13n_conversion_;
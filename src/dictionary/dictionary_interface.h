@@ -104,6 +104,15 @@ class DictionaryInterface {
       return TRAVERSE_CONTINUE;
     }
 
+    // Called back before OnToken() by the dictionaries that decode the value
+    // of a token lazily (currently SystemDictionary).  |token| has all the
+    // fields but the value set.  If this returns false, the token is skipped
+    // without decoding its value.  Since other dictionaries don't call this,
+    // OnToken() should still check what this checks.
+    virtual bool ShouldDecodeValue(const Token &token) {
+      return true;
+    }
+
    protected:
     Callback() {}
   };
@@ -51,14 +51,18 @@ void DictionaryFileCodec::WriteSections(
   DCHECK(ofs);
   WriteHeader(ofs);
 
-  if (sections.size() == 4) {
-    // In production, the number of sections equals 4.  In this case, write the
-    // sections in the following deterministic order.  This order was determined
-    // by random shuffle for engine version 24 but it's now made deterministic
-    // to obsolte DictionaryFileCodec.
+  if (sections.size() >= 4) {
+    // In production, the number of sections is at least 4.  In this case, write
+    // the first four sections in the following deterministic order.  This
+    // order was determined by random shuffle for engine version 24 but it's now
+    // made deterministic to obsolte DictionaryFileCodec.  The optional sections
+    // following them, e.g., the indices of tries, are written in given order.
     for (size_t i : {0, 2, 1, 3}) {
       WriteSection(sections[i], ofs);
     }
+    for (size_t i = 4; i < sections.size(); ++i) {
+      WriteSection(sections[i], ofs);
+    }
   } else {
     // Some tests don't have four sections.  In this case, simply write sections
     // in given order.
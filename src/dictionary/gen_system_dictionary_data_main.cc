@@ -33,6 +33,7 @@
 //  --input="dictionary0.txt dictionary1.txt"
 //  --output="output.h"
 //  --make_header
+//  --num_threads=4
 
 #include <memory>
 #include <string>
@@ -42,6 +43,7 @@
 #include "base/flags.h"
 #include "base/init_mozc.h"
 #include "base/logging.h"
+#include "base/stopwatch.h"
 #include "base/util.h"
 #include "data_manager/data_manager.h"
 #include "dictionary/dictionary_token.h"
@@ -52,6 +54,9 @@
 DEFINE_string(input, "", "space separated input text files");
 DEFINE_string(user_pos_manager_data, "", "user pos manager data");
 DEFINE_string(output, "", "output binary file");
+DEFINE_int32(num_threads, 4,
+             "number of threads used to load and build the dictionary. "
+             "The output doesn't depend on it.");
 
 namespace mozc {
 namespace {
@@ -110,11 +115,18 @@ int main(int argc, char **argv) {
   const mozc::dictionary::POSMatcher pos_matcher(
       data_manager.GetPOSMatcherData());
 
+  mozc::Stopwatch stopwatch = mozc::Stopwatch::StartNew();
   mozc::dictionary::TextDictionaryLoader loader(pos_matcher);
+  loader.set_num_threads(FLAGS_num_threads);
   loader.Load(system_dictionary_input, reading_correction_input);
+  LOG(INFO) << "Load: " << stopwatch.GetElapsedMilliseconds() << " msec";
 
+  stopwatch = mozc::Stopwatch::StartNew();
   mozc::dictionary::SystemDictionaryBuilder builder;
+  builder.set_num_threads(FLAGS_num_threads);
   builder.BuildFromTokens(loader.tokens());
+  LOG(INFO) << "BuildFromTokens: " << stopwatch.GetElapsedMilliseconds()
+            << " msec";
 
   std::unique_ptr<std::ostream> output_stream(new mozc::OutputFileStream(
       FLAGS_output.c_str(), std::ios::out | std::ios::binary));
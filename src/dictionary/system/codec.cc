@@ -76,6 +76,9 @@ const char kKeySectionName[] = "k";
 const char kValueSectionName[] = "v";
 const char kTokensSectionName[] = "t";
 const char kPosSectionName[] = "p";
+const char kKeyIndexSectionName[] = "ki";
+const char kValueIndexSectionName[] = "vi";
+const char kReverseLookupIndexSectionName[] = "ri";
 
 //// Constants for validation ////
 // 12 bits
@@ -213,6 +216,19 @@ const string SystemDictionaryCodec::GetSectionNameForPos() const {
   return kPosSectionName;
 }
 
+const string SystemDictionaryCodec::GetSectionNameForKeyIndex() const {
+  return kKeyIndexSectionName;
+}
+
+const string SystemDictionaryCodec::GetSectionNameForValueIndex() const {
+  return kValueIndexSectionName;
+}
+
+const string
+SystemDictionaryCodec::GetSectionNameForReverseLookupIndex() const {
+  return kReverseLookupIndexSectionName;
+}
+
 void SystemDictionaryCodec::EncodeKey(
     const StringPiece src, string *dst) const {
   EncodeDecodeKeyImpl(src, dst);
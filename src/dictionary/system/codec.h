@@ -58,6 +58,15 @@ class SystemDictionaryCodec : public SystemDictionaryCodecInterface {
   // Return section name for frequent pos map
   virtual const string GetSectionNameForPos() const;
 
+  // Return section name for the rank/select index of key trie
+  virtual const string GetSectionNameForKeyIndex() const;
+
+  // Return section name for the rank/select index of value trie
+  virtual const string GetSectionNameForValueIndex() const;
+
+  // Return section name for the reverse lookup index
+  virtual const string GetSectionNameForReverseLookupIndex() const;
+
   // Compresses key string into small bytes.
   virtual void EncodeKey(const StringPiece src, string *dst) const;
 
@@ -60,6 +60,15 @@ class SystemDictionaryCodecInterface {
   // Return section name for frequent pos map
   virtual const string GetSectionNameForPos() const = 0;
 
+  // Return section name for the rank/select index of key trie
+  virtual const string GetSectionNameForKeyIndex() const = 0;
+
+  // Return section name for the rank/select index of value trie
+  virtual const string GetSectionNameForValueIndex() const = 0;
+
+  // Return section name for the reverse lookup index
+  virtual const string GetSectionNameForReverseLookupIndex() const = 0;
+
   // Encode value(word) string
   virtual void EncodeValue(const StringPiece src, string *dst) const = 0;
 
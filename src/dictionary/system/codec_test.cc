@@ -319,6 +319,9 @@ class SystemDictionaryCodecMock : public SystemDictionaryCodecInterface {
   const string GetSectionNameForValue() const { return "Mock"; }
   const string GetSectionNameForTokens() const { return "Mock"; }
   const string GetSectionNameForPos() const { return "Mock"; }
+  const string GetSectionNameForKeyIndex() const { return "Mock"; }
+  const string GetSectionNameForValueIndex() const { return "Mock"; }
+  const string GetSectionNameForReverseLookupIndex() const { return "Mock"; }
   virtual void EncodeKey(const StringPiece src, string *dst) const {}
   virtual void DecodeKey(const StringPiece src, string *dst) const {}
   virtual size_t GetEncodedKeyLength(const StringPiece src) const { return 0; }
@@ -0,0 +1,168 @@
+// Copyright 2010-2018, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "dictionary/system/reverse_lookup_index.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace mozc {
+namespace dictionary {
+
+using ::mozc::storage::louds::BitVectorBasedArray;
+
+namespace {
+
+// The number of int32s preceding the offsets in the image.
+const size_t kHeaderSize = 1;
+
+void BuildIndex(const SystemDictionaryCodecInterface *codec,
+                const BitVectorBasedArray &token_array,
+                std::vector<int32> *index) {
+  // Gets id size.
+  int value_id_max = -1;
+  for (TokenScanIterator iter(codec, token_array);
+       !iter.Done(); iter.Next()) {
+    value_id_max = std::max(value_id_max, iter.Get().value_id);
+  }
+  const int index_size = value_id_max + 1;
+
+  // Gets result size for each ids, which is accumulated into the offsets.
+  std::vector<int32> offsets(index_size + 1, 0);
+  for (TokenScanIterator iter(codec, token_array);
+       !iter.Done(); iter.Next()) {
+    const TokenScanIterator::Result &result = iter.Get();
+    if (result.value_id != -1) {
+      ++offsets[result.value_id + 1];
+    }
+  }
+  for (int i = 0; i < index_size; ++i) {
+    offsets[i + 1] += offsets[i];
+  }
+
+  const size_t results_begin = kHeaderSize + offsets.size();
+  index->clear();
+  index->reserve(results_begin + offsets[index_size] * 2);
+  index->push_back(index_size);
+  index->insert(index->end(), offsets.begin(), offsets.end());
+  index->resize(results_begin + offsets[index_size] * 2);
+
+  // Builds index.  |offsets| is reused as the position to store the next
+  // result of each id.
+  for (TokenScanIterator iter(codec, token_array);
+       !iter.Done(); iter.Next()) {
+    const TokenScanIterator::Result &result = iter.Get();
+    if (result.value_id == -1) {
+      continue;
+    }
+    const size_t pos = results_begin + offsets[result.value_id]++ * 2;
+    (*index)[pos] = result.tokens_offset;
+    (*index)[pos + 1] = result.index;
+  }
+}
+
+}  // namespace
+
+ReverseLookupIndex::ReverseLookupIndex()
+    : offsets_(nullptr), results_(nullptr), index_size_(0) {}
+
+ReverseLookupIndex::~ReverseLookupIndex() {}
+
+// static
+void ReverseLookupIndex::BuildImage(
+    const SystemDictionaryCodecInterface *codec,
+    const BitVectorBasedArray &token_array,
+    string *image) {
+  std::vector<int32> index;
+  BuildIndex(codec, token_array, &index);
+  image->clear();
+  image->reserve(index.size() * sizeof(int32));
+  for (size_t i = 0; i < index.size(); ++i) {
+    // Output LSB to MSB.
+    const uint32 v = static_cast<uint32>(index[i]);
+    image->push_back(static_cast<char>(v & 0xFF));
+    image->push_back(static_cast<char>((v >> 8) & 0xFF));
+    image->push_back(static_cast<char>((v >> 16) & 0xFF));
+    image->push_back(static_cast<char>((v >> 24) & 0xFF));
+  }
+}
+
+bool ReverseLookupIndex::Init(const uint8 *image, size_t image_size) {
+  if (image == nullptr || image_size % sizeof(int32) != 0 ||
+      image_size < (kHeaderSize + 1) * sizeof(int32)) {
+    return false;
+  }
+  const int32 *data = reinterpret_cast<const int32 *>(image);
+  const size_t data_size = image_size / sizeof(int32);
+  const int32 index_size = data[0];
+  if (index_size < 0 || kHeaderSize + index_size + 1 > data_size) {
+    return false;
+  }
+  const int32 *offsets = data + kHeaderSize;
+  const int32 *results = offsets + index_size + 1;
+  const int32 num_results = offsets[index_size];
+  if (offsets[0] != 0 || num_results < 0 ||
+      results + num_results * 2 != data + data_size) {
+    return false;
+  }
+  buffer_.clear();
+  offsets_ = offsets;
+  results_ = results;
+  index_size_ = index_size;
+  return true;
+}
+
+void ReverseLookupIndex::Init(const SystemDictionaryCodecInterface *codec,
+                              const BitVectorBasedArray &token_array) {
+  BuildIndex(codec, token_array, &buffer_);
+  index_size_ = buffer_[0];
+  offsets_ = buffer_.data() + kHeaderSize;
+  results_ = offsets_ + index_size_ + 1;
+}
+
+void ReverseLookupIndex::FillResultMap(
+    const std::set<int> &id_set,
+    std::multimap<int, ReverseLookupResult> *result_map) const {
+  for (std::set<int>::const_iterator id_itr = id_set.begin();
+       id_itr != id_set.end(); ++id_itr) {
+    const int id = *id_itr;
+    if (id < 0 || id >= index_size_) {
+      continue;
+    }
+    for (int32 i = offsets_[id]; i < offsets_[id + 1]; ++i) {
+      ReverseLookupResult result;
+      result.tokens_offset = results_[i * 2];
+      result.id_in_key_trie = results_[i * 2 + 1];
+      result_map->insert(std::make_pair(id, result));
+    }
+  }
+}
+
+}  // namespace dictionary
+}  // namespace mozc
@@ -65,7 +65,9 @@
 #include "dictionary/file/codec_factory.h"
 #include "dictionary/file/dictionary_file.h"
 #include "dictionary/system/codec_interface.h"
+#include "dictionary/system/reverse_lookup_index.h"
 #include "dictionary/system/token_decode_iterator.h"
+#include "dictionary/system/trie_cache_size.h"
 #include "dictionary/system/words_info.h"
 #include "storage/louds/bit_vector_based_array.h"
 #include "storage/louds/louds_trie.h"
@@ -78,23 +80,6 @@ using ::mozc::storage::louds::LoudsTrie;
 
 namespace {
 
-const int kMinTokenArrayBlobSize = 4;
-
-// TODO(noriyukit): The following paramters may not be well optimized.  In our
-// experiments, Select1 is computational burden, so increasing cache size for
-// lb1/select1 may improve performance.
-const size_t kKeyTrieLb0CacheSize = 1 * 1024;
-const size_t kKeyTrieLb1CacheSize = 1 * 1024;
-const size_t kKeyTrieSelect0CacheSize = 4 * 1024;
-const size_t kKeyTrieSelect1CacheSize = 4 * 1024;
-const size_t kKeyTrieTermvecCacheSize = 1 * 1024;
-
-const size_t kValueTrieLb0CacheSize = 1 * 1024;
-const size_t kValueTrieLb1CacheSize = 1 * 1024;
-const size_t kValueTrieSelect0CacheSize = 1 * 1024;
-const size_t kValueTrieSelect1CacheSize = 16 * 1024;
-const size_t kValueTrieTermvecCacheSize = 4 * 1024;
-
 // Expansion table format:
 // "<Character to expand>[<Expanded character 1><Expanded character 2>...]"
 //
@@ -178,110 +163,6 @@ inline const uint8 *GetTokenArrayPtr(const BitVectorBasedArray &token_array,
   return reinterpret_cast<const uint8*>(token_array.Get(key_id, &length));
 }
 
-// Iterator for scanning token array.
-// This iterator does not return actual token info but returns
-// id data and the position only.
-// This will be used only for reverse lookup.
-// Forward lookup does not need such iterator because it can access
-// a token directly without linear scan.
-//
-//  Usage:
-//    for (TokenScanIterator iter(codec_, token_array_);
-//         !iter.Done(); iter.Next()) {
-//      const TokenScanIterator::Result &result = iter.Get();
-//      // Do something with |result|.
-//    }
-class TokenScanIterator {
- public:
-  struct Result {
-    // Value id for the current token
-    int value_id;
-    // Index (= key id) for the current token
-    int index;
-    // Offset from the tokens section beginning.
-    // (token_array_->Get(id_in_key_trie) ==
-    //  token_array_->Get(0) + tokens_offset)
-    int tokens_offset;
-  };
-
-  TokenScanIterator(
-      const SystemDictionaryCodecInterface *codec,
-      const BitVectorBasedArray &token_array)
-      : codec_(codec),
-        termination_flag_(codec->GetTokensTerminationFlag()),
-        state_(HAS_NEXT),
-        offset_(0),
-        tokens_offset_(0),
-        index_(0) {
-    encoded_tokens_ptr_ = GetTokenArrayPtr(token_array, 0);
-    NextInternal();
-  }
-
-  ~TokenScanIterator() {
-  }
-
-  const Result &Get() const { return result_; }
-
-  bool Done() const { return state_ == DONE; }
-
-  void Next() {
-    DCHECK_NE(state_, DONE);
-    NextInternal();
-  }
-
- private:
-  enum State {
-    HAS_NEXT,
-    DONE,
-  };
-
-  void NextInternal() {
-    if (encoded_tokens_ptr_[offset_] == termination_flag_) {
-      state_ = DONE;
-      return;
-    }
-    int read_bytes;
-    result_.value_id = -1;
-    result_.index = index_;
-    result_.tokens_offset = tokens_offset_;
-    const bool is_last_token =
-        !(codec_->ReadTokenForReverseLookup(encoded_tokens_ptr_ + offset_,
-                                            &result_.value_id, &read_bytes));
-    if (is_last_token) {
-      int tokens_size = offset_ + read_bytes - tokens_offset_;
-      if (tokens_size < kMinTokenArrayBlobSize) {
-        tokens_size = kMinTokenArrayBlobSize;
-      }
-      tokens_offset_ += tokens_size;
-      ++index_;
-      offset_ = tokens_offset_;
-    } else {
-      offset_ += read_bytes;
-    }
-  }
-
-  const SystemDictionaryCodecInterface *codec_;
-  const uint8 *encoded_tokens_ptr_;
-  const uint8 termination_flag_;
-  State state_;
-  Result result_;
-  int offset_;
-  int tokens_offset_;
-  int index_;
-
- private:
-  DISALLOW_COPY_AND_ASSIGN(TokenScanIterator);
-};
-
-struct ReverseLookupResult {
-  ReverseLookupResult() : tokens_offset(-1), id_in_key_trie(-1) {}
-  // Offset from the tokens section beginning.
-  // (token_array_.Get(id_in_key_trie) == token_array_.Get(0) + tokens_offset)
-  int tokens_offset;
-  // Id in key trie
-  int id_in_key_trie;
-};
-
 }  // namespace
 
 class SystemDictionary::ReverseLookupCache {
@@ -305,98 +186,6 @@ class SystemDictionary::ReverseLookupCache {
   DISALLOW_COPY_AND_ASSIGN(ReverseLookupCache);
 };
 
-class SystemDictionary::ReverseLookupIndex {
- public:
-  ReverseLookupIndex(
-      const SystemDictionaryCodecInterface *codec,
-      const BitVectorBasedArray &token_array) {
-    // Gets id size.
-    int value_id_max = -1;
-    for (TokenScanIterator iter(codec, token_array);
-         !iter.Done(); iter.Next()) {
-      const TokenScanIterator::Result &result = iter.Get();
-      value_id_max = std::max(value_id_max, result.value_id);
-    }
-
-    CHECK_GE(value_id_max, 0);
-    index_size_ = value_id_max + 1;
-    index_.reset(new ReverseLookupResultArray[index_size_]);
-
-    // Gets result size for each ids.
-    for (TokenScanIterator iter(codec, token_array);
-         !iter.Done(); iter.Next()) {
-      const TokenScanIterator::Result &result = iter.Get();
-      if (result.value_id != -1) {
-        DCHECK_LT(result.value_id, index_size_);
-        ++(index_[result.value_id].size);
-      }
-    }
-
-    for (size_t i = 0; i < index_size_; ++i) {
-      index_[i].results.reset(new ReverseLookupResult[index_[i].size]);
-    }
-
-    // Builds index.
-    for (TokenScanIterator iter(codec, token_array);
-         !iter.Done(); iter.Next()) {
-      const TokenScanIterator::Result &result = iter.Get();
-      if (result.value_id == -1) {
-        continue;
-      }
-
-      DCHECK_LT(result.value_id, index_size_);
-      ReverseLookupResultArray *result_array = &index_[result.value_id];
-
-      // Finds uninitialized result.
-      size_t result_index = 0;
-      for (result_index = 0;
-           result_index < result_array->size;
-           ++result_index) {
-        const ReverseLookupResult &lookup_result =
-            result_array->results[result_index];
-        if (lookup_result.tokens_offset == -1 &&
-            lookup_result.id_in_key_trie == -1) {
-          result_array->results[result_index].tokens_offset =
-              result.tokens_offset;
-          result_array->results[result_index].id_in_key_trie = result.index;
-          break;
-        }
-      }
-    }
-
-    CHECK(index_ != nullptr);
-  }
-
-  ~ReverseLookupIndex() {}
-
-  void FillResultMap(const std::set<int> &id_set,
-                     std::multimap<int, ReverseLookupResult> *result_map) {
-    for (std::set<int>::const_iterator id_itr  = id_set.begin();
-         id_itr != id_set.end(); ++id_itr) {
-      const ReverseLookupResultArray &result_array = index_[*id_itr];
-      for (size_t i = 0; i < result_array.size; ++i) {
-        result_map->insert(std::make_pair(*id_itr, result_array.results[i]));
-      }
-    }
-  }
-
- private:
-  struct ReverseLookupResultArray {
-    ReverseLookupResultArray() : size(0) {}
-    // Use std::unique_ptr for reducing memory consumption as possible.
-    // Using vector requires 90 MB even when we call resize explicitly.
-    // On the other hand, std::unique_ptr requires 57 MB.
-    std::unique_ptr<ReverseLookupResult[]> results;
-    size_t size;
-  };
-
-  // Use scoped array for reducing memory consumption as possible.
-  std::unique_ptr<ReverseLookupResultArray[]> index_;
-  size_t index_size_;
-
-  DISALLOW_COPY_AND_ASSIGN(ReverseLookupIndex);
-};
-
 struct SystemDictionary::PredictiveLookupSearchState {
   PredictiveLookupSearchState() : key_pos(0), is_expanded(false) {}
   PredictiveLookupSearchState(const storage::louds::LoudsTrie::Node &n,
@@ -515,12 +304,13 @@ bool SystemDictionary::OpenDictionaryFile(bool enable_reverse_lookup_index) {
 
   const uint8 *key_image = reinterpret_cast<const uint8 *>(
       dictionary_file_->GetSection(codec_->GetSectionNameForKey(), &len));
-  if (!key_trie_.Open(key_image,
-                      kKeyTrieLb0CacheSize,
-                      kKeyTrieLb1CacheSize,
-                      kKeyTrieSelect0CacheSize,
-                      kKeyTrieSelect1CacheSize,
-                      kKeyTrieTermvecCacheSize)) {
+  if (!OpenTrie(key_image, codec_->GetSectionNameForKeyIndex(),
+                kKeyTrieLb0CacheSize,
+                kKeyTrieLb1CacheSize,
+                kKeyTrieSelect0CacheSize,
+                kKeyTrieSelect1CacheSize,
+                kKeyTrieTermvecCacheSize,
+                &key_trie_)) {
     LOG(ERROR) << "cannot open key trie";
     return false;
   }
@@ -529,12 +319,13 @@ bool SystemDictionary::OpenDictionaryFile(bool enable_reverse_lookup_index) {
 
   const uint8 *value_image = reinterpret_cast<const uint8 *>(
       dictionary_file_->GetSection(codec_->GetSectionNameForValue(), &len));
-  if (!value_trie_.Open(value_image,
-                        kValueTrieLb0CacheSize,
-                        kValueTrieLb1CacheSize,
-                        kValueTrieSelect0CacheSize,
-                        kValueTrieSelect1CacheSize,
-                        kValueTrieTermvecCacheSize)) {
+  if (!OpenTrie(value_image, codec_->GetSectionNameForValueIndex(),
+                kValueTrieLb0CacheSize,
+                kValueTrieLb1CacheSize,
+                kValueTrieSelect0CacheSize,
+                kValueTrieSelect1CacheSize,
+                kValueTrieTermvecCacheSize,
+                &value_trie_)) {
     LOG(ERROR) << "can not open value trie";
     return false;
   }
@@ -557,11 +348,53 @@ bool SystemDictionary::OpenDictionaryFile(bool enable_reverse_lookup_index) {
   return true;
 }
 
+bool SystemDictionary::OpenTrie(const uint8 *image,
+                                const string &index_section_name,
+                                size_t lb0_cache_size, size_t lb1_cache_size,
+                                size_t select0_cache_size,
+                                size_t select1_cache_size,
+                                size_t termvec_cache_size,
+                                LoudsTrie *trie) const {
+  if (image == nullptr) {
+    return false;
+  }
+
+  // Dictionary files built by SystemDictionaryBuilder have the rank/select
+  // indices of the tries, which are used directly from the file image.  Such
+  // pages are shared between processes and not touched until necessary.
+  int index_len = 0;
+  const uint8 *index_image = reinterpret_cast<const uint8 *>(
+      dictionary_file_->GetSection(index_section_name, &index_len));
+  if (index_image != nullptr) {
+    if (trie->OpenWithIndex(image, index_image, index_len)) {
+      return true;
+    }
+    LOG(WARNING) << "Broken trie index section.  Building the index.";
+  }
+  return trie->Open(image, lb0_cache_size, lb1_cache_size,
+                    select0_cache_size, select1_cache_size,
+                    termvec_cache_size);
+}
+
 void SystemDictionary::InitReverseLookupIndex() {
   if (reverse_lookup_index_ != nullptr) {
     return;
   }
-  reverse_lookup_index_.reset(new ReverseLookupIndex(codec_, token_array_));
+  reverse_lookup_index_.reset(new ReverseLookupIndex);
+
+  // Use the index in the dictionary file if available.  Otherwise the index
+  // is built in heap by scanning the token array.
+  int len = 0;
+  const uint8 *index_image = reinterpret_cast<const uint8 *>(
+      dictionary_file_->GetSection(
+          codec_->GetSectionNameForReverseLookupIndex(), &len));
+  if (index_image != nullptr) {
+    if (reverse_lookup_index_->Init(index_image, len)) {
+      return;
+    }
+    LOG(WARNING) << "Broken reverse lookup index section.  Building the index.";
+  }
+  reverse_lookup_index_->Init(codec_, token_array_);
 }
 
 bool SystemDictionary::HasKey(StringPiece key) const {
@@ -777,6 +610,9 @@ void SystemDictionary::LookupPredictive(
                                   frequent_pos_, actual_key,
                                   GetTokenArrayPtr(token_array_, key_id));
          !iter.Done(); iter.Next()) {
+      if (!callback->ShouldDecodeValue(*iter.GetWithoutValue().token)) {
+        continue;
+      }
       const TokenInfo &token_info = iter.Get();
       const Callback::ResultType result =
           callback->OnToken(decoded_key, actual_key, *token_info.token);
@@ -854,6 +690,9 @@ void RunCallbackOnEachPrefix(const LoudsTrie &key_trie,
     for (TokenDecodeIterator iter(codec, value_trie, frequent_pos, prefix,
                                   GetTokenArrayPtr(token_array, key_id));
          !iter.Done(); iter.Next()) {
+      if (!callback->ShouldDecodeValue(*iter.GetWithoutValue().token)) {
+        continue;
+      }
       const TokenInfo &token_info = iter.Get();
       if (!token_filter(token_info)) {
         continue;
@@ -962,6 +801,9 @@ SystemDictionary::LookupPrefixWithKeyExpansionImpl(
                                   *actual_prefix,
                                   GetTokenArrayPtr(token_array_, key_id));
          !iter.Done(); iter.Next()) {
+      if (!callback->ShouldDecodeValue(*iter.GetWithoutValue().token)) {
+        continue;
+      }
       const TokenInfo &token_info = iter.Get();
       result = callback->OnToken(prefix, *actual_prefix, *token_info.token);
       if (result == Callback::TRAVERSE_DONE ||
@@ -1041,6 +883,9 @@ void SystemDictionary::LookupExact(
   for (TokenDecodeIterator iter(codec_, value_trie_, frequent_pos_, key,
                                 GetTokenArrayPtr(token_array_, key_id));
        !iter.Done(); iter.Next()) {
+    if (!callback->ShouldDecodeValue(*iter.GetWithoutValue().token)) {
+      continue;
+    }
     if (callback->OnToken(key, key, *iter.Get().token) !=
         Callback::TRAVERSE_CONTINUE) {
       break;
@@ -1087,8 +932,7 @@ void SystemDictionary::PopulateReverseLookupCache(StringPiece str) const {
     // as we have already built the index for reverse lookup.
     return;
   }
-  reverse_lookup_cache_.reset(new ReverseLookupCache);
-  DCHECK(reverse_lookup_cache_.get());
+  std::shared_ptr<ReverseLookupCache> cache(new ReverseLookupCache);
 
   // Iterate each suffix and collect IDs of all substrings.
   std::set<int> id_set;
@@ -1103,10 +947,14 @@ void SystemDictionary::PopulateReverseLookupCache(StringPiece str) const {
     pos += Util::OneCharLen(suffix.data());
   }
   // Collect tokens for all IDs.
-  ScanTokens(id_set, reverse_lookup_cache_.get());
+  ScanTokens(id_set, cache.get());
+
+  scoped_lock l(&reverse_lookup_cache_mutex_);
+  reverse_lookup_cache_ = std::move(cache);
 }
 
 void SystemDictionary::ClearReverseLookupCache() const {
+  scoped_lock l(&reverse_lookup_cache_mutex_);
   reverse_lookup_cache_.reset();
 }
 
@@ -1162,12 +1010,16 @@ void SystemDictionary::RegisterReverseLookupTokensForValue(
 
   ReverseLookupCache *results = nullptr;
   ReverseLookupCache non_cached_results;
+  std::shared_ptr<ReverseLookupCache> cache;
+  if (reverse_lookup_index_ == nullptr) {
+    scoped_lock l(&reverse_lookup_cache_mutex_);
+    cache = reverse_lookup_cache_;
+  }
   if (reverse_lookup_index_ != nullptr) {
     reverse_lookup_index_->FillResultMap(id_set, &non_cached_results.results);
     results = &non_cached_results;
-  } else if (reverse_lookup_cache_ != nullptr &&
-             reverse_lookup_cache_->IsAvailable(id_set)) {
-    results = reverse_lookup_cache_.get();
+  } else if (cache != nullptr && cache->IsAvailable(id_set)) {
+    results = cache.get();
   } else {
     // Cache is not available. Get token for each ID.
     ScanTokens(id_set, &non_cached_results);
@@ -1221,12 +1073,14 @@ void SystemDictionary::RegisterReverseLookupResults(
                codec_, value_trie_, frequent_pos_, tokens_key,
                encoded_tokens_ptr  + reverse_result.tokens_offset);
            !iter.Done(); iter.Next()) {
-        const TokenInfo &token_info = iter.Get();
+        // The value is known to be the one of |value_id|, so only the
+        // matching tokens are decoded.
+        const TokenInfo &token_info = iter.GetWithoutValue();
         if (token_info.token->attributes & Token::SPELLING_CORRECTION ||
             token_info.id_in_value_trie != value_id) {
           continue;
         }
-        callback->OnToken(tokens_key, tokens_key, *token_info.token);
+        callback->OnToken(tokens_key, tokens_key, *iter.Get().token);
       }
     }
   }
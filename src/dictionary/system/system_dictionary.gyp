@@ -48,6 +48,19 @@
         'key_expansion_table.h',
       ],
     },
+    {
+      'target_name': 'reverse_lookup_index',
+      'type': 'static_library',
+      'toolsets': ['target', 'host'],
+      'sources': [
+        'reverse_lookup_index.cc',
+      ],
+      'dependencies': [
+        '../../base/base.gyp:base_core',
+        '../../storage/louds/louds.gyp:bit_vector_based_array',
+        'system_dictionary_codec',
+      ],
+    },
     {
       'target_name': 'system_dictionary',
       'type': 'static_library',
@@ -63,6 +76,7 @@
         '../file/dictionary_file.gyp:codec_factory',
         '../file/dictionary_file.gyp:dictionary_file',
         'key_expansion_table',
+        'reverse_lookup_index',
         'system_dictionary_codec',
       ],
     },
@@ -88,15 +102,34 @@
         'system_dictionary_builder.cc',
       ],
       'dependencies': [
+        '../../base/base.gyp:base',
         '../../base/base.gyp:base_core',
         '../../storage/louds/louds.gyp:bit_vector_based_array_builder',
+        '../../storage/louds/louds.gyp:louds_trie',
         '../../storage/louds/louds.gyp:louds_trie_builder',
         '../dictionary_base.gyp:pos_matcher',
         '../dictionary_base.gyp:text_dictionary_loader',
         '../file/dictionary_file.gyp:codec',
         '../file/dictionary_file.gyp:codec_factory',
+        'reverse_lookup_index',
         'system_dictionary_codec',
       ],
     },
+    {
+      'target_name': 'system_dictionary_benchmark',
+      'type': 'executable',
+      'sources': [
+        'system_dictionary_benchmark.cc',
+      ],
+      'dependencies': [
+        '../../base/base.gyp:base',
+        '../../config/config.gyp:config_handler',
+        '../../data_manager/oss/oss_data_manager.gyp:oss_data_manager',
+        '../../protocol/protocol.gyp:commands_proto',
+        '../../protocol/protocol.gyp:config_proto',
+        '../../request/request.gyp:conversion_request',
+        'system_dictionary',
+      ],
+    },
   ],
 }
@@ -35,6 +35,7 @@
 #include <string>
 #include <vector>
 
+#include "base/mutex.h"
 #include "base/port.h"
 #include "base/string_piece.h"
 #include "dictionary/dictionary_interface.h"
@@ -50,6 +51,7 @@ namespace dictionary {
 
 class DictionaryFile;
 class DictionaryFileCodecInterface;
+class ReverseLookupIndex;
 class SystemDictionaryCodecInterface;
 
 class SystemDictionary : public DictionaryInterface {
@@ -125,12 +127,18 @@ class SystemDictionary : public DictionaryInterface {
 
  private:
   class ReverseLookupCache;
-  class ReverseLookupIndex;
   struct PredictiveLookupSearchState;
 
   explicit SystemDictionary(const SystemDictionaryCodecInterface *codec,
                             const DictionaryFileCodecInterface *file_codec);
   bool OpenDictionaryFile(bool enable_reverse_lookup_index);
+  // Opens |trie| with the index in |index_section_name| if the dictionary file
+  // has it.  Otherwise builds the index with the given cache sizes.
+  bool OpenTrie(const uint8 *image, const string &index_section_name,
+                size_t lb0_cache_size, size_t lb1_cache_size,
+                size_t select0_cache_size, size_t select1_cache_size,
+                size_t termvec_cache_size,
+                storage::louds::LoudsTrie *trie) const;
 
   void RegisterReverseLookupTokensForT13N(StringPiece value,
                                           Callback *callback) const;
@@ -166,7 +174,10 @@ class SystemDictionary : public DictionaryInterface {
   const SystemDictionaryCodecInterface *codec_;
   KeyExpansionTable hiragana_expansion_table_;
   std::unique_ptr<DictionaryFile> dictionary_file_;
-  mutable std::unique_ptr<ReverseLookupCache> reverse_lookup_cache_;
+  // Shared so that a reverse conversion running in parallel can keep using
+  // the cache while another one replaces it.
+  mutable std::shared_ptr<ReverseLookupCache> reverse_lookup_cache_;
+  mutable Mutex reverse_lookup_cache_mutex_;
   std::unique_ptr<ReverseLookupIndex> reverse_lookup_index_;
 
   DISALLOW_COPY_AND_ASSIGN(SystemDictionary);
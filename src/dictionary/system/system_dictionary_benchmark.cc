@@ -27,3 +27,388 @@
 // (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+
+// Benchmark for the lookup methods of SystemDictionary.
+//
+// Usage:
+//   system_dictionary_benchmark
+//     --query_file=data/dictionary_oss/dictionary00.txt
+//     [--engine_data=mozc.data --magic=...] [--dictionary_file=system.dic]
+//     [--max_queries=10000]
+//
+// Every line of --query_file is read as a TSV and its first column is used as
+// a reading, so both a plain list of readings and the dictionary source files
+// can be replayed.  For each reading, its modifier-stripped variant (e.g.
+// "かつこう" for "がっこう") is also looked up with kana modifier insensitive
+// conversion enabled so that the key expansion paths are measured as well.
+// Reverse lookup is measured with the surface forms found by LookupExact.
+// Prefix lookup is also measured with callbacks which take only the tokens of
+// the whole key, like the ones looking for a (key, value) pair, once rejecting
+// the other tokens in OnToken() and once in ShouldDecodeValue().
+//
+// For each API, the latency percentiles, the number of callbacks per second
+// and the number of key/value bytes delivered to callbacks are reported.
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/file_stream.h"
+#include "base/flags.h"
+#include "base/init_mozc.h"
+#include "base/logging.h"
+#include "base/mmap.h"
+#include "base/port.h"
+#include "base/stopwatch.h"
+#include "base/string_piece.h"
+#include "base/util.h"
+#include "config/config_handler.h"
+#include "data_manager/data_manager.h"
+#include "data_manager/oss/oss_data_manager.h"
+#include "dictionary/dictionary_interface.h"
+#include "dictionary/dictionary_token.h"
+#include "dictionary/system/system_dictionary.h"
+#include "protocol/commands.pb.h"
+#include "protocol/config.pb.h"
+#include "request/conversion_request.h"
+
+DEFINE_string(engine_data, "",
+              "Path to the data set file.  If empty, the embedded OSS data set "
+              "is used.");
+DEFINE_string(magic, "", "Expected magic number of --engine_data.");
+DEFINE_string(dictionary_file, "",
+              "Path to a system dictionary image.  If set, it is used instead "
+              "of the one in the data set.");
+DEFINE_string(query_file, "",
+              "TSV file whose first column is used as a reading.");
+DEFINE_int32(max_queries, 10000, "Maximum number of readings to replay.");
+DEFINE_int32(iterations, 3, "Number of times to replay the corpus.");
+DEFINE_bool(enable_reverse_lookup_index, false,
+            "Builds SystemDictionary with ENABLE_REVERSE_LOOKUP_INDEX.");
+
+namespace mozc {
+namespace dictionary {
+namespace {
+
+// Used when --query_file is not specified.
+const char *kDefaultQueries[] = {
+  "わたしのなまえはなかのです",
+  "きょうはいいてんきですね",
+  "がっこうにいく",
+  "とうきょうとっきょきょかきょく",
+  "にほんごにゅうりょく",
+  "へんかんえんじん",
+  "ぎじゅつひょうろんしゃ",
+  "こんばんは",
+  "ありがとうございます",
+  "よろしくおねがいします",
+  "しゃしんをとる",
+  "ちょっとまってください",
+  "ぴゃっこ",
+  "ゔぁいおりん",
+  "きゃっしゅ",
+  "でんしゃにのりおくれた",
+};
+
+// Pairs of (modified, base) characters.  These are the reverse mapping of the
+// hiragana expansion table in system_dictionary.cc: users often type the base
+// character and expect the modified one to be found.
+const char *kModifierStripTable[][2] = {
+  {"ぁ", "あ"}, {"ぃ", "い"}, {"ぅ", "う"}, {"ゔ", "う"}, {"ぇ", "え"},
+  {"ぉ", "お"}, {"が", "か"}, {"ぎ", "き"}, {"ぐ", "く"}, {"げ", "け"},
+  {"ご", "こ"}, {"ざ", "さ"}, {"じ", "し"}, {"ず", "す"}, {"ぜ", "せ"},
+  {"ぞ", "そ"}, {"だ", "た"}, {"ぢ", "ち"}, {"っ", "つ"}, {"づ", "つ"},
+  {"で", "て"}, {"ど", "と"}, {"ば", "は"}, {"ぱ", "は"}, {"び", "ひ"},
+  {"ぴ", "ひ"}, {"ぶ", "ふ"}, {"ぷ", "ふ"}, {"べ", "へ"}, {"ぺ", "へ"},
+  {"ぼ", "ほ"}, {"ぽ", "ほ"}, {"ゃ", "や"}, {"ゅ", "ゆ"}, {"ょ", "よ"},
+  {"ゎ", "わ"},
+};
+
+// Returns |key| whose modified kana are replaced with their base characters.
+string StripKanaModifiers(const string &key) {
+  static const std::map<string, string> *kStripMap = [] {
+    std::map<string, string> *m = new std::map<string, string>();
+    for (size_t i = 0; i < arraysize(kModifierStripTable); ++i) {
+      (*m)[kModifierStripTable[i][0]] = kModifierStripTable[i][1];
+    }
+    return m;
+  }();
+  std::vector<string> chars;
+  Util::SplitStringToUtf8Chars(key, &chars);
+  string result;
+  for (size_t i = 0; i < chars.size(); ++i) {
+    const auto it = kStripMap->find(chars[i]);
+    result.append(it == kStripMap->end() ? chars[i] : it->second);
+  }
+  return result;
+}
+
+// Counts the callbacks and the bytes passed to them.  For reverse lookup
+// preparation, it optionally collects the surface forms.
+class CountingCallback : public DictionaryInterface::Callback {
+ public:
+  // Which tokens are passed to OnToken() and how the others are rejected.
+  enum TokenFilter {
+    ALL_TOKENS,
+    WHOLE_KEY_IN_ON_TOKEN,
+    WHOLE_KEY_IN_SHOULD_DECODE_VALUE,
+  };
+
+  explicit CountingCallback(TokenFilter filter)
+      : filter_(filter), lookup_key_size_(0), num_callbacks_(0),
+        num_bytes_(0), values_(nullptr) {}
+
+  ResultType OnKey(StringPiece key) override {
+    ++num_callbacks_;
+    num_bytes_ += key.size();
+    return TRAVERSE_CONTINUE;
+  }
+
+  ResultType OnActualKey(StringPiece key, StringPiece actual_key,
+                         bool is_expanded) override {
+    ++num_callbacks_;
+    num_bytes_ += actual_key.size();
+    return TRAVERSE_CONTINUE;
+  }
+
+  bool ShouldDecodeValue(const Token &token) override {
+    return filter_ != WHOLE_KEY_IN_SHOULD_DECODE_VALUE ||
+           token.key.size() == lookup_key_size_;
+  }
+
+  ResultType OnToken(StringPiece key, StringPiece actual_key,
+                     const Token &token) override {
+    if (filter_ != ALL_TOKENS && token.key.size() != lookup_key_size_) {
+      return TRAVERSE_CONTINUE;
+    }
+    ++num_callbacks_;
+    num_bytes_ += token.key.size() + token.value.size();
+    if (values_ != nullptr) {
+      values_->push_back(token.value);
+    }
+    return TRAVERSE_CONTINUE;
+  }
+
+  void set_lookup_key(StringPiece key) { lookup_key_size_ = key.size(); }
+  void set_values(std::vector<string> *values) { values_ = values; }
+  uint64 num_callbacks() const { return num_callbacks_; }
+  uint64 num_bytes() const { return num_bytes_; }
+
+ private:
+  const TokenFilter filter_;
+  size_t lookup_key_size_;
+  uint64 num_callbacks_;
+  uint64 num_bytes_;
+  std::vector<string> *values_;
+
+  DISALLOW_COPY_AND_ASSIGN(CountingCallback);
+};
+
+// Accumulates the latency of each call of one API.
+class LatencyRecorder {
+ public:
+  explicit LatencyRecorder(const string &name) : name_(name) {}
+
+  void Add(double nanoseconds) { latencies_.push_back(nanoseconds); }
+
+  void Report(const CountingCallback &callback) {
+    if (latencies_.empty()) {
+      std::cout << name_ << ": no queries" << std::endl;
+      return;
+    }
+    std::sort(latencies_.begin(), latencies_.end());
+    double total = 0.0;
+    for (size_t i = 0; i < latencies_.size(); ++i) {
+      total += latencies_[i];
+    }
+    const double total_sec = total / 1e9;
+    std::cout << name_ << ": calls=" << latencies_.size()
+              << " avg=" << total / latencies_.size() / 1e3 << "us"
+              << " p50=" << Percentile(50) / 1e3 << "us"
+              << " p90=" << Percentile(90) / 1e3 << "us"
+              << " p99=" << Percentile(99) / 1e3 << "us"
+              << " max=" << latencies_.back() / 1e3 << "us"
+              << " callbacks=" << callback.num_callbacks()
+              << " callbacks/sec="
+              << (total_sec > 0.0 ? callback.num_callbacks() / total_sec : 0.0)
+              << " bytes=" << callback.num_bytes() << std::endl;
+  }
+
+ private:
+  double Percentile(int percent) const {
+    const size_t index = (latencies_.size() - 1) * percent / 100;
+    return latencies_[index];
+  }
+
+  const string name_;
+  std::vector<double> latencies_;
+
+  DISALLOW_COPY_AND_ASSIGN(LatencyRecorder);
+};
+
+void LoadQueries(std::vector<string> *queries) {
+  if (FLAGS_query_file.empty()) {
+    for (size_t i = 0; i < arraysize(kDefaultQueries); ++i) {
+      queries->push_back(kDefaultQueries[i]);
+    }
+    return;
+  }
+  InputFileStream ifs(FLAGS_query_file.c_str());
+  CHECK(ifs.good()) << "Cannot open " << FLAGS_query_file;
+  string line;
+  while (queries->size() < static_cast<size_t>(FLAGS_max_queries) &&
+         !getline(ifs, line).fail()) {
+    Util::ChopReturns(&line);
+    const string::size_type tab_pos = line.find('\t');
+    const string reading = line.substr(0, tab_pos);
+    if (!reading.empty()) {
+      queries->push_back(reading);
+    }
+  }
+}
+
+// Function type of DictionaryInterface::Lookup*.
+typedef void (SystemDictionary::*LookupMethod)(
+    StringPiece, const ConversionRequest &,
+    DictionaryInterface::Callback *) const;
+
+void RunLookup(const SystemDictionary &dictionary, LookupMethod method,
+               const std::vector<string> &queries,
+               const ConversionRequest &request, const string &name,
+               CountingCallback::TokenFilter filter) {
+  LatencyRecorder recorder(name);
+  CountingCallback callback(filter);
+  for (int iter = 0; iter < FLAGS_iterations; ++iter) {
+    for (size_t i = 0; i < queries.size(); ++i) {
+      callback.set_lookup_key(queries[i]);
+      Stopwatch stopwatch = Stopwatch::StartNew();
+      (dictionary.*method)(queries[i], request, &callback);
+      stopwatch.Stop();
+      recorder.Add(stopwatch.GetElapsedNanoseconds());
+    }
+  }
+  recorder.Report(callback);
+}
+
+void RunBenchmark(const SystemDictionary &dictionary,
+                  const std::vector<string> &queries) {
+  commands::Request request;
+  config::Config config;
+  config::ConfigHandler::GetDefaultConfig(&config);
+  ConversionRequest convreq;
+  convreq.set_request(&request);
+  convreq.set_config(&config);
+
+  // Prefix lookup is called for every suffix of the input by the converter.
+  std::vector<string> suffixes;
+  for (size_t i = 0; i < queries.size(); ++i) {
+    std::vector<string> chars;
+    Util::SplitStringToUtf8Chars(queries[i], &chars);
+    string suffix;
+    for (size_t j = chars.size(); j > 0; --j) {
+      suffix.insert(0, chars[j - 1]);
+      suffixes.push_back(suffix);
+    }
+  }
+
+  std::vector<string> stripped_queries, stripped_suffixes;
+  for (size_t i = 0; i < queries.size(); ++i) {
+    stripped_queries.push_back(StripKanaModifiers(queries[i]));
+  }
+  for (size_t i = 0; i < suffixes.size(); ++i) {
+    stripped_suffixes.push_back(StripKanaModifiers(suffixes[i]));
+  }
+
+  RunLookup(dictionary, &SystemDictionary::LookupPrefix, suffixes, convreq,
+            "LookupPrefix", CountingCallback::ALL_TOKENS);
+  RunLookup(dictionary, &SystemDictionary::LookupPredictive, queries, convreq,
+            "LookupPredictive", CountingCallback::ALL_TOKENS);
+  RunLookup(dictionary, &SystemDictionary::LookupExact, queries, convreq,
+            "LookupExact", CountingCallback::ALL_TOKENS);
+  RunLookup(dictionary, &SystemDictionary::LookupPrefix, suffixes, convreq,
+            "LookupPrefix (whole key, OnToken)",
+            CountingCallback::WHOLE_KEY_IN_ON_TOKEN);
+  RunLookup(dictionary, &SystemDictionary::LookupPrefix, suffixes, convreq,
+            "LookupPrefix (whole key, ShouldDecodeValue)",
+            CountingCallback::WHOLE_KEY_IN_SHOULD_DECODE_VALUE);
+
+  // Key expansion cases.
+  request.set_kana_modifier_insensitive_conversion(true);
+  config.set_use_kana_modifier_insensitive_conversion(true);
+  RunLookup(dictionary, &SystemDictionary::LookupPrefix, stripped_suffixes,
+            convreq, "LookupPrefix (key expansion)",
+            CountingCallback::ALL_TOKENS);
+  RunLookup(dictionary, &SystemDictionary::LookupPredictive, stripped_queries,
+            convreq, "LookupPredictive (key expansion)",
+            CountingCallback::ALL_TOKENS);
+  request.set_kana_modifier_insensitive_conversion(false);
+  config.set_use_kana_modifier_insensitive_conversion(false);
+
+  // Collects surface forms for reverse lookup.
+  std::vector<string> values;
+  {
+    CountingCallback callback(CountingCallback::ALL_TOKENS);
+    callback.set_values(&values);
+    for (size_t i = 0; i < queries.size(); ++i) {
+      dictionary.LookupExact(queries[i], convreq, &callback);
+    }
+  }
+  if (values.size() > static_cast<size_t>(FLAGS_max_queries)) {
+    values.resize(FLAGS_max_queries);
+  }
+  RunLookup(dictionary, &SystemDictionary::LookupReverse, values, convreq,
+            "LookupReverse", CountingCallback::ALL_TOKENS);
+}
+
+}  // namespace
+}  // namespace dictionary
+}  // namespace mozc
+
+int main(int argc, char **argv) {
+  mozc::InitMozc(argv[0], &argc, &argv, false);
+
+  const char *data = nullptr;
+  int size = 0;
+  std::unique_ptr<mozc::DataManager> data_manager;
+  mozc::Mmap dictionary_mmap;
+  if (!FLAGS_dictionary_file.empty()) {
+    CHECK(dictionary_mmap.Open(FLAGS_dictionary_file.c_str()))
+        << "Failed to open " << FLAGS_dictionary_file;
+    data = dictionary_mmap.begin();
+    size = static_cast<int>(dictionary_mmap.size());
+  } else {
+    if (FLAGS_engine_data.empty()) {
+      data_manager.reset(new mozc::oss::OssDataManager());
+    } else {
+      data_manager.reset(new mozc::DataManager());
+      const mozc::DataManager::Status status =
+          data_manager->InitFromFile(FLAGS_engine_data, FLAGS_magic);
+      CHECK_EQ(status, mozc::DataManager::Status::OK)
+          << "Failed to load " << FLAGS_engine_data;
+    }
+    data_manager->GetSystemDictionaryData(&data, &size);
+  }
+
+  mozc::Stopwatch open_stopwatch = mozc::Stopwatch::StartNew();
+  mozc::dictionary::SystemDictionary::Builder builder(data, size);
+  if (FLAGS_enable_reverse_lookup_index) {
+    builder.SetOptions(
+        mozc::dictionary::SystemDictionary::ENABLE_REVERSE_LOOKUP_INDEX);
+  }
+  std::unique_ptr<mozc::dictionary::SystemDictionary> dictionary(
+      builder.Build());
+  open_stopwatch.Stop();
+  CHECK(dictionary) << "Failed to open the system dictionary";
+  std::cout << "Open: " << open_stopwatch.GetElapsedMicroseconds() << "us, "
+            << "data size=" << size << std::endl;
+
+  std::vector<string> queries;
+  mozc::dictionary::LoadQueries(&queries);
+  std::cout << "Queries: " << queries.size() << std::endl;
+  mozc::dictionary::RunBenchmark(*dictionary, queries);
+
+  return 0;
+}
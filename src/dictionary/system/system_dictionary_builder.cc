@@ -32,12 +32,15 @@
 #include <algorithm>
 #include <climits>
 #include <cstring>
+#include <functional>
 #include <sstream>
 
 #include "base/file_stream.h"
 #include "base/flags.h"
 #include "base/logging.h"
 #include "base/mozc_hash_set.h"
+#include "base/parallel.h"
+#include "base/stopwatch.h"
 #include "base/util.h"
 #include "dictionary/dictionary_token.h"
 #include "dictionary/file/codec_factory.h"
@@ -45,20 +48,28 @@
 #include "dictionary/pos_matcher.h"
 #include "dictionary/system/codec.h"
 #include "dictionary/system/codec_interface.h"
+#include "dictionary/system/reverse_lookup_index.h"
+#include "dictionary/system/trie_cache_size.h"
 #include "dictionary/system/words_info.h"
 #include "dictionary/text_dictionary_loader.h"
+#include "storage/louds/bit_vector_based_array.h"
 #include "storage/louds/bit_vector_based_array_builder.h"
+#include "storage/louds/louds_trie.h"
 #include "storage/louds/louds_trie_builder.h"
 
 DEFINE_bool(preserve_intermediate_dictionary, false,
             "preserve inetemediate dictionary file.");
 DEFINE_int32(min_key_length_to_use_small_cost_encoding, 6,
              "minimum key length to use 1 byte cost encoding.");
+DEFINE_bool(build_reverse_lookup_index, false,
+            "embed the reverse lookup index into the dictionary file.");
 
 namespace mozc {
 namespace dictionary {
 
+using mozc::storage::louds::LoudsTrie;
 using mozc::storage::louds::LoudsTrieBuilder;
+using mozc::storage::louds::BitVectorBasedArray;
 using mozc::storage::louds::BitVectorBasedArrayBuilder;
 
 namespace {
@@ -85,6 +96,24 @@ void WriteSectionToFile(const DictionaryFileSection &section,
   ofs.write(section.ptr, section.len);
 }
 
+// Logs the time spent in a phase of the build on destruction.
+class ScopedPhaseTimer {
+ public:
+  explicit ScopedPhaseTimer(const char *phase)
+      : phase_(phase), stopwatch_(Stopwatch::StartNew()) {}
+
+  ~ScopedPhaseTimer() {
+    LOG(INFO) << phase_ << ": " << stopwatch_.GetElapsedMilliseconds()
+              << " msec";
+  }
+
+ private:
+  const char *phase_;
+  Stopwatch stopwatch_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedPhaseTimer);
+};
+
 }  // namespace
 
 SystemDictionaryBuilder::SystemDictionaryBuilder()
@@ -92,7 +121,8 @@ SystemDictionaryBuilder::SystemDictionaryBuilder()
       key_trie_builder_(new LoudsTrieBuilder),
       token_array_builder_(new BitVectorBasedArrayBuilder),
       codec_(SystemDictionaryCodecFactory::GetCodec()),
-      file_codec_(DictionaryFileCodecFactory::GetCodec()) {}
+      file_codec_(DictionaryFileCodecFactory::GetCodec()),
+      num_threads_(1) {}
 
 // This class does not have the ownership of |codec|.
 SystemDictionaryBuilder::SystemDictionaryBuilder(
@@ -102,27 +132,71 @@ SystemDictionaryBuilder::SystemDictionaryBuilder(
       key_trie_builder_(new LoudsTrieBuilder),
       token_array_builder_(new BitVectorBasedArrayBuilder),
       codec_(codec),
-      file_codec_(file_codec) {}
+      file_codec_(file_codec),
+      num_threads_(1) {}
 
 SystemDictionaryBuilder::~SystemDictionaryBuilder() {}
 
 void SystemDictionaryBuilder::BuildFromTokens(
     const std::vector<Token *> &tokens) {
   KeyInfoList key_info_list;
-  ReadTokens(tokens, &key_info_list);
+  {
+    ScopedPhaseTimer timer("ReadTokens");
+    ReadTokens(tokens, &key_info_list);
+  }
 
-  BuildFrequentPos(key_info_list);
-  BuildValueTrie(key_info_list);
-  BuildKeyTrie(key_info_list);
+  // The frequent POS table and the two tries depend only on |key_info_list|,
+  // so they are built concurrently.
+  {
+    ScopedPhaseTimer timer("BuildFrequentPos, BuildValueTrie, BuildKeyTrie");
+    std::vector<std::function<void()>> tasks;
+    tasks.push_back([this, &key_info_list]() {
+      ScopedPhaseTimer timer("BuildFrequentPos");
+      BuildFrequentPos(key_info_list);
+    });
+    tasks.push_back([this, &key_info_list]() {
+      ScopedPhaseTimer timer("BuildValueTrie");
+      BuildValueTrie(key_info_list);
+      BuildValueTrieIndex();
+    });
+    tasks.push_back([this, &key_info_list]() {
+      ScopedPhaseTimer timer("BuildKeyTrie");
+      BuildKeyTrie(key_info_list);
+      BuildKeyTrieIndex();
+    });
+    if (num_threads_ > 1) {
+      RunInParallel(tasks);
+    } else {
+      for (size_t i = 0; i < tasks.size(); ++i) {
+        tasks[i]();
+      }
+    }
+  }
 
-  SetIdForValue(&key_info_list);
-  SetIdForKey(&key_info_list);
-  SortTokenInfo(&key_info_list);
-  SetCostType(&key_info_list);
-  SetPosType(&key_info_list);
-  SetValueType(&key_info_list);
+  // Each KeyInfo is updated independently of the others.
+  {
+    ScopedPhaseTimer timer("SetTokenInfo");
+    ParallelFor(key_info_list.size(), num_threads_,
+                [this, &key_info_list](size_t begin, size_t end) {
+      const KeyInfoList::iterator first = key_info_list.begin() + begin;
+      const KeyInfoList::iterator last = key_info_list.begin() + end;
+      SetIdForValue(first, last);
+      SetIdForKey(first, last);
+      SortTokenInfo(first, last);
+      SetCostType(first, last);
+      SetPosType(first, last);
+      SetValueType(first, last);
+    });
+  }
 
-  BuildTokenArray(key_info_list);
+  {
+    ScopedPhaseTimer timer("BuildTokenArray");
+    BuildTokenArray(key_info_list);
+  }
+  if (FLAGS_build_reverse_lookup_index) {
+    ScopedPhaseTimer timer("BuildReverseLookupIndex");
+    BuildReverseLookupIndex();
+  }
 }
 
 void SystemDictionaryBuilder::WriteToFile(const string &output_file) const {
@@ -164,6 +238,27 @@ void SystemDictionaryBuilder::WriteToStream(
     file_codec_->GetSectionName(codec_->GetSectionNameForPos()));
   sections.push_back(frequent_pos_section);
 
+  DictionaryFileSection value_trie_index_section(
+    value_trie_index_image_.data(),
+    value_trie_index_image_.size(),
+    file_codec_->GetSectionName(codec_->GetSectionNameForValueIndex()));
+  sections.push_back(value_trie_index_section);
+
+  DictionaryFileSection key_trie_index_section(
+    key_trie_index_image_.data(),
+    key_trie_index_image_.size(),
+    file_codec_->GetSectionName(codec_->GetSectionNameForKeyIndex()));
+  sections.push_back(key_trie_index_section);
+
+  DictionaryFileSection reverse_lookup_index_section(
+    reverse_lookup_index_image_.data(),
+    reverse_lookup_index_image_.size(),
+    file_codec_->GetSectionName(
+        codec_->GetSectionNameForReverseLookupIndex()));
+  if (!reverse_lookup_index_image_.empty()) {
+    sections.push_back(reverse_lookup_index_section);
+  }
+
   if (FLAGS_preserve_intermediate_dictionary &&
       !intermediate_output_file_base_path.empty()) {
     // Write out intermediate results to files.
@@ -173,6 +268,12 @@ void SystemDictionaryBuilder::WriteToStream(
     WriteSectionToFile(key_trie_section, basepath + ".key");
     WriteSectionToFile(token_array_section, basepath + ".tokens");
     WriteSectionToFile(frequent_pos_section, basepath + ".freq_pos");
+    WriteSectionToFile(value_trie_index_section, basepath + ".value_index");
+    WriteSectionToFile(key_trie_index_section, basepath + ".key_index");
+    if (!reverse_lookup_index_image_.empty()) {
+      WriteSectionToFile(reverse_lookup_index_section,
+                         basepath + ".reverse_index");
+    }
   }
 
   LOG(INFO) << "Start writing dictionary file.";
@@ -222,6 +323,49 @@ struct TokenPtrLessThan {
   }
 };
 
+// Stably sorts |tokens| by key on |num_threads| threads.  The chunks are
+// stably sorted and then merged in order, which gives the same result as
+// std::stable_sort() on the whole array.
+void StableSortTokensByKey(int num_threads, std::vector<Token *> *tokens) {
+  const size_t num_chunks =
+      std::max<size_t>(1, std::min<size_t>(num_threads, tokens->size()));
+  std::vector<size_t> bounds(num_chunks + 1);
+  for (size_t i = 0; i <= num_chunks; ++i) {
+    bounds[i] = tokens->size() * i / num_chunks;
+  }
+  ParallelFor(num_chunks, num_threads,
+              [tokens, &bounds](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      std::stable_sort(tokens->begin() + bounds[i],
+                       tokens->begin() + bounds[i + 1], TokenPtrLessThan());
+    }
+  });
+
+  // Merges adjacent pairs of the sorted runs until one run remains.
+  // std::inplace_merge() keeps the elements of the left run first among the
+  // equivalent ones, so the merge is stable.
+  while (bounds.size() > 2) {
+    const size_t num_pairs = (bounds.size() - 1) / 2;
+    ParallelFor(num_pairs, num_threads,
+                [tokens, &bounds](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        std::inplace_merge(tokens->begin() + bounds[2 * i],
+                           tokens->begin() + bounds[2 * i + 1],
+                           tokens->begin() + bounds[2 * i + 2],
+                           TokenPtrLessThan());
+      }
+    });
+    std::vector<size_t> merged_bounds;
+    for (size_t i = 0; i < bounds.size(); i += 2) {
+      merged_bounds.push_back(bounds[i]);
+    }
+    if (merged_bounds.back() != bounds.back()) {
+      merged_bounds.push_back(bounds.back());
+    }
+    bounds.swap(merged_bounds);
+  }
+}
+
 }  // namespace
 
 void SystemDictionaryBuilder::ReadTokens(const std::vector<Token *> &tokens,
@@ -243,8 +387,7 @@ void SystemDictionaryBuilder::ReadTokens(const std::vector<Token *> &tokens,
     CHECK(!token->value.empty()) << "empty value string in input";
     reduce_buffer.push_back(token);
   }
-  std::stable_sort(reduce_buffer.begin(), reduce_buffer.end(),
-                   TokenPtrLessThan());
+  StableSortTokensByKey(num_threads_, &reduce_buffer);
 
   // Step 2.
   key_info_list->clear();
@@ -262,9 +405,18 @@ void SystemDictionaryBuilder::ReadTokens(const std::vector<Token *> &tokens,
       last_key_info.key = token->key;
     }
     last_key_info.tokens.push_back(TokenInfo(token));
-    last_key_info.tokens.back().value_type = GetValueType(token);
   }
   key_info_list->push_back(last_key_info);
+
+  ParallelFor(key_info_list->size(), num_threads_,
+              [key_info_list](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      std::vector<TokenInfo> *token_infos = &(*key_info_list)[i].tokens;
+      for (size_t j = 0; j < token_infos->size(); ++j) {
+        (*token_infos)[j].value_type = GetValueType((*token_infos)[j].token);
+      }
+    }
+  });
 }
 
 void SystemDictionaryBuilder::BuildFrequentPos(
@@ -339,9 +491,9 @@ void SystemDictionaryBuilder::BuildValueTrie(const KeyInfoList &key_info_list) {
   value_trie_builder_->Build();
 }
 
-void SystemDictionaryBuilder::SetIdForValue(KeyInfoList *key_info_list) const {
-  for (KeyInfoList::iterator itr = key_info_list->begin();
-       itr != key_info_list->end(); ++itr) {
+void SystemDictionaryBuilder::SetIdForValue(KeyInfoList::iterator begin,
+                                            KeyInfoList::iterator end) const {
+  for (KeyInfoList::iterator itr = begin; itr != end; ++itr) {
     for (size_t i = 0; i < itr->tokens.size(); ++i) {
       TokenInfo *token_info = &(itr->tokens[i]);
       string value_str;
@@ -352,18 +504,18 @@ void SystemDictionaryBuilder::SetIdForValue(KeyInfoList *key_info_list) const {
   }
 }
 
-void SystemDictionaryBuilder::SortTokenInfo(KeyInfoList *key_info_list) const {
-  for (KeyInfoList::iterator itr = key_info_list->begin();
-       itr != key_info_list->end(); ++itr) {
+void SystemDictionaryBuilder::SortTokenInfo(KeyInfoList::iterator begin,
+                                            KeyInfoList::iterator end) const {
+  for (KeyInfoList::iterator itr = begin; itr != end; ++itr) {
     KeyInfo *key_info = &(*itr);
     std::sort(key_info->tokens.begin(), key_info->tokens.end(),
               TokenGreaterThan());
   }
 }
 
-void SystemDictionaryBuilder::SetCostType(KeyInfoList *key_info_list) const {
-  for (KeyInfoList::iterator itr = key_info_list->begin();
-       itr != key_info_list->end(); ++itr) {
+void SystemDictionaryBuilder::SetCostType(KeyInfoList::iterator begin,
+                                          KeyInfoList::iterator end) const {
+  for (KeyInfoList::iterator itr = begin; itr != end; ++itr) {
     KeyInfo *key_info = &(*itr);
     if (HasHomonymsInSamePos(*key_info)) {
       continue;
@@ -378,9 +530,9 @@ void SystemDictionaryBuilder::SetCostType(KeyInfoList *key_info_list) const {
   }
 }
 
-void SystemDictionaryBuilder::SetPosType(KeyInfoList *key_info_list) const {
-  for (KeyInfoList::iterator itr = key_info_list->begin();
-       itr != key_info_list->end(); ++itr) {
+void SystemDictionaryBuilder::SetPosType(KeyInfoList::iterator begin,
+                                         KeyInfoList::iterator end) const {
+  for (KeyInfoList::iterator itr = begin; itr != end; ++itr) {
     KeyInfo *key_info = &(*itr);
     for (size_t i = 0; i < key_info->tokens.size(); ++i) {
       TokenInfo *token_info = &(key_info->tokens[i]);
@@ -404,9 +556,9 @@ void SystemDictionaryBuilder::SetPosType(KeyInfoList *key_info_list) const {
   }
 }
 
-void SystemDictionaryBuilder::SetValueType(KeyInfoList *key_info_list) const {
-  for (KeyInfoList::iterator itr = key_info_list->begin();
-       itr != key_info_list->end(); ++itr) {
+void SystemDictionaryBuilder::SetValueType(KeyInfoList::iterator begin,
+                                           KeyInfoList::iterator end) const {
+  for (KeyInfoList::iterator itr = begin; itr != end; ++itr) {
     KeyInfo *key_info = &(*itr);
     for (size_t i = 1; i < key_info->tokens.size(); ++i) {
       const TokenInfo *prev_token_info = &(key_info->tokens[i - 1]);
@@ -430,9 +582,38 @@ void SystemDictionaryBuilder::BuildKeyTrie(const KeyInfoList &key_info_list) {
   key_trie_builder_->Build();
 }
 
-void SystemDictionaryBuilder::SetIdForKey(KeyInfoList *key_info_list) const {
-  for (KeyInfoList::iterator itr = key_info_list->begin();
-       itr != key_info_list->end(); ++itr) {
+// The rank/select indices and the caches are built in the same way as
+// SystemDictionary does, so that it can use them from the dictionary file
+// without scanning the tries at startup.
+void SystemDictionaryBuilder::BuildValueTrieIndex() {
+  LoudsTrie value_trie;
+  value_trie.Open(
+      reinterpret_cast<const uint8 *>(value_trie_builder_->image().data()),
+      kValueTrieLb0CacheSize,
+      kValueTrieLb1CacheSize,
+      kValueTrieSelect0CacheSize,
+      kValueTrieSelect1CacheSize,
+      kValueTrieTermvecCacheSize);
+  value_trie_index_image_.clear();
+  value_trie.AppendIndexImage(&value_trie_index_image_);
+}
+
+void SystemDictionaryBuilder::BuildKeyTrieIndex() {
+  LoudsTrie key_trie;
+  key_trie.Open(
+      reinterpret_cast<const uint8 *>(key_trie_builder_->image().data()),
+      kKeyTrieLb0CacheSize,
+      kKeyTrieLb1CacheSize,
+      kKeyTrieSelect0CacheSize,
+      kKeyTrieSelect1CacheSize,
+      kKeyTrieTermvecCacheSize);
+  key_trie_index_image_.clear();
+  key_trie.AppendIndexImage(&key_trie_index_image_);
+}
+
+void SystemDictionaryBuilder::SetIdForKey(KeyInfoList::iterator begin,
+                                          KeyInfoList::iterator end) const {
+  for (KeyInfoList::iterator itr = begin; itr != end; ++itr) {
     KeyInfo *key_info = &(*itr);
     string key_str;
     codec_->EncodeKey(key_info->key, &key_str);
@@ -456,11 +637,20 @@ void SystemDictionaryBuilder::BuildTokenArray(
       id_to_keyinfo_table[id] = &key_info;
     }
 
-    for (size_t i = 0; i < id_to_keyinfo_table.size(); ++i) {
-      const KeyInfo &key_info = *id_to_keyinfo_table[i];
-      string tokens_str;
-      codec_->EncodeTokens(key_info.tokens, &tokens_str);
-      token_array_builder_->Add(tokens_str);
+    // The tokens are encoded in parallel and then added in the order of the
+    // key IDs.
+    std::vector<string> encoded_tokens(id_to_keyinfo_table.size());
+    ParallelFor(id_to_keyinfo_table.size(), num_threads_,
+                [this, &id_to_keyinfo_table, &encoded_tokens](size_t begin,
+                                                              size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        codec_->EncodeTokens(id_to_keyinfo_table[i]->tokens,
+                             &encoded_tokens[i]);
+      }
+    });
+    for (size_t i = 0; i < encoded_tokens.size(); ++i) {
+      token_array_builder_->Add(encoded_tokens[i]);
+      string().swap(encoded_tokens[i]);
     }
   }
 
@@ -468,5 +658,13 @@ void SystemDictionaryBuilder::BuildTokenArray(
   token_array_builder_->Build();
 }
 
+void SystemDictionaryBuilder::BuildReverseLookupIndex() {
+  BitVectorBasedArray token_array;
+  token_array.Open(
+      reinterpret_cast<const uint8 *>(token_array_builder_->image().data()));
+  ReverseLookupIndex::BuildImage(codec_, token_array,
+                                 &reverse_lookup_index_image_);
+}
+
 }  // namespace dictionary
 }  // namespace mozc
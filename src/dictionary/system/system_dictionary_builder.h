@@ -69,6 +69,12 @@ class SystemDictionaryBuilder {
   SystemDictionaryBuilder(const SystemDictionaryCodecInterface *codec,
                           const DictionaryFileCodecInterface *file_codec);
   virtual ~SystemDictionaryBuilder();
+
+  // Sets the number of threads used by BuildFromTokens().  The built image
+  // is the same regardless of the number.  The default is 1.
+  void set_num_threads(int num_threads) { num_threads_ = num_threads; }
+
+  // Builds the dictionary and logs the time spent in each phase.
   void BuildFromTokens(const std::vector<Token *> &tokens);
 
   void WriteToFile(const string &output_file) const;
@@ -87,26 +93,45 @@ class SystemDictionaryBuilder {
 
   void BuildKeyTrie(const KeyInfoList &key_info_list);
 
-  void BuildTokenArray(const KeyInfoList &key_info_list);
+  // Build the index images of the value and key tries, respectively.
+  void BuildValueTrieIndex();
+  void BuildKeyTrieIndex();
 
-  void SetIdForValue(KeyInfoList *key_info_list) const;
-  void SetIdForKey(KeyInfoList *key_info_list) const;
-  void SortTokenInfo(KeyInfoList *key_info_list) const;
+  void BuildTokenArray(const KeyInfoList &key_info_list);
 
-  void SetCostType(KeyInfoList *key_info_list) const;
-  void SetPosType(KeyInfoList *keyinfomap) const;
-  void SetValueType(KeyInfoList *key_info_list) const;
+  // Builds the image of ReverseLookupIndex from the token array.
+  void BuildReverseLookupIndex();
+
+  // The following methods update the KeyInfo in [begin, end) and can be
+  // called concurrently for disjoint ranges.
+  void SetIdForValue(KeyInfoList::iterator begin,
+                     KeyInfoList::iterator end) const;
+  void SetIdForKey(KeyInfoList::iterator begin,
+                   KeyInfoList::iterator end) const;
+  void SortTokenInfo(KeyInfoList::iterator begin,
+                     KeyInfoList::iterator end) const;
+
+  void SetCostType(KeyInfoList::iterator begin,
+                   KeyInfoList::iterator end) const;
+  void SetPosType(KeyInfoList::iterator begin,
+                  KeyInfoList::iterator end) const;
+  void SetValueType(KeyInfoList::iterator begin,
+                    KeyInfoList::iterator end) const;
 
   std::unique_ptr<mozc::storage::louds::LoudsTrieBuilder> value_trie_builder_;
   std::unique_ptr<mozc::storage::louds::LoudsTrieBuilder> key_trie_builder_;
   std::unique_ptr<mozc::storage::louds::BitVectorBasedArrayBuilder>
       token_array_builder_;
+  string value_trie_index_image_;
+  string key_trie_index_image_;
+  string reverse_lookup_index_image_;
 
   // mapping from {left_id, right_id} to POS index (0--255)
   std::map<uint32, int> frequent_pos_;
 
   const SystemDictionaryCodecInterface *codec_;
   const DictionaryFileCodecInterface *file_codec_;
+  int num_threads_;
 
   DISALLOW_COPY_AND_ASSIGN(SystemDictionaryBuilder);
 };
@@ -32,12 +32,15 @@
 #include <algorithm>
 #include <cstdlib>
 #include <memory>
+#include <sstream>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "base/file_stream.h"
 #include "base/file_util.h"
 #include "base/logging.h"
+#include "base/mmap.h"
 #include "base/port.h"
 #include "base/stl_util.h"
 #include "base/system_util.h"
@@ -46,6 +49,9 @@
 #include "data_manager/testing/mock_data_manager.h"
 #include "dictionary/dictionary_test_util.h"
 #include "dictionary/dictionary_token.h"
+#include "dictionary/file/codec_factory.h"
+#include "dictionary/file/codec_interface.h"
+#include "dictionary/file/section.h"
 #include "dictionary/pos_matcher.h"
 #include "dictionary/system/codec_interface.h"
 #include "dictionary/system/system_dictionary_builder.h"
@@ -62,6 +68,7 @@ DEFINE_int32(dictionary_test_size, 100000,
 DEFINE_int32(dictionary_reverse_lookup_test_size, 1000,
              "Number of tokens to run reverse lookup test.");
 DECLARE_int32(min_key_length_to_use_small_cost_encoding);
+DECLARE_bool(build_reverse_lookup_index);
 
 namespace mozc {
 namespace dictionary {
@@ -88,6 +95,8 @@ class SystemDictionaryTest : public ::testing::Test {
     original_flags_min_key_length_to_use_small_cost_encoding_ =
         FLAGS_min_key_length_to_use_small_cost_encoding;
     FLAGS_min_key_length_to_use_small_cost_encoding = kint32max;
+    original_flags_build_reverse_lookup_index_ =
+        FLAGS_build_reverse_lookup_index;
 
     request_.Clear();
     config::ConfigHandler::GetDefaultConfig(&config_);
@@ -96,6 +105,8 @@ class SystemDictionaryTest : public ::testing::Test {
   void TearDown() override {
     FLAGS_min_key_length_to_use_small_cost_encoding =
         original_flags_min_key_length_to_use_small_cost_encoding_;
+    FLAGS_build_reverse_lookup_index =
+        original_flags_build_reverse_lookup_index_;
 
     // This config initialization will be removed once ConversionRequest can
     // take config as an injected argument.
@@ -120,6 +131,7 @@ class SystemDictionaryTest : public ::testing::Test {
   commands::Request request_;
   const string dic_fn_;
   int original_flags_min_key_length_to_use_small_cost_encoding_;
+  bool original_flags_build_reverse_lookup_index_;
 };
 
 void SystemDictionaryTest::BuildSystemDictionary(
@@ -351,6 +363,84 @@ TEST_F(SystemDictionaryTest, LookupAllWords) {
   }
 }
 
+TEST_F(SystemDictionaryTest, LookupAllWordsWithoutTrieIndex) {
+  const std::vector<Token *> &source_tokens = text_dict_->tokens();
+  BuildSystemDictionary(source_tokens, FLAGS_dictionary_test_size);
+
+  // Drop the index sections of the tries.  The indices are built when the
+  // dictionary is opened then.
+  const DictionaryFileCodecInterface *file_codec =
+      DictionaryFileCodecFactory::GetCodec();
+  const SystemDictionaryCodecInterface *codec =
+      SystemDictionaryCodecFactory::GetCodec();
+  const string key_index_name =
+      file_codec->GetSectionName(codec->GetSectionNameForKeyIndex());
+  const string value_index_name =
+      file_codec->GetSectionName(codec->GetSectionNameForValueIndex());
+  const string no_index_fn = dic_fn_ + ".no_index";
+  {
+    Mmap mmap;
+    ASSERT_TRUE(mmap.Open(dic_fn_.c_str()));
+    std::vector<DictionaryFileSection> sections;
+    ASSERT_TRUE(file_codec->ReadSections(mmap.begin(), mmap.size(),
+                                         &sections));
+    std::vector<DictionaryFileSection> sections_without_index;
+    for (const DictionaryFileSection &section : sections) {
+      if (section.name != key_index_name && section.name != value_index_name) {
+        sections_without_index.push_back(section);
+      }
+    }
+    EXPECT_EQ(sections.size() - 2, sections_without_index.size());
+    OutputFileStream ofs(no_index_fn.c_str(), std::ios::binary);
+    file_codec->WriteSections(sections_without_index, &ofs);
+  }
+
+  unique_ptr<SystemDictionary> system_dic(
+      SystemDictionary::Builder(no_index_fn).Build());
+  ASSERT_TRUE(system_dic.get() != NULL)
+      << "Failed to open dictionary source:" << no_index_fn;
+  for (size_t i = 0; i < source_tokens.size(); ++i) {
+    CheckTokenExistenceCallback callback(source_tokens[i]);
+    system_dic->LookupPrefix(source_tokens[i]->key, convreq_, &callback);
+    EXPECT_TRUE(callback.found())
+        << "Token was not found: " << PrintToken(*source_tokens[i]);
+  }
+  system_dic.reset();
+  FileUtil::Unlink(no_index_fn);
+}
+
+TEST_F(SystemDictionaryTest, BuildWithMultipleThreads) {
+  FLAGS_build_reverse_lookup_index = true;
+  const string dic_path = mozc::testing::GetSourceFileOrDie({
+      "data", "dictionary_oss", "dictionary00.txt"});
+  TextDictionaryLoader parallel_text_dict(pos_matcher_);
+  parallel_text_dict.set_num_threads(4);
+  parallel_text_dict.LoadWithLineLimit(dic_path, "",
+                                       FLAGS_dictionary_test_size);
+  ASSERT_EQ(text_dict_->tokens().size(), parallel_text_dict.tokens().size());
+  for (size_t i = 0; i < text_dict_->tokens().size(); ++i) {
+    EXPECT_TRUE(CompareTokensForLookup(*text_dict_->tokens()[i],
+                                       *parallel_text_dict.tokens()[i],
+                                       false));
+  }
+
+  // The image has to be the same as the one built on a single thread.
+  std::ostringstream serial_image;
+  {
+    SystemDictionaryBuilder builder;
+    builder.BuildFromTokens(text_dict_->tokens());
+    builder.WriteToStream("", &serial_image);
+  }
+  std::ostringstream parallel_image;
+  {
+    SystemDictionaryBuilder builder;
+    builder.set_num_threads(4);
+    builder.BuildFromTokens(parallel_text_dict.tokens());
+    builder.WriteToStream("", &parallel_image);
+  }
+  EXPECT_EQ(serial_image.str(), parallel_image.str());
+}
+
 TEST_F(SystemDictionaryTest, SimpleLookupPrefix) {
   const string k0 = "は";
   const string k1 = "はひふへほ";
@@ -650,6 +740,66 @@ TEST_F(SystemDictionaryTest, LookupExact) {
   EXPECT_TRUE(callback_hoge.tokens().empty());
 }
 
+namespace {
+
+// Collects tokens but asks the dictionary to skip decoding the values of
+// tokens whose cost is above the threshold.
+class CostThresholdCallback : public CollectTokenCallback {
+ public:
+  explicit CostThresholdCallback(int max_cost)
+      : max_cost_(max_cost), num_skipped_(0) {}
+
+  bool ShouldDecodeValue(const Token &token) override {
+    if (token.cost > max_cost_) {
+      ++num_skipped_;
+      return false;
+    }
+    return true;
+  }
+
+  int num_skipped() const { return num_skipped_; }
+
+ private:
+  const int max_cost_;
+  int num_skipped_;
+};
+
+}  // namespace
+
+TEST_F(SystemDictionaryTest, ShouldDecodeValueSkipsTokens) {
+  std::vector<Token *> source_tokens;
+
+  const string k0 = "はひふへほ";
+  unique_ptr<Token> t0(CreateToken(k0, "cheap"));
+  t0->cost = 100;
+  unique_ptr<Token> t1(CreateToken(k0, "expensive"));
+  t1->cost = 5000;
+  source_tokens.push_back(t0.get());
+  source_tokens.push_back(t1.get());
+  BuildSystemDictionary(source_tokens, 100);
+
+  unique_ptr<SystemDictionary> system_dic(
+      SystemDictionary::Builder(dic_fn_).Build());
+  ASSERT_TRUE(system_dic.get() != NULL)
+      << "Failed to open dictionary source:" << dic_fn_;
+
+  CostThresholdCallback exact_callback(1000);
+  system_dic->LookupExact(k0, convreq_, &exact_callback);
+  ASSERT_EQ(1, exact_callback.tokens().size());
+  EXPECT_EQ("cheap", exact_callback.tokens()[0].value);
+  EXPECT_EQ(1, exact_callback.num_skipped());
+
+  CostThresholdCallback prefix_callback(1000);
+  system_dic->LookupPrefix(k0, convreq_, &prefix_callback);
+  ASSERT_EQ(1, prefix_callback.tokens().size());
+  EXPECT_EQ("cheap", prefix_callback.tokens()[0].value);
+
+  CostThresholdCallback predictive_callback(1000);
+  system_dic->LookupPredictive("はひ", convreq_, &predictive_callback);
+  ASSERT_EQ(1, predictive_callback.tokens().size());
+  EXPECT_EQ("cheap", predictive_callback.tokens()[0].value);
+}
+
 TEST_F(SystemDictionaryTest, LookupReverse) {
   unique_ptr<Token> t0(new Token);
   t0->key = "ど";
@@ -820,6 +970,64 @@ TEST_F(SystemDictionaryTest, LookupReverseIndex) {
   }
 }
 
+TEST_F(SystemDictionaryTest, LookupReverseIndexInDictionaryFile) {
+  const std::vector<Token *> &source_tokens = text_dict_->tokens();
+  FLAGS_build_reverse_lookup_index = true;
+  BuildSystemDictionary(source_tokens, FLAGS_dictionary_test_size);
+
+  // The index is embedded in the dictionary file.
+  {
+    const DictionaryFileCodecInterface *file_codec =
+        DictionaryFileCodecFactory::GetCodec();
+    const string index_name = file_codec->GetSectionName(
+        SystemDictionaryCodecFactory::GetCodec()
+            ->GetSectionNameForReverseLookupIndex());
+    Mmap mmap;
+    ASSERT_TRUE(mmap.Open(dic_fn_.c_str()));
+    std::vector<DictionaryFileSection> sections;
+    ASSERT_TRUE(file_codec->ReadSections(mmap.begin(), mmap.size(),
+                                         &sections));
+    bool found = false;
+    for (const DictionaryFileSection &section : sections) {
+      if (section.name == index_name) {
+        found = true;
+        EXPECT_LT(0, section.len);
+      }
+    }
+    EXPECT_TRUE(found);
+  }
+
+  unique_ptr<SystemDictionary> system_dic_without_index(
+      SystemDictionary::Builder(dic_fn_)
+      .SetOptions(SystemDictionary::NONE)
+      .Build());
+  ASSERT_TRUE(system_dic_without_index.get() != NULL)
+      << "Failed to open dictionary source:" << dic_fn_;
+  unique_ptr<SystemDictionary> system_dic_with_index(
+      SystemDictionary::Builder(dic_fn_)
+      .SetOptions(SystemDictionary::ENABLE_REVERSE_LOOKUP_INDEX)
+      .Build());
+  ASSERT_TRUE(system_dic_with_index.get() != NULL)
+      << "Failed to open dictionary source:" << dic_fn_;
+
+  std::vector<Token *>::const_iterator it;
+  int size = FLAGS_dictionary_reverse_lookup_test_size;
+  for (it = source_tokens.begin();
+       size > 0 && it != source_tokens.end(); ++it, --size) {
+    const Token &t = **it;
+    CollectTokenCallback callback1, callback2;
+    system_dic_without_index->LookupReverse(t.value, convreq_, &callback1);
+    system_dic_with_index->LookupReverse(t.value, convreq_, &callback2);
+
+    const std::vector<Token> &tokens1 = callback1.tokens();
+    const std::vector<Token> &tokens2 = callback2.tokens();
+    ASSERT_EQ(tokens1.size(), tokens2.size());
+    for (size_t i = 0; i < tokens1.size(); ++i) {
+      EXPECT_TOKEN_EQ(tokens1[i], tokens2[i]);
+    }
+  }
+}
+
 TEST_F(SystemDictionaryTest, LookupReverseWithCache) {
   const string kDoraemon = "ドラえもん";
 
@@ -44,6 +44,9 @@
 namespace mozc {
 namespace dictionary {
 
+// Decodes the tokens of a key one by one.  The value of a token is decoded
+// only when Get() is called, so that callers can skip tokens by cost, POS or
+// attributes without restoring the value from the value trie.
 class TokenDecodeIterator {
  public:
   TokenDecodeIterator(const SystemDictionaryCodecInterface *codec,
@@ -53,7 +56,18 @@ class TokenDecodeIterator {
                       const uint8 *ptr);
   ~TokenDecodeIterator() {}
 
-  const TokenInfo& Get() const { return token_info_; }
+  // Returns the current token with its value decoded.
+  const TokenInfo &Get() const {
+    if (!value_decoded_) {
+      DecodeValue();
+    }
+    return token_info_;
+  }
+
+  // Returns the current token without decoding its value.  All the fields but
+  // Token::value are valid.
+  const TokenInfo &GetWithoutValue() const { return token_info_; }
+
   bool Done() const { return state_ == DONE; }
   void Next();
 
@@ -65,6 +79,7 @@ class TokenDecodeIterator {
   };
 
   void NextInternal();
+  void DecodeValue() const;
 
   void LookupValue(int id, string *value) const {
     char buffer[storage::louds::LoudsTrie::kMaxDepth + 1];
@@ -78,13 +93,23 @@ class TokenDecodeIterator {
 
   const StringPiece key_;
   // Katakana key will be lazily initialized.
-  string key_katakana_;
+  mutable string key_katakana_;
 
   State state_;
   const uint8 *ptr_;
 
   TokenInfo token_info_;
-  Token token_;
+  mutable Token token_;
+
+  // The value of the current token is restored from |value_type_| and
+  // |value_id_|, which are carried over for SAME_AS_PREV_VALUE.
+  TokenInfo::ValueType value_type_;
+  int value_id_;
+  // True if |token_.value| is the value of the current token.
+  mutable bool value_decoded_;
+  // True if |token_.value| is the value of |value_type_| and |value_id_|
+  // without an accent suffix.  It is reused by SAME_AS_PREV_VALUE tokens.
+  mutable bool base_value_decoded_;
 
   DISALLOW_COPY_AND_ASSIGN(TokenDecodeIterator);
 };
@@ -103,7 +128,11 @@ inline TokenDecodeIterator::TokenDecodeIterator(
       key_(key),
       state_(HAS_NEXT),
       ptr_(ptr),
-      token_info_(nullptr) {
+      token_info_(nullptr),
+      value_type_(TokenInfo::DEFAULT_VALUE),
+      value_id_(-1),
+      value_decoded_(false),
+      base_value_decoded_(false) {
   token_.key.assign(key.data(), key.size());
   NextInternal();
 }
@@ -147,11 +176,15 @@ inline void TokenDecodeIterator::NextInternal() {
   }
   ptr_ += read_bytes;
 
-  // Fill remaining values.
+  // Remember where the value comes from.  It is decoded by Get().
   switch (token_info_.value_type) {
     case TokenInfo::DEFAULT_VALUE: {
-      token_.value.clear();
-      LookupValue(token_info_.id_in_value_trie, &token_.value);
+      if (value_type_ != TokenInfo::DEFAULT_VALUE ||
+          value_id_ != token_info_.id_in_value_trie) {
+        base_value_decoded_ = false;
+      }
+      value_type_ = TokenInfo::DEFAULT_VALUE;
+      value_id_ = token_info_.id_in_value_trie;
       break;
     }
     case TokenInfo::SAME_AS_PREV_VALUE: {
@@ -160,15 +193,13 @@ inline void TokenDecodeIterator::NextInternal() {
       // We can keep the current value here.
       break;
     }
-    case TokenInfo::AS_IS_HIRAGANA: {
-      token_.value = token_.key;
-      break;
-    }
+    case TokenInfo::AS_IS_HIRAGANA:
     case TokenInfo::AS_IS_KATAKANA: {
-      if (!key_.empty() && key_katakana_.empty()) {
-        Util::HiraganaToKatakana(key_, &key_katakana_);
+      if (value_type_ != token_info_.value_type) {
+        base_value_decoded_ = false;
       }
-      token_.value = key_katakana_;
+      value_type_ = token_info_.value_type;
+      value_id_ = -1;
       break;
     }
     default: {
@@ -176,11 +207,7 @@ inline void TokenDecodeIterator::NextInternal() {
       break;
     }
   }
-
-  if (token_info_.accent_encoding_type == TokenInfo::EMBEDDED_IN_TOKEN) {
-    token_.value.append(1, '_')
-                .append(Util::StringPrintf("%d", token_info_.accent_type));
-  }
+  value_decoded_ = false;
 
   if (token_info_.pos_type == TokenInfo::FREQUENT_POS) {
     const uint32 pos = frequent_pos_[token_info_.id_in_frequent_pos_map];
@@ -189,6 +216,41 @@ inline void TokenDecodeIterator::NextInternal() {
   }
 }
 
+inline void TokenDecodeIterator::DecodeValue() const {
+  if (!base_value_decoded_) {
+    switch (value_type_) {
+      case TokenInfo::DEFAULT_VALUE: {
+        token_.value.clear();
+        LookupValue(value_id_, &token_.value);
+        break;
+      }
+      case TokenInfo::AS_IS_HIRAGANA: {
+        token_.value = token_.key;
+        break;
+      }
+      case TokenInfo::AS_IS_KATAKANA: {
+        if (!key_.empty() && key_katakana_.empty()) {
+          Util::HiraganaToKatakana(key_, &key_katakana_);
+        }
+        token_.value = key_katakana_;
+        break;
+      }
+      default: {
+        LOG(DFATAL) << "unknown value_type: " << value_type_;
+        break;
+      }
+    }
+    base_value_decoded_ = true;
+  }
+
+  if (token_info_.accent_encoding_type == TokenInfo::EMBEDDED_IN_TOKEN) {
+    token_.value.append(1, '_')
+                .append(Util::StringPrintf("%d", token_info_.accent_type));
+    base_value_decoded_ = false;
+  }
+  value_decoded_ = true;
+}
+
 }  // namespace dictionary
 }  // namespace mozc
 
@@ -45,6 +45,7 @@
 #include "base/logging.h"
 #include "base/multifile.h"
 #include "base/number_util.h"
+#include "base/parallel.h"
 #include "base/stl_util.h"
 #include "base/string_piece.h"
 #include "base/util.h"
@@ -120,11 +121,14 @@ inline std::vector<Token *>::const_iterator CEnd(
 
 TextDictionaryLoader::TextDictionaryLoader(const POSMatcher &pos_matcher)
     : zipcode_id_(pos_matcher.GetZipcodeId()),
-      isolated_word_id_(pos_matcher.GetIsolatedWordId()) {}
+      isolated_word_id_(pos_matcher.GetIsolatedWordId()),
+      num_threads_(1) {}
 
 TextDictionaryLoader::TextDictionaryLoader(uint16 zipcode_id,
                                            uint16 isolated_word_id)
-    : zipcode_id_(zipcode_id), isolated_word_id_(isolated_word_id) {}
+    : zipcode_id_(zipcode_id),
+      isolated_word_id_(isolated_word_id),
+      num_threads_(1) {}
 
 TextDictionaryLoader::~TextDictionaryLoader() {
   Clear();
@@ -174,16 +178,40 @@ void TextDictionaryLoader::LoadWithLineLimit(
     tokens_.reserve(limit);
   }
 
-  // Read system dictionary.
+  // Read system dictionary.  The lines are read in batches, each of which is
+  // parsed on |num_threads_| threads.  A batch has at most |limit| lines so
+  // that no line after the limit is parsed.
   {
+    const int kMaxBatchSize = 1 << 16;
     InputMultiFile file(dictionary_filename);
-    string line;
-    while (limit > 0 && file.ReadLine(&line)) {
-      Util::ChopReturns(&line);
-      Token *token = ParseTSVLine(line);
-      if (token) {
-        tokens_.push_back(token);
-        --limit;
+    std::vector<string> lines;
+    std::vector<Token *> batch_tokens;
+    bool eof = false;
+    while (limit > 0 && !eof) {
+      const size_t batch_size = std::min(limit, kMaxBatchSize);
+      lines.resize(batch_size);
+      size_t num_lines = 0;
+      while (num_lines < batch_size) {
+        if (!file.ReadLine(&lines[num_lines])) {
+          eof = true;
+          break;
+        }
+        ++num_lines;
+      }
+
+      batch_tokens.assign(num_lines, nullptr);
+      ParallelFor(num_lines, num_threads_,
+                  [this, &lines, &batch_tokens](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+          Util::ChopReturns(&lines[i]);
+          batch_tokens[i] = ParseTSVLine(lines[i]);
+        }
+      });
+      for (size_t i = 0; i < num_lines; ++i) {
+        if (batch_tokens[i]) {
+          tokens_.push_back(batch_tokens[i]);
+          --limit;
+        }
       }
     }
     LOG(INFO) << tokens_.size() << " tokens from " << dictionary_filename;
@@ -69,6 +69,11 @@ class TextDictionaryLoader {
   // Clears the loaded tokens.
   void Clear();
 
+  // Sets the number of threads used to parse the lines of the dictionary
+  // files.  The loaded tokens are the same regardless of the number.  The
+  // default is 1.
+  void set_num_threads(int num_threads) { num_threads_ = num_threads; }
+
   // Adds a token.  The ownership is taken by the loader.
   void AddToken(Token *token) {
     tokens_.push_back(token);
@@ -84,7 +89,8 @@ class TextDictionaryLoader {
   void CollectTokens(std::vector<Token *> *res) const;
 
  protected:
-  // Allows derived classes to implement custom filtering rules.
+  // Allows derived classes to implement custom filtering rules.  This may be
+  // called concurrently when the number of threads is more than 1.
   virtual Token *ParseTSV(const std::vector<StringPiece> &columns) const;
 
  private:
@@ -106,6 +112,7 @@ class TextDictionaryLoader {
 
   const uint16 zipcode_id_;
   const uint16 isolated_word_id_;
+  int num_threads_;
   std::vector<Token *> tokens_;
 
   FRIEND_TEST(TextDictionaryLoaderTest, RewriteSpecialTokenTest);
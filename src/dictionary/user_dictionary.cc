@@ -34,6 +34,8 @@
 #include <memory>
 #include <set>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "base/compiler_specific.h"
 #include "base/file_util.h"
@@ -41,7 +43,6 @@
 #include "base/logging.h"
 #include "base/mutex.h"
 #include "base/singleton.h"
-#include "base/stl_util.h"
 #include "base/string_piece.h"
 #include "base/thread.h"
 #include "base/util.h"
@@ -52,36 +53,48 @@
 #include "dictionary/user_dictionary_util.h"
 #include "dictionary/user_pos.h"
 #include "protocol/config.pb.h"
+#include "storage/louds/louds_trie.h"
+#include "storage/louds/louds_trie_builder.h"
 #include "usage_stats/usage_stats.h"
 
 namespace mozc {
 namespace dictionary {
+
+using mozc::storage::louds::LoudsTrie;
+using mozc::storage::louds::LoudsTrieBuilder;
+
 namespace {
 
+// Cache sizes of the key trie, which is only traversed downward.  See
+// storage/louds/louds_trie.h.
+const size_t kTrieLb0CacheSize = 1 * 1024;
+const size_t kTrieSelect0CacheSize = 4 * 1024;
+const size_t kTrieTermvecCacheSize = 1 * 1024;
+
 struct OrderByKey {
-  bool operator()(const UserPOS::Token *token, StringPiece key) const {
-    return token->key < key;
+  bool operator()(const UserPOS::Token &token, StringPiece key) const {
+    return StringPiece(token.key) < key;
   }
 
-  bool operator()(StringPiece key, const UserPOS::Token *token) const {
-    return key < token->key;
+  bool operator()(StringPiece key, const UserPOS::Token &token) const {
+    return key < StringPiece(token.key);
   }
 };
 
 struct OrderByKeyPrefix {
-  bool operator()(const UserPOS::Token *token, StringPiece prefix) const {
-    return StringPiece(token->key).substr(0, prefix.size()) < prefix;
+  bool operator()(const UserPOS::Token &token, StringPiece prefix) const {
+    return StringPiece(token.key).substr(0, prefix.size()) < prefix;
   }
 
-  bool operator()(StringPiece prefix, const UserPOS::Token *token) const {
-    return prefix < StringPiece(token->key).substr(0, prefix.size());
+  bool operator()(StringPiece prefix, const UserPOS::Token &token) const {
+    return prefix < StringPiece(token.key).substr(0, prefix.size());
   }
 };
 
 struct OrderByKeyThenById {
-  bool operator()(const UserPOS::Token *lhs, const UserPOS::Token *rhs) const {
-    const int comp = lhs->key.compare(rhs->key);
-    return comp == 0 ? (lhs->id < rhs->id) : (comp < 0);
+  bool operator()(const UserPOS::Token &lhs, const UserPOS::Token &rhs) const {
+    const int comp = lhs.key.compare(rhs.key);
+    return comp == 0 ? (lhs.id < rhs.id) : (comp < 0);
   }
 };
 
@@ -121,20 +134,47 @@ void FillTokenFromUserPOSToken(const UserPOS::Token &user_pos_token,
 
 }  // namespace
 
-class UserDictionary::TokensIndex : public std::vector<UserPOS::Token *> {
+// Tokens of the user dictionary, stored in one array sorted by key and then by
+// POS ID, together with a LOUDS trie of their keys.  The key ID of the trie
+// maps to the range of the tokens having that key, so prefix lookup takes time
+// proportional to the key length, independent of the number of entries.
+// Exact and predictive lookups use binary search on the sorted array, which is
+// faster than the trie for a single key.
+class UserDictionary::TokensIndex {
  public:
+  typedef std::vector<UserPOS::Token>::const_iterator const_iterator;
+  typedef std::pair<const_iterator, const_iterator> Range;
+
   TokensIndex(const UserPOSInterface *user_pos,
               SuppressionDictionary *suppression_dictionary)
       : user_pos_(user_pos),
         suppression_dictionary_(suppression_dictionary) {}
 
-  ~TokensIndex() {
-    Clear();
+  ~TokensIndex() {}
+
+  bool empty() const { return tokens_.empty(); }
+  size_t size() const { return tokens_.size(); }
+
+  const LoudsTrie &trie() const { return trie_; }
+
+  // Returns the tokens whose key is the key of |key_id| in trie().
+  Range GetTokensForKeyId(int key_id) const {
+    DCHECK_LE(0, key_id);
+    DCHECK_LT(key_id, static_cast<int>(key_ranges_.size()));
+    const std::pair<uint32, uint32> &range = key_ranges_[key_id];
+    return Range(tokens_.begin() + range.first,
+                 tokens_.begin() + range.second);
   }
 
-  void Clear() {
-    STLDeleteElements(this);
-    clear();
+  // Returns the tokens whose key is |key|.
+  Range GetTokensForKey(StringPiece key) const {
+    return std::equal_range(tokens_.begin(), tokens_.end(), key, OrderByKey());
+  }
+
+  // Returns the tokens whose key starts with |prefix|, in key order.
+  Range GetTokensForKeyPrefix(StringPiece prefix) const {
+    return std::equal_range(tokens_.begin(), tokens_.end(), prefix,
+                            OrderByKeyPrefix());
   }
 
   void Load(const user_dictionary::UserDictionaryStorage &storage) {
@@ -196,27 +236,87 @@ MOZC_CLANG_POP_WARNING();
               reading, entry.value(),
               UserDictionaryUtil::GetStringPosType(entry.pos()), &tokens);
           for (size_t k = 0; k < tokens.size(); ++k) {
-            this->push_back(new UserPOS::Token(tokens[k]));
-            Util::StripWhiteSpaces(entry.comment(), &this->back()->comment);
+            if (tokens[k].key.empty()) {
+              // The trie cannot hold an empty key.
+              VLOG(1) << "Skipped the token of an empty key: "
+                      << tokens[k].value;
+              continue;
+            }
+            tokens_.push_back(std::move(tokens[k]));
+            Util::StripWhiteSpaces(entry.comment(), &tokens_.back().comment);
           }
         }
       }
     }
 
     // Sort first by key and then by POS ID.
-    std::sort(this->begin(), this->end(), OrderByKeyThenById());
+    std::sort(tokens_.begin(), tokens_.end(), OrderByKeyThenById());
+    BuildTrie();
 
     suppression_dictionary_->UnLock();
 
-    VLOG(1) << this->size() << " user dic entries loaded";
+    VLOG(1) << tokens_.size() << " user dic entries loaded";
 
     usage_stats::UsageStats::SetInteger("UserRegisteredWord",
-                                        static_cast<int>(this->size()));
+                                        static_cast<int>(tokens_.size()));
   }
 
  private:
+  void Clear() {
+    trie_.Close();
+    trie_image_.clear();
+    key_ranges_.clear();
+    tokens_.clear();
+  }
+
+  // Builds |trie_| and |key_ranges_| from |tokens_|, which must be sorted.
+  void BuildTrie() {
+    if (tokens_.empty()) {
+      return;
+    }
+    LoudsTrieBuilder builder;
+    size_t num_keys = 0;
+    for (size_t i = 0; i < tokens_.size(); ++i) {
+      if (i == 0 || tokens_[i].key != tokens_[i - 1].key) {
+        builder.Add(tokens_[i].key);
+        ++num_keys;
+      }
+    }
+    builder.Build();
+    key_ranges_.resize(num_keys);
+
+    size_t begin = 0;
+    for (size_t i = 1; i <= tokens_.size(); ++i) {
+      if (i < tokens_.size() && tokens_[i].key == tokens_[begin].key) {
+        continue;
+      }
+      const int key_id = builder.GetId(tokens_[begin].key);
+      DCHECK_LE(0, key_id);
+      DCHECK_LT(key_id, static_cast<int>(num_keys));
+      key_ranges_[key_id] = std::make_pair(static_cast<uint32>(begin),
+                                           static_cast<uint32>(i));
+      begin = i;
+    }
+
+    trie_image_ = builder.image();
+    CHECK(trie_.Open(reinterpret_cast<const uint8 *>(trie_image_.data()),
+                     kTrieLb0CacheSize, 0, kTrieSelect0CacheSize, 0,
+                     kTrieTermvecCacheSize));
+  }
+
   const UserPOSInterface *user_pos_;
   SuppressionDictionary *suppression_dictionary_;
+
+  // Sorted by key and then by POS ID.
+  std::vector<UserPOS::Token> tokens_;
+
+  string trie_image_;
+  LoudsTrie trie_;
+
+  // Indexed by key ID; [first, second) of |tokens_| have the key.
+  std::vector<std::pair<uint32, uint32>> key_ranges_;
+
+  DISALLOW_COPY_AND_ASSIGN(TokensIndex);
 };
 
 class UserDictionary::UserDictionaryReloader : public Thread {
@@ -358,10 +458,9 @@ void UserDictionary::LookupPredictive(
 
   // Find the starting point of iteration over dictionary contents.
   Token token;
-  for (auto range = std::equal_range(tokens_->begin(), tokens_->end(), key,
-                                     OrderByKeyPrefix());
+  for (auto range = tokens_->GetTokensForKeyPrefix(key);
        range.first != range.second; ++range.first) {
-    const UserPOS::Token &user_pos_token = **range.first;
+    const UserPOS::Token &user_pos_token = *range.first;
     switch (callback->OnKey(user_pos_token.key)) {
       case Callback::TRAVERSE_DONE:
         return;
@@ -401,42 +500,48 @@ void UserDictionary::LookupPrefix(
     return;
   }
 
-  // Find the starting point for iteration over dictionary contents.
-  const StringPiece first_char = key.substr(0, Util::OneCharLen(key.data()));
+  // Walk down the trie along |key|; every terminal node on the way is a key
+  // that is a prefix of |key|, visited from the shortest one.
+  const LoudsTrie &trie = tokens_->trie();
+  LoudsTrie::Node node;  // Root
   Token token;
-  for (auto it = std::lower_bound(tokens_->begin(), tokens_->end(), first_char,
-                                  OrderByKey());
-       it != tokens_->end(); ++it) {
-    const UserPOS::Token &user_pos_token = **it;
-    if (user_pos_token.key > key) {
-      break;
-    }
-    if (pos_matcher_.IsSuggestOnlyWord(user_pos_token.id)) {
-      continue;
+  for (StringPiece::size_type i = 0; i < key.size(); ) {
+    if (!trie.MoveToChildByLabel(key[i], &node)) {
+      return;
     }
-    if (!Util::StartsWith(key, user_pos_token.key)) {
+    ++i;
+    if (!trie.IsTerminalNode(node)) {
       continue;
     }
-    switch (callback->OnKey(user_pos_token.key)) {
-      case Callback::TRAVERSE_DONE:
-        return;
-      case Callback::TRAVERSE_NEXT_KEY:
+    for (auto range =
+             tokens_->GetTokensForKeyId(trie.GetKeyIdOfTerminalNode(node));
+         range.first != range.second; ++range.first) {
+      const UserPOS::Token &user_pos_token = *range.first;
+      if (pos_matcher_.IsSuggestOnlyWord(user_pos_token.id)) {
         continue;
-      case Callback::TRAVERSE_CULL:
-        LOG(FATAL) << "UserDictionary doesn't support culling.";
-        break;
-      default:
-        break;
-    }
-    FillTokenFromUserPOSToken(user_pos_token, &token);
-    switch (callback->OnToken(user_pos_token.key, user_pos_token.key, token)) {
-      case Callback::TRAVERSE_DONE:
-        return;
-      case Callback::TRAVERSE_CULL:
-        LOG(FATAL) << "UserDictionary doesn't support culling.";
-        break;
-      default:
-        break;
+      }
+      switch (callback->OnKey(user_pos_token.key)) {
+        case Callback::TRAVERSE_DONE:
+          return;
+        case Callback::TRAVERSE_NEXT_KEY:
+          continue;
+        case Callback::TRAVERSE_CULL:
+          LOG(FATAL) << "UserDictionary doesn't support culling.";
+          break;
+        default:
+          break;
+      }
+      FillTokenFromUserPOSToken(user_pos_token, &token);
+      switch (callback->OnToken(user_pos_token.key, user_pos_token.key,
+                                token)) {
+        case Callback::TRAVERSE_DONE:
+          return;
+        case Callback::TRAVERSE_CULL:
+          LOG(FATAL) << "UserDictionary doesn't support culling.";
+          break;
+        default:
+          break;
+      }
     }
   }
 }
@@ -450,8 +555,7 @@ void UserDictionary::LookupExact(
       conversion_request.config().incognito_mode()) {
     return;
   }
-  auto range = std::equal_range(tokens_->begin(), tokens_->end(), key,
-                                OrderByKey());
+  auto range = tokens_->GetTokensForKey(key);
   if (range.first == range.second) {
     return;
   }
@@ -461,7 +565,7 @@ void UserDictionary::LookupExact(
 
   Token token;
   for (; range.first != range.second; ++range.first) {
-    const UserPOS::Token &user_pos_token = **range.first;
+    const UserPOS::Token &user_pos_token = *range.first;
     if (pos_matcher_.IsSuggestOnlyWord(user_pos_token.id)) {
       continue;
     }
@@ -491,10 +595,9 @@ bool UserDictionary::LookupComment(StringPiece key, StringPiece value,
   }
 
   // Set the comment that was found first.
-  for (auto range = std::equal_range(tokens_->begin(), tokens_->end(), key,
-                                     OrderByKey());
+  for (auto range = tokens_->GetTokensForKey(key);
        range.first != range.second; ++range.first) {
-    const UserPOS::Token &token = **range.first;
+    const UserPOS::Token &token = *range.first;
     if (token.value == value && !token.comment.empty()) {
       comment->assign(token.comment);
       return true;
@@ -0,0 +1,225 @@
+// Copyright 2010-2018, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+// Benchmark for loading and looking up UserDictionary.
+//
+// Writes a user dictionary file of --entries random words, and reports the
+// time of reading the file, UserDictionary::Load(), which builds the index of
+// the tokens, and LookupPrefix() and LookupExact() of the words.  A reload of
+// the user dictionary is the file reading followed by Load().
+//
+// Usage:
+//   user_dictionary_benchmark_main --file=/tmp/user_dictionary.db
+//     --entries=100000
+
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "base/file_util.h"
+#include "base/flags.h"
+#include "base/init_mozc.h"
+#include "base/logging.h"
+#include "base/port.h"
+#include "base/stopwatch.h"
+#include "base/util.h"
+#include "config/config_handler.h"
+#include "data_manager/oss/oss_data_manager.h"
+#include "dictionary/dictionary_interface.h"
+#include "dictionary/pos_matcher.h"
+#include "dictionary/suppression_dictionary.h"
+#include "dictionary/user_dictionary.h"
+#include "dictionary/user_dictionary_storage.h"
+#include "dictionary/user_pos.h"
+#include "protocol/config.pb.h"
+#include "protocol/user_dictionary_storage.pb.h"
+#include "request/conversion_request.h"
+
+DEFINE_string(file, "user_dictionary_benchmark.db",
+              "user dictionary file to create");
+DEFINE_int32(entries, 100000, "number of entries of the user dictionary");
+DEFINE_int32(iterations, 10, "number of reloads and passes over the words");
+
+namespace mozc {
+namespace dictionary {
+namespace {
+
+const char *kHiragana[] = {
+  "あ", "い", "う", "え", "お", "か", "き", "く", "け", "こ",
+  "さ", "し", "す", "せ", "そ", "た", "ち", "つ", "て", "と",
+  "な", "に", "ぬ", "ね", "の", "は", "ひ", "ふ", "へ", "ほ",
+  "ま", "み", "む", "め", "も", "や", "ゆ", "よ", "ら", "り",
+  "る", "れ", "ろ", "わ", "ん", "が", "ざ", "だ", "ば", "ぱ",
+};
+
+class CountingCallback : public DictionaryInterface::Callback {
+ public:
+  CountingCallback() : num_tokens_(0) {}
+
+  ResultType OnToken(StringPiece key, StringPiece actual_key,
+                     const Token &token) override {
+    ++num_tokens_;
+    return TRAVERSE_CONTINUE;
+  }
+
+  int64 num_tokens() const { return num_tokens_; }
+
+ private:
+  int64 num_tokens_;
+};
+
+void ReportMilliseconds(const char *name, Stopwatch *stopwatch,
+                        double count) {
+  std::cout << name << ": "
+            << stopwatch->GetElapsedNanoseconds() / count / 1000000.0
+            << " ms" << std::endl;
+}
+
+void ReportNanosecondsPerOp(const char *name, Stopwatch *stopwatch,
+                            double count) {
+  std::cout << name << ": " << stopwatch->GetElapsedNanoseconds() / count
+            << " ns/op" << std::endl;
+}
+
+// Writes |num_entries| random words to |filename|.  One in ten words is a
+// verb, which has the tokens of its conjugations.
+void WriteUserDictionary(const string &filename, int num_entries,
+                         std::vector<string> *keys) {
+  std::mt19937 random(0);
+  std::uniform_int_distribution<size_t> char_dist(0, arraysize(kHiragana) - 1);
+  std::uniform_int_distribution<int> length_dist(2, 8);
+
+  UserDictionaryStorage storage(filename);
+  user_dictionary::UserDictionary *dic = storage.add_dictionaries();
+  dic->set_id(1);
+  dic->set_name("benchmark");
+  for (int i = 0; i < num_entries; ++i) {
+    string key;
+    const int length = length_dist(random);
+    for (int j = 0; j < length; ++j) {
+      key += kHiragana[char_dist(random)];
+    }
+    string value = "値" + std::to_string(i);
+    user_dictionary::UserDictionary::Entry *entry = dic->add_entries();
+    if (i % 10 == 0) {
+      key += "う";
+      value += "う";
+      entry->set_pos(user_dictionary::UserDictionary::WA_GROUP1_VERB);
+    } else {
+      entry->set_pos(user_dictionary::UserDictionary::NOUN);
+    }
+    entry->set_key(key);
+    entry->set_value(value);
+    keys->push_back(key);
+  }
+  CHECK(storage.Lock());
+  CHECK(storage.Save()) << "cannot save " << filename;
+  CHECK(storage.UnLock());
+}
+
+void Run() {
+  std::vector<string> keys;
+  WriteUserDictionary(FLAGS_file, FLAGS_entries, &keys);
+
+  oss::OssDataManager data_manager;
+  SuppressionDictionary suppression_dictionary;
+  UserDictionary dictionary(UserPOS::CreateFromDataManager(data_manager),
+                            POSMatcher(data_manager.GetPOSMatcherData()),
+                            &suppression_dictionary);
+
+  Stopwatch read_stopwatch;
+  Stopwatch load_stopwatch;
+  for (int i = 0; i < FLAGS_iterations; ++i) {
+    read_stopwatch.Start();
+    UserDictionaryStorage storage(FLAGS_file);
+    CHECK(storage.Load()) << "cannot load " << FLAGS_file;
+    read_stopwatch.Stop();
+
+    load_stopwatch.Start();
+    CHECK(dictionary.Load(storage));
+    load_stopwatch.Stop();
+  }
+  ReportMilliseconds("Read file", &read_stopwatch, FLAGS_iterations);
+  ReportMilliseconds("UserDictionary::Load", &load_stopwatch,
+                     FLAGS_iterations);
+
+  config::Config config;
+  config::ConfigHandler::GetDefaultConfig(&config);
+  ConversionRequest request;
+  request.set_config(&config);
+
+  {
+    CountingCallback callback;
+    Stopwatch stopwatch = Stopwatch::StartNew();
+    for (int i = 0; i < FLAGS_iterations; ++i) {
+      for (size_t j = 0; j < keys.size(); ++j) {
+        // Longer than the word, as the converter looks up the rest of the
+        // input.
+        dictionary.LookupPrefix(keys[j] + "を", request, &callback);
+      }
+    }
+    stopwatch.Stop();
+    CHECK_LE(static_cast<int64>(keys.size()) * FLAGS_iterations,
+             callback.num_tokens());
+    ReportNanosecondsPerOp("LookupPrefix", &stopwatch,
+                           static_cast<double>(keys.size()) *
+                           FLAGS_iterations);
+  }
+
+  {
+    CountingCallback callback;
+    Stopwatch stopwatch = Stopwatch::StartNew();
+    for (int i = 0; i < FLAGS_iterations; ++i) {
+      for (size_t j = 0; j < keys.size(); ++j) {
+        dictionary.LookupExact(keys[j], request, &callback);
+      }
+    }
+    stopwatch.Stop();
+    CHECK_LE(static_cast<int64>(keys.size()) * FLAGS_iterations,
+             callback.num_tokens());
+    ReportNanosecondsPerOp("LookupExact", &stopwatch,
+                           static_cast<double>(keys.size()) *
+                           FLAGS_iterations);
+  }
+
+  FileUtil::Unlink(FLAGS_file);
+}
+
+}  // namespace
+}  // namespace dictionary
+}  // namespace mozc
+
+int main(int argc, char **argv) {
+  mozc::InitMozc(argv[0], &argc, &argv, false);
+  mozc::dictionary::Run();
+  return 0;
+}
@@ -496,6 +496,51 @@ TEST_F(UserDictionaryTest, TestLookupPrefix) {
   TestLookupPrefixHelper(nullptr, 0, "starting", 8, *dic);
 }
 
+TEST_F(UserDictionaryTest, TestLookupPrefixWithManyEntries) {
+  unique_ptr<UserDictionary> dic(CreateDictionaryWithMockPos());
+  // Wait for async reload called from the constructor.
+  dic->WaitForReloader();
+
+  // Registers "a", "aa", ..., and many entries sharing their prefixes.
+  string contents;
+  string prefix;
+  for (int i = 0; i < 10; ++i) {
+    prefix += "a";
+    contents += prefix + "\t" + prefix + "\tnoun\n";
+  }
+  for (int i = 0; i < 10000; ++i) {
+    const string key = "a" + std::to_string(i);
+    contents += key + "\t" + key + "\tnoun\n";
+  }
+  {
+    UserDictionaryStorage storage("");
+    LoadFromString(contents, &storage);
+    dic->Load(storage);
+  }
+
+  const Entry kExpected0[] = {
+    { "a", "a", 100, 100 },
+    { "aa", "aa", 100, 100 },
+    { "aaa", "aaa", 100, 100 },
+  };
+  TestLookupPrefixHelper(kExpected0, arraysize(kExpected0), "aaab", 4, *dic);
+
+  const Entry kExpected1[] = {
+    { "a", "a", 100, 100 },
+    { "a1", "a1", 100, 100 },
+    { "a12", "a12", 100, 100 },
+    { "a123", "a123", 100, 100 },
+    { "a1234", "a1234", 100, 100 },
+  };
+  TestLookupPrefixHelper(kExpected1, arraysize(kExpected1), "a12345", 6, *dic);
+
+  const Entry kExpected2[] = {
+    { "a9999", "a9999", 100, 100 },
+  };
+  TestLookupExactHelper(kExpected2, arraysize(kExpected2), "a9999", 5, *dic);
+  TestLookupExactHelper(nullptr, 0, "a10000", 6, *dic);
+}
+
 TEST_F(UserDictionaryTest, TestLookupExact) {
   unique_ptr<UserDictionary> dic(CreateDictionaryWithMockPos());
   // Wait for async reload called from the constructor.
@@ -43,6 +43,7 @@
 #include "base/flags.h"
 #include "base/logging.h"
 #include "base/number_util.h"
+#include "base/trace.h"
 #include "base/util.h"
 #include "composer/composer.h"
 #include "converter/connector.h"
@@ -368,6 +369,7 @@ void DictionaryPredictor::MaybeRecordUsageStats(
 
 bool DictionaryPredictor::PredictForRequest(const ConversionRequest &request,
                                             Segments *segments) const {
+  MOZC_TRACE_SCOPE("DictionaryPredictor::Predict");
   if (segments == NULL) {
     return false;
   }
@@ -659,15 +661,23 @@ int DictionaryPredictor::GetLMCost(const Result &result, int rid) const {
 
 namespace {
 
+// Finds the token of the pair of |target_key| and |target_value| by
+// LookupPrefix().  The tokens of shorter prefixes of |target_key| are skipped
+// without decoding their values.
 class FindValueCallback : public DictionaryInterface::Callback {
  public:
-  explicit FindValueCallback(StringPiece target_value)
-      : target_value_(target_value), found_(false) {}
+  FindValueCallback(StringPiece target_key, StringPiece target_value)
+      : target_key_(target_key), target_value_(target_value), found_(false) {}
+
+  virtual bool ShouldDecodeValue(const Token &token) {
+    return token.key.size() == target_key_.size();
+  }
 
   virtual ResultType OnToken(StringPiece,  // key
                              StringPiece,  // actual_key
                              const Token &token) {
-    if (token.value != target_value_) {
+    if (token.key.size() != target_key_.size() ||
+        token.value != target_value_) {
       return TRAVERSE_CONTINUE;
     }
     found_ = true;
@@ -684,6 +694,7 @@ class FindValueCallback : public DictionaryInterface::Callback {
   }
 
  private:
+  StringPiece target_key_;
   StringPiece target_value_;
   bool found_;
   Token token_;
@@ -1465,7 +1476,7 @@ void DictionaryPredictor::AddBigramResultsFromHistory(
     const Segments &segments,
     std::vector<Result> *results) const {
   // Check that history_key/history_value are in the dictionary.
-  FindValueCallback find_history_callback(history_value);
+  FindValueCallback find_history_callback(history_key, history_value);
   dictionary_->LookupPrefix(history_key, request, &find_history_callback);
 
   // History value is not found in the dictionary.
@@ -1574,7 +1585,7 @@ void DictionaryPredictor::CheckBigramResult(
     return;
   }
 
-  FindValueCallback callback(value);
+  FindValueCallback callback(key, value);
   dictionary_->LookupPrefix(key, request, &callback);
   if (!callback.found()) {
     result->types = NO_PREDICTION;
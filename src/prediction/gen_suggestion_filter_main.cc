@@ -46,6 +46,8 @@ DEFINE_bool(header, true,
             "make header file instead of raw bloom filter");
 DEFINE_string(name, "SuggestionFilterData",
               "name for variable name in the header file");
+DEFINE_bool(blocked_existence_filter, true,
+            "generates the bloom filter of the blocked format");
 
 namespace {
 void ReadWords(const string &name, std::vector<uint64> *words) {
@@ -84,14 +86,18 @@ int main(int argc, char **argv) {
   LOG(INFO) << words.size() << " words found";
 
   static const float kErrorRate = 0.00001;
-  const size_t num_bytes =
-      std::max(ExistenceFilter::MinFilterSizeInBytesForErrorRate(kErrorRate,
-                                                                 words.size()),
-               kMinimumFilterBytes);
+  const size_t min_bytes = FLAGS_blocked_existence_filter ?
+      ExistenceFilter::MinBlockedFilterSizeInBytesForErrorRate(kErrorRate,
+                                                               words.size()) :
+      ExistenceFilter::MinFilterSizeInBytesForErrorRate(kErrorRate,
+                                                        words.size());
+  const size_t num_bytes = std::max(min_bytes, kMinimumFilterBytes);
 
   LOG(INFO) << "num_bytes: " << num_bytes;
 
   std::unique_ptr<ExistenceFilter> filter(
+      FLAGS_blocked_existence_filter ?
+      ExistenceFilter::CreateOptimalBlocked(num_bytes, words.size()) :
       ExistenceFilter::CreateOptimal(num_bytes, words.size()));
   for (size_t i = 0; i < words.size(); ++i) {
     filter->Insert(words[i]);
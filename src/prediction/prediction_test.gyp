@@ -38,6 +38,7 @@
       'type': 'executable',
       'sources': [
         'dictionary_predictor_test.cc',
+        'user_history_entry_index_test.cc',
         'user_history_predictor_test.cc',
         'predictor_test.cc',
       ],
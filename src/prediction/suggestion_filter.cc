@@ -44,11 +44,11 @@ SuggestionFilter::SuggestionFilter(const char *data, size_t size) {
 
 SuggestionFilter::~SuggestionFilter() {}
 
-bool SuggestionFilter::IsBadSuggestion(const string &text) const {
+bool SuggestionFilter::IsBadSuggestion(StringPiece text) const {
   if (filter_.get() == nullptr) {
     return false;
   }
-  string lower_text = text;
+  string lower_text = text.as_string();
   Util::LowerString(&lower_text);
   return filter_->Exists(Hash::Fingerprint(lower_text));
 }
@@ -34,6 +34,7 @@
 #include <string>
 
 #include "base/port.h"
+#include "base/string_piece.h"
 
 namespace mozc {
 namespace storage {
@@ -46,7 +47,7 @@ class SuggestionFilter {
   SuggestionFilter(const char *data, size_t size);
   ~SuggestionFilter();
 
-  bool IsBadSuggestion(const string &text) const;
+  bool IsBadSuggestion(StringPiece text) const;
 
  private:
   std::unique_ptr<mozc::storage::ExistenceFilter> filter_;
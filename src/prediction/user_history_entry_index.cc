@@ -0,0 +1,127 @@
+// Copyright 2010-2018, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "prediction/user_history_entry_index.h"
+
+#include <algorithm>
+#include <functional>
+
+#include "base/logging.h"
+#include "base/util.h"
+
+namespace mozc {
+
+UserHistoryEntryIndex::UserHistoryEntryIndex() : next_order_(0) {}
+
+UserHistoryEntryIndex::~UserHistoryEntryIndex() {}
+
+void UserHistoryEntryIndex::Add(uint32 fp, const string &key,
+                                const string &value) {
+  Remove(fp);
+  Item &item = items_[fp];
+  item.order = next_order_++;
+  item.key = keys_.insert(std::make_pair(key, fp)).first;
+  item.value = values_.insert(std::make_pair(value, fp)).first;
+}
+
+void UserHistoryEntryIndex::Remove(uint32 fp) {
+  mozc_hash_map<uint32, Item>::iterator it = items_.find(fp);
+  if (it == items_.end()) {
+    return;
+  }
+  keys_.erase(it->second.key);
+  values_.erase(it->second.value);
+  items_.erase(it);
+}
+
+void UserHistoryEntryIndex::Clear() {
+  items_.clear();
+  keys_.clear();
+  values_.clear();
+  next_order_ = 0;
+}
+
+void UserHistoryEntryIndex::LookupKey(StringPiece key,
+                                      std::vector<uint32> *fps) const {
+  DCHECK(fps);
+  fps->clear();
+  if (key.empty()) {
+    return;
+  }
+
+  // Keys starting with |key|.
+  for (StringSet::const_iterator it =
+           keys_.lower_bound(std::make_pair(key.as_string(), 0));
+       it != keys_.end() && Util::StartsWith(it->first, key); ++it) {
+    fps->push_back(it->second);
+  }
+
+  // Keys which are proper prefixes of |key|.
+  for (size_t len = 1; len < key.size(); ++len) {
+    AppendExactMatch(keys_, key.substr(0, len).as_string(), fps);
+  }
+
+  SortByOrder(fps);
+}
+
+void UserHistoryEntryIndex::LookupValueSuffix(StringPiece value,
+                                              std::vector<uint32> *fps) const {
+  DCHECK(fps);
+  fps->clear();
+  for (size_t pos = 0; pos < value.size(); ++pos) {
+    AppendExactMatch(values_, value.substr(pos).as_string(), fps);
+  }
+  SortByOrder(fps);
+}
+
+// static
+void UserHistoryEntryIndex::AppendExactMatch(const StringSet &set,
+                                             const string &str,
+                                             std::vector<uint32> *fps) {
+  for (StringSet::const_iterator it = set.lower_bound(std::make_pair(str, 0));
+       it != set.end() && it->first == str; ++it) {
+    fps->push_back(it->second);
+  }
+}
+
+void UserHistoryEntryIndex::SortByOrder(std::vector<uint32> *fps) const {
+  std::vector<std::pair<uint64, uint32>> ordered;
+  ordered.reserve(fps->size());
+  for (size_t i = 0; i < fps->size(); ++i) {
+    const uint32 fp = (*fps)[i];
+    ordered.push_back(std::make_pair(items_.find(fp)->second.order, fp));
+  }
+  std::sort(ordered.begin(), ordered.end(),
+            std::greater<std::pair<uint64, uint32>>());
+  for (size_t i = 0; i < ordered.size(); ++i) {
+    (*fps)[i] = ordered[i].second;
+  }
+}
+
+}  // namespace mozc
@@ -0,0 +1,100 @@
+// Copyright 2010-2018, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef MOZC_PREDICTION_USER_HISTORY_ENTRY_INDEX_H_
+#define MOZC_PREDICTION_USER_HISTORY_ENTRY_INDEX_H_
+
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/mozc_hash_map.h"
+#include "base/port.h"
+#include "base/string_piece.h"
+
+namespace mozc {
+
+// Index of the entries of UserHistoryPredictor by their keys and values.
+// Entries are identified by their fingerprints.  The index also remembers
+// the order in which the entries were added, so that lookup results are
+// returned in the same order as the LRU list of the history, i.e., the most
+// recently added one comes first.
+class UserHistoryEntryIndex {
+ public:
+  UserHistoryEntryIndex();
+  ~UserHistoryEntryIndex();
+
+  // Adds the entry of |fp| as the most recently used one.  If |fp| is already
+  // in the index, its key and value are replaced.
+  void Add(uint32 fp, const string &key, const string &value);
+
+  // Removes the entry of |fp|.  Does nothing if |fp| is not in the index.
+  void Remove(uint32 fp);
+
+  void Clear();
+
+  size_t size() const { return items_.size(); }
+
+  // Sets the entries whose keys start with |key|, or whose non-empty keys are
+  // prefixes of |key|, to |fps|.
+  void LookupKey(StringPiece key, std::vector<uint32> *fps) const;
+
+  // Sets the entries whose values are non-empty suffixes of |value|, including
+  // |value| itself, to |fps|.
+  void LookupValueSuffix(StringPiece value, std::vector<uint32> *fps) const;
+
+ private:
+  typedef std::set<std::pair<string, uint32>> StringSet;
+
+  struct Item {
+    // Larger is more recent.
+    uint64 order;
+    StringSet::iterator key;
+    StringSet::iterator value;
+  };
+
+  // Appends the entries of |str| in |set| to |fps|.
+  static void AppendExactMatch(const StringSet &set, const string &str,
+                               std::vector<uint32> *fps);
+
+  // Sorts |fps| from the most recent one.
+  void SortByOrder(std::vector<uint32> *fps) const;
+
+  mozc_hash_map<uint32, Item> items_;
+  StringSet keys_;
+  StringSet values_;
+  uint64 next_order_;
+
+  DISALLOW_COPY_AND_ASSIGN(UserHistoryEntryIndex);
+};
+
+}  // namespace mozc
+
+#endif  // MOZC_PREDICTION_USER_HISTORY_ENTRY_INDEX_H_
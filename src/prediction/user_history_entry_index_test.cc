@@ -0,0 +1,126 @@
+// Copyright 2010-2018, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "prediction/user_history_entry_index.h"
+
+#include <vector>
+
+#include "testing/base/public/gunit.h"
+
+namespace mozc {
+namespace {
+
+TEST(UserHistoryEntryIndexTest, LookupKey) {
+  UserHistoryEntryIndex index;
+  index.Add(1, "a", "A");
+  index.Add(2, "ab", "AB");
+  index.Add(3, "abc", "ABC");
+  index.Add(4, "b", "B");
+  index.Add(5, "abd", "ABD");
+  index.Add(6, "", "");
+  EXPECT_EQ(6, index.size());
+
+  std::vector<uint32> fps;
+  index.LookupKey("ab", &fps);
+  // Most recently added one comes first.
+  const std::vector<uint32> kExpected1 = {5, 3, 2, 1};
+  EXPECT_EQ(kExpected1, fps);
+
+  index.LookupKey("abcd", &fps);
+  const std::vector<uint32> kExpected2 = {3, 2, 1};
+  EXPECT_EQ(kExpected2, fps);
+
+  index.LookupKey("c", &fps);
+  EXPECT_TRUE(fps.empty());
+
+  index.LookupKey("", &fps);
+  EXPECT_TRUE(fps.empty());
+
+  // Adding the existing entry again makes it the most recent one.
+  index.Add(2, "ab", "AB");
+  index.LookupKey("ab", &fps);
+  const std::vector<uint32> kExpected3 = {2, 5, 3, 1};
+  EXPECT_EQ(kExpected3, fps);
+}
+
+TEST(UserHistoryEntryIndexTest, LookupValueSuffix) {
+  UserHistoryEntryIndex index;
+  index.Add(1, "a", "XYZ");
+  index.Add(2, "b", "YZ");
+  index.Add(3, "c", "Z");
+  index.Add(4, "d", "XY");
+  index.Add(5, "e", "YZ");
+
+  std::vector<uint32> fps;
+  index.LookupValueSuffix("XYZ", &fps);
+  const std::vector<uint32> kExpected1 = {5, 3, 2, 1};
+  EXPECT_EQ(kExpected1, fps);
+
+  index.LookupValueSuffix("WXYZ", &fps);
+  EXPECT_EQ(kExpected1, fps);
+
+  index.LookupValueSuffix("XY", &fps);
+  const std::vector<uint32> kExpected2 = {4};
+  EXPECT_EQ(kExpected2, fps);
+
+  index.LookupValueSuffix("", &fps);
+  EXPECT_TRUE(fps.empty());
+}
+
+TEST(UserHistoryEntryIndexTest, RemoveAndClear) {
+  UserHistoryEntryIndex index;
+  index.Add(1, "a", "A");
+  index.Add(2, "ab", "AB");
+
+  std::vector<uint32> fps;
+  index.Remove(2);
+  index.Remove(3);  // Not in the index.
+  EXPECT_EQ(1, index.size());
+  index.LookupKey("a", &fps);
+  const std::vector<uint32> kExpected = {1};
+  EXPECT_EQ(kExpected, fps);
+  index.LookupValueSuffix("AB", &fps);
+  EXPECT_TRUE(fps.empty());
+
+  // Adding an existing fingerprint replaces the key and value.
+  index.Add(1, "b", "B");
+  EXPECT_EQ(1, index.size());
+  index.LookupKey("a", &fps);
+  EXPECT_TRUE(fps.empty());
+  index.LookupKey("b", &fps);
+  EXPECT_EQ(kExpected, fps);
+
+  index.Clear();
+  EXPECT_EQ(0, index.size());
+  index.LookupKey("b", &fps);
+  EXPECT_TRUE(fps.empty());
+}
+
+}  // namespace
+}  // namespace mozc
@@ -42,6 +42,7 @@
 #include "base/logging.h"
 #include "base/mozc_hash_set.h"
 #include "base/thread.h"
+#include "base/trace.h"
 #include "base/trie.h"
 #include "base/util.h"
 #include "composer/composer.h"
@@ -77,13 +78,11 @@ using dictionary::POSMatcher;
 using usage_stats::UsageStats;
 
 // Finds suggestion candidates from the most recent 3000 history in LRU.
-// We don't check all history, since suggestion is called every key event
+// We don't check all history, since suggestion is called every key event.
+// When the candidates are taken from UserHistoryEntryIndex, this limits the
+// number of the matching entries to be checked.
 const size_t kMaxSuggestionTrial = 3000;
 
-// Finds suffix matches of history_segments from the most recent 500 histories
-// in LRU.
-const size_t kMaxPrevValueTrial = 500;
-
 // Cache size
 // Typically memory/storage footprint becomes kLRUCacheSize * 70 bytes.
 #ifdef OS_ANDROID
@@ -429,6 +428,7 @@ void UserHistoryPredictor::WaitForSyncer() {
 }
 
 bool UserHistoryPredictor::Wait() {
+  scoped_lock l(&mutex_);
   WaitForSyncer();
   return true;
 }
@@ -446,11 +446,13 @@ bool UserHistoryPredictor::CheckSyncerAndDelete() const {
 }
 
 bool UserHistoryPredictor::Sync() {
+  scoped_lock l(&mutex_);
   return AsyncSave();
   // return Save();   blocking version
 }
 
 bool UserHistoryPredictor::Reload() {
+  scoped_lock l(&mutex_);
   WaitForSyncer();
   return AsyncLoad();
 }
@@ -495,8 +497,12 @@ bool UserHistoryPredictor::Load() {
   }
 
   for (size_t i = 0; i < history.entries_size(); ++i) {
-    dic_->Insert(EntryFingerprint(history.entries(i)),
-                 history.entries(i));
+    const Entry &entry = history.entries(i);
+    DicElement *e =
+        InsertToDic(EntryFingerprint(entry), entry.key(), entry.value());
+    if (e != nullptr) {
+      e->value = entry;
+    }
   }
 
   VLOG(1) << "Loaded user histroy, size=" << history.entries_size();
@@ -540,6 +546,7 @@ bool UserHistoryPredictor::Save() {
 }
 
 bool UserHistoryPredictor::ClearAllHistory() {
+  scoped_lock l(&mutex_);
   // Waits until syncer finishes
   WaitForSyncer();
 
@@ -547,6 +554,7 @@ bool UserHistoryPredictor::ClearAllHistory() {
   // Renews DicCache as LRUCache tries to reuse the internal value by
   // using FreeList
   dic_.reset(new DicCache(UserHistoryPredictor::cache_size()));
+  entry_index_.Clear();
 
   // insert a dummy event entry.
   InsertEvent(Entry::CLEAN_ALL_EVENT);
@@ -559,6 +567,7 @@ bool UserHistoryPredictor::ClearAllHistory() {
 }
 
 bool UserHistoryPredictor::ClearUnusedHistory() {
+  scoped_lock l(&mutex_);
   // Waits until syncer finishes
   WaitForSyncer();
 
@@ -579,7 +588,7 @@ bool UserHistoryPredictor::ClearUnusedHistory() {
 
   for (size_t i = 0; i < keys.size(); ++i) {
     VLOG(2) << "Removing: " << keys[i];
-    if (!dic_->Erase(keys[i])) {
+    if (!EraseFromDic(keys[i])) {
       LOG(ERROR) << "cannot erase " << keys[i];
     }
   }
@@ -700,6 +709,7 @@ UserHistoryPredictor::RemoveNgramChain(const string &target_key,
 
 bool UserHistoryPredictor::ClearHistoryEntry(const string &key,
                                              const string &value) {
+  scoped_lock l(&mutex_);
   bool deleted = false;
   {
     // Finds the history entry that has the exactly same key and value and has
@@ -1181,6 +1191,8 @@ bool UserHistoryPredictor::Predict(Segments *segments) const {
 
 bool UserHistoryPredictor::PredictForRequest(const ConversionRequest &request,
                                              Segments *segments) const {
+  MOZC_TRACE_SCOPE("UserHistoryPredictor::Predict");
+  scoped_lock l(&mutex_);
   if (!CheckSyncerAndDelete()) {
     LOG(WARNING) << "Syncer is running";
     return false;
@@ -1272,20 +1284,19 @@ const UserHistoryPredictor::Entry *UserHistoryPredictor::LookupPrevEntry(
       (prev_entry != nullptr && prev_entry->next_entries_size() == 0)) {
     const string &prev_value = prev_entry == nullptr ?
         history_segment.candidate(0).value : prev_entry->value();
-    int trial = 0;
-    for (const DicElement *elm = dic_->Head();
-         trial++ < kMaxPrevValueTrial && elm != nullptr; elm = elm->next) {
-      const Entry *entry = &(elm->value);
-      // entry->value() equals to the prev_value or
-      // entry->value() is a SUFFIX of prev_value.
+    // Candidates are the entries whose values equal to prev_value or are
+    // SUFFIXes of prev_value, from the most recently used one.
+    std::vector<uint32> fps;
+    entry_index_.LookupValueSuffix(prev_value, &fps);
+    for (size_t i = 0; i < fps.size(); ++i) {
+      const Entry *entry = dic_->LookupWithoutInsert(fps[i]);
       // length of entry->value() must be >= 2, as single-length
       // match would be noisy.
-      if (IsValidEntry(*entry, available_emoji_carrier) &&
+      if (entry != nullptr &&
+          IsValidEntry(*entry, available_emoji_carrier) &&
           entry != prev_entry &&
           entry->next_entries_size() > 0 &&
-          Util::CharsLen(entry->value()) >= 2 &&
-          (entry->value() == prev_value ||
-           Util::EndsWith(prev_value, entry->value()))) {
+          Util::CharsLen(entry->value()) >= 2) {
         prev_entry = entry;
         break;
       }
@@ -1331,28 +1342,49 @@ void UserHistoryPredictor::GetResultsFromHistoryDictionary(
   GetInputKeyFromSegments(request, segments, &input_key, &base_key, &expanded);
 
   int trial = 0;
-  for (const DicElement *elm = dic_->Head(); elm != nullptr; elm = elm->next) {
+  // Returns false when no more entries need to be looked up.
+  auto lookup = [&](const Entry &entry) {
     if (!IsValidEntryIgnoringRemovedField(
-            elm->value, request.request().available_emoji_carrier())) {
-      continue;
+            entry, request.request().available_emoji_carrier())) {
+      return true;
     }
     if (segments.request_type() == Segments::SUGGESTION &&
         trial++ >= kMaxSuggestionTrial) {
       VLOG(2) << "too many trials";
-      break;
+      return false;
     }
 
     // Lookup key from elm_value and prev_entry.
     // If a new entry is found, the entry is pushed to the results.
     // TODO(team): make KanaFuzzyLookupEntry().
     if (!LookupEntry(request_type, input_key, base_key, expanded.get(),
-                     &(elm->value), prev_entry, results) &&
-        !RomanFuzzyLookupEntry(roman_input_key, &(elm->value), results)) {
-      continue;
+                     &entry, prev_entry, results) &&
+        !RomanFuzzyLookupEntry(roman_input_key, &entry, results)) {
+      return true;
     }
 
     // already found enough results.
-    if (results->size() >= max_results_size) {
+    return results->size() < max_results_size;
+  };
+
+  // Only the entries whose keys are prefixes of |base_key| or start with
+  // |base_key| can match the input unless |base_key| is empty or the roman
+  // fuzzy match is used.  Such entries are taken from the index in the same
+  // order as the LRU list.
+  if (!base_key.empty() && roman_input_key.empty()) {
+    std::vector<uint32> fps;
+    entry_index_.LookupKey(base_key, &fps);
+    for (size_t i = 0; i < fps.size(); ++i) {
+      const Entry *entry = dic_->LookupWithoutInsert(fps[i]);
+      if (entry != nullptr && !lookup(*entry)) {
+        break;
+      }
+    }
+    return;
+  }
+
+  for (const DicElement *elm = dic_->Head(); elm != nullptr; elm = elm->next) {
+    if (!lookup(elm->value)) {
       break;
     }
   }
@@ -1555,6 +1587,31 @@ bool UserHistoryPredictor::IsValidEntryIgnoringRemovedField(
   return true;
 }
 
+UserHistoryPredictor::DicElement *UserHistoryPredictor::InsertToDic(
+    uint32 fp, const string &key, const string &value) {
+  // When |dic_| is full, inserting a new entry evicts the tail of the LRU
+  // list.  Remember it to remove it from the index too.
+  const DicElement *tail = dic_->Tail();
+  const uint32 tail_fp = tail == nullptr ? 0 : tail->key;
+  const bool is_new_entry = !dic_->HasKey(fp);
+  const size_t size = dic_->Size();
+
+  DicElement *e = dic_->Insert(fp);
+  if (e == nullptr) {
+    return nullptr;
+  }
+  if (is_new_entry && tail != nullptr && dic_->Size() == size) {
+    entry_index_.Remove(tail_fp);
+  }
+  entry_index_.Add(fp, key, value);
+  return e;
+}
+
+bool UserHistoryPredictor::EraseFromDic(uint32 fp) {
+  entry_index_.Remove(fp);
+  return dic_->Erase(fp);
+}
+
 void UserHistoryPredictor::InsertEvent(EntryType type) {
   if (type == Entry::DEFAULT_ENTRY) {
     return;
@@ -1564,7 +1621,7 @@ void UserHistoryPredictor::InsertEvent(EntryType type) {
   const uint32 dic_key = Fingerprint("", "", type);
 
   CHECK(dic_.get());
-  DicElement *e = dic_->Insert(dic_key);
+  DicElement *e = InsertToDic(dic_key, "", "");
   if (e == nullptr) {
     VLOG(2) << "insert failed";
     return;
@@ -1627,7 +1684,7 @@ void UserHistoryPredictor::Insert(const string &key,
     // add a treatment for UPDATE_ENTRY mode
   }
 
-  DicElement *e = dic_->Insert(dic_key);
+  DicElement *e = InsertToDic(dic_key, key, value);
   if (e == nullptr) {
     VLOG(2) << "insert failed";
     return;
@@ -1694,6 +1751,7 @@ void UserHistoryPredictor::MaybeRecordUsageStats(
 
 void UserHistoryPredictor::Finish(const ConversionRequest &request,
                                   Segments *segments) {
+  scoped_lock l(&mutex_);
   if (segments->request_type() == Segments::REVERSE_CONVERSION) {
     // Do nothing for REVERSE_CONVERSION.
     return;
@@ -1961,6 +2019,7 @@ void UserHistoryPredictor::InsertHistory(RequestType request_type,
 }
 
 void UserHistoryPredictor::Revert(Segments *segments) {
+  scoped_lock l(&mutex_);
   if (!CheckSyncerAndDelete()) {
     LOG(WARNING) << "Syncer is running";
     return;
@@ -1972,7 +2031,7 @@ void UserHistoryPredictor::Revert(Segments *segments) {
     if (revert_entry.id == UserHistoryPredictor::revert_id() &&
         revert_entry.revert_entry_type == Segments::RevertEntry::CREATE_ENTRY) {
       VLOG(2) << "Erasing the key: " << StringToUint32(revert_entry.key);
-      dic_->Erase(StringToUint32(revert_entry.key));
+      EraseFromDic(StringToUint32(revert_entry.key));
     }
   }
 }
@@ -38,12 +38,14 @@
 #include <vector>
 
 #include "base/freelist.h"
+#include "base/mutex.h"
 #include "base/string_piece.h"
 #include "base/trie.h"
 #include "dictionary/dictionary_interface.h"
 #include "dictionary/pos_matcher.h"
 #include "dictionary/suppression_dictionary.h"
 #include "prediction/predictor_interface.h"
+#include "prediction/user_history_entry_index.h"
 #include "prediction/user_history_predictor.pb.h"
 #include "storage/lru_cache.h"
 // for FRIEND_TEST
@@ -384,6 +386,13 @@ class UserHistoryPredictor : public PredictorInterface {
   typedef mozc::storage::LRUCache<uint32, Entry> DicCache;
   typedef DicCache::Element DicElement;
 
+  // Inserts |fp| to |dic_| as the most recently used entry and updates
+  // |entry_index_| with |key| and |value| of the entry.
+  DicElement *InsertToDic(uint32 fp, const string &key, const string &value);
+
+  // Erases |fp| from |dic_| and |entry_index_|.
+  bool EraseFromDic(uint32 fp);
+
   bool CheckSyncerAndDelete() const;
 
   // If |entry| is the target of prediction,
@@ -534,7 +543,14 @@ class UserHistoryPredictor : public PredictorInterface {
   bool content_word_learning_enabled_;
   bool updated_;
   std::unique_ptr<DicCache> dic_;
+  // Index of the entries in |dic_| to look up entries matching the input
+  // without scanning |dic_|.
+  UserHistoryEntryIndex entry_index_;
   mutable std::unique_ptr<UserHistoryPredictorSyncer> syncer_;
+  // Guards |dic_|, |entry_index_| and |syncer_| against the sessions
+  // evaluated in parallel.  The syncer thread does not take it; the other
+  // methods do not touch |dic_| while the syncer is running.
+  mutable Mutex mutex_;
 };
 
 }  // namespace mozc
@@ -233,7 +233,8 @@ class UserHistoryPredictorTest : public ::testing::Test {
       UserHistoryPredictor *predictor,
       const string &key, const string &value) {
     UserHistoryPredictor::Entry *e =
-        &predictor->dic_->Insert(predictor->Fingerprint(key, value))->value;
+        &predictor->InsertToDic(predictor->Fingerprint(key, value), key,
+                                value)->value;
     e->set_key(key);
     e->set_value(value);
     e->set_removed(false);
@@ -38,10 +38,14 @@
 #include <vector>
 
 #include "base/codegen_bytearray_stream.h"
+#include "base/flags.h"
 #include "base/hash.h"
 #include "base/logging.h"
 #include "storage/existence_filter.h"
 
+DEFINE_bool(blocked_existence_filter, true,
+            "generates the existence filter of the blocked format");
+
 using mozc::storage::ExistenceFilter;
 
 namespace mozc {
@@ -52,11 +56,15 @@ void GenExistenceData(const std::vector<string> &entries,
                       char **existence_data,
                       size_t *existence_data_size) {
   const int n = entries.size();
-  const int m =  ExistenceFilter::MinFilterSizeInBytesForErrorRate(
-      error_rate, n);
+  const int m = FLAGS_blocked_existence_filter ?
+      ExistenceFilter::MinBlockedFilterSizeInBytesForErrorRate(error_rate, n) :
+      ExistenceFilter::MinFilterSizeInBytesForErrorRate(error_rate, n);
   LOG(INFO) << "entry: " << n << " err: " << error_rate << " bytes: " << m;
 
-  std::unique_ptr<ExistenceFilter> filter(ExistenceFilter::CreateOptimal(m, n));
+  std::unique_ptr<ExistenceFilter> filter(
+      FLAGS_blocked_existence_filter ?
+      ExistenceFilter::CreateOptimalBlocked(m, n) :
+      ExistenceFilter::CreateOptimal(m, n));
   DCHECK(filter.get());
 
   for (size_t i = 0; i < entries.size(); ++i) {
@@ -120,6 +120,7 @@ UserBoundaryHistoryRewriter::~UserBoundaryHistoryRewriter() {}
 
 void UserBoundaryHistoryRewriter::Finish(const ConversionRequest &request,
                                          Segments *segments) {
+  scoped_lock l(&mutex_);
   if (segments->request_type() != Segments::CONVERSION) {
     return;
   }
@@ -197,6 +198,7 @@ bool UserBoundaryHistoryRewriter::Rewrite(
 }
 
 bool UserBoundaryHistoryRewriter::Reload() {
+  scoped_lock l(&mutex_);
   const string filename = ConfigFileStream::GetFileName(kFileName);
   if (!storage_->OpenOrCreate(filename.c_str(),
                               kValueSize, kLRUSize, kSeedValue)) {
@@ -269,13 +271,24 @@ bool UserBoundaryHistoryRewriter::ResizeOrInsert(
     }
     for (int j = static_cast<int>(keys_size) - 1; j >= 0; --j) {
       if (type == RESIZE) {
-        const LengthArray *value =
-            reinterpret_cast<const LengthArray *>(storage_->Lookup(key));
-        if (value != NULL) {
+        // Copies the value out of the storage so that the lock is not held
+        // while the segments are resized.
+        LengthArray value;
+        bool found = false;
+        {
+          scoped_lock l(&mutex_);
+          const LengthArray *stored_value =
+              reinterpret_cast<const LengthArray *>(storage_->Lookup(key));
+          if (stored_value != NULL) {
+            value = *stored_value;
+            found = true;
+          }
+        }
+        if (found) {
           LengthArray orig_value;
           orig_value.CopyFromUCharArray(length_array);
-          if (!value->Equal(orig_value)) {
-            value->ToUCharArray(length_array);
+          if (!value.Equal(orig_value)) {
+            value.ToUCharArray(length_array);
             const int old_segments_size =
                 static_cast<int>(target_segments_size);
             VLOG(2) << "ResizeSegment key: " << key << " "
@@ -325,6 +338,7 @@ bool UserBoundaryHistoryRewriter::ResizeOrInsert(
 }
 
 void UserBoundaryHistoryRewriter::Clear() {
+  scoped_lock l(&mutex_);
   if (storage_.get() != NULL) {
     VLOG(1) << "Clearing user segment data";
     storage_->Clear();
@@ -34,6 +34,7 @@
 #include <string>
 #include <vector>
 
+#include "base/mutex.h"
 #include "base/port.h"
 #include "rewriter/rewriter_interface.h"
 
@@ -69,6 +70,8 @@ class UserBoundaryHistoryRewriter : public RewriterInterface {
 
   const ConverterInterface *parent_converter_;
   std::unique_ptr<mozc::storage::LRUStorage> storage_;
+  // Guards |storage_|, which is shared by the sessions evaluated in parallel.
+  mutable Mutex mutex_;
 };
 
 }  // namespace mozc
@@ -38,6 +38,7 @@
 #include "base/compiler_specific.h"
 #include "base/config_file_stream.h"
 #include "base/file_util.h"
+#include "base/hash.h"
 #include "base/logging.h"
 #include "base/number_util.h"
 #include "base/string_piece.h"
@@ -434,6 +435,261 @@ bool IsT13NCandidate(const Segment::Candidate &cand) {
   // Regard the cand with 0-id as the transliterated candidate.
   return (cand.lid == 0 && cand.rid == 0);
 }
+
+// Returns true if the default candidate of the (i - 1)-th segment is a
+// number.  Used for feature "Left Number".
+bool HasNumberOnLeft(const POSMatcher &pos_matcher,
+                     const Segments &segments, size_t i) {
+  if (i < 1) {
+    return false;
+  }
+  const int j = GetDefaultCandidateIndex(segments.segment(i - 1));
+  const Segment::Candidate &candidate = segments.segment(i - 1).candidate(j);
+  return (pos_matcher.IsNumber(candidate.rid) ||
+          pos_matcher.IsKanjiNumber(candidate.rid) ||
+          Util::GetScriptType(candidate.value) == Util::NUMBER);
+}
+
+// Returns true if the default candidate of the (i + 1)-th segment is a
+// number.  Used for feature "Right Number".
+bool HasNumberOnRight(const POSMatcher &pos_matcher,
+                      const Segments &segments, size_t i) {
+  if (i + 1 >= segments.segments_size()) {
+    return false;
+  }
+  const int j = GetDefaultCandidateIndex(segments.segment(i + 1));
+  const Segment::Candidate &candidate = segments.segment(i + 1).candidate(j);
+  return (pos_matcher.IsNumber(candidate.lid) ||
+          pos_matcher.IsKanjiNumber(candidate.lid) ||
+          Util::GetScriptType(candidate.value) == Util::NUMBER);
+}
+
+// The part of the features of a segment which doesn't depend on the
+// candidates, so that it is computed once for all the candidates.
+struct FeatureContext {
+  // The values of the default candidates of the segments around the
+  // segment, or NULL if the segments don't exist.
+  const string *left2_value;
+  const string *left1_value;
+  const string *right1_value;
+  const string *right2_value;
+  bool single;        // Feature "Single" is available.
+  bool left_number;   // Feature "Left Number" is available.
+  bool right_number;  // Feature "Right Number" is available.
+
+  uint32 trigram_score;
+  uint32 bigram_score;
+  uint32 bigram_number_score;
+  uint32 unigram_score;
+  uint32 single_score;
+};
+
+const string *GetDefaultValue(const Segments &segments, size_t i) {
+  const Segment &segment = segments.segment(i);
+  return &segment.candidate(GetDefaultCandidateIndex(segment)).value;
+}
+
+void InitFeatureContext(const POSMatcher &pos_matcher,
+                        const Segments &segments, size_t i,
+                        FeatureContext *context) {
+  const size_t size = segments.segments_size();
+  context->left2_value = (i >= 2) ? GetDefaultValue(segments, i - 2) : NULL;
+  context->left1_value = (i >= 1) ? GetDefaultValue(segments, i - 1) : NULL;
+  context->right1_value =
+      (i + 1 < size) ? GetDefaultValue(segments, i + 1) : NULL;
+  context->right2_value =
+      (i + 2 < size) ? GetDefaultValue(segments, i + 2) : NULL;
+  context->single = (size - segments.history_segments_size() == 1);
+  context->left_number = HasNumberOnLeft(pos_matcher, segments, i);
+  context->right_number = HasNumberOnRight(pos_matcher, segments, i);
+
+  const size_t segments_size = segments.conversion_segments_size();
+  context->trigram_score       = (segments_size == 3) ? 180 : 30;
+  context->bigram_score        = (segments_size == 2) ? 60  : 10;
+  context->bigram_number_score = (segments_size == 2) ? 50  : 8;
+  context->unigram_score       = (segments_size == 1) ? 36  : 6;
+  context->single_score        = (segments_size == 1) ? 90  : 15;
+}
+
+// The hash states of the features of a key up to the value of the
+// candidate, e.g., "LR\t<key>\t<left value>\t" for feature "Left Right".
+// They are shared by the candidates of the same key so that the fingerprints
+// of the features are computed without hashing the common prefixes again.
+struct FeaturePrefixes {
+  explicit FeaturePrefixes(uint32 seed)
+      : lr(seed), ll(seed), rr(seed), l(seed), r(seed), s(seed), c(seed) {}
+
+  FingerprintBuilder lr;
+  FingerprintBuilder ll;
+  FingerprintBuilder rr;
+  FingerprintBuilder l;
+  FingerprintBuilder r;
+  FingerprintBuilder s;
+  FingerprintBuilder c;
+};
+
+void InitFeaturePrefixes(const FeatureContext &context, uint32 seed,
+                         StringPiece key, FeaturePrefixes *prefixes) {
+  *prefixes = FeaturePrefixes(seed);
+  prefixes->lr.Append("LR\t");
+  prefixes->ll.Append("LL\t");
+  prefixes->rr.Append("RR\t");
+  prefixes->l.Append("L\t");
+  prefixes->r.Append("R\t");
+  prefixes->s.Append("S\t");
+  prefixes->c.Append("C\t");
+  FingerprintBuilder *builders[] = {
+      &prefixes->lr, &prefixes->ll, &prefixes->rr, &prefixes->l,
+      &prefixes->r, &prefixes->s, &prefixes->c};
+  for (size_t i = 0; i < arraysize(builders); ++i) {
+    builders[i]->Append(key);
+    builders[i]->Append("\t");
+  }
+  if (context.left2_value != NULL) {
+    prefixes->ll.Append(*context.left2_value);
+    prefixes->ll.Append("\t");
+  }
+  if (context.left1_value != NULL) {
+    prefixes->lr.Append(*context.left1_value);
+    prefixes->lr.Append("\t");
+    prefixes->ll.Append(*context.left1_value);
+    prefixes->ll.Append("\t");
+    prefixes->l.Append(*context.left1_value);
+    prefixes->l.Append("\t");
+  }
+}
+
+// Fingerprints of the features of all the candidates of a segment, which
+// are looked up in the storage at once.
+class FeatureBatch {
+ public:
+  explicit FeatureBatch(size_t candidates_size) {
+    fps_.reserve(candidates_size * kMaxFeaturesSize);
+    weights_.reserve(candidates_size * kMaxFeaturesSize);
+    ends_.reserve(candidates_size);
+  }
+
+  void Add(const FingerprintBuilder &builder, uint32 weight) {
+    fps_.push_back(builder.Fingerprint());
+    weights_.push_back(weight);
+  }
+
+  // Ends the features of the current candidate.
+  void EndCandidate() {
+    ends_.push_back(fps_.size());
+  }
+
+  void Lookup(const LRUStorage &storage) {
+    values_.resize(fps_.size());
+    last_access_times_.resize(fps_.size());
+    storage.LookupFingerprints(fps_.data(), fps_.size(), values_.data(),
+                               last_access_times_.data());
+  }
+
+  // Gets the score of the |n|-th candidate, the max weight of its features
+  // found in the storage, and the last access time of them.  Returns false
+  // if no feature is found.
+  bool GetScore(size_t n, uint32 *score, uint32 *last_access_time) const {
+    *score = 0;
+    *last_access_time = 0;
+    for (size_t i = (n == 0) ? 0 : ends_[n - 1]; i < ends_[n]; ++i) {
+      const FeatureValue *v =
+          reinterpret_cast<const FeatureValue *>(values_[i]);
+      if (v != NULL && v->IsValid()) {
+        *score = std::max(*score, weights_[i]);
+        *last_access_time = std::max(*last_access_time, last_access_times_[i]);
+      }
+    }
+    return (*score > 0);
+  }
+
+ private:
+  // "LR", "LL", "RR", "L", "R", "S" and "C" for the key and the content key,
+  // and "LN" and "RN".
+  static const size_t kMaxFeaturesSize = 16;
+
+  std::vector<uint64> fps_;
+  std::vector<uint32> weights_;
+  std::vector<size_t> ends_;
+  std::vector<const char *> values_;
+  std::vector<uint32> last_access_times_;
+
+  DISALLOW_COPY_AND_ASSIGN(FeatureBatch);
+};
+
+// Adds the features of |value| and the key of |prefixes| to |batch| with the
+// weights divided by |divisor|.  The features are the same as the ones built
+// by GetFeatureLR() etc.
+void AddFeatures(const FeatureContext &context,
+                 const FeaturePrefixes &prefixes, StringPiece value,
+                 uint32 divisor, bool use_current, FeatureBatch *batch) {
+  if (context.left1_value != NULL && context.right1_value != NULL) {
+    FingerprintBuilder builder = prefixes.lr;
+    builder.Append(value);
+    builder.Append("\t");
+    builder.Append(*context.right1_value);
+    batch->Add(builder, context.trigram_score / divisor);
+  }
+  if (context.left2_value != NULL) {
+    FingerprintBuilder builder = prefixes.ll;
+    builder.Append(value);
+    batch->Add(builder, context.trigram_score / divisor);
+  }
+  if (context.right2_value != NULL) {
+    FingerprintBuilder builder = prefixes.rr;
+    builder.Append(value);
+    builder.Append("\t");
+    builder.Append(*context.right1_value);
+    builder.Append("\t");
+    builder.Append(*context.right2_value);
+    batch->Add(builder, context.trigram_score / divisor);
+  }
+  if (context.left1_value != NULL) {
+    FingerprintBuilder builder = prefixes.l;
+    builder.Append(value);
+    batch->Add(builder, context.bigram_score / divisor);
+  }
+  if (context.right1_value != NULL) {
+    FingerprintBuilder builder = prefixes.r;
+    builder.Append(value);
+    builder.Append("\t");
+    builder.Append(*context.right1_value);
+    batch->Add(builder, context.bigram_score / divisor);
+  }
+  if (context.single) {
+    FingerprintBuilder builder = prefixes.s;
+    builder.Append(value);
+    batch->Add(builder, context.single_score / divisor);
+  }
+  if (use_current) {
+    FingerprintBuilder builder = prefixes.c;
+    builder.Append(value);
+    batch->Add(builder, context.unigram_score / divisor);
+  }
+}
+
+// Adds feature "Left Number" or "Right Number" of |candidate| to |batch|.
+void AddNumberFeature(StringPiece name, const Segment::Candidate &candidate,
+                      uint32 seed, uint32 weight, FeatureBatch *batch) {
+  FingerprintBuilder builder(seed);
+  builder.Append(name);
+  builder.Append("\t");
+  builder.Append(candidate.content_key);
+  builder.Append("\t");
+  builder.Append(candidate.content_value);
+  batch->Add(builder, weight);
+}
+
+// Converts the index of the candidates including the meta candidates to the
+// index used by Segment::candidate().
+inline int GetCandidateIndex(const Segment &segment, size_t l) {
+  int j = static_cast<int>(l);
+  if (j >= static_cast<int>(segment.candidates_size())) {
+    j -= static_cast<int>(segment.candidates_size() +
+                          transliteration::NUM_T13N_TYPES);
+  }
+  return j;
+}
 }  // namespace
 
 bool UserSegmentHistoryRewriter::SortCandidates(
@@ -541,94 +797,6 @@ do { \
   } \
 } while (0)
 
-#define FETCH_FEATURE(func, base_key, base_value, weight)                    \
-  do {                                                                       \
-    if (func(segments, segment_index, base_key, base_value, &feature_key)) { \
-      const FeatureValue *v = reinterpret_cast<const FeatureValue *>(        \
-          storage_->Lookup(feature_key, &last_access_time_result));          \
-      if (v != NULL && v->IsValid()) {                                       \
-        *score = std::max(*score, weight);                                   \
-        *last_access_time =                                                  \
-            std::max(*last_access_time, last_access_time_result);            \
-      }                                                                      \
-    }                                                                        \
-  } while (0)
-
-bool UserSegmentHistoryRewriter::GetScore(const Segments &segments,
-                                          size_t segment_index,
-                                          int candidate_index,
-                                          uint32 *score,
-                                          uint32 *last_access_time) const {
-  const size_t segments_size = segments.conversion_segments_size();
-  const Segment::Candidate &top_candidate =
-      segments.segment(segment_index).candidate(0);
-  const Segment::Candidate &candidate =
-      segments.segment(segment_index).candidate(candidate_index);
-  const string &all_value = candidate.value;
-  const string &content_value = candidate.content_value;
-  const string &all_key = segments.segment(segment_index).key();
-  const string &content_key = candidate.content_key;
-  // if the segments are resized by user OR
-  // either top/target candidate has CONTEXT_SENSITIVE flags,
-  // don't apply UNIGRAM model
-  const bool context_sensitive =
-      segments.resized() ||
-      (candidate.attributes & Segment::Candidate::CONTEXT_SENSITIVE) ||
-      (segments.segment(segment_index).candidate(0).attributes &
-       Segment::Candidate::CONTEXT_SENSITIVE);
-  DCHECK(score);
-  DCHECK(last_access_time);
-
-  *score = 0;
-  *last_access_time = 0;
-
-  // They are used inside FETCH_FEATURE
-  uint32 last_access_time_result = 0;
-  string feature_key;
-
-  const uint32 trigram_score       = (segments_size == 3) ? 180 : 30;
-  const uint32 bigram_score        = (segments_size == 2) ? 60  : 10;
-  const uint32 bigram_number_score = (segments_size == 2) ? 50  : 8;
-  const uint32 unigram_score       = (segments_size == 1) ? 36  : 6;
-  const uint32 single_score        = (segments_size == 1) ? 90  : 15;
-
-  FETCH_FEATURE(GetFeatureLR, all_key, all_value, trigram_score);
-  FETCH_FEATURE(GetFeatureLL, all_key, all_value, trigram_score);
-  FETCH_FEATURE(GetFeatureRR, all_key, all_value, trigram_score);
-  FETCH_FEATURE(GetFeatureL,  all_key, all_value, bigram_score);
-  FETCH_FEATURE(GetFeatureR,  all_key, all_value, bigram_score);
-  FETCH_FEATURE(GetFeatureS,  all_key, all_value, single_score);
-  FETCH_FEATURE(GetFeatureLN, content_key, content_value, bigram_number_score);
-  FETCH_FEATURE(GetFeatureRN, content_key, content_value, bigram_number_score);
-
-  const bool is_replaceable = Replaceable(top_candidate, candidate);
-
-  if (!context_sensitive && is_replaceable) {
-    FETCH_FEATURE(GetFeatureC,  all_key, all_value, unigram_score);
-  }
-
-  if (!is_replaceable) {
-    return (*score > 0);
-  }
-
-  FETCH_FEATURE(GetFeatureLR, content_key, content_value, trigram_score / 2);
-  FETCH_FEATURE(GetFeatureLL, content_key, content_value, trigram_score / 2);
-  FETCH_FEATURE(GetFeatureRR, content_key, content_value, trigram_score / 2);
-  FETCH_FEATURE(GetFeatureL,  content_key, content_value, bigram_score / 2);
-  FETCH_FEATURE(GetFeatureR,  content_key, content_value, bigram_score / 2);
-  FETCH_FEATURE(GetFeatureS,  content_key, content_value, single_score / 2);
-  FETCH_FEATURE(GetFeatureLN, content_key,
-                content_value, bigram_number_score / 2);
-  FETCH_FEATURE(GetFeatureRN, content_key,
-                content_value, bigram_number_score / 2);
-
-  if (!context_sensitive) {
-    FETCH_FEATURE(GetFeatureC,  content_key, content_value, unigram_score / 2);
-  }
-
-  return (*score > 0);
-}
-
 // Returns true if |lhs| candidate can be replaceable with |rhs|.
 bool UserSegmentHistoryRewriter::Replaceable(
     const Segment::Candidate &lhs, const Segment::Candidate &rhs) const {
@@ -786,6 +954,7 @@ bool UserSegmentHistoryRewriter::IsAvailable(
 
 void UserSegmentHistoryRewriter::Finish(const ConversionRequest &request,
                                         Segments *segments) {
+  scoped_lock l(&mutex_);
   if (segments->request_type() != Segments::CONVERSION) {
     return;
   }
@@ -821,6 +990,7 @@ void UserSegmentHistoryRewriter::Finish(const ConversionRequest &request,
 }
 
 bool UserSegmentHistoryRewriter::Reload() {
+  scoped_lock l(&mutex_);
   const string filename = ConfigFileStream::GetFileName(kFileName);
   if (!storage_->OpenOrCreate(filename.c_str(),
                               kValueSize, kLRUSize, kSeedValue)) {
@@ -945,6 +1115,7 @@ bool UserSegmentHistoryRewriter::RewriteNumber(Segment *segment) const {
 
 bool UserSegmentHistoryRewriter::Rewrite(const ConversionRequest &request,
                                          Segments *segments) const {
+  scoped_lock l(&mutex_);
   if (!IsAvailable(request, *segments)) {
     return false;
   }
@@ -991,24 +1162,71 @@ bool UserSegmentHistoryRewriter::Rewrite(const ConversionRequest &request,
     DVLOG_IF(2, (segment->candidates_size() < max_candidates_size))
         << "Cannot expand candidates. ignored. Rewrite may be failed";
 
-    // for each all candidates expanded
-    std::vector<ScoreType> scores;
-    for (size_t l = 0;
-         l < segment->candidates_size() + segment->meta_candidates_size();
-         ++l) {
-      int j = static_cast<int>(l);
-      if (j >= static_cast<int>(segment->candidates_size())) {
-        j -= static_cast<int>(segment->candidates_size() +
-                              transliteration::NUM_T13N_TYPES);
+    // Looks up the features of all the candidates expanded at once.
+    FeatureContext context;
+    InitFeatureContext(*pos_matcher_, *segments, i, &context);
+    const uint32 seed = storage_->seed();
+    FeaturePrefixes key_prefixes(seed);
+    InitFeaturePrefixes(context, seed, segment->key(), &key_prefixes);
+    FeaturePrefixes content_key_prefixes(seed);
+    const string *content_key_of_prefixes = NULL;
+    const size_t candidates_size =
+        segment->candidates_size() + segment->meta_candidates_size();
+    const Segment::Candidate &top_candidate = segment->candidate(0);
+    FeatureBatch batch(candidates_size);
+    for (size_t l = 0; l < candidates_size; ++l) {
+      const Segment::Candidate &candidate =
+          segment->candidate(GetCandidateIndex(*segment, l));
+      // if the segments are resized by user OR
+      // either top/target candidate has CONTEXT_SENSITIVE flags,
+      // don't apply UNIGRAM model
+      const bool context_sensitive =
+          segments->resized() ||
+          (candidate.attributes & Segment::Candidate::CONTEXT_SENSITIVE) ||
+          (top_candidate.attributes & Segment::Candidate::CONTEXT_SENSITIVE);
+      const bool is_replaceable = Replaceable(top_candidate, candidate);
+      const bool use_current = !context_sensitive && is_replaceable;
+
+      AddFeatures(context, key_prefixes, candidate.value, 1, use_current,
+                  &batch);
+      if (context.left_number) {
+        AddNumberFeature("LN", candidate, seed, context.bigram_number_score,
+                         &batch);
+      }
+      if (context.right_number) {
+        AddNumberFeature("RN", candidate, seed, context.bigram_number_score,
+                         &batch);
+      }
+      // The features of "LN" and "RN" are not added for the content again
+      // as they are the same as the ones above with the higher weights.
+      if (is_replaceable) {
+        const FeaturePrefixes *prefixes = &key_prefixes;
+        if (candidate.content_key != segment->key()) {
+          if (content_key_of_prefixes == NULL ||
+              *content_key_of_prefixes != candidate.content_key) {
+            InitFeaturePrefixes(context, seed, candidate.content_key,
+                                &content_key_prefixes);
+            content_key_of_prefixes = &candidate.content_key;
+          }
+          prefixes = &content_key_prefixes;
+        }
+        AddFeatures(context, *prefixes, candidate.content_value, 2,
+                    use_current, &batch);
       }
+      batch.EndCandidate();
+    }
+    batch.Lookup(*storage_);
 
+    std::vector<ScoreType> scores;
+    for (size_t l = 0; l < candidates_size; ++l) {
       uint32 score = 0;
       uint32 last_access_time = 0;
-      if (GetScore(*segments, i, j, &score, &last_access_time)) {
+      if (batch.GetScore(l, &score, &last_access_time)) {
         scores.push_back(ScoreType());
         scores.back().score = score;
         scores.back().last_access_time = last_access_time;
-        scores.back().candidate = segment->mutable_candidate(j);
+        scores.back().candidate =
+            segment->mutable_candidate(GetCandidateIndex(*segment, l));
       }
     }
 
@@ -1023,6 +1241,7 @@ bool UserSegmentHistoryRewriter::Rewrite(const ConversionRequest &request,
 }
 
 void UserSegmentHistoryRewriter::Clear() {
+  scoped_lock l(&mutex_);
   if (storage_.get() != NULL) {
     VLOG(1) << "Clearing user segment data";
     storage_->Clear();
@@ -1045,18 +1264,11 @@ bool UserSegmentHistoryRewriter::GetFeatureLN(const Segments &segments,
                                               const string &base_value,
                                               string *value) const {
   DCHECK(value);
-  if (i < 1) {
+  if (!HasNumberOnLeft(*pos_matcher_, segments, i)) {
     return false;
   }
-  const int j = GetDefaultCandidateIndex(segments.segment(i - 1));
-  const Segment::Candidate &candidate = segments.segment(i - 1).candidate(j);
-  if (pos_matcher_->IsNumber(candidate.rid) ||
-      pos_matcher_->IsKanjiNumber(candidate.rid) ||
-      Util::GetScriptType(candidate.value) == Util::NUMBER) {
-    JoinStringsWithTab3(StringPiece("LN", 2), base_key, base_value, value);
-    return true;
-  }
-  return false;
+  JoinStringsWithTab3(StringPiece("LN", 2), base_key, base_value, value);
+  return true;
 }
 
 // Feature "Right Number"
@@ -1066,18 +1278,11 @@ bool UserSegmentHistoryRewriter::GetFeatureRN(const Segments &segments,
                                               const string &base_value,
                                               string *value) const {
   DCHECK(value);
-  if (i + 1 >= segments.segments_size()) {
+  if (!HasNumberOnRight(*pos_matcher_, segments, i)) {
     return false;
   }
-  const int j = GetDefaultCandidateIndex(segments.segment(i + 1));
-  const Segment::Candidate &candidate = segments.segment(i + 1).candidate(j);
-  if (pos_matcher_->IsNumber(candidate.lid) ||
-      pos_matcher_->IsKanjiNumber(candidate.lid) ||
-      Util::GetScriptType(candidate.value) == Util::NUMBER) {
-    JoinStringsWithTab3(StringPiece("RN", 2), base_key, base_value, value);
-    return true;
-  }
-  return false;
+  JoinStringsWithTab3(StringPiece("RN", 2), base_key, base_value, value);
+  return true;
 }
 
 }  // namespace mozc
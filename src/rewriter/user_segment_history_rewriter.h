@@ -34,6 +34,7 @@
 #include <string>
 #include <vector>
 
+#include "base/mutex.h"
 #include "converter/segments.h"
 #include "dictionary/pos_group.h"
 #include "dictionary/pos_matcher.h"
@@ -68,11 +69,6 @@ class UserSegmentHistoryRewriter : public RewriterInterface {
  private:
   bool IsAvailable(const ConversionRequest &request,
                    const Segments &segments) const;
-  bool GetScore(const Segments &segments,
-                size_t segment_index,
-                int candidate_index,
-                uint32 *score,
-                uint32 *last_access_time) const;
   bool Replaceable(const Segment::Candidate &lhs,
                    const Segment::Candidate &rhs) const;
   void RememberFirstCandidate(const Segments &segments,
@@ -99,6 +95,8 @@ class UserSegmentHistoryRewriter : public RewriterInterface {
 
 
   std::unique_ptr<storage::LRUStorage> storage_;
+  // Guards |storage_|, which is shared by the sessions evaluated in parallel.
+  mutable Mutex mutex_;
   const dictionary::POSMatcher *pos_matcher_;
   const dictionary::PosGroup *pos_group_;
 };
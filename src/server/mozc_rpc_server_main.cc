@@ -37,20 +37,39 @@ using ssize_t = SSIZE_T;
 #include <fcntl.h>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <sys/socket.h>
 #include <unistd.h>
 #endif  // OS_WIN
 
+#ifdef OS_LINUX
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif  // OS_LINUX
+
+#include <algorithm>
+#include <cerrno>
 #include <cstddef>
 #include <cstring>
+#include <deque>
+#include <iostream>
+#include <map>
 #include <memory>
+#include <sstream>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "base/clock.h"
 #include "base/flags.h"
 #include "base/init_mozc.h"
+#include "base/mutex.h"
 #include "base/singleton.h"
+#include "base/stopwatch.h"
 #include "base/system_util.h"
+#include "base/thread.h"
+#include "base/unnamed_event.h"
 #include "engine/engine_factory.h"
 #include "protocol/commands.pb.h"
 #include "session/random_keyevents_generator.h"
@@ -61,8 +80,17 @@ DEFINE_string(host, "localhost", "server host name");
 DEFINE_bool(server, true, "server mode");
 DEFINE_bool(client, false, "client mode");
 DEFINE_int32(client_test_size, 100, "client test size");
+DEFINE_int32(client_threads, 1,
+             "number of concurrent clients in client mode.  Each client has "
+             "its own connection and session.");
+DEFINE_int32(client_pipeline_depth, 1,
+             "number of requests a client sends without waiting for replies");
 DEFINE_int32(port, 8000, "port of RPC server");
 DEFINE_int32(rpc_timeout, 60000, "timeout");
+DEFINE_int32(rpc_worker_threads, 4, "number of worker threads of RPC server");
+DEFINE_int32(rpc_stats_interval, 60,
+             "interval in seconds to log the latency histogram of RPC server. "
+             "0 disables it.");
 DEFINE_string(user_profile_directory, "", "user profile directory");
 
 namespace mozc {
@@ -73,16 +101,36 @@ const size_t kMaxRequestSize = 32 * 32 * 8192;
 const size_t kMaxOutputSize  = 32 * 32 * 8192;
 const int    kInvalidSocket  = -1;
 
+// Requests and replies are framed by the size of the serialized protobuf in
+// network byte order.  A connection may carry any number of frames, and a
+// client may send the next request before receiving the previous reply.
+// Replies are returned in the order of the requests.
+void AppendFrame(const string &payload, string *output) {
+  const uint32 size = htonl(static_cast<uint32>(payload.size()));
+  output->append(reinterpret_cast<const char *>(&size), sizeof(size));
+  output->append(payload);
+}
+
 // TODO(taku): timeout should be handled.
 bool Recv(int socket, char *buf,
           size_t buf_size, int timeout) {
   ssize_t buf_left = buf_size;
   while (buf_left > 0) {
     const ssize_t read_size = ::recv(socket, buf, buf_left, 0);
+#ifndef OS_WIN
+    if (read_size < 0 && errno == EINTR) {
+      // Interrupted by a signal before receiving any data.
+      continue;
+    }
+#endif  // OS_WIN
     if (read_size < 0) {
       LOG(ERROR) << "an error occurred during recv()";
       return false;
     }
+    if (read_size == 0) {
+      // The peer closed the connection.
+      return false;
+    }
     buf += read_size;
     buf_left -= read_size;
   }
@@ -102,6 +150,11 @@ bool Send(int socket, const char *buf,
     const int kFlag = MSG_NOSIGNAL;
 #endif
     const ssize_t read_size = ::send(socket, buf, buf_left, kFlag);
+#ifndef OS_WIN
+    if (read_size < 0 && errno == EINTR) {
+      continue;
+    }
+#endif  // OS_WIN
     if (read_size < 0) {
       LOG(ERROR) << "an error occurred during sending";
       return false;
@@ -122,46 +175,132 @@ void CloseSocket(int client_socket) {
 #endif
 }
 
-// Standalone RPCServer.
-// TODO(taku): Make a RPC class inherited from IPCInterface.
-// This allows us to reuse client::Session library and SessionServer.
-class RPCServer {
- public:
-  RPCServer() : server_socket_(kInvalidSocket),
-                handler_(new SessionHandler(
-                    std::unique_ptr<Engine>(EngineFactory::Create()))) {
-    struct sockaddr_in sin;
+// Small requests and replies are sent back to back on a connection, so
+// Nagle's algorithm only adds latency.
+void SetNoDelay(int socket) {
+  int on = 1;
+  ::setsockopt(socket, IPPROTO_TCP, TCP_NODELAY,
+               reinterpret_cast<char *>(&on), sizeof(on));
+}
 
-    server_socket_ = ::socket(AF_INET, SOCK_STREAM, 0);
+int CreateServerSocket() {
+  struct sockaddr_in sin;
 
-    CHECK_NE(server_socket_, kInvalidSocket) << "socket failed";
+  const int server_socket = ::socket(AF_INET, SOCK_STREAM, 0);
+
+  CHECK_NE(server_socket, kInvalidSocket) << "socket failed";
 
 #ifndef OS_WIN
-    int flags = ::fcntl(server_socket_, F_GETFD, 0);
-    CHECK_GE(flags, 0) << "fcntl(F_GETFD) failed";
-    flags |= FD_CLOEXEC;
-    CHECK_EQ(::fcntl(server_socket_, F_SETFD, flags), 0)
-        << "fctl(F_SETFD) failed";
+  int flags = ::fcntl(server_socket, F_GETFD, 0);
+  CHECK_GE(flags, 0) << "fcntl(F_GETFD) failed";
+  flags |= FD_CLOEXEC;
+  CHECK_EQ(::fcntl(server_socket, F_SETFD, flags), 0)
+      << "fctl(F_SETFD) failed";
 #endif
 
-    ::memset(&sin, 0, sizeof(sin));
-    sin.sin_port = htons(FLAGS_port);
-    sin.sin_family = AF_INET;
-    sin.sin_addr.s_addr = htonl(INADDR_ANY);
+  ::memset(&sin, 0, sizeof(sin));
+  sin.sin_port = htons(FLAGS_port);
+  sin.sin_family = AF_INET;
+  sin.sin_addr.s_addr = htonl(INADDR_ANY);
+
+  int on = 1;
+  ::setsockopt(server_socket,
+               SOL_SOCKET,
+               SO_REUSEADDR, reinterpret_cast<char * >(&on),
+               sizeof(on));
+
+  CHECK_GE(::bind(server_socket,
+                  reinterpret_cast<struct sockaddr *>(&sin),
+                  sizeof(sin)), 0) << "bind failed";
+
+  CHECK_GE(::listen(server_socket, SOMAXCONN), 0) << "listen failed";
+  CHECK_NE(server_socket, 0);
+  return server_socket;
+}
+
+// Histogram of latencies in microseconds.  The i-th bucket (i > 0) counts the
+// latencies in [2^(i-1), 2^i).  The 0-th bucket counts zero.
+class LatencyHistogram {
+ public:
+  LatencyHistogram() {
+    Clear();
+  }
+
+  void Add(uint64 usec) {
+    size_t i = 0;
+    while (i + 1 < kNumBuckets && (1ULL << i) <= usec) {
+      ++i;
+    }
+    ++buckets_[i];
+    ++count_;
+    sum_ += usec;
+    max_ = std::max(max_, usec);
+  }
 
-    int on = 1;
-    ::setsockopt(server_socket_,
-                 SOL_SOCKET,
-                 SO_REUSEADDR, reinterpret_cast<char * >(&on),
-                 sizeof(on));
+  void Merge(const LatencyHistogram &other) {
+    for (size_t i = 0; i < kNumBuckets; ++i) {
+      buckets_[i] += other.buckets_[i];
+    }
+    count_ += other.count_;
+    sum_ += other.sum_;
+    max_ = std::max(max_, other.max_);
+  }
 
-    CHECK_GE(::bind(server_socket_,
-                    reinterpret_cast<struct sockaddr *>(&sin),
-                    sizeof(sin)), 0) << "bind failed";
+  void Clear() {
+    std::fill(buckets_, buckets_ + kNumBuckets, 0);
+    count_ = 0;
+    sum_ = 0;
+    max_ = 0;
+  }
 
-    CHECK_GE(::listen(server_socket_, SOMAXCONN), 0) << "listen failed";
-    CHECK_NE(server_socket_, 0);
+  uint64 count() const { return count_; }
 
+  // Returns the upper bound of the bucket where the |percentile| % of the
+  // latencies fall in, capped by the maximum latency.
+  uint64 GetPercentile(int percentile) const {
+    const uint64 threshold = (count_ * percentile + 99) / 100;
+    uint64 accumulated = 0;
+    for (size_t i = 0; i < kNumBuckets; ++i) {
+      accumulated += buckets_[i];
+      if (accumulated >= threshold) {
+        return std::min<uint64>(1ULL << i, max_);
+      }
+    }
+    return max_;
+  }
+
+  string DebugString() const {
+    std::ostringstream os;
+    os << "count=" << count_;
+    if (count_ > 0) {
+      os << " avg=" << sum_ / count_ << "us"
+         << " p50<=" << GetPercentile(50) << "us"
+         << " p90<=" << GetPercentile(90) << "us"
+         << " p99<=" << GetPercentile(99) << "us"
+         << " max=" << max_ << "us";
+    }
+    return os.str();
+  }
+
+ private:
+  static const size_t kNumBuckets = 32;
+
+  uint64 buckets_[kNumBuckets];
+  uint64 count_;
+  uint64 sum_;
+  uint64 max_;
+};
+
+// Standalone RPCServer.
+// Serves the requests of each connection serially until the client closes it.
+// Used on the platforms where EpollRPCServer is not available.
+// TODO(taku): Make a RPC class inherited from IPCInterface.
+// This allows us to reuse client::Session library and SessionServer.
+class RPCServer {
+ public:
+  RPCServer() : server_socket_(CreateServerSocket()),
+                handler_(new SessionHandler(
+                    std::unique_ptr<Engine>(EngineFactory::Create()))) {
     handler_->AddObserver(Singleton<session::SessionUsageObserver>::get());
   }
 
@@ -180,69 +319,577 @@ class RPCServer {
         LOG(ERROR) << "accept failed";
         continue;
       }
+      SetNoDelay(client_socket);
 
-      uint32 request_size = 0;
-      // Receive the size of data.
-      if (!Recv(client_socket, reinterpret_cast<char *>(&request_size),
-                sizeof(request_size), FLAGS_rpc_timeout)) {
-        LOG(ERROR) << "Cannot receive request_size header.";
-        CloseSocket(client_socket);
-        continue;
+      while (HandleRequest(client_socket)) {
       }
-      request_size = ntohl(request_size);
-      CHECK_GT(request_size, 0);
-      CHECK_LT(request_size, kMaxRequestSize);
-
-      // Receive the body of serialized protobuf.
-      std::unique_ptr<char[]> request_str(new char[request_size]);
-      if (!Recv(client_socket,
-                request_str.get(), request_size, FLAGS_rpc_timeout)) {
-        LOG(ERROR) << "cannot receive body of request.";
-        CloseSocket(client_socket);
+
+      CloseSocket(client_socket);
+    }
+  }
+
+ private:
+  // Returns false when the connection should be closed.
+  bool HandleRequest(int client_socket) {
+    uint32 request_size = 0;
+    // Receive the size of data.
+    if (!Recv(client_socket, reinterpret_cast<char *>(&request_size),
+              sizeof(request_size), FLAGS_rpc_timeout)) {
+      // The client closed the connection.
+      return false;
+    }
+    request_size = ntohl(request_size);
+    if (request_size == 0 || request_size >= kMaxRequestSize) {
+      LOG(ERROR) << "Invalid request size: " << request_size;
+      return false;
+    }
+
+    // Receive the body of serialized protobuf.
+    std::unique_ptr<char[]> request_str(new char[request_size]);
+    if (!Recv(client_socket,
+              request_str.get(), request_size, FLAGS_rpc_timeout)) {
+      LOG(ERROR) << "cannot receive body of request.";
+      return false;
+    }
+
+    commands::Command command;
+    if (!command.mutable_input()->ParseFromArray(request_str.get(),
+                                                 request_size)) {
+      LOG(ERROR) << "ParseFromArray failed";
+      return false;
+    }
+
+    CHECK(handler_->EvalCommand(&command));
+
+    string output_str;
+    // Return the result.
+    CHECK(command.output().SerializeToString(&output_str));
+    CHECK_GT(output_str.size(), 0);
+    CHECK_LT(output_str.size(), kMaxOutputSize);
+
+    string frame;
+    AppendFrame(output_str, &frame);
+    if (!Send(client_socket, frame.data(), frame.size(), FLAGS_rpc_timeout)) {
+      LOG(ERROR) << "Cannot send reply.";
+      return false;
+    }
+    return true;
+  }
+
+  int server_socket_;
+  std::unique_ptr<SessionHandler> handler_;
+};
+
+#ifdef OS_LINUX
+
+struct RPCRequest {
+  uint64 connection_id;
+  // Sequence number of the request in the connection.
+  uint64 seq;
+  commands::Command command;
+  // Measures the time from the arrival of the request.
+  Stopwatch stopwatch;
+};
+
+struct RPCResponse {
+  uint64 connection_id;
+  uint64 seq;
+  // Framed output.
+  string frame;
+};
+
+// Queue of the responses from the workers to the I/O thread.  The I/O thread
+// is woken up via eventfd.
+class RPCResponseQueue {
+ public:
+  RPCResponseQueue() : event_fd_(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+    CHECK_NE(event_fd_, kInvalidSocket) << "eventfd failed";
+  }
+
+  ~RPCResponseQueue() {
+    ::close(event_fd_);
+  }
+
+  int event_fd() const { return event_fd_; }
+
+  void Push(RPCResponse *response) {
+    {
+      scoped_lock l(&mutex_);
+      responses_.push_back(RPCResponse());
+      std::swap(responses_.back(), *response);
+    }
+    const uint64 one = 1;
+    if (::write(event_fd_, &one, sizeof(one)) != sizeof(one)) {
+      LOG(ERROR) << "Cannot notify the response: " << errno;
+    }
+  }
+
+  void PopAll(std::vector<RPCResponse> *responses) {
+    uint64 value = 0;
+    if (::read(event_fd_, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+      LOG(ERROR) << "Cannot read eventfd: " << errno;
+    }
+    responses->clear();
+    scoped_lock l(&mutex_);
+    responses->swap(responses_);
+  }
+
+ private:
+  const int event_fd_;
+  Mutex mutex_;
+  std::vector<RPCResponse> responses_;
+
+  DISALLOW_COPY_AND_ASSIGN(RPCResponseQueue);
+};
+
+// Evaluates the requests dispatched to this worker in FIFO order.  The
+// requests of a session are always dispatched to the same worker, so that
+// they are evaluated in the order the client sent them, while the sessions on
+// the other workers are evaluated in parallel.
+class RPCWorker : public Thread {
+ public:
+  RPCWorker(SessionHandler *handler, RPCResponseQueue *responses)
+      : handler_(handler),
+        responses_(responses),
+        quit_(false) {}
+
+  ~RPCWorker() override {}
+
+  void Push(std::unique_ptr<RPCRequest> request) {
+    {
+      scoped_lock l(&mutex_);
+      requests_.push_back(std::move(request));
+    }
+    event_.Notify();
+  }
+
+  void Quit() {
+    {
+      scoped_lock l(&mutex_);
+      quit_ = true;
+    }
+    event_.Notify();
+  }
+
+  // Merges the latencies of the requests evaluated since the last call into
+  // |histogram|.
+  void FlushHistogram(LatencyHistogram *histogram) {
+    scoped_lock l(&histogram_mutex_);
+    histogram->Merge(histogram_);
+    histogram_.Clear();
+  }
+
+  void Run() override {
+    while (true) {
+      std::unique_ptr<RPCRequest> request;
+      {
+        scoped_lock l(&mutex_);
+        if (quit_) {
+          return;
+        }
+        if (!requests_.empty()) {
+          request = std::move(requests_.front());
+          requests_.pop_front();
+        }
+      }
+      if (request == nullptr) {
+        event_.Wait(-1);
         continue;
       }
+      Eval(request.get());
+    }
+  }
+
+ private:
+  void Eval(RPCRequest *request) {
+    CHECK(handler_->EvalCommand(&request->command));
+
+    string output_str;
+    CHECK(request->command.output().SerializeToString(&output_str));
+    CHECK_GT(output_str.size(), 0);
+    CHECK_LT(output_str.size(), kMaxOutputSize);
+
+    RPCResponse response;
+    response.connection_id = request->connection_id;
+    response.seq = request->seq;
+    AppendFrame(output_str, &response.frame);
+
+    request->stopwatch.Stop();
+    {
+      scoped_lock l(&histogram_mutex_);
+      histogram_.Add(
+          static_cast<uint64>(request->stopwatch.GetElapsedMicroseconds()));
+    }
+
+    responses_->Push(&response);
+  }
+
+  SessionHandler *handler_;
+  RPCResponseQueue *responses_;
+
+  Mutex mutex_;
+  std::deque<std::unique_ptr<RPCRequest>> requests_;
+  bool quit_;
+  UnnamedEvent event_;
+
+  Mutex histogram_mutex_;
+  LatencyHistogram histogram_;
+
+  DISALLOW_COPY_AND_ASSIGN(RPCWorker);
+};
+
+// RPC server with persistent connections.  A single I/O thread accepts and
+// reads/writes all the connections with epoll, and the requests are
+// evaluated by a pool of RPCWorkers.
+class EpollRPCServer {
+ public:
+  EpollRPCServer()
+      : server_socket_(CreateServerSocket()),
+        epoll_fd_(::epoll_create1(EPOLL_CLOEXEC)),
+        handler_(new SessionHandler(
+            std::unique_ptr<Engine>(EngineFactory::Create()))),
+        next_connection_id_(kFirstConnectionId),
+        last_stats_time_(Clock::GetTime()) {
+    CHECK_NE(epoll_fd_, kInvalidSocket) << "epoll_create1 failed";
+    handler_->AddObserver(Singleton<session::SessionUsageObserver>::get());
+
+    SetNonBlocking(server_socket_);
+    AddToEpoll(server_socket_, kServerSocketId, EPOLLIN);
+    AddToEpoll(responses_.event_fd(), kResponseQueueId, EPOLLIN);
+
+    const int num_workers = std::max(1, FLAGS_rpc_worker_threads);
+    for (int i = 0; i < num_workers; ++i) {
+      workers_.emplace_back(
+          new RPCWorker(handler_.get(), &responses_));
+      workers_.back()->SetJoinable(true);
+      workers_.back()->Start("RPCWorker");
+    }
+  }
+
+  ~EpollRPCServer() {
+    for (size_t i = 0; i < workers_.size(); ++i) {
+      workers_[i]->Quit();
+      workers_[i]->Join();
+    }
+    for (auto &it : connections_) {
+      CloseSocket(it.second->socket);
+    }
+    ::close(epoll_fd_);
+    CloseSocket(server_socket_);
+  }
+
+  void Loop() {
+    LOG(INFO) << "Start Mozc EpollRPCServer with " << workers_.size()
+              << " workers";
+
+    const int kMaxEvents = 64;
+    const int kTimeoutMsec = 1000;
+    struct epoll_event events[kMaxEvents];
+    while (true) {
+      const int num_events =
+          ::epoll_wait(epoll_fd_, events, kMaxEvents, kTimeoutMsec);
+      if (num_events < 0 && errno != EINTR) {
+        LOG(ERROR) << "epoll_wait failed: " << errno;
+      }
+      for (int i = 0; i < num_events; ++i) {
+        const uint64 id = events[i].data.u64;
+        if (id == kServerSocketId) {
+          Accept();
+        } else if (id == kResponseQueueId) {
+          HandleResponses();
+        } else {
+          HandleConnectionEvent(id, events[i].events);
+        }
+      }
+      MaybeLogStats();
+    }
+  }
+
+ private:
+  // Ids in epoll_event::data.  Connections have ids larger than these.
+  static const uint64 kServerSocketId = 0;
+  static const uint64 kResponseQueueId = 1;
+  static const uint64 kFirstConnectionId = 2;
+
+  // Stops reading a connection while it has this number of requests in
+  // flight.
+  static const uint64 kMaxPipelinedRequests = 1024;
+
+  struct Connection {
+    Connection() : socket(kInvalidSocket), events(0), read_closed(false),
+                   write_offset(0), next_request_seq(0),
+                   next_response_seq(0) {}
+
+    uint64 in_flight() const { return next_request_seq - next_response_seq; }
+
+    int socket;
+    uint32 events;
+    bool read_closed;
+    string read_buffer;
+    string write_buffer;
+    size_t write_offset;
+    uint64 next_request_seq;
+    uint64 next_response_seq;
+    // Responses which arrived before the preceding ones.
+    std::map<uint64, string> pending_responses;
+  };
+
+  static void SetNonBlocking(int socket) {
+    const int flags = ::fcntl(socket, F_GETFL, 0);
+    CHECK_GE(flags, 0) << "fcntl(F_GETFL) failed";
+    CHECK_EQ(::fcntl(socket, F_SETFL, flags | O_NONBLOCK), 0)
+        << "fcntl(F_SETFL) failed";
+  }
+
+  void AddToEpoll(int socket, uint64 id, uint32 events) {
+    struct epoll_event event;
+    ::memset(&event, 0, sizeof(event));
+    event.events = events;
+    event.data.u64 = id;
+    CHECK_EQ(::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, socket, &event), 0)
+        << "epoll_ctl failed";
+  }
 
-      commands::Command command;
-      if (!command.mutable_input()->ParseFromArray(request_str.get(),
-                                                   request_size)) {
+  void UpdateEvents(uint64 id, Connection *connection) {
+    uint32 events = 0;
+    if (!connection->read_closed &&
+        connection->in_flight() < kMaxPipelinedRequests) {
+      events |= EPOLLIN;
+    }
+    if (connection->write_offset < connection->write_buffer.size()) {
+      events |= EPOLLOUT;
+    }
+    if (events == connection->events) {
+      return;
+    }
+    struct epoll_event event;
+    ::memset(&event, 0, sizeof(event));
+    event.events = events;
+    event.data.u64 = id;
+    if (::epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, connection->socket,
+                    &event) != 0) {
+      LOG(ERROR) << "epoll_ctl failed: " << errno;
+    }
+    connection->events = events;
+  }
+
+  void Accept() {
+    while (true) {
+      const int client_socket = ::accept4(server_socket_, NULL, NULL,
+                                          SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (client_socket == kInvalidSocket) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+          LOG(ERROR) << "accept failed: " << errno;
+        }
+        return;
+      }
+      SetNoDelay(client_socket);
+      const uint64 id = next_connection_id_++;
+      std::unique_ptr<Connection> connection(new Connection);
+      connection->socket = client_socket;
+      connection->events = EPOLLIN;
+      AddToEpoll(client_socket, id, EPOLLIN);
+      connections_[id] = std::move(connection);
+    }
+  }
+
+  void HandleConnectionEvent(uint64 id, uint32 events) {
+    auto it = connections_.find(id);
+    if (it == connections_.end()) {
+      return;
+    }
+    Connection *connection = it->second.get();
+    bool ok = true;
+    if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+      ok = Read(id, connection);
+    }
+    if (ok && (events & EPOLLOUT)) {
+      ok = Write(connection);
+    }
+    FinishEvent(id, connection, ok);
+  }
+
+  // Closes the connection if |ok| is false or nothing is left to do.
+  // Otherwise updates the events to wait for.
+  void FinishEvent(uint64 id, Connection *connection, bool ok) {
+    if (!ok || (connection->read_closed && connection->in_flight() == 0 &&
+                connection->write_offset == connection->write_buffer.size())) {
+      // Responses to this connection arriving later are discarded.
+      ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, connection->socket, NULL);
+      CloseSocket(connection->socket);
+      connections_.erase(id);
+      return;
+    }
+    UpdateEvents(id, connection);
+  }
+
+  // Returns false on errors.
+  bool Read(uint64 id, Connection *connection) {
+    char buf[65536];
+    while (!connection->read_closed) {
+      const ssize_t read_size = ::recv(connection->socket, buf, sizeof(buf), 0);
+      if (read_size < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+          break;
+        }
+        if (errno == EINTR) {
+          continue;
+        }
+        VLOG(1) << "recv failed: " << errno;
+        return false;
+      }
+      if (read_size == 0) {
+        connection->read_closed = true;
+        break;
+      }
+      connection->read_buffer.append(buf, read_size);
+    }
+    return DispatchRequests(id, connection);
+  }
+
+  // Dispatches the complete requests in the read buffer.  Returns false if
+  // the request is broken.
+  bool DispatchRequests(uint64 id, Connection *connection) {
+    const string &buffer = connection->read_buffer;
+    size_t offset = 0;
+    while (connection->in_flight() < kMaxPipelinedRequests &&
+           buffer.size() - offset >= sizeof(uint32)) {
+      uint32 request_size = 0;
+      ::memcpy(&request_size, buffer.data() + offset, sizeof(request_size));
+      request_size = ntohl(request_size);
+      if (request_size == 0 || request_size >= kMaxRequestSize) {
+        LOG(ERROR) << "Invalid request size: " << request_size;
+        return false;
+      }
+      if (buffer.size() - offset - sizeof(uint32) < request_size) {
+        break;
+      }
+      std::unique_ptr<RPCRequest> request(new RPCRequest);
+      request->stopwatch = Stopwatch::StartNew();
+      if (!request->command.mutable_input()->ParseFromArray(
+              buffer.data() + offset + sizeof(uint32), request_size)) {
         LOG(ERROR) << "ParseFromArray failed";
-        CloseSocket(client_socket);
-        continue;
+        return false;
       }
+      offset += sizeof(uint32) + request_size;
+      request->connection_id = id;
+      request->seq = connection->next_request_seq++;
 
-      CHECK(handler_->EvalCommand(&command));
+      // Requests without session id, e.g., CREATE_SESSION, are dispatched by
+      // the connection.
+      const uint64 session_id = request->command.input().id();
+      const uint64 key = session_id != 0 ? session_id : id;
+      workers_[key % workers_.size()]->Push(std::move(request));
+    }
+    connection->read_buffer.erase(0, offset);
+    return true;
+  }
 
-      string output_str;
-      // Return the result.
-      CHECK(command.output().SerializeToString(&output_str));
+  // Returns false on errors.
+  bool Write(Connection *connection) {
+    while (connection->write_offset < connection->write_buffer.size()) {
+      const ssize_t sent_size = ::send(
+          connection->socket,
+          connection->write_buffer.data() + connection->write_offset,
+          connection->write_buffer.size() - connection->write_offset,
+          MSG_NOSIGNAL);
+      if (sent_size < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+          return true;
+        }
+        if (errno == EINTR) {
+          continue;
+        }
+        VLOG(1) << "send failed: " << errno;
+        return false;
+      }
+      connection->write_offset += sent_size;
+    }
+    connection->write_buffer.clear();
+    connection->write_offset = 0;
+    return true;
+  }
 
-      uint32 output_size = output_str.size();
-      CHECK_GT(output_size, 0);
-      CHECK_LT(output_size, kMaxOutputSize);
-      output_size = htonl(output_size);
+  void HandleResponses() {
+    std::vector<RPCResponse> responses;
+    responses_.PopAll(&responses);
+    std::vector<uint64> updated_ids;
+    for (size_t i = 0; i < responses.size(); ++i) {
+      RPCResponse &response = responses[i];
+      auto it = connections_.find(response.connection_id);
+      if (it == connections_.end()) {
+        continue;
+      }
+      Connection *connection = it->second.get();
+      connection->pending_responses[response.seq].swap(response.frame);
+      // Append the responses which are ready in the order of the requests.
+      auto pending = connection->pending_responses.begin();
+      while (pending != connection->pending_responses.end() &&
+             pending->first == connection->next_response_seq) {
+        connection->write_buffer.append(pending->second);
+        ++connection->next_response_seq;
+        pending = connection->pending_responses.erase(pending);
+      }
+      updated_ids.push_back(response.connection_id);
+    }
 
-      if (!Send(client_socket, reinterpret_cast<char *>(&output_size),
-                sizeof(output_size), FLAGS_rpc_timeout) ||
-          !Send(client_socket, output_str.data(), output_str.size(),
-                FLAGS_rpc_timeout)) {
-        LOG(ERROR) << "Cannot send reply.";
+    std::sort(updated_ids.begin(), updated_ids.end());
+    updated_ids.erase(std::unique(updated_ids.begin(), updated_ids.end()),
+                      updated_ids.end());
+    for (size_t i = 0; i < updated_ids.size(); ++i) {
+      const uint64 id = updated_ids[i];
+      Connection *connection = connections_[id].get();
+      // Requests left in the read buffer by the pipelining limit.
+      bool ok = DispatchRequests(id, connection);
+      if (ok) {
+        ok = Write(connection);
       }
+      FinishEvent(id, connection, ok);
+    }
+  }
 
-      CloseSocket(client_socket);
+  void MaybeLogStats() {
+    if (FLAGS_rpc_stats_interval <= 0) {
+      return;
     }
+    const uint64 now = Clock::GetTime();
+    if (now < last_stats_time_ + FLAGS_rpc_stats_interval) {
+      return;
+    }
+    last_stats_time_ = now;
+    LatencyHistogram histogram;
+    for (size_t i = 0; i < workers_.size(); ++i) {
+      workers_[i]->FlushHistogram(&histogram);
+    }
+    LOG(INFO) << "connections=" << connections_.size()
+              << " latency: " << histogram.DebugString();
   }
 
- private:
-  int server_socket_;
+  const int server_socket_;
+  const int epoll_fd_;
   std::unique_ptr<SessionHandler> handler_;
+  RPCResponseQueue responses_;
+  std::vector<std::unique_ptr<RPCWorker>> workers_;
+  std::map<uint64, std::unique_ptr<Connection>> connections_;
+  uint64 next_connection_id_;
+  uint64 last_stats_time_;
+
+  DISALLOW_COPY_AND_ASSIGN(EpollRPCServer);
 };
 
+#endif  // OS_LINUX
+
 // Standalone RPCClient.
+// The connection is kept until the session is deleted.
 // TODO(taku): Make a RPC class inherited from IPCInterface.
 // This allows us to reuse client::Session library and SessionServer.
 class RPCClient {
  public:
-  RPCClient() : id_(0) {}
+  RPCClient() : id_(0), socket_(kInvalidSocket) {}
+
+  ~RPCClient() {
+    Disconnect();
+  }
 
   bool CreateSession() {
     id_ = 0;
@@ -260,14 +907,17 @@ class RPCClient {
   bool DeleteSession() {
     commands::Input input;
     commands::Output output;
+    input.set_id(id_);
     id_ = 0;
     input.set_type(commands::Input::DELETE_SESSION);
-    return (Call(input, &output) &&
-            output.error_code() == commands::Output::SESSION_SUCCESS);
+    const bool result = (Call(input, &output) &&
+        output.error_code() == commands::Output::SESSION_SUCCESS);
+    Disconnect();
+    return result;
   }
 
   bool SendKey(const mozc::commands::KeyEvent &key,
-               mozc::commands::Output *output) const {
+               mozc::commands::Output *output) {
     if (id_ == 0) {
       return false;
     }
@@ -279,9 +929,49 @@ class RPCClient {
             output->error_code() == commands::Output::SESSION_SUCCESS);
   }
 
+  // Sends |keys| keeping up to |pipeline_depth| requests in flight, and adds
+  // the latency of each request to |histogram|.
+  bool SendKeys(const std::vector<commands::KeyEvent> &keys,
+                int pipeline_depth, LatencyHistogram *histogram) {
+    if (id_ == 0) {
+      return false;
+    }
+    pipeline_depth = std::max(1, pipeline_depth);
+    std::deque<Stopwatch> in_flight;
+    size_t sent = 0;
+    size_t received = 0;
+    while (received < keys.size()) {
+      while (sent < keys.size() && in_flight.size() < pipeline_depth) {
+        commands::Input input;
+        input.set_type(commands::Input::SEND_KEY);
+        input.set_id(id_);
+        input.mutable_key()->CopyFrom(keys[sent]);
+        in_flight.push_back(Stopwatch::StartNew());
+        if (!SendInput(input)) {
+          return false;
+        }
+        ++sent;
+      }
+      commands::Output output;
+      if (!ReceiveOutput(&output) ||
+          output.error_code() != commands::Output::SESSION_SUCCESS) {
+        return false;
+      }
+      VLOG(1) << "Output of SendKey: " << output.Utf8DebugString();
+      in_flight.front().Stop();
+      histogram->Add(
+          static_cast<uint64>(in_flight.front().GetElapsedMicroseconds()));
+      in_flight.pop_front();
+      ++received;
+    }
+    return true;
+  }
+
  private:
-  bool Call(const commands::Input &input,
-            commands::Output *output) const {
+  void Connect() {
+    if (socket_ != kInvalidSocket) {
+      return;
+    }
     struct addrinfo hints, *res;
     ::memset(&hints, 0, sizeof(hints));
     hints.ai_socktype = SOCK_STREAM;
@@ -292,47 +982,91 @@ class RPCClient {
                            &hints, &res), 0)
         << "getaddrinfo failed";
 
-    const int client_socket = ::socket(res->ai_family,
-                                       res->ai_socktype,
-                                       res->ai_protocol);
-    CHECK_NE(client_socket, kInvalidSocket) << "socket failed";
-    CHECK_GE(::connect(client_socket,
-                       res->ai_addr, res->ai_addrlen), 0)
+    socket_ = ::socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    CHECK_NE(socket_, kInvalidSocket) << "socket failed";
+    CHECK_GE(::connect(socket_, res->ai_addr, res->ai_addrlen), 0)
         << "connect failed";
+    SetNoDelay(socket_);
+
+    ::freeaddrinfo(res);
+  }
+
+  void Disconnect() {
+    if (socket_ != kInvalidSocket) {
+      CloseSocket(socket_);
+      socket_ = kInvalidSocket;
+    }
+  }
 
+  bool SendInput(const commands::Input &input) {
+    Connect();
     string request_str;
     CHECK(input.SerializeToString(&request_str));
-    uint32 request_size = request_str.size();
-    CHECK_GT(request_size, 0);
-    CHECK_LT(request_size, kMaxRequestSize);
-    request_size = htonl(request_size);
+    CHECK_GT(request_str.size(), 0);
+    CHECK_LT(request_str.size(), kMaxRequestSize);
 
-    CHECK(Send(client_socket, reinterpret_cast<char *>(&request_size),
-               sizeof(request_size), FLAGS_rpc_timeout));
-    CHECK(Send(client_socket, request_str.data(), request_str.size(),
-               FLAGS_rpc_timeout));
+    string frame;
+    AppendFrame(request_str, &frame);
+    return Send(socket_, frame.data(), frame.size(), FLAGS_rpc_timeout);
+  }
 
+  bool ReceiveOutput(commands::Output *output) {
     uint32 output_size = 0;
-    CHECK(Recv(client_socket, reinterpret_cast<char *>(&output_size),
-               sizeof(output_size), FLAGS_rpc_timeout));
+    if (!Recv(socket_, reinterpret_cast<char *>(&output_size),
+              sizeof(output_size), FLAGS_rpc_timeout)) {
+      return false;
+    }
     output_size = ntohl(output_size);
     CHECK_GT(output_size, 0);
     CHECK_LT(output_size, kMaxOutputSize);
 
     std::unique_ptr<char[]> output_str(new char[output_size]);
-    CHECK(Recv(client_socket,
-               output_str.get(), output_size, FLAGS_rpc_timeout));
+    if (!Recv(socket_, output_str.get(), output_size, FLAGS_rpc_timeout)) {
+      return false;
+    }
 
-    CHECK(output->ParseFromArray(output_str.get(), output_size));
+    return output->ParseFromArray(output_str.get(), output_size);
+  }
 
-    ::freeaddrinfo(res);
+  bool Call(const commands::Input &input, commands::Output *output) {
+    return SendInput(input) && ReceiveOutput(output);
+  }
 
-    CloseSocket(client_socket);
+  uint64 id_;
+  int socket_;
+};
 
-    return true;
+// Drives the server with random key events through one RPCClient.
+class RPCClientThread : public Thread {
+ public:
+  // The key events are generated here rather than in Run(), since
+  // RandomKeyEventsGenerator shares the random state of the process and is
+  // not thread-safe.  Construct the threads on one thread.
+  RPCClientThread() : num_requests_(0) {
+    sequences_.resize(FLAGS_client_test_size);
+    for (size_t i = 0; i < sequences_.size(); ++i) {
+      session::RandomKeyEventsGenerator::GenerateSequence(&sequences_[i]);
+    }
   }
 
-  uint64 id_;
+  void Run() override {
+    RPCClient client;
+    CHECK(client.CreateSession());
+    for (size_t i = 0; i < sequences_.size(); ++i) {
+      CHECK(client.SendKeys(sequences_[i], FLAGS_client_pipeline_depth,
+                            &histogram_));
+      num_requests_ += sequences_[i].size();
+    }
+    CHECK(client.DeleteSession());
+  }
+
+  const LatencyHistogram &histogram() const { return histogram_; }
+  uint64 num_requests() const { return num_requests_; }
+
+ private:
+  std::vector<std::vector<commands::KeyEvent>> sequences_;
+  LatencyHistogram histogram_;
+  uint64 num_requests_;
 };
 
 // Wrapper class for WSAStartup on Windows.
@@ -367,22 +1101,37 @@ int main(int argc, char *argv[]) {
   }
 
   if (FLAGS_client) {
-    mozc::RPCClient client;
-    CHECK(client.CreateSession());
-    for (int n = 0; n < FLAGS_client_test_size; ++n) {
-      std::vector<mozc::commands::KeyEvent> keys;
-      mozc::session::RandomKeyEventsGenerator::GenerateSequence(&keys);
-      for (size_t i = 0; i < keys.size(); ++i) {
-        LOG(INFO) << "Sending to Server: " << keys[i].Utf8DebugString();
-        mozc::commands::Output output;
-        CHECK(client.SendKey(keys[i], &output));
-        LOG(INFO) << "Output of SendKey: " << output.Utf8DebugString();
-      }
+    // Load generator: each thread has its own connection and session.
+    std::vector<std::unique_ptr<mozc::RPCClientThread>> threads;
+    for (int i = 0; i < std::max(1, FLAGS_client_threads); ++i) {
+      threads.emplace_back(new mozc::RPCClientThread);
+      threads.back()->SetJoinable(true);
     }
-    CHECK(client.DeleteSession());
+    mozc::Stopwatch stopwatch = mozc::Stopwatch::StartNew();
+    for (size_t i = 0; i < threads.size(); ++i) {
+      threads[i]->Start("RPCClientThread");
+    }
+    mozc::LatencyHistogram histogram;
+    uint64 num_requests = 0;
+    for (size_t i = 0; i < threads.size(); ++i) {
+      threads[i]->Join();
+      histogram.Merge(threads[i]->histogram());
+      num_requests += threads[i]->num_requests();
+    }
+    stopwatch.Stop();
+    const int64 elapsed_msec = std::max<int64>(
+        1, stopwatch.GetElapsedMilliseconds());
+    std::cout << "requests=" << num_requests
+              << " elapsed=" << elapsed_msec << "ms"
+              << " qps=" << num_requests * 1000 / elapsed_msec
+              << " latency: " << histogram.DebugString() << std::endl;
     return 0;
   } else if (FLAGS_server) {
+#ifdef OS_LINUX
+    mozc::EpollRPCServer server;
+#else
     mozc::RPCServer server;
+#endif  // OS_LINUX
     server.Loop();
   } else {
     LOG(ERROR) << "use --server or --client option";
@@ -32,6 +32,7 @@
 #include <map>
 
 #include "base/freelist.h"
+#include "base/mutex.h"
 #include "base/port.h"
 #include "protocol/config.pb.h"
 #include "session/internal/keymap.h"
@@ -41,12 +42,19 @@ namespace keymap {
 
 using config::Config;
 
+namespace {
+// Guards the static members below, which are shared by the sessions
+// evaluated in parallel.
+Mutex g_keymaps_mutex;  // NOLINT
+}  // namespace
+
 // static member variable
 ObjectPool<KeyMapManager> KeyMapFactory::pool_(6);
 KeyMapFactory::KeyMapManagerMap KeyMapFactory::keymaps_;
 
 KeyMapManager *KeyMapFactory::GetKeyMapManager(
     const Config::SessionKeymap keymap) {
+  scoped_lock l(&g_keymaps_mutex);
   KeyMapManagerMap::iterator iter = keymaps_.find(keymap);
 
   if (iter != keymaps_.end()) {
@@ -61,6 +69,7 @@ KeyMapManager *KeyMapFactory::GetKeyMapManager(
 }
 
 void KeyMapFactory::ReloadConfig(const Config& config) {
+  scoped_lock l(&g_keymaps_mutex);
   KeyMapManagerMap::iterator iter = keymaps_.find(Config::CUSTOM);
   if (iter == keymaps_.end()) {
     return;
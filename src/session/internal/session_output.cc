@@ -72,17 +72,44 @@ bool FillAnnotation(const Segment::Candidate &candidate_value,
   return is_modified;
 }
 
+// Returns the number of the candidate words in |candidate_list| from |begin|
+// to |end| (exclusive) including the ones in the sub-candidate lists.
+size_t CountCandidateWords(const CandidateList &candidate_list,
+                           size_t begin, size_t end) {
+  size_t count = 0;
+  for (size_t i = begin; i < end; ++i) {
+    const Candidate &candidate = candidate_list.candidate(i);
+    if (candidate.IsSubcandidateList()) {
+      const CandidateList &subcandidate_list = candidate.subcandidate_list();
+      count += CountCandidateWords(subcandidate_list,
+                                   0, subcandidate_list.size());
+    } else {
+      ++count;
+    }
+  }
+  return count;
+}
+
+// Fills the candidate words of |candidate_list| from |begin| to |end| (both
+// inclusive).  |index| is the index of the first candidate word in the whole
+// flattened list and is advanced by the number of the filled words.
 void FillAllCandidateWordsInternal(
     const Segment &segment,
     const CandidateList &candidate_list,
     const int focused_id,
+    const size_t begin,
+    const size_t end,
+    int *index,
     commands::CandidateList *candidate_list_proto) {
-  for (size_t i = 0; i < candidate_list.size(); ++i) {
+  for (size_t i = begin; i <= end && i < candidate_list.size(); ++i) {
     const Candidate &candidate = candidate_list.candidate(i);
     if (candidate.IsSubcandidateList()) {
-      FillAllCandidateWordsInternal(
-          segment, candidate.subcandidate_list(), focused_id,
-          candidate_list_proto);
+      const CandidateList &subcandidate_list = candidate.subcandidate_list();
+      if (subcandidate_list.size() > 0) {
+        FillAllCandidateWordsInternal(
+            segment, subcandidate_list, focused_id,
+            0, subcandidate_list.size() - 1, index, candidate_list_proto);
+      }
       continue;
     }
 
@@ -93,12 +120,11 @@ void FillAllCandidateWordsInternal(
     candidate_word_proto->set_id(id);
 
     // index
-    const int index = candidate_list_proto->candidates_size() - 1;
-    candidate_word_proto->set_index(index);
+    candidate_word_proto->set_index((*index)++);
 
     // check focused id
     if (id == focused_id && candidate_list.focused()) {
-      candidate_list_proto->set_focused_index(index);
+      candidate_list_proto->set_focused_index(candidate_word_proto->index());
     }
 
     const Segment::Candidate &segment_candidate = segment.candidate(id);
@@ -189,9 +215,44 @@ void SessionOutput::FillAllCandidateWords(
     const commands::Category category,
     commands::CandidateList *candidate_list_proto) {
   candidate_list_proto->set_category(category);
+  if (candidate_list.size() == 0) {
+    return;
+  }
+  int index = 0;
   FillAllCandidateWordsInternal(
       segment, candidate_list, candidate_list.focused_id(),
-      candidate_list_proto);
+      0, candidate_list.size() - 1, &index, candidate_list_proto);
+}
+
+// static
+void SessionOutput::FillPagedCandidateWords(
+    const Segment &segment,
+    const CandidateList &candidate_list,
+    const commands::Category category,
+    const size_t look_ahead_pages,
+    commands::CandidateList *candidate_list_proto) {
+  candidate_list_proto->set_category(category);
+  if (candidate_list.size() == 0) {
+    return;
+  }
+
+  size_t c_begin = 0;
+  size_t c_end = 0;
+  candidate_list.GetPageRange(candidate_list.focused_index(),
+                              &c_begin, &c_end);
+  c_end = std::min(c_end + look_ahead_pages * candidate_list.page_size(),
+                   candidate_list.size() - 1);
+
+  // The candidate words before the page are counted, but not filled, so that
+  // the indices, including the focused index, are the ones in the whole list.
+  int index = CountCandidateWords(candidate_list, 0, c_begin);
+  FillAllCandidateWordsInternal(
+      segment, candidate_list, candidate_list.focused_id(),
+      c_begin, c_end, &index, candidate_list_proto);
+
+  const size_t size = index + CountCandidateWords(
+      candidate_list, c_end + 1, candidate_list.size());
+  candidate_list_proto->set_size(size);
 }
 
 
@@ -73,6 +73,17 @@ class SessionOutput {
       const commands::Category category,
       commands::CandidateList *candidate_list_proto);
 
+  // Same as FillAllCandidateWords() but fills only the candidate words on
+  // the page of the focused candidate and the following |look_ahead_pages|
+  // pages.  The indices of the candidate words are the ones in the whole
+  // flattened list and the size of the list is stored in the |size| field.
+  static void FillPagedCandidateWords(
+      const Segment &segment,
+      const CandidateList &candidate_list,
+      const commands::Category category,
+      size_t look_ahead_pages,
+      commands::CandidateList *candidate_list_proto);
+
   // Check if the usages should be rendered on the current CandidateList status.
   static bool ShouldShowUsages(const Segment &segment,
                                const CandidateList &cand_list);
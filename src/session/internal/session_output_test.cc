@@ -322,6 +322,85 @@ TEST(SessionOutputTest, FillAllCandidateWords) {
   EXPECT_TRUE(candidates_proto.candidates(6).has_annotation());
 }
 
+TEST(SessionOutputTest, FillPagedCandidateWords) {
+  //  Idx| Candidate list (IDs)
+  //    0| 0
+  //    1| 1
+  //    2| [20, 21, 22]
+  //    3| 2
+  //  ...
+  //   20| 19
+  CandidateList main_list(true);
+  CandidateList sub(true);
+  main_list.set_page_size(5);
+
+  Segment segment;
+  segment.set_key("key");
+  for (size_t i = 0; i < 23; ++i) {
+    Segment::Candidate *candidate = segment.push_back_candidate();
+    candidate->content_key = "key";
+    candidate->value = "value" + std::to_string(i);
+  }
+  main_list.AddCandidate(0, "value0");
+  main_list.AddCandidate(1, "value1");
+  main_list.AddSubCandidateList(&sub);
+  for (size_t i = 2; i < 20; ++i) {
+    main_list.AddCandidate(i, "value" + std::to_string(i));
+  }
+  for (size_t i = 20; i < 23; ++i) {
+    sub.AddCandidate(i, "value" + std::to_string(i));
+  }
+  main_list.set_focused(true);
+
+  {
+    // The first page contains the sub-candidate list.
+    commands::CandidateList candidates_proto;
+    SessionOutput::FillPagedCandidateWords(segment, main_list,
+                                           commands::CONVERSION, 0,
+                                           &candidates_proto);
+    EXPECT_EQ(commands::CONVERSION, candidates_proto.category());
+    EXPECT_EQ(0, candidates_proto.focused_index());
+    EXPECT_EQ(23, candidates_proto.size());
+    const int kExpectedIds[] = {0, 1, 20, 21, 22, 2, 3};
+    ASSERT_EQ(arraysize(kExpectedIds), candidates_proto.candidates_size());
+    for (size_t i = 0; i < arraysize(kExpectedIds); ++i) {
+      EXPECT_EQ(kExpectedIds[i], candidates_proto.candidates(i).id());
+      EXPECT_EQ(i, candidates_proto.candidates(i).index());
+    }
+  }
+  {
+    // The second page and the look-ahead page.  The indices and the focused
+    // index are the ones in the whole list.
+    ASSERT_TRUE(main_list.MoveToId(6));
+    commands::CandidateList candidates_proto;
+    SessionOutput::FillPagedCandidateWords(segment, main_list,
+                                           commands::CONVERSION, 1,
+                                           &candidates_proto);
+    EXPECT_EQ(9, candidates_proto.focused_index());
+    EXPECT_EQ(23, candidates_proto.size());
+    ASSERT_EQ(10, candidates_proto.candidates_size());
+    for (size_t i = 0; i < 10; ++i) {
+      EXPECT_EQ(i + 4, candidates_proto.candidates(i).id());
+      EXPECT_EQ(i + 7, candidates_proto.candidates(i).index());
+      EXPECT_EQ("value" + std::to_string(i + 4),
+                candidates_proto.candidates(i).value());
+    }
+  }
+  {
+    // The look-ahead is truncated at the end of the list.
+    ASSERT_TRUE(main_list.MoveToId(19));
+    commands::CandidateList candidates_proto;
+    SessionOutput::FillPagedCandidateWords(segment, main_list,
+                                           commands::CONVERSION, 1,
+                                           &candidates_proto);
+    EXPECT_EQ(22, candidates_proto.focused_index());
+    EXPECT_EQ(23, candidates_proto.size());
+    ASSERT_EQ(1, candidates_proto.candidates_size());
+    EXPECT_EQ(19, candidates_proto.candidates(0).id());
+    EXPECT_EQ(22, candidates_proto.candidates(0).index());
+  }
+}
+
 TEST(SessionOutputTest, ShouldShowUsages) {
   {
     Segment segment;
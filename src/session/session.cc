@@ -238,23 +238,39 @@ void Session::InitContext(ImeContext *context) const {
 
 
 void Session::PushUndoContext() {
-  // TODO(komatsu): Support multiple undo.
-  prev_context_.reset(new ImeContext);
-  InitContext(prev_context_.get());
-  ImeContext::CopyContext(*context_, prev_context_.get());
+  const int max_size = context_->GetRequest().undo_history_size();
+  if (max_size <= 0) {
+    undo_contexts_.clear();
+    return;
+  }
+
+  std::unique_ptr<ImeContext> undo_context(new ImeContext);
+  InitContext(undo_context.get());
+
+  // The output is overwritten when the commit finishes, so it is moved to the
+  // snapshot rather than copied.  The converter shares its candidates with
+  // the snapshot; see SessionConverter::Clone().
+  commands::Output output;
+  output.Swap(context_->mutable_output());
+  ImeContext::CopyContext(*context_, undo_context.get());
+  undo_context->mutable_output()->Swap(&output);
+
+  undo_contexts_.push_back(std::move(undo_context));
+  while (undo_contexts_.size() > static_cast<size_t>(max_size)) {
+    undo_contexts_.pop_front();
+  }
 }
 
 void Session::PopUndoContext() {
-  // TODO(komatsu): Support multiple undo.
-  if (!prev_context_.get()) {
+  if (undo_contexts_.empty()) {
     return;
   }
-  context_.swap(prev_context_);
-  prev_context_.reset();
+  context_ = std::move(undo_contexts_.back());
+  undo_contexts_.pop_back();
 }
 
 void Session::ClearUndoContext() {
-  prev_context_.reset();
+  undo_contexts_.clear();
 }
 
 void Session::EnsureIMEIsOn() {
@@ -463,7 +479,7 @@ bool Session::TestSendKey(commands::Command *command) {
     // If undo context is empty, echoes back the key event so that it can be
     // handled by the application. b/5553298
     if (key_command == keymap::PrecompositionState::UNDO &&
-        !prev_context_.get()) {
+        undo_contexts_.empty()) {
       return EchoBack(command);
     }
 
@@ -1198,7 +1214,7 @@ bool Session::RequestUndo(commands::Command *command) {
   // If undo context is empty, echoes back the key event so that it can be
   // handled by the application. b/5553298
   if (context_->state() == ImeContext::PRECOMPOSITION &&
-      !prev_context_.get()) {
+      undo_contexts_.empty()) {
     return EchoBack(command);
   }
 
@@ -1221,7 +1237,7 @@ bool Session::Undo(commands::Command *command) {
   command->mutable_output()->set_consumed(true);
 
   // Check the undo context
-  if (!prev_context_.get()) {
+  if (undo_contexts_.empty()) {
     return DoNothing(command);
   }
 
@@ -2210,7 +2226,7 @@ bool Session::UndoOrRewind(commands::Command *command) {
   }
 
   // Undo if we can order UNDO command.
-  if (prev_context_.get()) {
+  if (!undo_contexts_.empty()) {
     return Undo(command);
   }
 
@@ -171,6 +171,22 @@
         'session_server',
       ],
     },
+    {
+      'target_name': 'session_undo_benchmark_main',
+      'type': 'executable',
+      'sources': [
+        'session_undo_benchmark_main.cc',
+      ],
+      'dependencies': [
+        '../base/base.gyp:base',
+        '../composer/composer.gyp:composer',
+        '../composer/composer.gyp:key_parser',
+        '../config/config.gyp:config_handler',
+        '../engine/engine.gyp:mock_data_engine_factory',
+        '../protocol/protocol.gyp:commands_proto',
+        'session',
+      ],
+    },
     {
       'target_name': 'gen_session_stress_test_data',
       'type': 'none',
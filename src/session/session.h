@@ -32,6 +32,7 @@
 #ifndef MOZC_SESSION_SESSION_H_
 #define MOZC_SESSION_SESSION_H_
 
+#include <deque>
 #include <memory>
 #include <string>
 
@@ -278,7 +279,9 @@ class Session : public SessionInterface {
   mozc::EngineInterface *engine_;
 
   std::unique_ptr<ImeContext> context_;
-  std::unique_ptr<ImeContext> prev_context_;
+  // Snapshots of |context_| taken before the last commits, the newest last.
+  // The size is bounded by Request::undo_history_size().
+  std::deque<std::unique_ptr<ImeContext>> undo_contexts_;
 
   void InitContext(ImeContext *context) const;
 
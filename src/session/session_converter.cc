@@ -39,6 +39,7 @@
 #include "base/logging.h"
 #include "base/port.h"
 #include "base/text_normalizer.h"
+#include "base/trace.h"
 #include "base/util.h"
 #include "composer/composer.h"
 #include "config/config_handler.h"
@@ -149,6 +150,7 @@ bool SessionConverter::Convert(const composer::Composer &composer) {
 bool SessionConverter::ConvertWithPreferences(
     const composer::Composer &composer,
     const ConversionPreferences &preferences) {
+  MOZC_TRACE_SCOPE("SessionConverter::Convert");
   DCHECK(CheckState(COMPOSITION | SUGGESTION | CONVERSION));
 
   segments_->set_request_type(Segments::CONVERSION);
@@ -410,6 +412,7 @@ bool SessionConverter::Suggest(const composer::Composer &composer) {
 bool SessionConverter::SuggestWithPreferences(
     const composer::Composer &composer,
     const ConversionPreferences &preferences) {
+  MOZC_TRACE_SCOPE("SessionConverter::Suggest");
   DCHECK(CheckState(COMPOSITION | SUGGESTION));
   candidate_list_visible_ = false;
 
@@ -487,6 +490,7 @@ bool SessionConverter::IsEmptySegment(const Segment &segment) const {
 bool SessionConverter::PredictWithPreferences(
     const composer::Composer &composer,
     const ConversionPreferences &preferences) {
+  MOZC_TRACE_SCOPE("SessionConverter::Predict");
   // TODO(komatsu): DCHECK should be
   // DCHECK(CheckState(COMPOSITION | SUGGESTION | PREDICTION));
   DCHECK(CheckState(COMPOSITION | SUGGESTION | CONVERSION | PREDICTION));
@@ -1179,9 +1183,10 @@ SessionConverter* SessionConverter::Clone() const {
   // moment it's ok because the current design guarantees that the converter is
   // singleton. However, we should refactor such bad design; see also the
   // comment right above.
-  session_converter->segments_->CopyFrom(*segments_);
+  // The candidates are shared so that a clone taken for undo is cheap.
+  session_converter->segments_->ShareFrom(*segments_);
   session_converter->segment_index_ = segment_index_;
-  session_converter->previous_suggestions_.CopyFrom(previous_suggestions_);
+  session_converter->previous_suggestions_.ShareFrom(previous_suggestions_);
   session_converter->conversion_preferences_ = conversion_preferences();
   session_converter->result_->CopyFrom(*result_);
   session_converter->request_ = request_;
@@ -1574,6 +1579,13 @@ void SessionConverter::FillAllCandidateWords(
   }
 
   const Segment &segment = segments_->conversion_segment(segment_index_);
+  if (request_->has_all_candidate_words_look_ahead_pages()) {
+    SessionOutput::FillPagedCandidateWords(
+        segment, *candidate_list_, category,
+        std::max(0, request_->all_candidate_words_look_ahead_pages()),
+        candidates);
+    return;
+  }
   SessionOutput::FillAllCandidateWords(
       segment, *candidate_list_, category, candidates);
 }
@@ -2444,6 +2444,61 @@ TEST_F(SessionConverterTest, OutputAllCandidateWords) {
   }
 }
 
+TEST_F(SessionConverterTest, OutputPagedCandidateWords) {
+  request_->set_candidate_page_size(2);
+  request_->set_all_candidate_words_look_ahead_pages(0);
+  SessionConverter converter(
+      convertermock_.get(), request_.get(), config_.get());
+  Segments segments;
+  SetKamaboko(&segments);
+  const string kKamabokono = "かまぼこの";
+  const string kInbou = "いんぼう";
+  composer_->InsertCharacterPreedit(kKamabokono + kInbou);
+
+  FillT13Ns(&segments, composer_.get());
+  convertermock_->SetStartConversionForRequest(&segments, true);
+
+  commands::Output output;
+
+  EXPECT_TRUE(converter.Convert(*composer_));
+  {
+    output.Clear();
+    converter.PopOutput(*composer_, &output);
+    const commands::CandidateList &words = output.all_candidate_words();
+    EXPECT_EQ(0, words.focused_index());
+    EXPECT_EQ(5, words.size());
+    // [ "かまぼこの", "カマボコの" ]
+    ASSERT_EQ(2, words.candidates_size());
+    EXPECT_EQ(0, words.candidates(0).index());
+    EXPECT_EQ(1, words.candidates(1).index());
+  }
+
+  converter.CandidateNextPage();
+  {
+    output.Clear();
+    converter.PopOutput(*composer_, &output);
+    const commands::CandidateList &words = output.all_candidate_words();
+    EXPECT_EQ(0, words.focused_index());
+    EXPECT_EQ(5, words.size());
+    // [ "カマボコノ" (t13n), "かまぼこの" (t13n), "ｶﾏﾎﾞｺﾉ" (t13n) ]
+    ASSERT_EQ(3, words.candidates_size());
+    EXPECT_EQ(2, words.candidates(0).index());
+    EXPECT_EQ(3, words.candidates(1).index());
+    EXPECT_EQ(4, words.candidates(2).index());
+  }
+
+  request_->set_all_candidate_words_look_ahead_pages(1);
+  converter.CandidatePrevPage();
+  {
+    output.Clear();
+    converter.PopOutput(*composer_, &output);
+    const commands::CandidateList &words = output.all_candidate_words();
+    EXPECT_EQ(0, words.focused_index());
+    EXPECT_EQ(5, words.size());
+    EXPECT_EQ(5, words.candidates_size());
+  }
+}
+
 TEST_F(SessionConverterTest, GetPreeditAndGetConversion) {
   Segments segments;
 
@@ -40,12 +40,14 @@
 #include "base/clock.h"
 #include "base/flags.h"
 #include "base/logging.h"
+#include "base/mutex.h"
 #include "base/port.h"
 #ifndef MOZC_DISABLE_SESSION_WATCHDOG
 #include "base/process.h"
 #endif  // MOZC_DISABLE_SESSION_WATCHDOG
 #include "base/singleton.h"
 #include "base/stopwatch.h"
+#include "base/trace.h"
 #include "base/util.h"
 #include "composer/table.h"
 #include "config/character_form_manager.h"
@@ -164,7 +166,6 @@ void SessionHandler::Init(
   engine_ = std::move(engine);
   engine_builder_ = std::move(engine_builder);
   observer_handler_.reset(new session::SessionObserverHandler());
-  stopwatch_.reset(new Stopwatch);
   user_dictionary_session_handler_.reset(
       new user_dictionary::UserDictionarySessionHandler);
   table_manager_.reset(new composer::TableManager);
@@ -467,104 +468,108 @@ bool SessionHandler::EvalCommand(commands::Command *command) {
     return false;
   }
 
+  MOZC_TRACE_SCOPE("SessionHandler::EvalCommand");
+  Stopwatch stopwatch = Stopwatch::StartNew();
+
+  const commands::Input::CommandType type = command->input().type();
   bool eval_succeeded = false;
-  stopwatch_->Reset();
-  stopwatch_->Start();
+  if (type == commands::Input::SEND_KEY ||
+      type == commands::Input::TEST_SEND_KEY ||
+      type == commands::Input::SEND_COMMAND) {
+    {
+      scoped_reader_lock l(&mutex_);
+      eval_succeeded = EvalCommandInternal(command);
+    }
+    // The config updated by the session affects all the sessions.  Most of
+    // the commands don't update it, so take the writer lock only when the
+    // output has the config.
+    if (eval_succeeded && type != commands::Input::TEST_SEND_KEY &&
+        command->output().has_config()) {
+      scoped_writer_lock l(&mutex_);
+      MaybeUpdateStoredConfig(command);
+    }
+  } else {
+    scoped_writer_lock l(&mutex_);
+    eval_succeeded = EvalCommandInternal(command);
+  }
+
+  if (eval_succeeded) {
+    UsageStats::IncrementCount("SessionAllEvent");
+    if (command->input().type() != commands::Input::CREATE_SESSION) {
+      // Fill a session ID even if command->input() doesn't have a id to ensure
+      // that response size should not be 0, which causes disconnection of IPC.
+      command->mutable_output()->set_id(command->input().id());
+    }
+  } else {
+    command->mutable_output()->set_id(0);
+    command->mutable_output()->set_error_code(
+        commands::Output::SESSION_FAILURE);
+  }
+
+  if (eval_succeeded) {
+    // TODO(komatsu): Make sre if checking eval_succeeded is necessary or not.
+    scoped_lock l(&observer_mutex_);
+    observer_handler_->EvalCommandHandler(*command);
+  }
 
+  stopwatch.Stop();
+  UsageStats::UpdateTiming("ElapsedTimeUSec",
+                           stopwatch.GetElapsedMicroseconds());
+
+  return is_available_;
+}
+
+bool SessionHandler::EvalCommandInternal(commands::Command *command) {
   switch (command->input().type()) {
     case commands::Input::CREATE_SESSION:
-      eval_succeeded = CreateSession(command);
-      break;
+      return CreateSession(command);
     case commands::Input::DELETE_SESSION:
-      eval_succeeded = DeleteSession(command);
-      break;
+      return DeleteSession(command);
     case commands::Input::SEND_KEY:
-      eval_succeeded = SendKey(command);
-      break;
+      return SendKey(command);
     case commands::Input::TEST_SEND_KEY:
-      eval_succeeded = TestSendKey(command);
-      break;
+      return TestSendKey(command);
     case commands::Input::SEND_COMMAND:
-      eval_succeeded = SendCommand(command);
-      break;
+      return SendCommand(command);
     case commands::Input::SYNC_DATA:
-      eval_succeeded = SyncData(command);
-      break;
+      return SyncData(command);
     case commands::Input::CLEAR_USER_HISTORY:
-      eval_succeeded = ClearUserHistory(command);
-      break;
+      return ClearUserHistory(command);
     case commands::Input::CLEAR_USER_PREDICTION:
-      eval_succeeded = ClearUserPrediction(command);
-      break;
+      return ClearUserPrediction(command);
     case commands::Input::CLEAR_UNUSED_USER_PREDICTION:
-      eval_succeeded = ClearUnusedUserPrediction(command);
-      break;
+      return ClearUnusedUserPrediction(command);
     case commands::Input::GET_CONFIG:
-      eval_succeeded = GetStoredConfig(command);
-      break;
+      return GetStoredConfig(command);
     case commands::Input::SET_CONFIG:
-      eval_succeeded = SetStoredConfig(command);
-      break;
+      return SetStoredConfig(command);
     case commands::Input::SET_IMPOSED_CONFIG:
-      eval_succeeded = SetImposedConfig(command);
-      break;
+      return SetImposedConfig(command);
     case commands::Input::SET_REQUEST:
-      eval_succeeded = SetRequest(command);
-      break;
+      return SetRequest(command);
     case commands::Input::SHUTDOWN:
-      eval_succeeded = Shutdown(command);
-      break;
+      return Shutdown(command);
     case commands::Input::RELOAD:
-      eval_succeeded = Reload(command);
-      break;
+      return Reload(command);
     case commands::Input::CLEANUP:
-      eval_succeeded = Cleanup(command);
-      break;
+      return Cleanup(command);
     case commands::Input::INSERT_TO_STORAGE:
-      eval_succeeded = InsertToStorage(command);
-      break;
+      return InsertToStorage(command);
     case commands::Input::READ_ALL_FROM_STORAGE:
-      eval_succeeded = ReadAllFromStorage(command);
-      break;
+      return ReadAllFromStorage(command);
     case commands::Input::CLEAR_STORAGE:
-      eval_succeeded = ClearStorage(command);
-      break;
+      return ClearStorage(command);
     case commands::Input::SEND_USER_DICTIONARY_COMMAND:
-      eval_succeeded = SendUserDictionaryCommand(command);
-      break;
+      return SendUserDictionaryCommand(command);
     case commands::Input::SEND_ENGINE_RELOAD_REQUEST:
-      eval_succeeded = SendEngineReloadRequest(command);
-      break;
+      return SendEngineReloadRequest(command);
     case commands::Input::NO_OPERATION:
-      eval_succeeded = NoOperation(command);
-      break;
+      return NoOperation(command);
+    case commands::Input::GET_TRACE_EVENTS:
+      return GetTraceEvents(command);
     default:
-      eval_succeeded = false;
-  }
-
-  if (eval_succeeded) {
-    UsageStats::IncrementCount("SessionAllEvent");
-    if (command->input().type() != commands::Input::CREATE_SESSION) {
-      // Fill a session ID even if command->input() doesn't have a id to ensure
-      // that response size should not be 0, which causes disconnection of IPC.
-      command->mutable_output()->set_id(command->input().id());
-    }
-  } else {
-    command->mutable_output()->set_id(0);
-    command->mutable_output()->set_error_code(
-        commands::Output::SESSION_FAILURE);
-  }
-
-  if (eval_succeeded) {
-    // TODO(komatsu): Make sre if checking eval_succeeded is necessary or not.
-    observer_handler_->EvalCommandHandler(*command);
+      return false;
   }
-
-  stopwatch_->Stop();
-  UsageStats::UpdateTiming("ElapsedTimeUSec",
-                           stopwatch_->GetElapsedMicroseconds());
-
-  return is_available_;
 }
 
 session::SessionInterface *SessionHandler::NewSession() {
@@ -586,39 +591,51 @@ void SessionHandler::MaybeUpdateStoredConfig(commands::Command *command) {
   Reload(command);
 }
 
+session::SessionInterface *SessionHandler::LookupSession(SessionID id) {
+  scoped_lock l(&session_map_mutex_);
+  session::SessionInterface **session = session_map_->MutableLookup(id);
+  return session == NULL ? NULL : *session;
+}
+
+Mutex *SessionHandler::GetSessionMutex(SessionID id) {
+  return &session_mutexes_[id % kNumSessionMutexes];
+}
+
+// The session commands below are evaluated with |mutex_| held as a reader.
+// The stored config is updated by EvalCommand() afterwards.
 bool SessionHandler::SendKey(commands::Command *command) {
   const SessionID id = command->input().id();
-  session::SessionInterface **session = session_map_->MutableLookup(id);
-  if (session == NULL || *session == NULL) {
+  session::SessionInterface *session = LookupSession(id);
+  if (session == NULL) {
     LOG(WARNING) << "SessionID " << id << " is not available";
     return false;
   }
-  (*session)->SendKey(command);
-  MaybeUpdateStoredConfig(command);
+  scoped_lock l(GetSessionMutex(id));
+  session->SendKey(command);
   return true;
 }
 
 bool SessionHandler::TestSendKey(commands::Command *command) {
   const SessionID id = command->input().id();
-  session::SessionInterface **session = session_map_->MutableLookup(id);
-  if (session == NULL || *session == NULL) {
+  session::SessionInterface *session = LookupSession(id);
+  if (session == NULL) {
     LOG(WARNING) << "SessionID " << id << " is not available";
     return false;
   }
-  (*session)->TestSendKey(command);
+  scoped_lock l(GetSessionMutex(id));
+  session->TestSendKey(command);
   return true;
 }
 
 bool SessionHandler::SendCommand(commands::Command *command) {
   const SessionID id = command->input().id();
-  session::SessionInterface **session =
-    const_cast<session::SessionInterface **>(session_map_->Lookup(id));
-  if (session == NULL || *session == NULL) {
+  session::SessionInterface *session = LookupSession(id);
+  if (session == NULL) {
     LOG(WARNING) << "SessionID " << id << " is not available";
     return false;
   }
-  (*session)->SendCommand(command);
-  MaybeUpdateStoredConfig(command);
+  scoped_lock l(GetSessionMutex(id));
+  session->SendCommand(command);
   return true;
 }
 
@@ -831,6 +848,12 @@ bool SessionHandler::NoOperation(commands::Command *command) {
   return true;
 }
 
+bool SessionHandler::GetTraceEvents(commands::Command *command) {
+  Tracer::GetChromeTraceEvents(
+      command->mutable_output()->mutable_trace_events());
+  return true;
+}
+
 // Create Random Session ID in order to make the session id unpredicable
 SessionID SessionHandler::CreateNewSessionID() {
   SessionID id = 0;
@@ -32,10 +32,12 @@
 #ifndef MOZC_SESSION_SESSION_HANDLER_H_
 #define MOZC_SESSION_SESSION_HANDLER_H_
 
+#include <atomic>
 #include <map>
 #include <memory>
 #include <string>
 
+#include "base/mutex.h"
 #include "base/port.h"
 #include "composer/table.h"
 #include "engine/engine_builder_interface.h"
@@ -61,7 +63,6 @@ class SessionWatchDog;
 // TODO(kkojima): Remove this guard after
 // enabling session watch dog for android.
 #endif  // MOZC_DISABLE_SESSION_WATCHDOG
-class Stopwatch;
 
 namespace commands {
 class Command;
@@ -78,6 +79,11 @@ namespace user_dictionary {
 class UserDictionarySessionHandler;
 }  // namespace user_dictionary
 
+// EvalCommand() is thread-safe.  The commands to a session, i.e. SEND_KEY,
+// TEST_SEND_KEY and SEND_COMMAND, are evaluated in parallel with the commands
+// to the other sessions.  The other commands, which change the state of the
+// handler or the engine, are evaluated exclusively.  The commands to the same
+// session are evaluated one by one; the caller is responsible for their order.
 class SessionHandler : public SessionHandlerInterface {
  public:
   explicit SessionHandler(std::unique_ptr<EngineInterface> engine);
@@ -143,10 +149,33 @@ class SessionHandler : public SessionHandlerInterface {
   bool SendUserDictionaryCommand(commands::Command *command);
   bool SendEngineReloadRequest(commands::Command *command);
   bool NoOperation(commands::Command *command);
+  bool GetTraceEvents(commands::Command *command);
+
+  // Evaluates |command| with |mutex_| held.
+  bool EvalCommandInternal(commands::Command *command);
+
+  // Returns the session of |id| marking it as the most recently used one, or
+  // nullptr if not found.
+  session::SessionInterface *LookupSession(SessionID id);
+  // Returns the mutex to serialize the commands to the session of |id|.
+  Mutex *GetSessionMutex(SessionID id);
 
   SessionID CreateNewSessionID();
   bool DeleteSessionID(SessionID id);
 
+  // Held as a reader while a command to a session is evaluated, and as a
+  // writer otherwise.
+  ReaderWriterMutex mutex_;
+  // Guards |session_map_| among the readers of |mutex_|, as looking up a
+  // session updates the LRU order.
+  Mutex session_map_mutex_;
+  // Striped by the session id so that the sessions do not need their own
+  // mutexes.
+  static const size_t kNumSessionMutexes = 64;
+  Mutex session_mutexes_[kNumSessionMutexes];
+  // Guards the observers, which are notified of every command.
+  Mutex observer_mutex_;
+
   std::unique_ptr<SessionMap> session_map_;
 #ifndef MOZC_DISABLE_SESSION_WATCHDOG
   std::unique_ptr<SessionWatchDog> session_watch_dog_;
@@ -155,7 +184,7 @@ class SessionHandler : public SessionHandlerInterface {
   // TODO(kkojima): Remove this guard after
   // enabling session watch dog for android.
 #endif  // MOZC_DISABLE_SESSION_WATCHDOG
-  bool is_available_ = false;
+  std::atomic<bool> is_available_{false};
   uint32 max_session_size_ = 0;
   uint64 last_session_empty_time_ = 0;
   uint64 last_cleanup_time_ = 0;
@@ -164,7 +193,6 @@ class SessionHandler : public SessionHandlerInterface {
   std::unique_ptr<EngineInterface> engine_;
   std::unique_ptr<EngineBuilderInterface> engine_builder_;
   std::unique_ptr<session::SessionObserverHandler> observer_handler_;
-  std::unique_ptr<Stopwatch> stopwatch_;
   std::unique_ptr<user_dictionary::UserDictionarySessionHandler>
       user_dictionary_session_handler_;
   std::unique_ptr<composer::TableManager> table_manager_;
@@ -36,8 +36,11 @@
 
 #include "base/file_util.h"
 #include "base/port.h"
+#include "base/thread.h"
+#include "config/config_handler.h"
 #include "engine/engine_factory.h"
 #include "protocol/commands.pb.h"
+#include "protocol/config.pb.h"
 #include "session/random_keyevents_generator.h"
 #include "session/session_handler_test_util.h"
 #include "testing/base/public/gunit.h"
@@ -64,6 +67,71 @@ namespace {
 using session::testing::SessionHandlerTestBase;
 using session::testing::TestSessionClient;
 
+// Sends |keys| to the session of |id| and returns the outputs.  The session
+// id is removed from the outputs to compare them between handlers.
+std::vector<string> SendKeys(SessionHandler *handler, uint64 id,
+                             const std::vector<commands::KeyEvent> &keys) {
+  std::vector<string> outputs;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    commands::Command command;
+    command.mutable_input()->set_type(commands::Input::SEND_KEY);
+    command.mutable_input()->set_id(id);
+    *command.mutable_input()->mutable_key() = keys[i];
+    EXPECT_TRUE(handler->EvalCommand(&command));
+    command.mutable_output()->clear_id();
+    outputs.push_back(command.output().Utf8DebugString());
+  }
+  return outputs;
+}
+
+class SendKeysThread : public Thread {
+ public:
+  SendKeysThread(SessionHandler *handler, uint64 id,
+                 const std::vector<commands::KeyEvent> *keys)
+      : handler_(handler), id_(id), keys_(keys) {}
+
+  void Run() override {
+    outputs_ = SendKeys(handler_, id_, *keys_);
+  }
+
+  const std::vector<string> &outputs() const { return outputs_; }
+
+ private:
+  SessionHandler *handler_;
+  const uint64 id_;
+  const std::vector<commands::KeyEvent> *keys_;
+  std::vector<string> outputs_;
+};
+
+// Appends the key events typing |romaji| to |keys|.
+void AppendKeysForRomaji(const string &romaji,
+                         std::vector<commands::KeyEvent> *keys) {
+  for (size_t i = 0; i < romaji.size(); ++i) {
+    commands::KeyEvent key;
+    key.set_key_code(romaji[i]);
+    keys->push_back(key);
+  }
+}
+
+void AppendSpecialKey(commands::KeyEvent::SpecialKey special_key,
+                      std::vector<commands::KeyEvent> *keys) {
+  commands::KeyEvent key;
+  key.set_special_key(special_key);
+  keys->push_back(key);
+}
+
+bool IsInAllCandidateWords(const string &value,
+                           const commands::Output &output) {
+  for (int i = 0; i < output.all_candidate_words().candidates_size(); ++i) {
+    if (output.all_candidate_words().candidates(i).value() == value) {
+      return true;
+    }
+  }
+  return false;
+}
+
+class SessionHandlerParallelStressTest : public SessionHandlerTestBase {};
+
 TEST(SessionHandlerStressTest, BasicStressTest) {
   std::vector<commands::KeyEvent> keys;
   commands::Output output;
@@ -88,5 +156,152 @@ TEST(SessionHandlerStressTest, BasicStressTest) {
   EXPECT_TRUE(client.DeleteSession());
 }
 
+TEST_F(SessionHandlerParallelStressTest, MatchesSerialExecution) {
+  const size_t kNumSessions = 8;
+  const size_t kMaxEventSize = 300;
+
+  // Disables learning so that the sessions do not affect each other.  The
+  // character forms are fixed as they are learned even in incognito mode.
+  config::Config config;
+  config::ConfigHandler::GetDefaultConfig(&config);
+  config.set_incognito_mode(true);
+  config.set_history_learning_level(config::Config::NO_HISTORY);
+  for (int i = 0; i < config.character_form_rules_size(); ++i) {
+    config.mutable_character_form_rules(i)->set_conversion_character_form(
+        config::Config::FULL_WIDTH);
+  }
+  config::ConfigHandler::SetConfig(config);
+
+  const uint32 random_seed = static_cast<uint32>(FLAGS_random_seed);
+  LOG(INFO) << "Random seed: " << random_seed;
+  session::RandomKeyEventsGenerator::InitSeed(random_seed);
+  std::vector<std::vector<commands::KeyEvent>> keys(kNumSessions);
+  for (size_t i = 0; i < kNumSessions; ++i) {
+    while (keys[i].size() < kMaxEventSize) {
+      std::vector<commands::KeyEvent> sequence;
+      session::RandomKeyEventsGenerator::GenerateSequence(&sequence);
+      keys[i].insert(keys[i].end(), sequence.begin(), sequence.end());
+    }
+  }
+
+  std::vector<std::vector<string>> expected_outputs(kNumSessions);
+  {
+    SessionHandler handler(std::unique_ptr<Engine>(EngineFactory::Create()));
+    for (size_t i = 0; i < kNumSessions; ++i) {
+      uint64 id = 0;
+      ASSERT_TRUE(session::testing::CreateSession(&handler, &id));
+      expected_outputs[i] = SendKeys(&handler, id, keys[i]);
+      EXPECT_TRUE(session::testing::DeleteSession(&handler, id));
+    }
+  }
+
+  SessionHandler handler(std::unique_ptr<Engine>(EngineFactory::Create()));
+  std::vector<uint64> ids(kNumSessions);
+  std::vector<std::unique_ptr<SendKeysThread>> threads;
+  for (size_t i = 0; i < kNumSessions; ++i) {
+    ASSERT_TRUE(session::testing::CreateSession(&handler, &ids[i]));
+    threads.emplace_back(new SendKeysThread(&handler, ids[i], &keys[i]));
+    threads.back()->SetJoinable(true);
+  }
+  for (size_t i = 0; i < kNumSessions; ++i) {
+    threads[i]->Start("SendKeysThread");
+  }
+  for (size_t i = 0; i < kNumSessions; ++i) {
+    threads[i]->Join();
+  }
+  for (size_t i = 0; i < kNumSessions; ++i) {
+    const std::vector<string> &outputs = threads[i]->outputs();
+    ASSERT_EQ(expected_outputs[i].size(), outputs.size());
+    for (size_t j = 0; j < outputs.size(); ++j) {
+      ASSERT_EQ(expected_outputs[i][j], outputs[j])
+          << "session: " << i << " key: " << keys[i][j].DebugString();
+    }
+    EXPECT_TRUE(session::testing::DeleteSession(&handler, ids[i]));
+  }
+}
+
+TEST_F(SessionHandlerParallelStressTest, LearnsInParallel) {
+  // Words committed as Katakana by each session, and the prefix to look them
+  // up by prediction.
+  const struct {
+    const char *romaji;
+    const char *prefix;
+    const char *katakana;
+  } kWords[] = {
+    {"aiueokakikukeko", "aiueo", "アイウエオカキクケコ"},
+    {"kakikukekosasisuseso", "kakikukeko", "カキクケコサシスセソ"},
+    {"sasisusesotatituteto", "sasisuseso", "サシスセソタチツテト"},
+    {"tatitutetonaninuneno", "tatituteto", "タチツテトナニヌネノ"},
+    {"naninunenohahihuheho", "naninuneno", "ナニヌネノハヒフヘホ"},
+    {"hahihuhehomamimumemo", "hahihuheho", "ハヒフヘホマミムメモ"},
+    {"mamimumemoyayuyo", "mamimumemo", "マミムメモヤユヨ"},
+    {"yayuyorarirurero", "yayuyora", "ヤユヨラリルレロ"},
+  };
+  const size_t kNumSessions = arraysize(kWords);
+  const size_t kMaxEventSize = 300;
+
+  // Learning is enabled, so the sessions update the learners concurrently.
+  config::Config config;
+  config::ConfigHandler::GetDefaultConfig(&config);
+  config.set_session_keymap(config::Config::MSIME);
+  config::ConfigHandler::SetConfig(config);
+
+  const uint32 random_seed = static_cast<uint32>(FLAGS_random_seed);
+  LOG(INFO) << "Random seed: " << random_seed;
+  session::RandomKeyEventsGenerator::InitSeed(random_seed);
+  std::vector<std::vector<commands::KeyEvent>> keys(kNumSessions);
+  for (size_t i = 0; i < kNumSessions; ++i) {
+    // Each session commits its own word first, and then random sequences.
+    AppendSpecialKey(commands::KeyEvent::ON, &keys[i]);
+    AppendKeysForRomaji(kWords[i].romaji, &keys[i]);
+    AppendSpecialKey(commands::KeyEvent::F7, &keys[i]);
+    AppendSpecialKey(commands::KeyEvent::ENTER, &keys[i]);
+    while (keys[i].size() < kMaxEventSize) {
+      std::vector<commands::KeyEvent> sequence;
+      session::RandomKeyEventsGenerator::GenerateSequence(&sequence);
+      keys[i].insert(keys[i].end(), sequence.begin(), sequence.end());
+    }
+  }
+
+  SessionHandler handler(std::unique_ptr<Engine>(EngineFactory::Create()));
+  std::vector<uint64> ids(kNumSessions);
+  std::vector<std::unique_ptr<SendKeysThread>> threads;
+  for (size_t i = 0; i < kNumSessions; ++i) {
+    ASSERT_TRUE(session::testing::CreateSession(&handler, &ids[i]));
+    threads.emplace_back(new SendKeysThread(&handler, ids[i], &keys[i]));
+    threads.back()->SetJoinable(true);
+  }
+  for (size_t i = 0; i < kNumSessions; ++i) {
+    threads[i]->Start("SendKeysThread");
+  }
+  for (size_t i = 0; i < kNumSessions; ++i) {
+    threads[i]->Join();
+    EXPECT_TRUE(session::testing::DeleteSession(&handler, ids[i]));
+  }
+
+  // The words committed by all the sessions are learned.
+  for (size_t i = 0; i < kNumSessions; ++i) {
+    uint64 id = 0;
+    ASSERT_TRUE(session::testing::CreateSession(&handler, &id));
+    std::vector<commands::KeyEvent> lookup_keys;
+    AppendSpecialKey(commands::KeyEvent::ON, &lookup_keys);
+    AppendKeysForRomaji(kWords[i].prefix, &lookup_keys);
+    AppendSpecialKey(commands::KeyEvent::TAB, &lookup_keys);
+    commands::Output output;
+    for (size_t j = 0; j < lookup_keys.size(); ++j) {
+      commands::Command command;
+      command.mutable_input()->set_type(commands::Input::SEND_KEY);
+      command.mutable_input()->set_id(id);
+      *command.mutable_input()->mutable_key() = lookup_keys[j];
+      ASSERT_TRUE(handler.EvalCommand(&command));
+      output.Swap(command.mutable_output());
+    }
+    EXPECT_TRUE(IsInAllCandidateWords(kWords[i].katakana, output))
+        << kWords[i].katakana << " is not learned.\n"
+        << output.Utf8DebugString();
+    EXPECT_TRUE(session::testing::DeleteSession(&handler, id));
+  }
+}
+
 }  // namespace
 }  // namespace mozc
@@ -577,6 +577,29 @@ TEST_F(SessionHandlerTest, EmojiUsageStatsTest) {
 
 // Tests the interaction with EngineBuilderInterface for successful Engine
 // reload event.
+TEST_F(SessionHandlerTest, GetTraceEvents) {
+  SessionHandler handler(CreateMockDataEngine());
+  uint64 id = 0;
+  ASSERT_TRUE(CreateSession(&handler, &id));
+  {
+    commands::Command command;
+    command.mutable_input()->set_id(id);
+    command.mutable_input()->set_type(commands::Input::SEND_KEY);
+    command.mutable_input()->mutable_key()->set_key_code('a');
+    ASSERT_TRUE(handler.EvalCommand(&command));
+  }
+
+  commands::Command command;
+  command.mutable_input()->set_type(commands::Input::GET_TRACE_EVENTS);
+  ASSERT_TRUE(handler.EvalCommand(&command));
+  const string &trace_events = command.output().trace_events();
+  EXPECT_EQ(0, trace_events.find("{\"traceEvents\":["));
+#ifndef MOZC_NO_TRACE
+  EXPECT_NE(string::npos, trace_events.find("SessionHandler::EvalCommand"));
+  EXPECT_NE(string::npos, trace_events.find("SessionConverter::Suggest"));
+#endif  // MOZC_NO_TRACE
+}
+
 TEST_F(SessionHandlerTest, EngineReload_SuccessfulScenario) {
   MockEngineBuilder *engine_builder = new MockEngineBuilder();
   SessionHandler handler(
@@ -2614,6 +2614,79 @@ TEST_F(SessionTest, UndoForMultipleSegments) {
   }
 }
 
+TEST_F(SessionTest, MultipleUndo) {
+  std::unique_ptr<Session> session(new Session(engine_.get()));
+  InitSessionToPrecomposition(session.get());
+
+  // Undo requires capability DELETE_PRECEDING_TEXT.
+  commands::Capability capability;
+  capability.set_text_deletion(commands::Capability::DELETE_PRECEDING_TEXT);
+  session->set_client_capability(capability);
+
+  commands::Request request;
+  request.set_undo_history_size(2);
+  session->SetRequest(&request);
+
+  commands::Command command;
+  Segments segments;
+  InsertCharacterChars("key1key2", session.get(), &command);
+  {
+    Segment *segment = segments.add_segment();
+    segment->set_key("key1");
+    segment->add_candidate()->value = "cand1-1";
+    segment->add_candidate()->value = "cand1-2";
+    segment = segments.add_segment();
+    segment->set_key("key2");
+    segment->add_candidate()->value = "cand2-1";
+    segment->add_candidate()->value = "cand2-2";
+  }
+
+  GetConverterMock()->SetStartConversionForRequest(&segments, true);
+  command.Clear();
+  session->Convert(&command);
+  EXPECT_PREEDIT("cand1-1cand2-1", command);
+
+  GetConverterMock()->SetCommitSegmentValue(&segments, true);
+  command.Clear();
+  session->CommitSegment(&command);
+  EXPECT_RESULT("cand1-1", command);
+
+  command.Clear();
+  session->ConvertNext(&command);
+  EXPECT_PREEDIT("cand1-2cand2-1", command);
+  command.Clear();
+  session->CommitSegment(&command);
+  EXPECT_RESULT("cand1-2", command);
+
+  // The commits are undone in the reverse order.
+  command.Clear();
+  session->Undo(&command);
+  EXPECT_TRUE(command.output().has_deletion_range());
+  EXPECT_EQ(-7, command.output().deletion_range().offset());
+  EXPECT_PREEDIT("cand1-2cand2-1", command);
+
+  command.Clear();
+  session->Undo(&command);
+  EXPECT_TRUE(command.output().has_deletion_range());
+  EXPECT_EQ(-7, command.output().deletion_range().offset());
+  EXPECT_PREEDIT("cand1-1cand2-1", command);
+
+  command.Clear();
+  session->Undo(&command);
+  EXPECT_FALSE(command.output().has_deletion_range());
+  EXPECT_PREEDIT("cand1-1cand2-1", command);
+
+  // Undo is disabled by the request.
+  request.set_undo_history_size(0);
+  session->SetRequest(&request);
+  command.Clear();
+  session->CommitSegment(&command);
+  EXPECT_RESULT("cand1-1", command);
+  command.Clear();
+  session->Undo(&command);
+  EXPECT_FALSE(command.output().has_deletion_range());
+}
+
 TEST_F(SessionTest, UndoOrRewind_undo) {
   std::unique_ptr<Session> session(new Session(engine_.get()));
   InitSessionToPrecomposition(session.get());
@@ -248,6 +248,8 @@
         'session_handler_stress_test.cc'
       ],
       'dependencies': [
+        '../base/base.gyp:base',
+        '../config/config.gyp:config_handler',
         '../engine/engine.gyp:engine_factory',
         '../testing/testing.gyp:gtest_main',
         'session.gyp:random_keyevents_generator',
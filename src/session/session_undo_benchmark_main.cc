@@ -0,0 +1,166 @@
+// Copyright 2010-2018, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Benchmark for the undo snapshot taken by Session on commit.
+//
+// Types each sentence in romaji, converts it and measures the latency of
+// committing the conversion for every value of --undo_history_sizes, where
+// 0 disables undo and the others capture an undo snapshot on every commit.
+// The sizes are run alternately for each sentence so that the learning by
+// the previous commits affects all of them equally.
+//
+// Usage:
+//   session_undo_benchmark_main --iterations=100 --undo_history_sizes=0,1,8
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/file_util.h"
+#include "base/flags.h"
+#include "base/init_mozc.h"
+#include "base/logging.h"
+#include "base/number_util.h"
+#include "base/port.h"
+#include "base/stopwatch.h"
+#include "base/system_util.h"
+#include "base/util.h"
+#include "composer/key_parser.h"
+#include "composer/table.h"
+#include "config/config_handler.h"
+#include "engine/engine_interface.h"
+#include "engine/mock_data_engine_factory.h"
+#include "protocol/commands.pb.h"
+#include "session/session.h"
+
+DEFINE_string(profile_dir, "session_undo_benchmark_profile",
+              "user profile directory to use");
+DEFINE_int32(iterations, 100, "number of passes over the sentences");
+DEFINE_string(undo_history_sizes, "0,1,8",
+              "comma separated values of Request::undo_history_size");
+
+namespace mozc {
+namespace session {
+namespace {
+
+const char *kSentences[] = {
+  "watashinonamaehanakanodesu",
+  "kyouhaiitenkidesune",
+  "ashitahaamegafurusoudesu",
+  "kaigihagogosanjikaradesu",
+  "konoshiryouwoyondekudasai",
+};
+
+void SendKey(const string &key, Session *session) {
+  commands::Command command;
+  CHECK(KeyParser::ParseKey(key, command.mutable_input()->mutable_key()));
+  command.mutable_input()->set_type(commands::Input::SEND_KEY);
+  CHECK(session->SendKey(&command));
+}
+
+// Types |sentence|, converts it and returns the time spent on the commit.
+int64 ConvertAndCommit(const string &sentence, Session *session) {
+  for (size_t i = 0; i < sentence.size(); ++i) {
+    SendKey(string(1, sentence[i]), session);
+  }
+  SendKey("Space", session);
+
+  Stopwatch stopwatch = Stopwatch::StartNew();
+  SendKey("Enter", session);
+  stopwatch.Stop();
+  return stopwatch.GetElapsedNanoseconds();
+}
+
+void Report(int undo_history_size, std::vector<int64> *latencies) {
+  std::sort(latencies->begin(), latencies->end());
+  int64 total = 0;
+  for (size_t i = 0; i < latencies->size(); ++i) {
+    total += (*latencies)[i];
+  }
+  const size_t size = latencies->size();
+  std::cout << "undo_history_size=" << undo_history_size
+            << ": mean " << total / size / 1000.0 << " us"
+            << ", p50 " << (*latencies)[size / 2] / 1000.0 << " us"
+            << ", p90 " << (*latencies)[size * 9 / 10] / 1000.0 << " us"
+            << std::endl;
+}
+
+void Run() {
+  std::vector<int> undo_history_sizes;
+  std::vector<string> values;
+  Util::SplitStringUsing(FLAGS_undo_history_sizes, ",", &values);
+  for (size_t i = 0; i < values.size(); ++i) {
+    int size = 0;
+    CHECK(NumberUtil::SafeStrToInt32(values[i], &size)) << values[i];
+    undo_history_sizes.push_back(size);
+  }
+  CHECK(!undo_history_sizes.empty());
+
+  std::unique_ptr<EngineInterface> engine(MockDataEngineFactory::Create());
+  composer::Table table;
+  CHECK(table.InitializeWithRequestAndConfig(
+      commands::Request::default_instance(),
+      config::ConfigHandler::DefaultConfig(), *engine->GetDataManager()));
+  std::vector<std::unique_ptr<commands::Request>> requests;
+  std::vector<std::unique_ptr<Session>> sessions;
+  for (size_t i = 0; i < undo_history_sizes.size(); ++i) {
+    requests.emplace_back(new commands::Request);
+    requests.back()->set_undo_history_size(undo_history_sizes[i]);
+    sessions.emplace_back(new Session(engine.get()));
+    sessions.back()->SetRequest(requests.back().get());
+    sessions.back()->SetTable(&table);
+  }
+
+  std::vector<std::vector<int64>> latencies(undo_history_sizes.size());
+  for (int i = 0; i < FLAGS_iterations; ++i) {
+    for (size_t j = 0; j < arraysize(kSentences); ++j) {
+      for (size_t k = 0; k < sessions.size(); ++k) {
+        latencies[k].push_back(
+            ConvertAndCommit(kSentences[j], sessions[k].get()));
+      }
+    }
+  }
+  for (size_t i = 0; i < undo_history_sizes.size(); ++i) {
+    Report(undo_history_sizes[i], &latencies[i]);
+  }
+}
+
+}  // namespace
+}  // namespace session
+}  // namespace mozc
+
+int main(int argc, char **argv) {
+  mozc::InitMozc(argv[0], &argc, &argv, false);
+  mozc::FileUtil::CreateDirectory(FLAGS_profile_dir);
+  mozc::SystemUtil::SetUserProfileDirectory(FLAGS_profile_dir);
+  mozc::session::Run();
+  return 0;
+}
@@ -29,6 +29,7 @@
 
 #include "storage/existence_filter.h"
 
+#include <algorithm>
 #include <cstring>
 #include <cmath>
 
@@ -46,6 +47,57 @@ inline uint64 RotateLeft64(uint64 original, int num_bits) {
   return (original << (64 - num_bits)) | (original >> num_bits);
 }
 
+// Header::k of the blocked format has this flag, so that the readers which
+// only know the classic format reject the blocked format.
+const int kBlockedFormatFlag = 0x100;
+
+const size_t kHeaderBytes = 12;
+// The header of the blocked format is padded to a block, so that the blocks
+// are aligned at cache lines if the data is.
+const size_t kBlockedHeaderBytes = 64;
+
+const uint32 kBitsPerBlock = 512;  // 64-byte block, the size of a cache line.
+const size_t kWordsPerBlock = kBitsPerBlock / 64;
+
+inline uint32 GetBlockIndex(uint64 hash, uint32 num_blocks) {
+  // Maps the upper 32 bits to [0, num_blocks) without division.
+  return static_cast<uint32>(((hash >> 32) * num_blocks) >> 32);
+}
+
+// Returns the bits from which the positions of the 'k' bits in a block are
+// taken, 9 bits for each.  63 bits are enough as k < 8.
+inline uint64 GetBitPositions(uint64 hash) {
+  return hash * GG_ULONGLONG(0x9e3779b97f4a7c15);
+}
+
+// Returns the false positive rate of the blocked format.  The number of the
+// values in a block follows the Poisson distribution.
+double GetBlockedErrorRate(uint32 num_blocks, uint32 n, int k) {
+  const double lambda = static_cast<double>(n) / num_blocks;
+  const size_t max_values =
+      static_cast<size_t>(lambda + 10 * sqrt(lambda) + 20);
+  double probability = exp(-lambda);  // of j values in a block
+  double error_rate = 0;
+  for (size_t j = 0; j <= max_values; ++j) {
+    const double unset = pow(1.0 - 1.0 / kBitsPerBlock,
+                             static_cast<double>(k) * j);
+    error_rate += probability * pow(1.0 - unset, k);
+    probability *= lambda / (j + 1);
+  }
+  return error_rate;
+}
+
+int GetOptimalBlockedNumHashes(uint32 num_blocks, uint32 n) {
+  int optimal_k = 1;
+  for (int k = 2; k < 8; ++k) {
+    if (GetBlockedErrorRate(num_blocks, n, k) <
+        GetBlockedErrorRate(num_blocks, n, optimal_k)) {
+      optimal_k = k;
+    }
+  }
+  return optimal_k;
+}
+
 inline uint32 BitsToWords(uint32 bits) {
   uint32 words = (bits + 31) >> 5;
   if (bits > 0 && words == 0) {
@@ -149,7 +201,8 @@ void ExistenceFilter::BlockBitmap::Clear() {
 }
 
 ExistenceFilter::ExistenceFilter(uint32 m, uint32 n, int k)
-    : vec_size_(m ? m : 1),
+    : blocks_(NULL),
+      vec_size_(m ? m : 1),
       expected_nelts_(n),
       num_hashes_(k) {
   CHECK_LT(num_hashes_, 8);
@@ -160,7 +213,8 @@ ExistenceFilter::ExistenceFilter(uint32 m, uint32 n, int k)
 // this is private constructor
 ExistenceFilter::ExistenceFilter(uint32 m, uint32 n, int k,
                                  bool is_mutable)
-    : vec_size_(m ? m : 1),
+    : blocks_(NULL),
+      vec_size_(m ? m : 1),
       expected_nelts_(n),
       num_hashes_(k) {
   CHECK_LT(num_hashes_, 8);
@@ -168,6 +222,31 @@ ExistenceFilter::ExistenceFilter(uint32 m, uint32 n, int k,
   rep_->Clear();
 }
 
+// this is private constructor
+ExistenceFilter::ExistenceFilter(uint32 m, uint32 n, int k,
+                                 const char *blocks)
+    : vec_size_(m),
+      expected_nelts_(n),
+      num_hashes_(k) {
+  CHECK_LT(num_hashes_, 8);
+  CHECK_GT(vec_size_, 0);
+  CHECK_EQ(vec_size_ % kBitsPerBlock, 0);
+  const size_t words = vec_size_ / 64;
+  if (blocks != NULL && reinterpret_cast<uintptr_t>(blocks) % 8 == 0) {
+    // The filter is immutable like the one of the classic format.
+    blocks_ = reinterpret_cast<uint64 *>(const_cast<char *>(blocks));
+    return;
+  }
+  allocated_blocks_.reset(new uint64[words]);
+  blocks_ = allocated_blocks_.get();
+  if (blocks == NULL) {
+    memset(blocks_, 0, words * sizeof(uint64));
+  } else {
+    VLOG(1) << "Copying the bitmap as it is not aligned";
+    memcpy(blocks_, blocks, words * sizeof(uint64));
+  }
+}
+
 // static
 ExistenceFilter *
 ExistenceFilter::CreateImmutableExietenceFilter(uint32 m,
@@ -200,10 +279,33 @@ ExistenceFilter* ExistenceFilter::CreateOptimal(size_t size_in_bytes,
   return filter;
 }
 
+ExistenceFilter* ExistenceFilter::CreateOptimalBlocked(
+    size_t size_in_bytes, uint32 estimated_insertions) {
+  CHECK_LT(size_in_bytes, (1 << 29))
+                             << "Requested size is too big";
+  CHECK_GT(estimated_insertions, 0);
+  const uint32 num_blocks =
+      std::max<uint32>((size_in_bytes * 8 + kBitsPerBlock - 1) / kBitsPerBlock,
+                       1);
+  const int optimal_k =
+      GetOptimalBlockedNumHashes(num_blocks, estimated_insertions);
+
+  VLOG(1) << "optimal_k: " << optimal_k;
+
+  return new ExistenceFilter(num_blocks * kBitsPerBlock, estimated_insertions,
+                             optimal_k, static_cast<const char *>(NULL));
+}
+
 ExistenceFilter::~ExistenceFilter() {
 }
 
 void ExistenceFilter::Clear() {
+  if (blocks_ != NULL) {
+    if (allocated_blocks_.get() != NULL) {
+      memset(blocks_, 0, Size());
+    }
+    return;
+  }
   rep_->Clear();
 }
 
@@ -237,6 +339,20 @@ bool ExistenceFilter::BlockBitmap::GetMutableFragment(uint32 *iter,
 }
 
 bool ExistenceFilter::Exists(uint64 hash) const {
+  if (blocks_ != NULL) {
+    // All the bits are tested without branches as they are in one cache line.
+    const uint64 *block =
+        blocks_ + GetBlockIndex(hash, vec_size_ / kBitsPerBlock) *
+                  kWordsPerBlock;
+    uint64 bits = GetBitPositions(hash);
+    uint64 missing = 0;
+    for (int i = 0; i < num_hashes_; ++i) {
+      const uint32 pos = static_cast<uint32>(bits) & (kBitsPerBlock - 1);
+      missing |= ~block[pos >> 6] & (static_cast<uint64>(1) << (pos & 63));
+      bits >>= 9;
+    }
+    return missing == 0;
+  }
   for (size_t i = 0; i < num_hashes_; ++i) {
     hash = RotateLeft64(hash, 8);
     uint32 index = hash % vec_size_;
@@ -248,6 +364,17 @@ bool ExistenceFilter::Exists(uint64 hash) const {
 }
 
 void ExistenceFilter::Insert(uint64 hash) {
+  if (blocks_ != NULL) {
+    uint64 *block = blocks_ + GetBlockIndex(hash, vec_size_ / kBitsPerBlock) *
+                              kWordsPerBlock;
+    uint64 bits = GetBitPositions(hash);
+    for (int i = 0; i < num_hashes_; ++i) {
+      const uint32 pos = static_cast<uint32>(bits) & (kBitsPerBlock - 1);
+      block[pos >> 6] |= static_cast<uint64>(1) << (pos & 63);
+      bits >>= 9;
+    }
+    return;
+  }
   for (size_t i = 0; i < num_hashes_; ++i) {
     hash = RotateLeft64(hash, 8);
     uint32 index = hash % vec_size_;
@@ -273,10 +400,53 @@ size_t ExistenceFilter::MinFilterSizeInBytesForErrorRate(float error_rate,
   return static_cast<size_t>(ceil(min_bits / 8));
 }
 
+size_t ExistenceFilter::MinBlockedFilterSizeInBytesForErrorRate(
+    float error_rate, size_t num_elements) {
+  // The error rate decreases as the number of blocks increases, so the
+  // minimum number of blocks is searched from the size of the classic format.
+  const uint32 n = static_cast<uint32>(num_elements);
+  const size_t block_bytes = kBitsPerBlock / 8;
+  uint32 low = 0;
+  uint32 high = std::max<uint32>(
+      MinFilterSizeInBytesForErrorRate(error_rate, num_elements) / block_bytes,
+      1);
+  while (GetBlockedErrorRate(high, n, GetOptimalBlockedNumHashes(high, n)) >
+         error_rate) {
+    low = high;
+    high *= 2;
+  }
+  // The error rate is too high with |low| blocks and low enough with |high|.
+  while (low + 1 < high) {
+    const uint32 mid = low + (high - low) / 2;
+    if (GetBlockedErrorRate(mid, n, GetOptimalBlockedNumHashes(mid, n)) >
+        error_rate) {
+      low = mid;
+    } else {
+      high = mid;
+    }
+  }
+  return high * block_bytes;
+}
+
 // allocate 'buf' and write filter to the buf.
 // 'size' will hold the size of buf
 void ExistenceFilter::Write(char **buf, size_t *size) {
-  const int require_bytes = sizeof(Header) + Size();
+  if (blocks_ != NULL) {
+    *size = kBlockedHeaderBytes + Size();
+    *buf = new char[*size];
+    const int32 k = num_hashes_ | kBlockedFormatFlag;
+    memset(*buf, 0, kBlockedHeaderBytes);
+    memcpy(*buf, &vec_size_, sizeof(vec_size_));
+    memcpy(*buf + 4, &expected_nelts_, sizeof(expected_nelts_));
+    memcpy(*buf + 8, &k, sizeof(k));
+    memcpy(*buf + kBlockedHeaderBytes, blocks_, Size());
+    LOG(INFO) << "Write blocked header : vec_size " << vec_size_
+              << " expected_nelts " << expected_nelts_
+              << " num_hashes " << num_hashes_;
+    return;
+  }
+
+  const int require_bytes = kHeaderBytes + Size();
 
   *buf = new char[require_bytes];
   CHECK(*buf);
@@ -316,6 +486,13 @@ bool ExistenceFilter::ReadHeader(const char *buf, Header* header) {
   buf += sizeof(header->n);
   memcpy(&(header->k), buf, sizeof(header->k));
   buf += sizeof(header->k);
+  header->blocked = (header->k & kBlockedFormatFlag) != 0;
+  header->k &= ~kBlockedFormatFlag;
+  if (header->blocked &&
+      (header->m == 0 || header->m % kBitsPerBlock != 0)) {
+    LOG(ERROR) << "Bad size of the blocked format (header->m)";
+    return false;
+  }
   if (header->k >= 8 || header->k <= 0) {
     LOG(ERROR) << "Bad number of hashes (header->k)";
     return false;
@@ -325,8 +502,7 @@ bool ExistenceFilter::ReadHeader(const char *buf, Header* header) {
 
 ExistenceFilter* ExistenceFilter::Read(const char *buf, size_t size) {
   Header header;
-  const uint32 header_bytes =
-      sizeof(header.m) + sizeof(header.n) + sizeof(header.k);
+  uint32 header_bytes = kHeaderBytes;
   if (size < header_bytes) {
     LOG(ERROR) << "Not enough bufsize: could not read header";
     return NULL;
@@ -336,6 +512,15 @@ ExistenceFilter* ExistenceFilter::Read(const char *buf, size_t size) {
     LOG(ERROR) << "Invalid format: could not read header";
     return NULL;
   }
+  if (header.blocked) {
+    header_bytes = kBlockedHeaderBytes;
+    if (size < header_bytes + header.m / 8) {
+      LOG(ERROR) << "Not enough bufsize: could not read filter";
+      return NULL;
+    }
+    return new ExistenceFilter(header.m, header.n, header.k,
+                               buf + header_bytes);
+  }
   buf += header_bytes;
 
   const uint32 filter_size = BitsToWords(header.m);
@@ -38,12 +38,19 @@ namespace mozc {
 namespace storage {
 
 // Bloom filter
+//
+// The filter has two formats.  The classic format sets 'k' bits spread over
+// the whole bitmap for a hash.  The blocked format sets all the 'k' bits for
+// a hash in one 64-byte block, so that Exists() touches one cache line
+// instead of 'k'.  The blocked format needs a few more bits than the classic
+// format for the same error rate.
 class ExistenceFilter {
  public:
   struct Header {
     uint32 m;
     uint32 n;
     int k;
+    bool blocked;  // true for the blocked format
   };
 
   // 'm' is the number of bits in the bit vector
@@ -56,6 +63,11 @@ class ExistenceFilter {
   static ExistenceFilter* CreateOptimal(size_t size_in_bytes,
                                         uint32 estimated_insertions);
 
+  // Same as CreateOptimal() but creates a filter of the blocked format.
+  // |size_in_bytes| is rounded up to the multiple of the block size.
+  static ExistenceFilter* CreateOptimalBlocked(size_t size_in_bytes,
+                                               uint32 estimated_insertions);
+
   void Clear();
 
   // Inserts a hash value into the filter
@@ -74,6 +86,10 @@ class ExistenceFilter {
   static size_t MinFilterSizeInBytesForErrorRate(float error_rate,
                                                  size_t num_elements);
 
+  // Same as MinFilterSizeInBytesForErrorRate() for the blocked format.
+  static size_t MinBlockedFilterSizeInBytesForErrorRate(float error_rate,
+                                                        size_t num_elements);
+
   void Write(char **buf, size_t *size);
 
   static bool ReadHeader(const char *buf, Header* header);
@@ -81,6 +97,10 @@ class ExistenceFilter {
   // Read Existence filter from buf[]
   // Note that the returned ExsitenceFilter is immutable filter.
   // Any mutable operations will destroy buf[].
+  // The bitmap of the blocked format is used in place without copying if
+  // it is aligned at 8 bytes in buf[].  Store the filter at 64-byte
+  // boundary, e.g., with 512-bit alignment in a data set, so that each
+  // block is in one cache line.
   static ExistenceFilter* Read(const char *buf, size_t size);
 
  private:
@@ -89,11 +109,18 @@ class ExistenceFilter {
   // private constructor for ExistenceFilter::Read();
   ExistenceFilter(uint32 m, uint32 n, int k, bool is_mutable);
 
+  // private constructor for the blocked format.  The bitmap of |m| bits is
+  // |blocks| if it is aligned, a copy of |blocks| otherwise, or a new
+  // cleared one if |blocks| is NULL.
+  ExistenceFilter(uint32 m, uint32 n, int k, const char *blocks);
+
   static ExistenceFilter *CreateImmutableExietenceFilter(uint32 m,
                                                          uint32 n,
                                                          int k);
 
-  std::unique_ptr<BlockBitmap> rep_;  // points to bitmap
+  std::unique_ptr<BlockBitmap> rep_;  // points to bitmap (classic format)
+  uint64 *blocks_;  // points to bitmap (blocked format)
+  std::unique_ptr<uint64[]> allocated_blocks_;  // owns |blocks_| if not NULL
   const uint32 vec_size_;  // size of bitmap (in bits)
   const uint32 expected_nelts_;  // expected number of inserts
   const int32 num_hashes_;  // number of hashes per lookup
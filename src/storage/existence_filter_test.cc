@@ -43,7 +43,7 @@ namespace mozc {
 namespace storage {
 namespace {
 
-void CheckValues(ExistenceFilter* filter, int m, int n) {
+int CheckValues(ExistenceFilter* filter, int m, int n) {
   int false_positives = 0;
   for (int i = 0; i < 2 * n; ++i) {
     uint64 hash = Hash::Fingerprint(i);
@@ -59,6 +59,7 @@ void CheckValues(ExistenceFilter* filter, int m, int n) {
   }
 
   LOG(INFO) << "false_positives: " << false_positives;
+  return false_positives;
 }
 
 void RunTest(int m, int n) {
@@ -85,6 +86,40 @@ void RunTest(int m, int n) {
   delete filter;
 }
 
+void RunBlockedTest(int m, int n) {
+  LOG(INFO) << "Test blocked " << m << " " << n;
+  std::unique_ptr<ExistenceFilter> filter(
+      ExistenceFilter::CreateOptimalBlocked(m, n));
+  for (int i = 0; i < n; ++i) {
+    filter->Insert(Hash::Fingerprint(i * 2));
+  }
+  const int false_positives = CheckValues(filter.get(), m, n);
+
+  char *buf = NULL;
+  size_t size = 0;
+  filter->Write(&buf, &size);
+  EXPECT_EQ(64 + filter->Size(), size);
+
+  ExistenceFilter::Header header;
+  ASSERT_TRUE(ExistenceFilter::ReadHeader(buf, &header));
+  EXPECT_TRUE(header.blocked);
+
+  // Reads the filter both in place and from a copy at an odd address.
+  std::unique_ptr<ExistenceFilter> filter2(ExistenceFilter::Read(buf, size));
+  ASSERT_TRUE(filter2.get() != NULL);
+  EXPECT_EQ(false_positives, CheckValues(filter2.get(), m, n));
+  string misaligned(1, '\0');
+  misaligned.append(buf, size);
+  std::unique_ptr<ExistenceFilter> filter3(
+      ExistenceFilter::Read(misaligned.data() + 1, size));
+  ASSERT_TRUE(filter3.get() != NULL);
+  EXPECT_EQ(false_positives, CheckValues(filter3.get(), m, n));
+
+  // A truncated filter is rejected.
+  EXPECT_TRUE(ExistenceFilter::Read(buf, size - 1) == NULL);
+  delete[] buf;
+}
+
 }  // namespace
 
 TEST(ExistenceFilterTest, RunTest) {
@@ -93,6 +128,46 @@ TEST(ExistenceFilterTest, RunTest) {
   RunTest(m, n);
 }
 
+TEST(ExistenceFilterTest, RunBlockedTest) {
+  const int n = 50000;
+  const int m =
+      ExistenceFilter::MinBlockedFilterSizeInBytesForErrorRate(0.01, n);
+  RunBlockedTest(m, n);
+  RunBlockedTest(64, 10);
+  RunBlockedTest(100, 100);
+}
+
+TEST(ExistenceFilterTest, BlockedErrorRateTest) {
+  const int n = 20000;
+  const float kErrorRates[] = {0.01, 0.001};
+  for (size_t i = 0; i < arraysize(kErrorRates); ++i) {
+    const size_t m = ExistenceFilter::MinBlockedFilterSizeInBytesForErrorRate(
+        kErrorRates[i], n);
+    // The blocked format needs more bits than the classic format, but not
+    // too many.
+    const size_t classic_m =
+        ExistenceFilter::MinFilterSizeInBytesForErrorRate(kErrorRates[i], n);
+    EXPECT_EQ(0, m % 64);
+    EXPECT_LE(classic_m, m);
+    EXPECT_GE(classic_m * 3 / 2, m);
+
+    std::unique_ptr<ExistenceFilter> filter(
+        ExistenceFilter::CreateOptimalBlocked(m, n));
+    for (int j = 0; j < n; ++j) {
+      filter->Insert(Hash::Fingerprint(j));
+    }
+    int false_positives = 0;
+    const int kNumTrials = 1000000;
+    for (int j = n; j < n + kNumTrials; ++j) {
+      if (filter->Exists(Hash::Fingerprint(j))) {
+        ++false_positives;
+      }
+    }
+    EXPECT_GT(kErrorRates[i] * 1.2,
+              static_cast<double>(false_positives) / kNumTrials);
+  }
+}
+
 TEST(ExistenceFilterTest, MinFilterSizeEstimateTest) {
   EXPECT_EQ(61,
             ExistenceFilter::MinFilterSizeInBytesForErrorRate(0.1, 100));
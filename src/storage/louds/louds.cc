@@ -29,11 +29,36 @@
 
 #include "storage/louds/louds.h"
 
+#include <string>
+
+#include "base/logging.h"
+
 namespace mozc {
 namespace storage {
 namespace louds {
+namespace {
+
+void PushInt32(int32 value, string *image) {
+  // Output LSB to MSB.
+  const uint32 v = static_cast<uint32>(value);
+  image->push_back(static_cast<char>(v & 0xFF));
+  image->push_back(static_cast<char>((v >> 8) & 0xFF));
+  image->push_back(static_cast<char>((v >> 16) & 0xFF));
+  image->push_back(static_cast<char>((v >> 24) & 0xFF));
+}
+
+inline int32 ReadInt32(const uint8 *data) {
+  // TODO(noriyukit): static assertion for the endian.
+  return *reinterpret_cast<const int32 *>(data);
+}
 
-Louds::Louds() : select0_cache_size_(0), select1_cache_size_(0) {}
+}  // namespace
+
+Louds::Louds()
+    : select0_cache_size_(0),
+      select1_cache_size_(0),
+      select0_cache_ptr_(nullptr),
+      select1_cache_ptr_(nullptr) {}
 
 Louds::~Louds() {}
 
@@ -62,30 +87,96 @@ void Louds::Init(const uint8 *image, int length,
     return;
   }
   select_cache_.reset(new int[cache_size]);
+  int *select0_cache = select_cache_.get();
+  int *select1_cache = select_cache_.get() + select0_cache_size;
+  select0_cache_ptr_ = select0_cache;
+  select1_cache_ptr_ = select1_cache;
 
   if (select0_cache_size > 0) {
     // Precompute Select0(i) + 1 for i in (0, select0_cache_size).
-    select_cache_[0] = 0;
+    select0_cache[0] = 0;
     for (size_t i = 1; i < select0_cache_size; ++i) {
-      select_cache_[i] = index_.Select0(i) + 1;
+      select0_cache[i] = index_.Select0(i) + 1;
     }
   }
 
   if (select1_cache_size > 0) {
     // Precompute Select1(i) for i in (0, select1_cache_size).
-    select1_cache_ptr_ = select_cache_.get() + select0_cache_size;
-    select1_cache_ptr_[0] = 0;
+    select1_cache[0] = 0;
     for (size_t i = 1; i < select1_cache_size; ++i) {
-      select1_cache_ptr_[i] = index_.Select1(i);
+      select1_cache[i] = index_.Select1(i);
     }
   }
 }
 
+bool Louds::InitFromIndexImage(const uint8 *image, int length,
+                               const uint8 *index_image,
+                               int index_image_size) {
+  Reset();
+  if (!index_.InitFromIndexImage(image, length, index_image,
+                                 index_image_size)) {
+    return false;
+  }
+  const int bitvec_index_image_size =
+      SimpleSuccinctBitVectorIndex::GetIndexImageSize(index_image);
+  if (bitvec_index_image_size + 8 > index_image_size ||
+      GetIndexImageSize(index_image) > index_image_size) {
+    LOG(ERROR) << "Broken LOUDS index image: " << index_image_size;
+    Reset();
+    return false;
+  }
+
+  const uint8 *ptr = index_image + bitvec_index_image_size;
+  const int select0_cache_size = ReadInt32(ptr);
+  const int select1_cache_size = ReadInt32(ptr + 4);
+  if (select0_cache_size < 0 || select0_cache_size > index_.GetNum0Bits() ||
+      select1_cache_size < 0 || select1_cache_size > index_.GetNum1Bits()) {
+    LOG(ERROR) << "Invalid select cache size: " << select0_cache_size << ", "
+               << select1_cache_size;
+    Reset();
+    return false;
+  }
+  select0_cache_size_ = select0_cache_size;
+  select1_cache_size_ = select1_cache_size;
+  select0_cache_ptr_ = reinterpret_cast<const int *>(ptr + 8);
+  select1_cache_ptr_ = select0_cache_ptr_ + select0_cache_size;
+  return true;
+}
+
+void Louds::AppendIndexImage(string *index_image) const {
+  index_.AppendIndexImage(index_image);
+  PushInt32(select0_cache_size_, index_image);
+  PushInt32(select1_cache_size_, index_image);
+  for (size_t i = 0; i < select0_cache_size_; ++i) {
+    PushInt32(select0_cache_ptr_[i], index_image);
+  }
+  for (size_t i = 0; i < select1_cache_size_; ++i) {
+    PushInt32(select1_cache_ptr_[i], index_image);
+  }
+}
+
+int Louds::GetIndexImageSize(const uint8 *index_image) {
+  const int index_size =
+      SimpleSuccinctBitVectorIndex::GetIndexImageSize(index_image);
+  if (index_size < 0) {
+    return -1;
+  }
+  const uint8 *ptr = index_image + index_size;
+  const int select0_cache_size = ReadInt32(ptr);
+  const int select1_cache_size = ReadInt32(ptr + 4);
+  if (select0_cache_size < 0 || select1_cache_size < 0) {
+    return -1;
+  }
+  return index_size + 4 * (2 + select0_cache_size + select1_cache_size);
+}
+
 void Louds::Reset() {
   index_.Reset();
   select_cache_.reset();
   select0_cache_size_ = 0;
   select1_cache_size_ = 0;
+  select0_cache_ptr_ = nullptr;
+  select1_cache_ptr_ = nullptr;
 }
 
 }  // namespace louds
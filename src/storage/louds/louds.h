@@ -31,6 +31,7 @@
 #define MOZC_STORAGE_LOUDS_LOUDS_H_
 
 #include <memory>
+#include <string>
 
 #include "base/port.h"
 #include "storage/louds/simple_succinct_bit_vector_index.h"
@@ -106,6 +107,23 @@ class Louds {
     Init(image, length, 0, 0, 0, 0);
   }
 
+  // Initializes this LOUDS from bit array and the index image created by
+  // AppendIndexImage(), which holds the rank/select index and the caches, so
+  // that the bit array doesn't need to be scanned.  The image is used in place;
+  // see SimpleSuccinctBitVectorIndex::InitFromIndexImage().  Returns false if
+  // the image doesn't match the bit array.
+  bool InitFromIndexImage(const uint8 *image, int length,
+                          const uint8 *index_image, int index_image_size);
+
+  // Appends the index and the caches built by Init() to |index_image|:
+  // [bit vector index image (see SimpleSuccinctBitVectorIndex)]
+  // [select0 cache size: 32-bit][select1 cache size: 32-bit]
+  // [select0 cache][select1 cache]
+  void AppendIndexImage(string *index_image) const;
+
+  // Returns the size of the image in bytes.
+  static int GetIndexImageSize(const uint8 *index_image);
+
   // Explicitly clears the internal bit array.
   void Reset();
 
@@ -134,7 +152,7 @@ class Louds {
   // REQUIRES: |node| is valid.
   void MoveToFirstChild(Node *node) const {
     node->edge_index_ = node->node_id_ < select0_cache_size_
-                            ? select_cache_[node->node_id_]
+                            ? select0_cache_ptr_[node->node_id_]
                             : index_.Select0(node->node_id_) + 1;
     node->node_id_ = node->edge_index_ - node->node_id_ + 1;
   }
@@ -174,7 +192,10 @@ class Louds {
   size_t select0_cache_size_;
   size_t select1_cache_size_;
   std::unique_ptr<int[]> select_cache_;
-  int* select1_cache_ptr_;  // = select_cache_.get() + select0_cache_size_
+  // Point to either |select_cache_| or the image given to
+  // InitFromIndexImage().
+  const int *select0_cache_ptr_;
+  const int *select1_cache_ptr_;
 
   DISALLOW_COPY_AND_ASSIGN(Louds);
 };
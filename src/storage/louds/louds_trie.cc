@@ -95,6 +95,43 @@ bool LoudsTrie::Open(const uint8 *image,
   return true;
 }
 
+bool LoudsTrie::OpenWithIndex(const uint8 *image,
+                              const uint8 *index_image,
+                              int index_image_size) {
+  // See Open() for the format of |image|.
+  const int louds_size = ReadInt32(image);
+  const int terminal_size = ReadInt32(image + 4);
+  const int num_character_bits = ReadInt32(image + 8);
+  const int edge_character_size = ReadInt32(image + 12);
+  CHECK_EQ(num_character_bits, 8);
+  CHECK_GT(edge_character_size, 0);
+
+  const uint8 *louds_image = image + 16;
+  const uint8 *terminal_image = louds_image + louds_size;
+  const uint8 *edge_character = terminal_image + terminal_size;
+
+  if (!louds_.InitFromIndexImage(louds_image, louds_size,
+                                 index_image, index_image_size)) {
+    return false;
+  }
+  const int louds_index_image_size = Louds::GetIndexImageSize(index_image);
+  if (!terminal_bit_vector_.InitFromIndexImage(
+          terminal_image, terminal_size,
+          index_image + louds_index_image_size,
+          index_image_size - louds_index_image_size)) {
+    louds_.Reset();
+    return false;
+  }
+  edge_character_ = reinterpret_cast<const char*>(edge_character);
+
+  return true;
+}
+
+void LoudsTrie::AppendIndexImage(string *index_image) const {
+  louds_.AppendIndexImage(index_image);
+  terminal_bit_vector_.AppendIndexImage(index_image);
+}
+
 void LoudsTrie::Close() {
   louds_.Reset();
   terminal_bit_vector_.Reset();
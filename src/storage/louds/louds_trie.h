@@ -31,6 +31,7 @@
 #define MOZC_STORAGE_LOUDS_LOUDS_TRIE_H_
 
 #include <memory>
+#include <string>
 
 #include "base/port.h"
 #include "base/string_piece.h"
@@ -69,6 +70,19 @@ class LoudsTrie {
     return Open(data, 0, 0, 0, 0, 0);
   }
 
+  // Same as Open() but takes the rank/select indices and the caches from
+  // |index_image| created by AppendIndexImage() for the same |data|, so that
+  // the bit vectors in |data| are not scanned.  The image is used in place, so
+  // it needs to be aligned to 32-bits and alive until Close is invoked.
+  // Returns false if the image doesn't match |data|.
+  bool OpenWithIndex(const uint8 *data,
+                     const uint8 *index_image, int index_image_size);
+
+  // Appends the indices and the caches built by Open() to |index_image|:
+  // [LOUDS index image (see Louds)]
+  // [terminal bit vector index image (see SimpleSuccinctBitVectorIndex)]
+  void AppendIndexImage(string *index_image) const;
+
   // Destructs the internal data structure explicitly (the destructor will do
   // clean up too).
   void Close();
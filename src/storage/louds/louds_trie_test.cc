@@ -29,6 +29,7 @@
 
 #include "storage/louds/louds_trie.h"
 
+#include <string>
 #include <vector>
 
 #include "base/port.h"
@@ -552,6 +553,53 @@ TEST_P(LoudsTrieTest, RestoreKeyString) {
 }
 INSTANTIATE_TEST_CASE(GenRestoreKeyStringTest);
 
+TEST_P(LoudsTrieTest, OpenWithIndex) {
+  LoudsTrieBuilder builder;
+  const char *kKeys[] = {
+    "aa", "ab", "abc", "abcd", "abcde", "abcdef", "abcea", "abcef", "abd",
+    "ebd",
+  };
+  for (const char *key : kKeys) {
+    builder.Add(key);
+  }
+  builder.Build();
+  const uint8 *image = reinterpret_cast<const uint8 *>(builder.image().data());
+
+  const CacheSizeParam &param = GetParam();
+  LoudsTrie expected;
+  expected.Open(image,
+                param.louds_lb0_cache_size,
+                param.louds_lb1_cache_size,
+                param.louds_select0_cache_size,
+                param.louds_select1_cache_size,
+                param.termvec_lb1_cache_size);
+  string index_image;
+  expected.AppendIndexImage(&index_image);
+
+  LoudsTrie trie;
+  ASSERT_TRUE(trie.OpenWithIndex(
+      image, reinterpret_cast<const uint8 *>(index_image.data()),
+      index_image.size()));
+  char buffer[LoudsTrie::kMaxDepth + 1];
+  for (const char *key : kKeys) {
+    const int key_id = builder.GetId(key);
+    EXPECT_EQ(key_id, trie.ExactSearch(key)) << key;
+    EXPECT_EQ(key, trie.RestoreKeyString(key_id, buffer));
+  }
+  EXPECT_EQ(-1, trie.ExactSearch("abce"));
+  EXPECT_EQ(-1, trie.ExactSearch("b"));
+
+  // A truncated image is rejected.
+  LoudsTrie broken;
+  EXPECT_FALSE(broken.OpenWithIndex(
+      image, reinterpret_cast<const uint8 *>(index_image.data()),
+      index_image.size() - 4));
+
+  trie.Close();
+  expected.Close();
+}
+INSTANTIATE_TEST_CASE(GenOpenWithIndexTest);
+
 }  // namespace
 }  // namespace louds
 }  // namespace storage
@@ -31,6 +31,7 @@
 
 #include <algorithm>
 #include <iterator>
+#include <string>
 #include <vector>
 
 #include "base/iterator_adapter.h"
@@ -48,18 +49,18 @@ class ZeroBitAdapter : public AdapterBase<int> {
   // Needs to be default constructive to create invalid iterator.
   ZeroBitAdapter() : index_(nullptr), chunk_size_(0) {}
 
-  ZeroBitAdapter(const std::vector<int>* index, int chunk_size)
+  ZeroBitAdapter(const int *index, int chunk_size)
       : index_(index), chunk_size_(chunk_size) {}
 
   value_type operator()(const int *ptr) const {
     // The number of 0-bits
     //   = (total num bits) - (1-bits)
     //   = (chunk_size [bytes] * 8 [bits/byte] * (ptr's offset) - (1-bits)
-    return chunk_size_ * 8 * (ptr - index_->data()) - *ptr;
+    return chunk_size_ * 8 * (ptr - index_) - *ptr;
   }
 
  private:
-  const std::vector<int> *index_;
+  const int *index_;
   int chunk_size_;
 };
 
@@ -127,41 +128,85 @@ void InitIndex(
   CHECK_EQ(chunk_length + 1, index->size());
 }
 
-void InitLowerBound0Cache(const std::vector<int> &index, int chunk_size,
+// Returns the number of chunks with ceiling plus a sentinel.
+inline int GetIndexSize(int length, int chunk_size) {
+  return (length + chunk_size - 1) / chunk_size + 1;
+}
+
+// Returns the width of the uniform increment for the lower bound cache.
+inline int GetLowerBoundCacheIncrement(int num_bits, size_t cache_size) {
+  const int increment = cache_size == 0 ? num_bits : num_bits / cache_size;
+  return increment == 0 ? 1 : increment;
+}
+
+void InitLowerBound0Cache(const int *index, int index_size, int chunk_size,
                           size_t increment, size_t size,
-                          std::vector<const int *> *cache) {
+                          std::vector<int32> *cache) {
   DCHECK_GT(increment, 0);
   cache->clear();
   cache->reserve(size + 2);
-  cache->push_back(index.data());
-  ZeroBitAdapter adapter(&index, chunk_size);
+  cache->push_back(0);
+  ZeroBitAdapter adapter(index, chunk_size);
   for (size_t i = 1; i <= size; ++i) {
     const int target_index = increment * i;
     const int *ptr = std::lower_bound(
-        MakeIteratorAdapter(index.data(), adapter),
-        MakeIteratorAdapter(index.data() + index.size(), adapter),
+        MakeIteratorAdapter(index, adapter),
+        MakeIteratorAdapter(index + index_size, adapter),
         target_index).base();
-    cache->push_back(ptr);
+    cache->push_back(ptr - index);
   }
-  cache->push_back(index.data() + index.size());
+  cache->push_back(index_size);
 }
 
-void InitLowerBound1Cache(const std::vector<int> &index, int chunk_size,
+void InitLowerBound1Cache(const int *index, int index_size,
                           size_t increment, size_t size,
-                          std::vector<const int *> *cache) {
+                          std::vector<int32> *cache) {
   DCHECK_GT(increment, 0);
   cache->clear();
   cache->reserve(size + 2);
-  cache->push_back(index.data());
+  cache->push_back(0);
   for (size_t i = 1; i <= size; ++i) {
     const int target_index = increment * i;
-    const int *ptr = std::lower_bound(index.data(), index.data() + index.size(),
-                                      target_index);
-    cache->push_back(ptr);
+    const int *ptr = std::lower_bound(index, index + index_size, target_index);
+    cache->push_back(ptr - index);
   }
-  cache->push_back(index.data() + index.size());
+  cache->push_back(index_size);
+}
+
+// Returns true if all the offsets of the lower bound cache are in the index.
+bool IsValidLowerBoundCache(const int32 *offsets, size_t size,
+                            int index_size) {
+  for (size_t i = 0; i < size + 2; ++i) {
+    if (offsets[i] < 0 || offsets[i] > index_size) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Returns the number of the 32-bit integers of the lower bound cache of
+// |size| in the index image.
+inline int GetLowerBoundCacheImageSize(int size) {
+  return size == 0 ? 0 : size + 2;
+}
+
+void PushInt32(int32 value, string *image) {
+  // Output LSB to MSB.
+  const uint32 v = static_cast<uint32>(value);
+  image->push_back(static_cast<char>(v & 0xFF));
+  image->push_back(static_cast<char>((v >> 8) & 0xFF));
+  image->push_back(static_cast<char>((v >> 16) & 0xFF));
+  image->push_back(static_cast<char>((v >> 24) & 0xFF));
+}
+
+inline int32 ReadInt32(const uint8 *data) {
+  // TODO(noriyukit): static assertion for the endian.
+  return *reinterpret_cast<const int32 *>(data);
 }
 
+// The number of the 32-bit integers in the header of the index image.
+const int kIndexImageHeaderSize = 4;
+
 }  // namespace
 
 void SimpleSuccinctBitVectorIndex::Init(const uint8 *data, int length,
@@ -169,35 +214,140 @@ void SimpleSuccinctBitVectorIndex::Init(const uint8 *data, int length,
                                         size_t lb1_cache_size) {
   data_ = data;
   length_ = length;
-  InitIndex(data, length, chunk_size_, &index_);
+  InitIndex(data, length, chunk_size_, &index_buffer_);
+  index_ = index_buffer_.data();
+  index_size_ = index_buffer_.size();
+  InitLowerBoundCaches(lb0_cache_size, lb1_cache_size);
+}
 
+void SimpleSuccinctBitVectorIndex::InitLowerBoundCaches(
+    size_t lb0_cache_size, size_t lb1_cache_size) {
   // TODO(noriyukit): Currently, we simply use uniform increment width for lower
   // bound cache.  Nonuniform increment width may improve performance.
   lb0_cache_increment_ =
-      lb0_cache_size == 0 ? GetNum0Bits() : GetNum0Bits() / lb0_cache_size;
-  if (lb0_cache_increment_ == 0) {
-    lb0_cache_increment_ = 1;
-  }
-  InitLowerBound0Cache(index_, chunk_size_, lb0_cache_increment_,
-                       lb0_cache_size, &lb0_cache_);
+      GetLowerBoundCacheIncrement(GetNum0Bits(), lb0_cache_size);
+  InitLowerBound0Cache(index_, index_size_, chunk_size_, lb0_cache_increment_,
+                       lb0_cache_size, &lb0_cache_buffer_);
+  lb0_cache_ = lb0_cache_buffer_.data();
+  lb0_cache_size_ = lb0_cache_buffer_.size();
 
   lb1_cache_increment_ =
-      lb1_cache_size == 0 ? GetNum1Bits() : GetNum1Bits() / lb1_cache_size;
-  if (lb1_cache_increment_ == 0) {
-    lb1_cache_increment_ = 1;
+      GetLowerBoundCacheIncrement(GetNum1Bits(), lb1_cache_size);
+  InitLowerBound1Cache(index_, index_size_, lb1_cache_increment_,
+                       lb1_cache_size, &lb1_cache_buffer_);
+  lb1_cache_ = lb1_cache_buffer_.data();
+  lb1_cache_size_ = lb1_cache_buffer_.size();
+}
+
+bool SimpleSuccinctBitVectorIndex::LoadLowerBoundCaches(
+    const int32 *image, size_t lb0_cache_size, size_t lb1_cache_size) {
+  lb0_cache_buffer_.clear();
+  lb1_cache_buffer_.clear();
+  whole_index_[0] = 0;
+  whole_index_[1] = index_size_;
+
+  lb0_cache_increment_ =
+      GetLowerBoundCacheIncrement(GetNum0Bits(), lb0_cache_size);
+  lb0_cache_ = lb0_cache_size == 0 ? whole_index_ : image;
+  lb0_cache_size_ = lb0_cache_size + 2;
+  image += GetLowerBoundCacheImageSize(lb0_cache_size);
+
+  lb1_cache_increment_ =
+      GetLowerBoundCacheIncrement(GetNum1Bits(), lb1_cache_size);
+  lb1_cache_ = lb1_cache_size == 0 ? whole_index_ : image;
+  lb1_cache_size_ = lb1_cache_size + 2;
+
+  return IsValidLowerBoundCache(lb0_cache_, lb0_cache_size, index_size_) &&
+         IsValidLowerBoundCache(lb1_cache_, lb1_cache_size, index_size_);
+}
+
+bool SimpleSuccinctBitVectorIndex::InitFromIndexImage(
+    const uint8 *data, int length,
+    const uint8 *index_image, int index_image_size) {
+  if (index_image_size < kIndexImageHeaderSize * 4) {
+    LOG(ERROR) << "Too short index image: " << index_image_size;
+    return false;
+  }
+  const int expected_image_size = GetIndexImageSize(index_image);
+  if (expected_image_size < 0 || expected_image_size > index_image_size) {
+    LOG(ERROR) << "Broken index image: " << index_image_size;
+    return false;
+  }
+  const int chunk_size = ReadInt32(index_image);
+  const int image_length = ReadInt32(index_image + 4);
+  const size_t lb0_cache_size = ReadInt32(index_image + 8);
+  const size_t lb1_cache_size = ReadInt32(index_image + 12);
+  if (chunk_size != chunk_size_ || image_length != length) {
+    LOG(ERROR) << "The index image is not for this bit vector: chunk_size="
+               << chunk_size << ", length=" << image_length;
+    return false;
   }
-  InitLowerBound1Cache(index_, chunk_size_, lb1_cache_increment_,
-                       lb1_cache_size, &lb1_cache_);
+
+  data_ = data;
+  length_ = length;
+  index_buffer_.clear();
+  index_ = reinterpret_cast<const int *>(
+      index_image + kIndexImageHeaderSize * 4);
+  index_size_ = GetIndexSize(length, chunk_size);
+
+  if (!LoadLowerBoundCaches(index_ + index_size_, lb0_cache_size,
+                            lb1_cache_size)) {
+    LOG(ERROR) << "Broken lower bound cache in the index image";
+    Reset();
+    return false;
+  }
+  return true;
+}
+
+void SimpleSuccinctBitVectorIndex::AppendIndexImage(string *image) const {
+  DCHECK(index_);
+  PushInt32(chunk_size_, image);
+  PushInt32(length_, image);
+  PushInt32(lb0_cache_size_ - 2, image);
+  PushInt32(lb1_cache_size_ - 2, image);
+  for (int i = 0; i < index_size_; ++i) {
+    PushInt32(index_[i], image);
+  }
+  if (lb0_cache_size_ > 2) {
+    for (size_t i = 0; i < lb0_cache_size_; ++i) {
+      PushInt32(lb0_cache_[i], image);
+    }
+  }
+  if (lb1_cache_size_ > 2) {
+    for (size_t i = 0; i < lb1_cache_size_; ++i) {
+      PushInt32(lb1_cache_[i], image);
+    }
+  }
+}
+
+int SimpleSuccinctBitVectorIndex::GetIndexImageSize(const uint8 *index_image) {
+  const int chunk_size = ReadInt32(index_image);
+  const int length = ReadInt32(index_image + 4);
+  const int lb0_cache_size = ReadInt32(index_image + 8);
+  const int lb1_cache_size = ReadInt32(index_image + 12);
+  if (chunk_size <= 0 || length < 0 ||
+      lb0_cache_size < 0 || lb1_cache_size < 0) {
+    return -1;
+  }
+  return 4 * (kIndexImageHeaderSize + GetIndexSize(length, chunk_size) +
+              GetLowerBoundCacheImageSize(lb0_cache_size) +
+              GetLowerBoundCacheImageSize(lb1_cache_size));
 }
 
 void SimpleSuccinctBitVectorIndex::Reset() {
   data_ = nullptr;
   length_ = 0;
-  index_.clear();
+  index_ = nullptr;
+  index_size_ = 0;
+  index_buffer_.clear();
   lb0_cache_increment_ = 1;
-  lb0_cache_.clear();
+  lb0_cache_ = nullptr;
+  lb0_cache_size_ = 0;
+  lb0_cache_buffer_.clear();
   lb1_cache_increment_ = 1;
-  lb1_cache_.clear();
+  lb1_cache_ = nullptr;
+  lb1_cache_size_ = 0;
+  lb1_cache_buffer_.clear();
 }
 
 int SimpleSuccinctBitVectorIndex::Rank1(int n) const {
@@ -226,19 +376,21 @@ int SimpleSuccinctBitVectorIndex::Select0(int n) const {
 
   // Narrow down the range of |index_| on which lower bound is performed.
   int lb0_cache_index = n / lb0_cache_increment_;
-  if (lb0_cache_index > lb0_cache_.size() - 2) {
-    lb0_cache_index = lb0_cache_.size() - 2;
+  if (lb0_cache_index > lb0_cache_size_ - 2) {
+    lb0_cache_index = lb0_cache_size_ - 2;
   }
   DCHECK_GE(lb0_cache_index, 0);
 
   // Binary search on chunks.
-  ZeroBitAdapter adapter(&index_, chunk_size_);
+  ZeroBitAdapter adapter(index_, chunk_size_);
   const int *chunk_ptr =
       std::lower_bound(
-          MakeIteratorAdapter(lb0_cache_[lb0_cache_index], adapter),
-          MakeIteratorAdapter(lb0_cache_[lb0_cache_index + 1], adapter), n)
+          MakeIteratorAdapter(index_ + lb0_cache_[lb0_cache_index], adapter),
+          MakeIteratorAdapter(index_ + lb0_cache_[lb0_cache_index + 1],
+                              adapter),
+          n)
           .base();
-  const int chunk_index = (chunk_ptr - index_.data()) - 1;
+  const int chunk_index = (chunk_ptr - index_) - 1;
   DCHECK_GE(chunk_index, 0);
   n -= chunk_size_ * 8 * chunk_index - index_[chunk_index];
 
@@ -269,15 +421,16 @@ int SimpleSuccinctBitVectorIndex::Select1(int n) const {
 
   // Narrow down the range of |index_| on which lower bound is performed.
   int lb1_cache_index = n / lb1_cache_increment_;
-  if (lb1_cache_index > lb1_cache_.size() - 2) {
-    lb1_cache_index = lb1_cache_.size() - 2;
+  if (lb1_cache_index > lb1_cache_size_ - 2) {
+    lb1_cache_index = lb1_cache_size_ - 2;
   }
   DCHECK_GE(lb1_cache_index, 0);
 
   // Binary search on chunks.
-  const int *chunk_ptr = std::lower_bound(lb1_cache_[lb1_cache_index],
-                                          lb1_cache_[lb1_cache_index + 1], n);
-  const int chunk_index = (chunk_ptr - index_.data()) - 1;
+  const int *chunk_ptr =
+      std::lower_bound(index_ + lb1_cache_[lb1_cache_index],
+                       index_ + lb1_cache_[lb1_cache_index + 1], n);
+  const int chunk_index = (chunk_ptr - index_) - 1;
   DCHECK_GE(chunk_index, 0);
   n -= index_[chunk_index];
 
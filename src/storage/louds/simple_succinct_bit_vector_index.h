@@ -30,7 +30,9 @@
 #ifndef MOZC_STORAGE_LOUDS_SIMPLE_SUCCINCT_BIT_VECTOR_INDEX_H_
 #define MOZC_STORAGE_LOUDS_SIMPLE_SUCCINCT_BIT_VECTOR_INDEX_H_
 
+#include <string>
 #include <vector>
+
 #include "base/port.h"
 
 namespace mozc {
@@ -45,8 +47,14 @@ class SimpleSuccinctBitVectorIndex {
       : data_(nullptr),
         length_(0),
         chunk_size_(32),
+        index_(nullptr),
+        index_size_(0),
         lb0_cache_increment_(1),
-        lb1_cache_increment_(1) {}
+        lb0_cache_(nullptr),
+        lb0_cache_size_(0),
+        lb1_cache_increment_(1),
+        lb1_cache_(nullptr),
+        lb1_cache_size_(0) {}
 
   // chunk_size is in bytes, and must be greater than or equal to 4
   // and power of 2, at the moment, although we may relax the restriction
@@ -55,8 +63,14 @@ class SimpleSuccinctBitVectorIndex {
       : data_(nullptr),
         length_(0),
         chunk_size_(chunk_size),
+        index_(nullptr),
+        index_size_(0),
         lb0_cache_increment_(1),
-        lb1_cache_increment_(1) {}
+        lb0_cache_(nullptr),
+        lb0_cache_size_(0),
+        lb1_cache_increment_(1),
+        lb1_cache_(nullptr),
+        lb1_cache_size_(0) {}
 
   // Initializes the index. This class doesn't have the ownership of the memory
   // pointed by data, so it is caller's responsibility to manage its life time.
@@ -68,6 +82,27 @@ class SimpleSuccinctBitVectorIndex {
     Init(data, length, 0, 0);
   }
 
+  // Initializes the index from |index_image| created by AppendIndexImage()
+  // for the same bit vector, instead of scanning the bit vector.  The image,
+  // including the lower bound caches, is used in place without copying, so it
+  // needs to be aligned to 32-bits and to outlive this instance, like |data|.
+  // Returns false if the image doesn't match |data|.
+  bool InitFromIndexImage(const uint8 *data, int length,
+                          const uint8 *index_image, int index_image_size);
+
+  // Appends the index built by Init() to |image|.  The image consists of
+  // little endian 32-bit integers:
+  // [chunk size][bit vector length][lb0 cache size][lb1 cache size]
+  // [index: ceil(bit vector length / chunk size) + 1 integers]
+  // [lb0 cache: lb0 cache size + 2 offsets in the index]
+  // [lb1 cache: lb1 cache size + 2 offsets in the index]
+  // A lower bound cache of size 0 is omitted, as it always covers the whole
+  // index.
+  void AppendIndexImage(string *image) const;
+
+  // Returns the size of the image in bytes, reading only its header.
+  static int GetIndexImageSize(const uint8 *index_image);
+
   // Resets the internal state, especially releases the allocated memory
   // for the index used internally.
   void Reset();
@@ -95,19 +130,38 @@ class SimpleSuccinctBitVectorIndex {
   // Returned index is 0-origin.
   int Select1(int n) const;
 
-  int GetNum1Bits() const { return index_.back(); }
-  int GetNum0Bits() const { return 8 * length_ - index_.back(); }
+  int GetNum1Bits() const { return index_[index_size_ - 1]; }
+  int GetNum0Bits() const { return 8 * length_ - index_[index_size_ - 1]; }
 
  private:
+  void InitLowerBoundCaches(size_t lb0_cache_size, size_t lb1_cache_size);
+  bool LoadLowerBoundCaches(const int32 *image, size_t lb0_cache_size,
+                            size_t lb1_cache_size);
+
   const uint8 *data_;
   int length_;
   int chunk_size_;
 
-  std::vector<int> index_;
+  // Points to either |index_buffer_| or the image given to
+  // InitFromIndexImage().
+  const int *index_;
+  int index_size_;
+  std::vector<int> index_buffer_;
+
+  // The lower bound caches are the offsets in |index_|, and point to either
+  // the buffers, the image given to InitFromIndexImage() or |whole_index_|.
+  // Each of them has its size + 2 offsets.
   int lb0_cache_increment_;
-  std::vector<const int *> lb0_cache_;
+  const int32 *lb0_cache_;
+  size_t lb0_cache_size_;
+  std::vector<int32> lb0_cache_buffer_;
   int lb1_cache_increment_;
-  std::vector<const int *> lb1_cache_;
+  const int32 *lb1_cache_;
+  size_t lb1_cache_size_;
+  std::vector<int32> lb1_cache_buffer_;
+
+  // The lower bound cache of size 0, i.e., [0, index_size_].
+  int32 whole_index_[2];
 
   DISALLOW_COPY_AND_ASSIGN(SimpleSuccinctBitVectorIndex);
 };
@@ -190,4 +190,53 @@ TEST_P(SimpleSuccinctBitVectorIndexTest, Pattern2) {
 }
 INSTANTIATE_TEST_CASE(GenPattern2Test);
 
+TEST_P(SimpleSuccinctBitVectorIndexTest, IndexImage) {
+  const CacheSizeParam &param = GetParam();
+
+  // Bit pattern with varying density, so that chunks have different counts.
+  string data;
+  for (int i = 0; i < 1024; ++i) {
+    data.push_back(static_cast<char>((i * 37) ^ (i >> 3)));
+  }
+  const uint8 *bits = reinterpret_cast<const uint8 *>(data.data());
+
+  SimpleSuccinctBitVectorIndex expected;
+  expected.Init(bits, data.length(), param.first, param.second);
+  string image;
+  expected.AppendIndexImage(&image);
+  EXPECT_EQ(image.size(), SimpleSuccinctBitVectorIndex::GetIndexImageSize(
+                              reinterpret_cast<const uint8 *>(image.data())));
+  // The header, the index and the lower bound caches of nonzero size.
+  const size_t index_size = data.length() / 32 + 1;
+  EXPECT_EQ(4 * (4 + index_size +
+                 (param.first == 0 ? 0 : param.first + 2) +
+                 (param.second == 0 ? 0 : param.second + 2)),
+            image.size());
+
+  SimpleSuccinctBitVectorIndex bit_vector;
+  ASSERT_TRUE(bit_vector.InitFromIndexImage(
+      bits, data.length(), reinterpret_cast<const uint8 *>(image.data()),
+      image.size()));
+  EXPECT_EQ(expected.GetNum0Bits(), bit_vector.GetNum0Bits());
+  EXPECT_EQ(expected.GetNum1Bits(), bit_vector.GetNum1Bits());
+  for (int i = 0; i <= data.length() * 8; ++i) {
+    EXPECT_EQ(expected.Rank1(i), bit_vector.Rank1(i)) << i;
+  }
+  for (int i = 1; i <= expected.GetNum0Bits(); ++i) {
+    EXPECT_EQ(expected.Select0(i), bit_vector.Select0(i)) << i;
+  }
+  for (int i = 1; i <= expected.GetNum1Bits(); ++i) {
+    EXPECT_EQ(expected.Select1(i), bit_vector.Select1(i)) << i;
+  }
+
+  // The image is rejected for another bit vector or when it's truncated.
+  EXPECT_FALSE(bit_vector.InitFromIndexImage(
+      bits, data.length() - 4, reinterpret_cast<const uint8 *>(image.data()),
+      image.size()));
+  EXPECT_FALSE(bit_vector.InitFromIndexImage(
+      bits, data.length(), reinterpret_cast<const uint8 *>(image.data()),
+      image.size() - 4));
+}
+INSTANTIATE_TEST_CASE(GenIndexImageTest);
+
 }  // namespace
@@ -27,14 +27,13 @@
 // (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+
 #include "storage/lru_storage.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cstdlib>
 #include <cstring>
-#include <ctime>
-#include <map>
-#include <memory>
 #include <set>
 #include <string>
 #include <vector>
@@ -48,142 +47,172 @@
 #include "base/port.h"
 #include "base/util.h"
 
+// File format
+//
+// Header: LRUStorage::Header (kHeaderSize bytes)
+// Journal: kJournalSize bytes
+//   Undo entries of the update in progress.  Each entry is the offset and
+//   the size of the overwritten bytes as uint32, followed by the bytes
+//   padded to 4 bytes.  Header::journal_size is the total size of the
+//   entries, and 0 when no update is in progress.
+// Records: size * (kRecordHeaderSize + value_size) bytes
+//   uint64 fingerprint of the key
+//   uint32 last access time, which is 0 for unused records
+//   uint32 previous (newer) record in the LRU list, or kNil
+//   uint32 next (older) record in the LRU list or the free list, or kNil
+//   value
+// Index: index_size * uint32
+//   Open-addressing hash table of the records in the LRU list.  Each slot
+//   holds a record, kEmptySlot or kDeletedSlot, and a record is placed by
+//   linear probing from its fingerprint.
+//
+// The journal protects the file from the process being killed in the middle
+// of an update, since the updates of the mapped pages are written back by
+// the OS in any case.  The bytes overwritten by an update are saved to the
+// journal before being overwritten, and the journal is cleared when the
+// update is completed.  Open() rolls back the update left in the journal.
+//
+// Version 1 of the format has only value_size, size and seed as uint32 in
+// the header, followed by the records without the links.  Open() converts
+// it to the current version.
+
 namespace mozc {
 namespace storage {
 
+struct LRUStorage::Header {
+  uint32 magic;
+  uint32 version;
+  uint32 value_size;
+  uint32 size;
+  uint32 seed;
+  uint32 index_size;
+  uint32 flags;
+  uint32 head;
+  uint32 tail;
+  uint32 free_head;
+  uint32 used_size;
+  // Number of the slots which are not empty, including deleted ones.
+  uint32 index_used;
+  uint32 journal_size;
+  uint32 reserved[3];
+};
+
 namespace {
 const size_t kMaxLRUSize   = 1000000;  // 1M
 const size_t kMaxValueSize = 1024;     // 1024 byte
 
+const uint32 kMagic = 0x55524C4D;  // "MLRU"
+const uint32 kVersion = 2;
+const size_t kJournalSize = 4096;
+const size_t kJournalEntryHeaderSize = 8;
+const size_t kRecordHeaderSize = 20;
+const uint32 kNil = 0xFFFFFFFF;
+const uint32 kEmptySlot = 0xFFFFFFFF;
+const uint32 kDeletedSlot = 0xFFFFFFFE;
+
+// Bits of Header::flags, which are cleared while the LRU list or the index
+// is rebuilt.
+const uint32 kListValid = 1;
+const uint32 kIndexValid = 2;
+
+const size_t kHeaderSize = 64;
+const size_t kVersion1HeaderSize = 12;
+const size_t kVersion1RecordHeaderSize = 12;
+
 template <class T>
 inline void ReadValue(char **ptr, T *value) {
   memcpy(value, *ptr, sizeof(*value));
   *ptr += sizeof(*value);
 }
 
+inline uint32 GetUint32(const char *ptr) {
+  uint32 value = 0;
+  memcpy(&value, ptr, sizeof(value));
+  return value;
+}
+
 uint64 GetFP(const char *ptr) {
-  return *reinterpret_cast<const uint64 *>(ptr);
+  uint64 fp = 0;
+  memcpy(&fp, ptr, sizeof(fp));
+  return fp;
 }
 
 uint32 GetTimeStamp(const char *ptr) {
-  return *reinterpret_cast<const uint32 *>(ptr + 8);
+  return GetUint32(ptr + 8);
 }
 
-const char* GetValue(const char *ptr) {
-  return ptr + 12;
+uint32 *MutablePrev(char *ptr) {
+  return reinterpret_cast<uint32 *>(ptr + 12);
 }
 
-void Update(char *ptr) {
-  const uint32 last_access_time = static_cast<uint32>(Clock::GetTime());
-  memcpy(ptr + 8, reinterpret_cast<const char *>(&last_access_time), 4);
+uint32 *MutableNext(char *ptr) {
+  return reinterpret_cast<uint32 *>(ptr + 16);
 }
 
-void Update(char *ptr, uint64 fp, const char *value, size_t value_size) {
-  const uint32 last_access_time = static_cast<uint32>(Clock::GetTime());
-  memcpy(ptr,     reinterpret_cast<const char *>(&fp), 8);
-  memcpy(ptr + 8, reinterpret_cast<const char *>(&last_access_time), 4);
-  memcpy(ptr + 12, value, value_size);
+uint32 GetNext(const char *ptr) {
+  return GetUint32(ptr + 16);
 }
 
-class CompareByTimeStamp {
- public:
-  bool operator()(const char *a, const char *b) const {
-    return GetTimeStamp(a) > GetTimeStamp(b);
-  }
-};
-}  // namespace
+const char* GetValue(const char *ptr) {
+  return ptr + kRecordHeaderSize;
+}
 
-class LRUStorage::Node {
- public:
-  Node(): next(NULL), prev(NULL), value(NULL) {
+// Returns the number of the slots of the index, which keeps the load factor
+// at most 0.5 when the storage is full.
+size_t GetIndexSize(size_t size) {
+  size_t index_size = 8;
+  while (index_size < size * 2) {
+    index_size *= 2;
   }
+  return index_size;
+}
 
-  Node *next;
-  Node *prev;
-  char *value;
-
- private:
-  DISALLOW_COPY_AND_ASSIGN(Node);
-};
+size_t GetFileSize(size_t value_size, size_t size) {
+  return kHeaderSize + kJournalSize +
+         (kRecordHeaderSize + value_size) * size +
+         sizeof(uint32) * GetIndexSize(size);
+}
 
-class LRUStorage::LRUList {
- public:
-  explicit LRUList(size_t max_size)
-      : max_size_(max_size), size_(0), last_(NULL), top_(NULL) {
-  }
+inline size_t RoundUp4(size_t size) {
+  return (size + 3) & ~static_cast<size_t>(3);
+}
 
-  ~LRUList() {
-    Clear();
-  }
+// Keeps the compiler from reordering the writes to the mapped file, so that
+// the journal is always written before the data it protects.
+inline void WriteBarrier() {
+  std::atomic_signal_fence(std::memory_order_seq_cst);
+}
 
-  void Clear() {
-    Node *node = top_;
-    while (node != NULL) {
-      Node *next = node->next;
-      delete node;
-      node = next;
-    }
-    size_ = 0;
-    top_ = last_ = NULL;
-  }
-
-  Node *Add(char *value) {
-    if (size_ < max_size_) {
-      Node *node = new Node;
-      node->value = value;
-      if (last_ == NULL) {
-        node->prev = NULL;
-        top_ = node;
-      } else {
-        last_->next = node;
-      }
-      node->next = NULL;
-      node->prev = last_;
-      last_ = node;
-      ++size_;
-      return node;
-    }
-    LOG(WARNING) << "LRUList is full";
-    return NULL;
-  }
+// Hints the processor to load |ptr| into the cache ahead of the access.
+inline void Prefetch(const void *ptr) {
+#if defined(__GNUC__)
+  __builtin_prefetch(ptr);
+#endif  // __GNUC__
+}
 
-  bool empty() const {
-    return (top_ == NULL);
+bool IsValidSize(size_t value_size, size_t size) {
+  if (value_size == 0 || value_size > kMaxValueSize) {
+    LOG(ERROR) << "value_size is out of range: " << value_size;
+    return false;
   }
-
-  size_t size() const {
-    return size_;
+  if (size == 0 || size > kMaxLRUSize) {
+    LOG(ERROR) << "size is out of range: " << size;
+    return false;
   }
-
-  Node *GetLastNode() {
-    return last_;
+  if (value_size % 4 != 0) {
+    LOG(ERROR) << "value_size_ must be 4 byte alignment";
+    return false;
   }
+  return true;
+}
 
-  void MoveToTop(Node *node) {
-    if (node->prev != NULL) {  // this is top
-      Node *prev = node->prev;
-      Node *next = node->next;
-      prev->next = next;
-      if (next == NULL) {
-        last_ = prev;
-      } else {
-        next->prev = prev;
-      }
-      node->next = top_;
-      top_->prev = node;
-      top_ = node;
-      top_->prev = NULL;
-    }
+class CompareByTimeStamp {
+ public:
+  bool operator()(const char *a, const char *b) const {
+    return GetTimeStamp(a) > GetTimeStamp(b);
   }
-
- private:
-  size_t max_size_;
-  size_t size_;
-  Node *last_;
-  Node *top_;
-
-  DISALLOW_COPY_AND_ASSIGN(LRUList);
 };
+}  // namespace
 
 LRUStorage *LRUStorage::Create(const char *filename) {
   std::unique_ptr<LRUStorage> n(new LRUStorage);
@@ -210,18 +239,7 @@ bool LRUStorage::CreateStorageFile(const char *filename,
                                    size_t value_size,
                                    size_t size,
                                    uint32 seed) {
-  if (value_size == 0 || value_size > kMaxValueSize) {
-    LOG(ERROR) << "value_size is out of range";
-    return false;
-  }
-
-  if (size == 0 || size > kMaxLRUSize) {
-    LOG(ERROR) << "size is out of range";
-    return false;
-  }
-
-  if (value_size % 4 != 0) {
-    LOG(ERROR) << "value_size_ must be 4 byte alignment";
+  if (!IsValidSize(value_size, size)) {
     return false;
   }
 
@@ -231,46 +249,51 @@ bool LRUStorage::CreateStorageFile(const char *filename,
     return false;
   }
 
-  const uint32 value_size_uint32 = static_cast<uint32>(value_size);
-  const uint32 size_uint32 = static_cast<uint32>(size);
-
-  ofs.write(reinterpret_cast<const char *>(&value_size_uint32),
-            sizeof(value_size_uint32));
-  ofs.write(reinterpret_cast<const char *>(&size_uint32),
-            sizeof(size_uint32));
-  ofs.write(reinterpret_cast<const char *>(&seed),
-            sizeof(seed));
-  std::vector<char> ary(value_size, '\0');
-  const uint32 last_access_time = 0;
-  const uint64 fp = 0;
-
+  static_assert(sizeof(Header) == kHeaderSize, "Invalid header size");
+
+  // All the records are in the free list.
+  Header header;
+  memset(&header, 0, sizeof(header));
+  header.magic = kMagic;
+  header.version = kVersion;
+  header.value_size = static_cast<uint32>(value_size);
+  header.size = static_cast<uint32>(size);
+  header.seed = seed;
+  header.index_size = static_cast<uint32>(GetIndexSize(size));
+  header.flags = kListValid | kIndexValid;
+  header.head = kNil;
+  header.tail = kNil;
+  header.free_head = 0;
+  ofs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+  const string journal(kJournalSize, '\0');
+  ofs.write(journal.data(), journal.size());
+
+  string record(kRecordHeaderSize + value_size, '\0');
+  *MutablePrev(&record[0]) = kNil;
   for (size_t i = 0; i < size; ++i) {
-    ofs.write(reinterpret_cast<const char *>(&fp), sizeof(fp));
-    ofs.write(reinterpret_cast<const char *>(&last_access_time),
-              sizeof(last_access_time));
-    ofs.write(reinterpret_cast<const char *>(&ary[0]),
-              static_cast<std::streamsize>(ary.size() * sizeof(ary[0])));
+    *MutableNext(&record[0]) =
+        (i + 1 < size) ? static_cast<uint32>(i + 1) : kNil;
+    ofs.write(record.data(), record.size());
   }
 
-  return true;
+  const std::vector<uint32> index(header.index_size, kEmptySlot);
+  ofs.write(reinterpret_cast<const char *>(&index[0]),
+            static_cast<std::streamsize>(index.size() * sizeof(index[0])));
+
+  return ofs.good();
 }
 
-// Reopen file after initializing mapped page.
+// Initializes the records and rebuilds the LRU list.
 bool LRUStorage::Clear() {
   // Don't need to clear the page if the lru list is empty
-  if (mmap_.get() == NULL || lru_list_.get() == NULL ||
-      lru_list_->size() == 0) {
+  if (begin_ == NULL || header()->used_size == 0) {
     return true;
   }
-  const size_t offset =
-      sizeof(value_size_) + sizeof(size_) + sizeof(seed_);
-  if (offset >= mmap_->size()) {   // should not happen
-    return false;
-  }
-  memset(mmap_->begin() + offset, '\0', mmap_->size() - offset);
-  lru_list_.reset();
-  map_.clear();
-  Open(mmap_->begin(), mmap_->size());
+  header()->flags = 0;
+  WriteBarrier();
+  memset(begin_, '\0', (kRecordHeaderSize + value_size_) * size_);
+  RebuildList();
   return true;
 }
 
@@ -283,6 +306,10 @@ bool LRUStorage::Merge(const char *filename) {
 }
 
 bool LRUStorage::Merge(const LRUStorage &storage) {
+  if (begin_ == NULL || storage.begin_ == NULL) {
+    return false;
+  }
+
   if (storage.value_size() !=  value_size()) {
     return false;
   }
@@ -292,58 +319,35 @@ bool LRUStorage::Merge(const LRUStorage &storage) {
   }
 
   std::vector<const char *> ary;
-
-  // this file
-  {
-    const char *begin = begin_;
-    const char *end = end_;
-    while (begin < end) {
-      ary.push_back(begin);
-      begin += (value_size_ + 12);
-    }
+  for (uint32 i = 0; i < size_; ++i) {
+    ary.push_back(GetRecord(i));
   }
-
-  // target file
-  {
-    const char *begin = storage.begin_;
-    const char *end = storage.end_;
-    while (begin < end) {
-      ary.push_back(begin);
-      begin += (value_size_ + 12);
-    }
+  for (uint32 i = 0; i < storage.size_; ++i) {
+    ary.push_back(storage.GetRecord(i));
   }
 
   std::stable_sort(ary.begin(), ary.end(), CompareByTimeStamp());
 
-  string buf;
+  std::vector<const char *> records;
   std::set<uint64> seen;   // remove duplicated entries.
-  for (size_t i = 0; i < ary.size(); ++i) {
+  for (size_t i = 0; i < ary.size() && records.size() < size_; ++i) {
     if (!seen.insert(GetFP(ary[i])).second) {
       continue;
     }
-    buf.append(const_cast<const char *>(ary[i]), value_size_ + 12);
-  }
-
-  const size_t old_size = static_cast<size_t>(end_ - begin_);
-  const size_t new_size = std::min(buf.size(), old_size);
-
-  // TODO(taku): this part is not atomic.
-  // If the converter process is killed while memcpy or memset is running,
-  // the storage data will be broken.
-  memcpy(begin_, buf.data(), new_size);
-  if (new_size < old_size) {
-    memset(begin_ + new_size, '\0', old_size - new_size);
+    records.push_back(ary[i]);
   }
 
-  return Open(mmap_->begin(), mmap_->size());
+  return RewriteFile(records);
 }
 
 LRUStorage::LRUStorage()
     : value_size_(0),
       size_(0),
       seed_(0),
-      last_item_(NULL),
-      begin_(NULL), end_(NULL) {}
+      journal_(NULL),
+      begin_(NULL),
+      index_(NULL),
+      index_size_(0) {}
 
 LRUStorage::~LRUStorage() {
   Close();
@@ -412,6 +416,7 @@ bool LRUStorage::OpenOrCreate(const char *filename,
 }
 
 bool LRUStorage::Open(const char *filename) {
+  Close();
   mmap_.reset(new Mmap);
 
   if (mmap_.get() == NULL) {
@@ -425,79 +430,434 @@ bool LRUStorage::Open(const char *filename) {
     return false;
   }
 
-  if (mmap_->size() < 8) {
+  if (mmap_->size() < kVersion1HeaderSize) {
     LOG(ERROR) << "file size is too small";
     return false;
   }
 
   filename_ = filename;
-  return Open(mmap_->begin(), mmap_->size());
+  if (GetUint32(mmap_->begin()) != kMagic && !ConvertFromVersion1()) {
+    return false;
+  }
+  return OpenMappedFile();
 }
 
-bool LRUStorage::Open(char *ptr, size_t ptr_size) {
-  begin_ = ptr;
-  end_ = ptr + ptr_size;
+bool LRUStorage::OpenMappedFile() {
+  if (mmap_->size() < kHeaderSize) {
+    LOG(ERROR) << "file size is too small";
+    return false;
+  }
+
+  const Header *h = header();
+  if (h->magic != kMagic || h->version != kVersion) {
+    LOG(ERROR) << "Unknown format version: " << h->version;
+    return false;
+  }
 
-  uint32 value_size_uint32 = 0;
-  uint32 size_uint32 = 0;
+  if (!IsValidSize(h->value_size, h->size)) {
+    return false;
+  }
 
-  ReadValue<uint32>(&begin_, &value_size_uint32);
-  ReadValue<uint32>(&begin_, &size_uint32);
-  ReadValue<uint32>(&begin_, &seed_);
+  if (h->index_size != GetIndexSize(h->size) ||
+      mmap_->size() != GetFileSize(h->value_size, h->size) ||
+      h->journal_size > kJournalSize) {
+    LOG(ERROR) << "LRU file is broken";
+    return false;
+  }
 
-  value_size_ = static_cast<size_t>(value_size_uint32);
-  size_ = static_cast<size_t>(size_uint32);
+  value_size_ = h->value_size;
+  size_ = h->size;
+  seed_ = h->seed;
+  index_size_ = h->index_size;
+  journal_ = mmap_->begin() + kHeaderSize;
+  begin_ = journal_ + kJournalSize;
+  index_ = reinterpret_cast<uint32 *>(
+      begin_ + (kRecordHeaderSize + value_size_) * size_);
 
-  if (value_size_ % 4 != 0) {
-    LOG(ERROR) << "value_size_ must be 4 byte alignment";
+  if (h->journal_size != 0 && !RollbackJournal()) {
+    LOG(ERROR) << "LRU file is broken";
+    begin_ = NULL;
     return false;
   }
 
-  if (size_ == 0 || size_ > kMaxLRUSize) {
-    LOG(ERROR) << "LRU size is invalid: " << size_;
+  // Only the ends of the lists are checked here to keep Open() from reading
+  // the whole file.  The other links and the index slots are checked when
+  // they are followed.
+  if ((h->flags & kListValid) == 0) {
+    RebuildList();
+  }
+  if (!IsValidLink(h->head) || !IsValidLink(h->tail) ||
+      !IsValidLink(h->free_head)) {
+    LOG(ERROR) << "LRU file is broken";
+    begin_ = NULL;
     return false;
   }
+  if ((h->flags & kIndexValid) == 0 && !RebuildIndex()) {
+    LOG(ERROR) << "LRU file is broken";
+    begin_ = NULL;
+    return false;
+  }
+
+  return true;
+}
 
-  if (value_size_ == 0 || value_size_ > kMaxValueSize) {
-    LOG(ERROR) << "value_size is invalid: " << value_size_;
+bool LRUStorage::IsValidLink(uint32 i) const {
+  return i == kNil || i < size_;
+}
+
+bool LRUStorage::RecreateBrokenFile() {
+  LOG(ERROR) << "LRU file is broken. Recreating " << filename_;
+  const string filename = filename_;
+  const size_t value_size = value_size_;
+  const size_t size = size_;
+  const uint32 seed = seed_;
+  Close();
+  if (filename.empty() ||
+      !CreateStorageFile(filename.c_str(), value_size, size, seed) ||
+      !Open(filename.c_str())) {
+    LOG(ERROR) << "cannot recreate " << filename;
+    Close();
+  }
+  return false;
+}
+
+bool LRUStorage::ConvertFromVersion1() {
+  char *ptr = mmap_->begin();
+  uint32 value_size = 0;
+  uint32 size = 0;
+  uint32 seed = 0;
+  ReadValue<uint32>(&ptr, &value_size);
+  ReadValue<uint32>(&ptr, &size);
+  ReadValue<uint32>(&ptr, &seed);
+
+  if (!IsValidSize(value_size, size)) {
     return false;
   }
 
-  const size_t file_size = mmap_->size() - 12;
-  if ((value_size_ + 12) * size_ != file_size) {
+  const size_t record_size = kVersion1RecordHeaderSize + value_size;
+  if (record_size * size != mmap_->size() - kVersion1HeaderSize) {
     LOG(ERROR) << "LRU file is broken";
     return false;
   }
 
-  std::vector<char *> ary;
-  char *begin = begin_;
-  char *end = end_;
-  while (begin < end) {
-    ary.push_back(begin);
-    begin += (value_size_ + 12);
+  const string filename = filename_;
+  const string temp_filename = filename + ".tmp";
+  if (!CreateStorageFile(temp_filename.c_str(), value_size, size, seed)) {
+    return false;
   }
-  std::stable_sort(ary.begin(), ary.end(), CompareByTimeStamp());
-
-  lru_list_.reset(new LRUList(size_));
-  map_.clear();
-  last_item_ = NULL;
-  for (size_t i = 0; i < ary.size(); ++i) {
-    if (GetTimeStamp(ary[i]) != 0) {
-      Node *node = lru_list_->Add(ary[i]);
-      map_.insert(std::make_pair(GetFP(ary[i]), node));
-    } else if (last_item_ == NULL) {
-      last_item_ = ary[i];
+  {
+    LRUStorage storage;
+    if (!storage.Open(temp_filename.c_str())) {
+      return false;
+    }
+    for (uint32 i = 0; i < size; ++i) {
+      const char *record = ptr + record_size * i;
+      storage.Write(i, GetFP(record),
+                    string(record + kVersion1RecordHeaderSize, value_size),
+                    GetUint32(record + 8));
     }
+    storage.RebuildList();
   }
 
+  mmap_.reset(new Mmap);
+  if (!FileUtil::AtomicRename(temp_filename, filename)) {
+    LOG(ERROR) << "cannot rename " << temp_filename << " to " << filename;
+    return false;
+  }
+  if (!mmap_->Open(filename.c_str(), "r+")) {
+    LOG(ERROR) << "cannot open " << filename
+               << " with read+write mode";
+    return false;
+  }
+  VLOG(1) << filename << " is converted to version " << kVersion;
   return true;
 }
 
+bool LRUStorage::RewriteFile(const std::vector<const char *> &records) {
+  if (filename_.empty()) {
+    return false;
+  }
+
+  const string filename = filename_;
+  const string temp_filename = filename + ".tmp";
+  if (!CreateStorageFile(temp_filename.c_str(), value_size_, size_, seed_)) {
+    return false;
+  }
+  {
+    LRUStorage storage;
+    if (!storage.Open(temp_filename.c_str())) {
+      return false;
+    }
+    for (size_t i = 0; i < records.size(); ++i) {
+      storage.Write(i, GetFP(records[i]),
+                    string(GetValue(records[i]), value_size_),
+                    GetTimeStamp(records[i]));
+    }
+    storage.RebuildList();
+  }
+
+  // The file cannot be replaced while it is mapped on Windows.
+  Close();
+  if (!FileUtil::AtomicRename(temp_filename, filename)) {
+    LOG(ERROR) << "cannot rename " << temp_filename << " to " << filename;
+    Open(filename.c_str());
+    return false;
+  }
+  return Open(filename.c_str());
+}
+
 void LRUStorage::Close() {
   filename_.clear();
   mmap_.reset();
-  lru_list_.reset();
-  map_.clear();
+  journal_ = NULL;
+  begin_ = NULL;
+  index_ = NULL;
+}
+
+LRUStorage::Header *LRUStorage::header() const {
+  return reinterpret_cast<Header *>(mmap_->begin());
+}
+
+char *LRUStorage::GetRecord(uint32 i) const {
+  DCHECK_LT(i, size_);
+  return begin_ + (kRecordHeaderSize + value_size_) * i;
+}
+
+uint32 LRUStorage::FindRecord(uint64 fp, uint32 *slot) const {
+  const size_t mask = index_size_ - 1;
+  size_t i = static_cast<size_t>(fp) & mask;
+  for (size_t n = 0; n < index_size_; ++n, i = (i + 1) & mask) {
+    const uint32 record = index_[i];
+    if (record == kEmptySlot) {
+      break;
+    }
+    if (record < size_ && GetFP(GetRecord(record)) == fp) {
+      if (slot != NULL) {
+        *slot = static_cast<uint32>(i);
+      }
+      return record;
+    }
+  }
+  return kNil;
+}
+
+uint32 LRUStorage::FindFreeSlot(uint64 fp) const {
+  const size_t mask = index_size_ - 1;
+  size_t i = static_cast<size_t>(fp) & mask;
+  for (size_t n = 0; n < index_size_; ++n, i = (i + 1) & mask) {
+    if (index_[i] == kEmptySlot || index_[i] == kDeletedSlot) {
+      return static_cast<uint32>(i);
+    }
+  }
+  return kNil;
+}
+
+void LRUStorage::WriteWithJournal(char *ptr, const void *data, size_t size) {
+  Header *h = header();
+  const size_t entry_size = kJournalEntryHeaderSize + RoundUp4(size);
+  CHECK_LE(h->journal_size + entry_size, kJournalSize);
+  char *entry = journal_ + h->journal_size;
+  const uint32 offset = static_cast<uint32>(ptr - mmap_->begin());
+  const uint32 size_uint32 = static_cast<uint32>(size);
+  memcpy(entry, &offset, sizeof(offset));
+  memcpy(entry + 4, &size_uint32, sizeof(size_uint32));
+  memcpy(entry + kJournalEntryHeaderSize, ptr, size);
+  WriteBarrier();
+  h->journal_size += static_cast<uint32>(entry_size);
+  WriteBarrier();
+  memcpy(ptr, data, size);
+}
+
+void LRUStorage::WriteUint32WithJournal(uint32 *ptr, uint32 value) {
+  WriteWithJournal(reinterpret_cast<char *>(ptr), &value, sizeof(value));
+}
+
+void LRUStorage::CommitJournal() {
+  WriteBarrier();
+  header()->journal_size = 0;
+}
+
+bool LRUStorage::RollbackJournal() {
+  Header *h = header();
+  const size_t journal_begin = kHeaderSize;
+  const size_t journal_end = journal_begin + kJournalSize;
+  std::vector<const char *> entries;
+  for (size_t pos = 0; pos < h->journal_size;) {
+    if (pos + kJournalEntryHeaderSize > h->journal_size) {
+      return false;
+    }
+    const char *entry = journal_ + pos;
+    const size_t offset = GetUint32(entry);
+    const size_t size = GetUint32(entry + 4);
+    pos += kJournalEntryHeaderSize + RoundUp4(size);
+    if (pos > h->journal_size || offset + size > mmap_->size() ||
+        (offset < journal_end && offset + size > journal_begin)) {
+      return false;
+    }
+    entries.push_back(entry);
+  }
+  for (size_t i = entries.size(); i > 0; --i) {
+    const char *entry = entries[i - 1];
+    memcpy(mmap_->begin() + GetUint32(entry),
+           entry + kJournalEntryHeaderSize, GetUint32(entry + 4));
+  }
+  CommitJournal();
+  LOG(WARNING) << "Rolled back the interrupted update of " << filename_;
+  return true;
+}
+
+bool LRUStorage::Unlink(uint32 i) {
+  Header *h = header();
+  char *record = GetRecord(i);
+  const uint32 prev = *MutablePrev(record);
+  const uint32 next = *MutableNext(record);
+  if (!IsValidLink(prev) || !IsValidLink(next)) {
+    return false;
+  }
+  if (prev == kNil) {
+    WriteUint32WithJournal(&h->head, next);
+  } else {
+    WriteUint32WithJournal(MutableNext(GetRecord(prev)), next);
+  }
+  if (next == kNil) {
+    WriteUint32WithJournal(&h->tail, prev);
+  } else {
+    WriteUint32WithJournal(MutablePrev(GetRecord(next)), prev);
+  }
+  return true;
+}
+
+bool LRUStorage::PushFront(uint32 i) {
+  Header *h = header();
+  char *record = GetRecord(i);
+  const uint32 head = h->head;
+  if (!IsValidLink(head)) {
+    return false;
+  }
+  WriteUint32WithJournal(MutablePrev(record), kNil);
+  WriteUint32WithJournal(MutableNext(record), head);
+  if (head == kNil) {
+    WriteUint32WithJournal(&h->tail, i);
+  } else {
+    WriteUint32WithJournal(MutablePrev(GetRecord(head)), i);
+  }
+  WriteUint32WithJournal(&h->head, i);
+  return true;
+}
+
+bool LRUStorage::AddToIndex(uint64 fp, uint32 i) {
+  // The index never gets full unless the file is broken.
+  const uint32 slot = FindFreeSlot(fp);
+  if (slot == kNil) {
+    return false;
+  }
+  if (index_[slot] == kEmptySlot) {
+    Header *h = header();
+    WriteUint32WithJournal(&h->index_used, h->index_used + 1);
+  }
+  WriteUint32WithJournal(&index_[slot], i);
+  return true;
+}
+
+void LRUStorage::RemoveFromIndex(uint64 fp, uint32 i) {
+  uint32 slot = 0;
+  if (FindRecord(fp, &slot) != i) {
+    // |i| is a duplicated entry which is not in the index.
+    return;
+  }
+  // The slot can be emptied if no probe sequence passes through it.
+  const uint32 next_slot = (slot + 1) & (index_size_ - 1);
+  if (index_[next_slot] == kEmptySlot) {
+    Header *h = header();
+    WriteUint32WithJournal(&h->index_used, h->index_used - 1);
+    WriteUint32WithJournal(&index_[slot], kEmptySlot);
+  } else {
+    WriteUint32WithJournal(&index_[slot], kDeletedSlot);
+  }
+}
+
+void LRUStorage::UpdateRecord(uint32 i, uint64 fp, const char *value) {
+  char *record = GetRecord(i);
+  if (GetFP(record) != fp) {
+    WriteWithJournal(record, &fp, sizeof(fp));
+  }
+  const uint32 last_access_time = static_cast<uint32>(Clock::GetTime());
+  WriteWithJournal(record + 8, &last_access_time, sizeof(last_access_time));
+  WriteWithJournal(record + kRecordHeaderSize, value, value_size_);
+}
+
+void LRUStorage::RebuildList() {
+  Header *h = header();
+  h->flags = 0;
+  WriteBarrier();
+
+  std::vector<char *> used;
+  uint32 free_head = kNil;
+  for (uint32 i = size_; i > 0; --i) {
+    char *record = GetRecord(i - 1);
+    if (GetTimeStamp(record) != 0) {
+      used.push_back(record);
+    } else {
+      *MutablePrev(record) = kNil;
+      *MutableNext(record) = free_head;
+      free_head = i - 1;
+    }
+  }
+  // Sorts the records by the access times, and by the positions for the same
+  // access time.
+  std::reverse(used.begin(), used.end());
+  std::stable_sort(used.begin(), used.end(), CompareByTimeStamp());
+
+  const size_t record_size = kRecordHeaderSize + value_size_;
+  uint32 prev = kNil;
+  for (size_t i = 0; i < used.size(); ++i) {
+    const uint32 current = static_cast<uint32>((used[i] - begin_) /
+                                               record_size);
+    *MutablePrev(used[i]) = prev;
+    *MutableNext(used[i]) = kNil;
+    if (prev != kNil) {
+      *MutableNext(GetRecord(prev)) = current;
+    }
+    prev = current;
+  }
+  h->head = used.empty() ? kNil :
+      static_cast<uint32>((used.front() - begin_) / record_size);
+  h->tail = prev;
+  h->free_head = free_head;
+  h->used_size = static_cast<uint32>(used.size());
+  h->journal_size = 0;
+  WriteBarrier();
+
+  // The links have just been rebuilt and are always valid.
+  RebuildIndex();
+  WriteBarrier();
+  h->flags |= kListValid;
+}
+
+bool LRUStorage::RebuildIndex() {
+  Header *h = header();
+  h->flags &= ~kIndexValid;
+  WriteBarrier();
+
+  std::fill(index_, index_ + index_size_, kEmptySlot);
+  h->index_used = 0;
+  // Only the newest one of the duplicated entries is indexed.
+  size_t n = 0;
+  for (uint32 i = h->head; i != kNil && n < size_; i = GetNext(GetRecord(i)),
+       ++n) {
+    if (i >= size_) {
+      return false;
+    }
+    const uint64 fp = GetFP(GetRecord(i));
+    if (FindRecord(fp, NULL) == kNil) {
+      index_[FindFreeSlot(fp)] = i;
+      ++h->index_used;
+    }
+  }
+
+  WriteBarrier();
+  h->flags |= kIndexValid;
+  return true;
 }
 
 const char* LRUStorage::Lookup(const string &key) const {
@@ -507,96 +867,151 @@ const char* LRUStorage::Lookup(const string &key) const {
 
 const char* LRUStorage::Lookup(const string &key,
                                uint32 *last_access_time) const {
+  if (begin_ == NULL) {
+    return NULL;
+  }
   const uint64 fp = Hash::FingerprintWithSeed(key, seed_);
-  std::map<uint64, Node *>::const_iterator it = map_.find(fp);
-  if (it == map_.end()) {
+  const uint32 i = FindRecord(fp, NULL);
+  if (i == kNil) {
     return NULL;
   }
-  *last_access_time = GetTimeStamp(it->second->value);
-  return GetValue(it->second->value);
+  const char *record = GetRecord(i);
+  *last_access_time = GetTimeStamp(record);
+  return GetValue(record);
+}
+
+void LRUStorage::LookupFingerprints(const uint64 *fps, size_t size,
+                                    const char **values,
+                                    uint32 *last_access_times) const {
+  if (begin_ == NULL) {
+    std::fill(values, values + size, static_cast<const char *>(NULL));
+    return;
+  }
+  // The probes are split into passes so that the loads of the index slots
+  // and the records of all the keys are in flight at once, instead of
+  // waiting for a cache miss per key.
+  const size_t mask = index_size_ - 1;
+  for (size_t n = 0; n < size; ++n) {
+    Prefetch(index_ + (static_cast<size_t>(fps[n]) & mask));
+  }
+  for (size_t n = 0; n < size; ++n) {
+    const uint32 i = FindRecord(fps[n], NULL);
+    values[n] = (i == kNil) ? NULL : GetRecord(i);
+    if (values[n] != NULL) {
+      Prefetch(values[n]);
+    }
+  }
+  for (size_t n = 0; n < size; ++n) {
+    if (values[n] != NULL) {
+      last_access_times[n] = GetTimeStamp(values[n]);
+      values[n] = GetValue(values[n]);
+    }
+  }
 }
 
 bool LRUStorage::GetAllValues(std::vector<string> *values) const {
-  if (lru_list_.get() == NULL) {
+  if (begin_ == NULL) {
     return false;
   }
   DCHECK(values);
   values->clear();
-  for (const Node *node = lru_list_->GetLastNode();
-       node != NULL;
-       node = node->prev) {
+  size_t n = 0;
+  for (uint32 i = header()->head; i != kNil && n < size_;
+       i = GetNext(GetRecord(i)), ++n) {
+    if (i >= size_) {
+      LOG(ERROR) << "LRU file is broken";
+      return false;
+    }
     // Default constructor of string is not applicable
     // because value's size() must return value_size_.
-    DCHECK(node->value);
-    values->push_back(string(GetValue(node->value), value_size_));
+    values->push_back(string(GetValue(GetRecord(i)), value_size_));
   }
-  std::reverse(values->begin(), values->end());
   return true;
 }
 
 bool LRUStorage::Touch(const string &key) {
-  if (lru_list_.get() == NULL) {
+  if (begin_ == NULL) {
     return false;
   }
 
   const uint64 fp = Hash::FingerprintWithSeed(key, seed_);
-  std::map<uint64, Node *>::iterator it = map_.find(fp);
-  if (it != map_.end()) {     // find in the cache
-    Update(it->second->value);
-    lru_list_->MoveToTop(it->second);
-    return true;
+  const uint32 i = FindRecord(fp, NULL);
+  if (i == kNil) {
+    return false;
   }
-  return false;
+  const uint32 last_access_time = static_cast<uint32>(Clock::GetTime());
+  WriteWithJournal(GetRecord(i) + 8, &last_access_time,
+                   sizeof(last_access_time));
+  if (header()->head != i && (!Unlink(i) || !PushFront(i))) {
+    return RecreateBrokenFile();
+  }
+  CommitJournal();
+  return true;
 }
 
 bool LRUStorage::Insert(const string &key, const char *value) {
-  if (lru_list_.get() == NULL) {
+  if (begin_ == NULL) {
     return false;
   }
 
+  Header *h = header();
   const uint64 fp = Hash::FingerprintWithSeed(key, seed_);
-  std::map<uint64, Node *>::iterator it = map_.find(fp);
-  if (it != map_.end()) {     // find in the cache
-    Update(it->second->value, fp, value, value_size_);
-    lru_list_->MoveToTop(it->second);
-  } else if (lru_list_->size() >= size_ ||
-             last_item_ == NULL) {  // not found, but cache is FULL
-    Node *node = lru_list_->GetLastNode();
-    const uint64 old_fp = GetFP(node->value);  // remove oldest item
-    std::map<uint64, Node *>::iterator old_it = map_.find(old_fp);
-    if (old_it != map_.end()) {
-      map_.erase(old_it);
+  // The links read from the file are checked before they are followed, and
+  // the file is recreated if any of them is broken.
+  uint32 i = FindRecord(fp, NULL);
+  if (i != kNil) {     // find in the cache
+    UpdateRecord(i, fp, value);
+    if (h->head != i && (!Unlink(i) || !PushFront(i))) {
+      return RecreateBrokenFile();
+    }
+  } else if (h->free_head != kNil) {  // not found, cache is not FULL
+    i = h->free_head;
+    if (i >= size_ || !IsValidLink(GetNext(GetRecord(i)))) {
+      return RecreateBrokenFile();
+    }
+    WriteUint32WithJournal(&h->free_head, GetNext(GetRecord(i)));
+    WriteUint32WithJournal(&h->used_size, h->used_size + 1);
+    UpdateRecord(i, fp, value);
+    if (!PushFront(i) || !AddToIndex(fp, i)) {
+      return RecreateBrokenFile();
+    }
+  } else if (h->tail != kNil) {  // not found, but cache is FULL
+    i = h->tail;  // remove oldest item
+    if (i >= size_) {
+      return RecreateBrokenFile();
     }
-    lru_list_->MoveToTop(node);
-    Update(node->value, fp, value, value_size_);
-    map_.insert(std::make_pair(fp, node));
-  } else if (last_item_ < mmap_->end()) {  // not found, cahce is not FULL
-    Node *node = lru_list_->Add(last_item_);
-    lru_list_->MoveToTop(node);
-    Update(node->value, fp, value, value_size_);
-    map_.insert(std::make_pair(fp, node));
-    last_item_ += (value_size_ + 12);
-    if (last_item_ >= mmap_->end()) {
-      last_item_ = NULL;
+    RemoveFromIndex(GetFP(GetRecord(i)), i);
+    UpdateRecord(i, fp, value);
+    if (!Unlink(i) || !PushFront(i) || !AddToIndex(fp, i)) {
+      return RecreateBrokenFile();
     }
   } else {
     LOG(ERROR) << "insertion failed";
     return false;
   }
+  CommitJournal();
+
+  // Removes the deleted slots before they slow down the lookups.
+  if (h->index_used > index_size_ / 4 * 3 && !RebuildIndex()) {
+    return RecreateBrokenFile();
+  }
 
   return true;
 }
 
 bool LRUStorage::TryInsert(const string &key, const char *value) {
-  if (lru_list_.get() == NULL) {
+  if (begin_ == NULL) {
     return false;
   }
 
   const uint64 fp = Hash::FingerprintWithSeed(key, seed_);
-  std::map<uint64, Node *>::iterator it = map_.find(fp);
-  if (it != map_.end()) {     // find in the cache
-    Update(it->second->value, fp, value, value_size_);
-    lru_list_->MoveToTop(it->second);
+  const uint32 i = FindRecord(fp, NULL);
+  if (i != kNil) {     // find in the cache
+    UpdateRecord(i, fp, value);
+    if (header()->head != i && (!Unlink(i) || !PushFront(i))) {
+      return RecreateBrokenFile();
+    }
+    CommitJournal();
   }
 
   return true;
@@ -611,7 +1026,7 @@ size_t LRUStorage::size() const {
 }
 
 size_t LRUStorage::used_size() const {
-  return lru_list_.get() == NULL ? 0 : lru_list_->size();
+  return begin_ == NULL ? 0 : header()->used_size;
 }
 
 uint32 LRUStorage::seed() const {
@@ -627,11 +1042,13 @@ void LRUStorage::Write(size_t i,
                        const string &value,
                        uint32 last_access_time) {
   DCHECK_LT(i, size_);
-  char *ptr = begin_ + (i * (value_size_ + 12));
+  // Makes the next Open() rebuild the LRU list and the index.
+  header()->flags = 0;
+  char *ptr = GetRecord(static_cast<uint32>(i));
   memcpy(ptr,     reinterpret_cast<const char *>(&fp), 8);
   memcpy(ptr + 8, reinterpret_cast<const char *>(&last_access_time), 4);
   if (value.size() == value_size_) {
-    memcpy(ptr + 12, value.data(), value_size_);
+    memcpy(ptr + kRecordHeaderSize, value.data(), value_size_);
   } else {
     LOG(ERROR) << "value size is not " << value_size_ << " byte.";
   }
@@ -642,7 +1059,7 @@ void LRUStorage::Read(size_t i,
                       string *value,
                       uint32 *last_access_time) const {
   DCHECK_LT(i, size_);
-  const char *ptr = begin_ + (i * (value_size_ + 12));
+  const char *ptr = GetRecord(static_cast<uint32>(i));
   *fp = GetFP(ptr);
   value->assign(GetValue(ptr), value_size_);
   *last_access_time = GetTimeStamp(ptr);
@@ -30,7 +30,6 @@
 #ifndef MOZC_STORAGE_LRU_STORAGE_H_
 #define MOZC_STORAGE_LRU_STORAGE_H_
 
-#include <map>
 #include <memory>
 #include <string>
 #include <vector>
@@ -43,11 +42,21 @@ class Mmap;
 
 namespace storage {
 
+// Fixed-size LRU storage backed by a memory-mapped file.  The entries are
+// chained in LRU order and indexed by an open-addressing hash table, both of
+// which are stored in the file, so Open() does not need to sort the entries.
+// The links and the index are checked when they are followed, and an update
+// finding them broken recreates the file.  Every update saves the bytes it
+// overwrites to an undo journal in the file first, and an update interrupted by
+// a crash is rolled back on the next Open().  See lru_storage.cc for the file
+// format.
 class LRUStorage {
  public:
   LRUStorage();
   ~LRUStorage();
 
+  // Opens the storage file.  Files of the previous format, which has no
+  // index, are converted to the current format.
   bool Open(const char *filename);
   void Close();
 
@@ -65,6 +74,14 @@ class LRUStorage {
 
   const char *Lookup(const string &key) const;
 
+  // Looks up |size| keys at once.  |fps| are the fingerprints of the keys by
+  // Hash::FingerprintWithSeed() with seed().  Sets the value of each key, or
+  // NULL if not found, to |values|, and the last access time of each found
+  // key to |last_access_times|.
+  void LookupFingerprints(const uint64 *fps, size_t size,
+                          const char **values,
+                          uint32 *last_access_times) const;
+
   // Returns all values.
   // The order is new to old (*values->begin() is the newest).
   bool GetAllValues(std::vector<string> *values) const;
@@ -97,7 +114,9 @@ class LRUStorage {
 
   // Write one entry at |i| th index.
   // i must be 0 <= i < size.
-  // This data will not update the index of the storage.
+  // This data will not update the index of the storage.  The LRU order and
+  // the index are rebuilt from the access times when the file is opened
+  // next time.
   void Write(size_t i,
              uint64 fp,
              const string &value,
@@ -125,21 +144,66 @@ class LRUStorage {
                                 size_t size,
                                 uint32 seed);
  private:
-  class LRUList;
-  class Node;
-
-  // load from memory buffer
-  bool Open(char *ptr, size_t ptr_size);
+  struct Header;
+
+  // Opens the mapped file of the current format.
+  bool OpenMappedFile();
+
+  // Returns true if |i| is kNil or in the records.  The links read from the
+  // file are checked before they are followed, so that a broken file never
+  // makes an update go out of the file.
+  bool IsValidLink(uint32 i) const;
+
+  // Replaces the broken file with an empty one.  Returns false for the update
+  // which found the file broken.
+  bool RecreateBrokenFile();
+
+  // Converts the mapped file of the previous format to the current format.
+  bool ConvertFromVersion1();
+
+  // Replaces the file with the entries of |records|, which are sorted from
+  // new to old, and opens it.
+  bool RewriteFile(const std::vector<const char *> &records);
+
+  Header *header() const;
+  char *GetRecord(uint32 i) const;
+
+  // Returns the record of |fp| or kNil, and the slot of the index holding
+  // it in |slot| if not null.
+  uint32 FindRecord(uint64 fp, uint32 *slot) const;
+
+  // Returns the first empty or deleted slot for |fp|, or kNil.
+  uint32 FindFreeSlot(uint64 fp) const;
+
+  // Updates of the file with the journal.
+  void WriteWithJournal(char *ptr, const void *data, size_t size);
+  void WriteUint32WithJournal(uint32 *ptr, uint32 value);
+  void CommitJournal();
+  bool RollbackJournal();
+
+  // Updates of the LRU list and the index with the journal.  Return false
+  // without the update if the file is broken.
+  bool Unlink(uint32 i);
+  bool PushFront(uint32 i);
+  bool AddToIndex(uint64 fp, uint32 i);
+  void RemoveFromIndex(uint64 fp, uint32 i);
+  void UpdateRecord(uint32 i, uint64 fp, const char *value);
+
+  // Rebuilds the LRU list from the access times of the records, and the
+  // index from the LRU list.  The rebuilds are done without the journal and
+  // restarted on the next Open() if interrupted.  RebuildIndex() returns
+  // false if the LRU list is broken.
+  void RebuildList();
+  bool RebuildIndex();
 
   size_t value_size_;
   size_t size_;
   uint32 seed_;
-  char *last_item_;
+  char *journal_;
   char *begin_;
-  char *end_;
+  uint32 *index_;
+  size_t index_size_;
   string filename_;
-  std::map<uint64, Node *> map_;
-  std::unique_ptr<LRUList> lru_list_;
   std::unique_ptr<Mmap> mmap_;
 
   DISALLOW_COPY_AND_ASSIGN(LRUStorage);
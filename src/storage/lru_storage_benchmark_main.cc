@@ -0,0 +1,172 @@
+// Copyright 2010-2018, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+// Benchmark for LRUStorage.
+//
+// Fills a storage file of --size entries and reports the time of Insert()
+// for new and existing keys, Lookup() for present and missing keys, and
+// Open() of the full file.
+//
+// Usage:
+//   lru_storage_benchmark_main --file=/tmp/test.db --size=20000
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "base/file_util.h"
+#include "base/flags.h"
+#include "base/init_mozc.h"
+#include "base/logging.h"
+#include "base/port.h"
+#include "base/stopwatch.h"
+#include "storage/lru_storage.h"
+
+DEFINE_string(file, "lru_storage_benchmark.db", "storage file to create");
+DEFINE_int32(size, 20000, "number of entries of the storage");
+DEFINE_int32(value_size, 4, "value size of the storage");
+DEFINE_int32(iterations, 10, "number of passes over the keys");
+
+namespace mozc {
+namespace storage {
+namespace {
+
+void Report(const char *name, Stopwatch *stopwatch, double count) {
+  std::cout << name << ": "
+            << stopwatch->GetElapsedNanoseconds() / count << " ns/op"
+            << std::endl;
+}
+
+void InsertAll(LRUStorage *storage, const std::vector<string> &keys,
+               const string &value) {
+  for (size_t i = 0; i < keys.size(); ++i) {
+    CHECK(storage->Insert(keys[i], value.data()));
+  }
+}
+
+int LookupAll(const LRUStorage &storage, const std::vector<string> &keys) {
+  int found = 0;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    if (storage.Lookup(keys[i]) != NULL) {
+      ++found;
+    }
+  }
+  return found;
+}
+
+void Run() {
+  const size_t size = FLAGS_size;
+  const string value(FLAGS_value_size, 'v');
+  std::vector<string> keys, missing_keys;
+  for (size_t i = 0; i < size; ++i) {
+    keys.push_back("key" + std::to_string(i));
+    missing_keys.push_back("missing" + std::to_string(i));
+  }
+
+  CHECK(LRUStorage::CreateStorageFile(FLAGS_file.c_str(), FLAGS_value_size,
+                                      size, 0x12345678));
+  LRUStorage storage;
+  CHECK(storage.Open(FLAGS_file.c_str()));
+
+  // The first pass fills the storage and the others evict the oldest
+  // entries, since the keys are renamed for every pass.
+  {
+    Stopwatch stopwatch = Stopwatch::StartNew();
+    for (int i = 0; i < FLAGS_iterations; ++i) {
+      std::vector<string> pass_keys = keys;
+      for (size_t j = 0; j < pass_keys.size(); ++j) {
+        pass_keys[j] += "_" + std::to_string(i);
+      }
+      InsertAll(&storage, pass_keys, value);
+    }
+    stopwatch.Stop();
+    Report("Insert (new key)", &stopwatch,
+           static_cast<double>(size) * FLAGS_iterations);
+  }
+
+  InsertAll(&storage, keys, value);
+  {
+    Stopwatch stopwatch = Stopwatch::StartNew();
+    for (int i = 0; i < FLAGS_iterations; ++i) {
+      InsertAll(&storage, keys, value);
+    }
+    stopwatch.Stop();
+    Report("Insert (existing key)", &stopwatch,
+           static_cast<double>(size) * FLAGS_iterations);
+  }
+
+  {
+    int found = 0;
+    Stopwatch stopwatch = Stopwatch::StartNew();
+    for (int i = 0; i < FLAGS_iterations; ++i) {
+      found += LookupAll(storage, keys);
+    }
+    stopwatch.Stop();
+    CHECK_EQ(size * FLAGS_iterations, found);
+    Report("Lookup (hit)", &stopwatch,
+           static_cast<double>(size) * FLAGS_iterations);
+  }
+
+  {
+    int found = 0;
+    Stopwatch stopwatch = Stopwatch::StartNew();
+    for (int i = 0; i < FLAGS_iterations; ++i) {
+      found += LookupAll(storage, missing_keys);
+    }
+    stopwatch.Stop();
+    CHECK_EQ(0, found);
+    Report("Lookup (miss)", &stopwatch,
+           static_cast<double>(size) * FLAGS_iterations);
+  }
+  storage.Close();
+
+  {
+    Stopwatch stopwatch = Stopwatch::StartNew();
+    for (int i = 0; i < FLAGS_iterations; ++i) {
+      LRUStorage reopened;
+      CHECK(reopened.Open(FLAGS_file.c_str()));
+      CHECK_EQ(size, reopened.used_size());
+    }
+    stopwatch.Stop();
+    Report("Open", &stopwatch, FLAGS_iterations);
+  }
+
+  FileUtil::Unlink(FLAGS_file);
+}
+
+}  // namespace
+}  // namespace storage
+}  // namespace mozc
+
+int main(int argc, char **argv) {
+  mozc::InitMozc(argv[0], &argc, &argv, false);
+  mozc::storage::Run();
+  return 0;
+}
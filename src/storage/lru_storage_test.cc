@@ -30,6 +30,8 @@
 #include "storage/lru_storage.h"
 
 #include <algorithm>
+#include <cstring>
+#include <iterator>
 #include <set>
 #include <string>
 #include <utility>
@@ -37,6 +39,7 @@
 
 #include "base/file_stream.h"
 #include "base/file_util.h"
+#include "base/hash.h"
 #include "base/logging.h"
 #include "base/port.h"
 #include "base/util.h"
@@ -58,6 +61,17 @@ string GenRandomString(int size) {
   return result;
 }
 
+string ReadFile(const string &filename) {
+  InputFileStream ifs(filename.c_str(), std::ios::binary | std::ios::in);
+  return string(std::istreambuf_iterator<char>(ifs),
+                std::istreambuf_iterator<char>());
+}
+
+void WriteFile(const string &filename, const string &contents) {
+  OutputFileStream ofs(filename.c_str(), std::ios::binary | std::ios::out);
+  ofs.write(contents.data(), contents.size());
+}
+
 void RunTest(LRUStorage *storage, uint32 size) {
   mozc::storage::LRUCache<string, uint32> cache(size);
   std::set<string> used;
@@ -312,6 +326,372 @@ TEST_F(LRUStorageTest, Merge) {
   FileUtil::Unlink(file2);
 }
 
+TEST_F(LRUStorageTest, ReopenTest) {
+  const string file = GetTemporaryFilePath();
+  const int kSize = 100;
+  LRUStorage::CreateStorageFile(file.c_str(), 4, kSize, 0x76fef);
+  std::vector<string> expected;
+  {
+    LRUStorage storage;
+    ASSERT_TRUE(storage.Open(file.c_str()));
+    for (uint32 i = 0; i < kSize * 3 / 2; ++i) {
+      storage.Insert("key" + std::to_string(i),
+                     reinterpret_cast<const char *>(&i));
+    }
+    EXPECT_TRUE(storage.Touch("key70"));
+    EXPECT_TRUE(storage.GetAllValues(&expected));
+  }
+
+  // The LRU order is kept even for the entries of the same access time.
+  LRUStorage storage;
+  ASSERT_TRUE(storage.Open(file.c_str()));
+  EXPECT_EQ(kSize, storage.used_size());
+  std::vector<string> values;
+  EXPECT_TRUE(storage.GetAllValues(&values));
+  EXPECT_EQ(expected, values);
+
+  // Evicts the oldest entries, key50 to key69 and key71 to key79.
+  for (uint32 i = 0; i < 29; ++i) {
+    storage.Insert("new" + std::to_string(i),
+                   reinterpret_cast<const char *>(&i));
+  }
+  EXPECT_TRUE(storage.Lookup("key69") == NULL);
+  EXPECT_TRUE(storage.Lookup("key79") == NULL);
+  EXPECT_TRUE(storage.Lookup("key70") != NULL);
+  EXPECT_TRUE(storage.Lookup("key80") != NULL);
+  EXPECT_EQ(kSize, storage.used_size());
+}
+
+TEST_F(LRUStorageTest, ManyEvictionsTest) {
+  const string file = GetTemporaryFilePath();
+  const int kSize = 100;
+  LRUStorage::CreateStorageFile(file.c_str(), 4, kSize, 0x76fef);
+  LRUStorage storage;
+  ASSERT_TRUE(storage.Open(file.c_str()));
+  const uint32 kNumKeys = kSize * 50;
+  for (uint32 i = 0; i < kNumKeys; ++i) {
+    storage.Insert(std::to_string(i), reinterpret_cast<const char *>(&i));
+  }
+  EXPECT_EQ(kSize, storage.used_size());
+  for (uint32 i = 0; i < kNumKeys; ++i) {
+    const uint32 *value = reinterpret_cast<const uint32 *>(
+        storage.Lookup(std::to_string(i)));
+    if (i < kNumKeys - kSize) {
+      EXPECT_TRUE(value == NULL) << i;
+    } else {
+      ASSERT_TRUE(value != NULL) << i;
+      EXPECT_EQ(i, *value);
+    }
+  }
+}
+
+TEST_F(LRUStorageTest, LookupFingerprintsTest) {
+  const string file = GetTemporaryFilePath();
+  const int kSize = 100;
+  LRUStorage::CreateStorageFile(file.c_str(), 4, kSize, 0x76fef);
+  LRUStorage storage;
+  ASSERT_TRUE(storage.Open(file.c_str()));
+  for (uint32 i = 0; i < kSize; i += 2) {
+    storage.Insert("key" + std::to_string(i),
+                   reinterpret_cast<const char *>(&i));
+  }
+
+  std::vector<uint64> fps;
+  for (uint32 i = 0; i < kSize; ++i) {
+    fps.push_back(Hash::FingerprintWithSeed("key" + std::to_string(i),
+                                            storage.seed()));
+  }
+  std::vector<const char *> values(fps.size());
+  std::vector<uint32> last_access_times(fps.size(), 0);
+  storage.LookupFingerprints(fps.data(), fps.size(), values.data(),
+                             last_access_times.data());
+  for (uint32 i = 0; i < kSize; ++i) {
+    const string key = "key" + std::to_string(i);
+    uint32 last_access_time = 0;
+    EXPECT_EQ(storage.Lookup(key, &last_access_time), values[i]) << key;
+    if (i % 2 == 0) {
+      ASSERT_TRUE(values[i] != NULL) << key;
+      EXPECT_EQ(i, *reinterpret_cast<const uint32 *>(values[i]));
+      EXPECT_EQ(last_access_time, last_access_times[i]);
+    } else {
+      EXPECT_TRUE(values[i] == NULL) << key;
+    }
+  }
+
+  // Nothing is found in the storage which is not opened.
+  LRUStorage closed_storage;
+  closed_storage.LookupFingerprints(fps.data(), fps.size(), values.data(),
+                                    last_access_times.data());
+  EXPECT_EQ(fps.size(), std::count(values.begin(), values.end(),
+                                   static_cast<const char *>(NULL)));
+}
+
+TEST_F(LRUStorageTest, ConvertFromVersion1Test) {
+  const string file = GetTemporaryFilePath();
+  const uint32 kValueSize = 4;
+  const uint32 kSize = 4;
+  const uint32 kSeed = 0x76fef;
+  {
+    // The header and records without the links.
+    OutputFileStream ofs(file.c_str(), std::ios::binary | std::ios::out);
+    ofs.write(reinterpret_cast<const char *>(&kValueSize), 4);
+    ofs.write(reinterpret_cast<const char *>(&kSize), 4);
+    ofs.write(reinterpret_cast<const char *>(&kSeed), 4);
+    const char *kKeys[] = {"a", "b", "c", ""};
+    const uint32 kTimes[] = {20, 30, 10, 0};
+    for (size_t i = 0; i < kSize; ++i) {
+      const uint64 fp =
+          kTimes[i] == 0 ? 0 : Hash::FingerprintWithSeed(kKeys[i], kSeed);
+      ofs.write(reinterpret_cast<const char *>(&fp), 8);
+      ofs.write(reinterpret_cast<const char *>(&kTimes[i]), 4);
+      ofs.write(kKeys[i], 1);
+      ofs.write("xyz", 3);
+    }
+  }
+
+  LRUStorage storage;
+  ASSERT_TRUE(storage.Open(file.c_str()));
+  EXPECT_EQ(kValueSize, storage.value_size());
+  EXPECT_EQ(kSize, storage.size());
+  EXPECT_EQ(kSeed, storage.seed());
+  EXPECT_EQ(3, storage.used_size());
+  uint32 last_access_time = 0;
+  const char *value = storage.Lookup("a", &last_access_time);
+  ASSERT_TRUE(value != NULL);
+  EXPECT_EQ("axyz", string(value, kValueSize));
+  EXPECT_EQ(20, last_access_time);
+
+  std::vector<string> values;
+  EXPECT_TRUE(storage.GetAllValues(&values));
+  ASSERT_EQ(3, values.size());
+  EXPECT_EQ("bxyz", values[0]);
+  EXPECT_EQ("axyz", values[1]);
+  EXPECT_EQ("cxyz", values[2]);
+
+  // The converted file is opened without conversion.
+  LRUStorage reopened;
+  ASSERT_TRUE(reopened.Open(file.c_str()));
+  EXPECT_EQ(3, reopened.used_size());
+  EXPECT_TRUE(reopened.Lookup("c") != NULL);
+}
+
+// Simulates the crashes in the middle of an insertion with the journal left
+// by the insertion, and checks that the insertion is rolled back.
+TEST_F(LRUStorageTest, RollbackTest) {
+  // Layout of the file; see lru_storage.cc.
+  const size_t kJournalSizeOffset = 48;
+  const size_t kJournalOffset = 64;
+  const size_t kJournalSize = 4096;
+  const size_t kJournalEntryHeaderSize = 8;
+
+  const string file = GetTemporaryFilePath();
+  const int kSize = 4;
+  LRUStorage::CreateStorageFile(file.c_str(), 4, kSize, 0x76fef);
+  std::vector<string> expected_values;
+  string before, after;
+  {
+    LRUStorage storage;
+    ASSERT_TRUE(storage.Open(file.c_str()));
+    for (uint32 i = 0; i < kSize; ++i) {
+      storage.Insert("key" + std::to_string(i),
+                     reinterpret_cast<const char *>(&i));
+    }
+    EXPECT_TRUE(storage.GetAllValues(&expected_values));
+    storage.Close();
+    // Clears the entries left in the journal by the insertions above.
+    before = ReadFile(file);
+    before.replace(kJournalOffset, kJournalSize, kJournalSize, '\0');
+    WriteFile(file, before);
+
+    // Evicts key0.
+    ASSERT_TRUE(storage.Open(file.c_str()));
+    const uint32 value = 100;
+    storage.Insert("new", reinterpret_cast<const char *>(&value));
+    storage.Close();
+    after = ReadFile(file);
+  }
+
+  // The journal entries of the insertion are left after the commit.
+  std::vector<std::pair<size_t, size_t>> entries;
+  size_t journal_size = 0;
+  while (true) {
+    uint32 offset = 0, size = 0;
+    memcpy(&offset, after.data() + kJournalOffset + journal_size, 4);
+    memcpy(&size, after.data() + kJournalOffset + journal_size + 4, 4);
+    if (size == 0) {
+      break;
+    }
+    entries.push_back(std::make_pair(offset, size));
+    journal_size += kJournalEntryHeaderSize + (size + 3) / 4 * 4;
+  }
+  ASSERT_FALSE(entries.empty());
+
+  for (size_t n = 0; n <= entries.size(); ++n) {
+    // The first |n| writes are done, and the last one may be partial.
+    string crashed = before;
+    size_t size = 0;
+    for (size_t i = 0; i < n; ++i) {
+      crashed.replace(entries[i].first, entries[i].second,
+                      entries[i].second, '\xAB');
+      size += kJournalEntryHeaderSize + (entries[i].second + 3) / 4 * 4;
+    }
+    crashed.replace(kJournalOffset, size, after, kJournalOffset, size);
+    const uint32 size_uint32 = static_cast<uint32>(size);
+    crashed.replace(kJournalSizeOffset, 4,
+                    reinterpret_cast<const char *>(&size_uint32), 4);
+    WriteFile(file, crashed);
+
+    LRUStorage storage;
+    ASSERT_TRUE(storage.Open(file.c_str())) << n;
+    std::vector<string> values;
+    EXPECT_TRUE(storage.GetAllValues(&values));
+    EXPECT_EQ(expected_values, values) << n;
+    EXPECT_TRUE(storage.Lookup("key0") != NULL) << n;
+    EXPECT_TRUE(storage.Lookup("new") == NULL) << n;
+    storage.Close();
+
+    // Everything but the journal is restored.
+    const string restored = ReadFile(file);
+    ASSERT_EQ(before.size(), restored.size());
+    EXPECT_EQ(before.substr(0, kJournalOffset),
+              restored.substr(0, kJournalOffset)) << n;
+    EXPECT_EQ(before.substr(kJournalOffset + kJournalSize),
+              restored.substr(kJournalOffset + kJournalSize)) << n;
+  }
+}
+
+TEST_F(LRUStorageTest, CorruptedLinksTest) {
+  // Layout of the file; see lru_storage.cc.
+  const size_t kHeadOffset = 28;
+  const size_t kTailOffset = 32;
+  const size_t kFreeHeadOffset = 36;
+  const size_t kRecordsOffset = 64 + 4096;
+  const size_t kRecordSize = 20 + 4;
+  const size_t kPrevOffset = 12;
+  const size_t kNextOffset = 16;
+  const uint32 kEmptySlot = 0xFFFFFFFF;
+
+  const string file = GetTemporaryFilePath();
+  const int kSize = 8;
+  const size_t kIndexOffset = kRecordsOffset + kRecordSize * kSize;
+  const size_t kIndexSize = 16;
+  LRUStorage::CreateStorageFile(file.c_str(), 4, kSize, 0x76fef);
+  {
+    LRUStorage storage;
+    ASSERT_TRUE(storage.Open(file.c_str()));
+    for (uint32 i = 0; i < kSize / 2; ++i) {
+      storage.Insert("key" + std::to_string(i),
+                     reinterpret_cast<const char *>(&i));
+    }
+  }
+  const string original = ReadFile(file);
+  ASSERT_EQ(kIndexOffset + kIndexSize * 4, original.size());
+
+  struct Uint32Field {
+    static uint32 Get(const string &data, size_t offset) {
+      uint32 value = 0;
+      memcpy(&value, data.data() + offset, sizeof(value));
+      return value;
+    }
+    static void Set(size_t offset, uint32 value, string *data) {
+      data->replace(offset, sizeof(value),
+                    reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+  };
+  const uint32 head = Uint32Field::Get(original, kHeadOffset);
+  const uint32 tail = Uint32Field::Get(original, kTailOffset);
+  const uint32 free_head = Uint32Field::Get(original, kFreeHeadOffset);
+  size_t used_slot = kIndexSize;
+  for (size_t i = 0; i < kIndexSize; ++i) {
+    if (Uint32Field::Get(original, kIndexOffset + i * 4) != kEmptySlot) {
+      used_slot = i;
+      break;
+    }
+  }
+  ASSERT_LT(used_slot, kIndexSize);
+
+  std::vector<string> corrupted_files;
+  // Link out of the records.
+  corrupted_files.push_back(original);
+  Uint32Field::Set(kRecordsOffset + kRecordSize * tail + kNextOffset, 1000,
+                   &corrupted_files.back());
+  // Cycle in the LRU list.
+  corrupted_files.push_back(original);
+  Uint32Field::Set(kRecordsOffset + kRecordSize * head + kNextOffset, head,
+                   &corrupted_files.back());
+  // Cycle in the free list.
+  corrupted_files.push_back(original);
+  Uint32Field::Set(kRecordsOffset + kRecordSize * free_head + kNextOffset,
+                   free_head, &corrupted_files.back());
+  // Inconsistent backward link.
+  corrupted_files.push_back(original);
+  Uint32Field::Set(kRecordsOffset + kRecordSize * head + kPrevOffset, 0,
+                   &corrupted_files.back());
+  // Index slot out of the records.
+  corrupted_files.push_back(original);
+  Uint32Field::Set(kIndexOffset + used_slot * 4, 1000,
+                   &corrupted_files.back());
+  // Index slot to an unused record.
+  corrupted_files.push_back(original);
+  Uint32Field::Set(kIndexOffset + used_slot * 4, free_head,
+                   &corrupted_files.back());
+  // Record missing from the index.
+  corrupted_files.push_back(original);
+  Uint32Field::Set(kIndexOffset + used_slot * 4, kEmptySlot,
+                   &corrupted_files.back());
+
+  for (size_t i = 0; i < corrupted_files.size(); ++i) {
+    WriteFile(file, corrupted_files[i]);
+    LRUStorage storage;
+    ASSERT_TRUE(storage.Open(file.c_str())) << i;
+
+    // The updates following the broken links never go out of the file.
+    std::vector<string> values;
+    storage.GetAllValues(&values);
+    for (uint32 j = 0; j < kSize * 2; ++j) {
+      storage.Touch("key" + std::to_string(j % kSize));
+      storage.Insert("new" + std::to_string(j),
+                     reinterpret_cast<const char *>(&j));
+    }
+
+    // The storage is still usable, with the file recreated if the broken
+    // link is found.
+    const uint32 value = 100;
+    EXPECT_TRUE(storage.Insert("new", reinterpret_cast<const char *>(&value)))
+        << i;
+    EXPECT_TRUE(storage.Lookup("new") != NULL) << i;
+  }
+
+  // The file is recreated when an update finds the broken link.
+  WriteFile(file, corrupted_files[0]);
+  LRUStorage storage;
+  ASSERT_TRUE(storage.Open(file.c_str()));
+  std::vector<string> values;
+  EXPECT_FALSE(storage.GetAllValues(&values));
+  const uint32 value = 100;
+  for (uint32 i = 0; i < kSize; ++i) {
+    if (!storage.Insert("new" + std::to_string(i),
+                        reinterpret_cast<const char *>(&value))) {
+      break;
+    }
+  }
+  EXPECT_EQ(0, storage.used_size());
+  EXPECT_TRUE(storage.GetAllValues(&values));
+  EXPECT_TRUE(values.empty());
+
+  // Ends of the lists out of the records are found by Open(), and
+  // OpenOrCreate() recreates the file.
+  string broken_head = original;
+  Uint32Field::Set(kHeadOffset, 1000, &broken_head);
+  WriteFile(file, broken_head);
+  {
+    LRUStorage storage;
+    EXPECT_FALSE(storage.Open(file.c_str()));
+  }
+  ASSERT_TRUE(storage.OpenOrCreate(file.c_str(), 4, kSize, 0x76fef));
+  EXPECT_EQ(0, storage.used_size());
+}
+
 TEST_F(LRUStorageTest, InvalidFileOpenTest) {
   LRUStorage storage;
   EXPECT_FALSE(storage.Insert("test", NULL));
@@ -33,6 +33,7 @@
 #include <numeric>
 
 #include "base/logging.h"
+#include "base/mutex.h"
 #include "config/stats_config_util.h"
 #include "storage/registry.h"
 #include "usage_stats/usage_stats.pb.h"
@@ -43,6 +44,10 @@ namespace usage_stats {
 namespace {
 const char kRegistryPrefix[] = "usage_stats.";
 
+// Makes the read-modify-write of a stats entry atomic, as the sessions may be
+// evaluated in parallel.
+Mutex g_update_mutex;  // NOLINT
+
 #include "usage_stats/usage_stats_list.h"
 
 void AddDoubleValueStats(
@@ -151,6 +156,7 @@ void UsageStats::IncrementCountBy(const string &name, uint32 val) {
     return;
   }
 
+  scoped_lock l(&g_update_mutex);
   Stats stats;
   if (GetterInternal(name, Stats::COUNT, &stats)) {
     stats.set_count(stats.count() + val);
@@ -169,6 +175,7 @@ void UsageStats::UpdateTiming(const string &name, uint32 val) {
     return;
   }
 
+  scoped_lock l(&g_update_mutex);
   Stats stats;
   if (GetterInternal(name, Stats::TIMING, &stats)) {
     stats.set_num_timings(stats.num_timings() + 1);
@@ -327,6 +334,7 @@ void UsageStats::StoreTouchEventStats(
     return;
   }
 
+  scoped_lock l(&g_update_mutex);
   Stats stats;
   std::map<string, TouchEventStatsMap> tmp_stats(touch_stats);
   if (GetterInternal(name, Stats::VIRTUAL_KEYBOARD, &stats)) {